@@ -0,0 +1,250 @@
+//===================================================================
+// File: bench.cpp
+//
+// Desc: Renders a fixed workload over a sweep of configurations and
+//       writes frame time statistics as JSON lines.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/main.h"
+
+#include <cstdio>
+#include <sstream>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t BENCH_DEFAULT_FRAMES = 500; // Frames per configuration
+const uint32_t BENCH_DEFAULT_WARMUP = 50;  // Frames left out of statistics
+const char *BENCH_DEFAULT_OUTPUT = "bench_results.jsonl";
+
+//-------------------------------------------------------------------
+// BenchOptions (Struct Definition)
+//-------------------------------------------------------------------
+struct BenchOptions {
+  uint32_t frameCount = BENCH_DEFAULT_FRAMES;
+  double duration = 0.0; // seconds per configuration, replaces frameCount
+  uint32_t warmupFrames = BENCH_DEFAULT_WARMUP;
+  std::vector<std::string> presentModes = {"headless"};
+  std::vector<uint32_t> framesInFlight = {1, 2, 3};
+  std::vector<uint32_t> drawCounts = {1, 100, 1000};
+  std::vector<uint32_t> instanceCounts = {0};
+  bool gpuCulling = false; // cull instanced configurations on the GPU
+  uint32_t recordThreads = 0;
+  std::string outputPath = BENCH_DEFAULT_OUTPUT;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Splits a comma separated list.
+// ~Returns: vector of the list's items.
+static std::vector<std::string> splitList(const std::string &list) {
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) {
+      items.push_back(item);
+    }
+  }
+  if (items.empty()) {
+    throw std::runtime_error("empty list " + list + "!");
+  }
+  return items;
+}
+
+// Splits a comma separated list of integers, which must be positive unless
+// zero is allowed.
+// ~Returns: vector of the list's values.
+static std::vector<uint32_t> splitCounts(const std::string &list,
+                                         bool allowZero = false) {
+  std::vector<uint32_t> counts;
+  for (const auto &item : splitList(list)) {
+    uint32_t count = static_cast<uint32_t>(std::stoul(item));
+    if (count == 0 && !allowZero) {
+      throw std::runtime_error("counts must be at least 1 in " + list + "!");
+    }
+    counts.push_back(count);
+  }
+  return counts;
+}
+
+// Parses command line arguments into benchmark options.
+// ~Returns: BenchOptions struct with parsed options.
+static BenchOptions parseBenchOptions(int argc, char **argv) {
+  BenchOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    // fetch the value following an option that requires one
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("missing value for option " + arg + "!");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--frames") {
+      options.frameCount = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--duration") {
+      options.duration = std::stod(value());
+    } else if (arg == "--warmup") {
+      options.warmupFrames = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--present-modes") {
+      options.presentModes = splitList(value());
+      for (const auto &name : options.presentModes) {
+        if (name != "headless" && !parsePresentMode(name)) {
+          throw std::runtime_error("unknown present mode " + name + "!");
+        }
+      }
+    } else if (arg == "--frames-in-flight") {
+      options.framesInFlight = splitCounts(value());
+    } else if (arg == "--draws") {
+      options.drawCounts = splitCounts(value());
+    } else if (arg == "--instances") {
+      options.instanceCounts = splitCounts(value(), true);
+    } else if (arg == "--gpu-culling") {
+      options.gpuCulling = true;
+    } else if (arg == "--record-threads") {
+      options.recordThreads = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--output") {
+      options.outputPath = value();
+    } else if (arg == "--help") {
+      std::cout
+          << "usage: " << argv[0] << " [options]\n"
+          << "  --frames <n>        frames per configuration (default "
+          << BENCH_DEFAULT_FRAMES << ")\n"
+          << "  --duration <s>      seconds per configuration instead of\n"
+          << "                      a frame count\n"
+          << "  --warmup <n>        frames left out of the statistics\n"
+          << "                      (default " << BENCH_DEFAULT_WARMUP << ")\n"
+          << "  --present-modes <list>\n"
+          << "                      comma separated present modes, use\n"
+          << "                      headless for offscreen rendering\n"
+          << "                      (default headless)\n"
+          << "  --frames-in-flight <list>\n"
+          << "                      comma separated frames in flight\n"
+          << "                      (default 1,2,3)\n"
+          << "  --draws <list>      comma separated draws per frame\n"
+          << "                      (default 1,100,1000)\n"
+          << "  --instances <list>  comma separated instanced triangle\n"
+          << "                      counts, 0 for plain draws (default 0)\n"
+          << "  --gpu-culling       cull instanced configurations on the\n"
+          << "                      GPU and draw them indirectly\n"
+          << "  --record-threads <n>\n"
+          << "                      secondary recording threads\n"
+          << "  --output <file>     JSON lines results (default "
+          << BENCH_DEFAULT_OUTPUT << ")\n";
+      std::exit(EXIT_SUCCESS);
+    } else {
+      throw std::runtime_error("unknown option " + arg + "!");
+    }
+  }
+
+  if (options.frameCount == 0 && options.duration <= 0.0) {
+    throw std::runtime_error("either --frames or --duration must be set!");
+  }
+
+  return options;
+}
+
+// Renders one configuration and writes its statistics as a JSON line.
+static void runConfiguration(const BenchOptions &bench,
+                             const std::string &presentMode,
+                             uint32_t framesInFlight, uint32_t drawCount,
+                             uint32_t instanceCount, std::ostream &output) {
+  ApplicationOptions options;
+  options.headless = presentMode == "headless";
+  if (!options.headless) {
+    options.presentMode = parsePresentMode(presentMode);
+  }
+  options.frameCount = bench.duration > 0.0 ? 0 : bench.frameCount;
+  options.duration = bench.duration;
+  options.framesInFlight = framesInFlight;
+  options.drawCount = drawCount;
+  options.instanceCount = instanceCount;
+  options.gpuCulling = bench.gpuCulling && instanceCount > 0;
+  options.recordThreads = bench.recordThreads;
+  options.profiler = false;
+  options.collectFrameTimes = true;
+
+  HelloTriangleApplication app(options);
+  app.run();
+  const FrameReport &report = app.frameReport();
+
+  // leave the warmup frames out, pipeline creation and first submits are
+  // not representative
+  size_t warmup = std::min<size_t>(bench.warmupFrames,
+                                   report.frameTimes.size() / 2);
+  std::vector<double> frameTimes(report.frameTimes.begin() + warmup,
+                                 report.frameTimes.end());
+  std::vector<double> cpuFrameTimes(report.cpuFrameTimes.begin() + warmup,
+                                    report.cpuFrameTimes.end());
+
+  FrameTimeStats frameStats = summarizeFrameTimes(frameTimes);
+  FrameTimeStats cpuStats = summarizeFrameTimes(cpuFrameTimes);
+  FrameTimeStats gpuStats = app.gpuFrameStats();
+  double fps = frameStats.avg > 0.0 ? 1000.0 / frameStats.avg : 0.0;
+
+  // an unsupported mode falls back, so report what actually ran
+  std::string usedPresentMode =
+      report.presentMode ? presentModeName(*report.presentMode) : "headless";
+
+  // keys are written in a fixed order so results diff cleanly
+  char line[1024];
+  std::snprintf(
+      line, sizeof(line),
+      "{\"present_mode\":\"%s\",\"present_mode_used\":\"%s\","
+      "\"frames_in_flight\":%u,\"draws\":%u,\"instances\":%u,"
+      "\"gpu_culling\":%s,\"record_threads\":%u,"
+      "\"frames\":%zu,\"warmup\":%zu,\"fps\":%.3f,"
+      "\"frame_ms_p50\":%.4f,\"frame_ms_p95\":%.4f,\"frame_ms_p99\":%.4f,"
+      "\"frame_ms_max\":%.4f,\"cpu_ms_per_frame\":%.4f,"
+      "\"gpu_ms_p50\":%.4f,\"gpu_ms_p99\":%.4f}",
+      presentMode.c_str(), usedPresentMode.c_str(), framesInFlight, drawCount,
+      instanceCount, options.gpuCulling ? "true" : "false",
+      bench.recordThreads, frameStats.count, warmup, fps,
+      frameStats.p50, frameStats.p95, frameStats.p99, frameStats.max,
+      cpuStats.avg, gpuStats.p50, gpuStats.p99);
+  output << line << std::endl;
+  std::cout << line << std::endl;
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  try {
+    BenchOptions bench = parseBenchOptions(argc, argv);
+    std::ofstream output(bench.outputPath, std::ios::trunc);
+    if (!output) {
+      throw std::runtime_error("failed to open " + bench.outputPath + "!");
+    }
+
+    for (const auto &presentMode : bench.presentModes) {
+      for (uint32_t framesInFlight : bench.framesInFlight) {
+        for (uint32_t drawCount : bench.drawCounts) {
+          for (uint32_t instanceCount : bench.instanceCounts) {
+            runConfiguration(bench, presentMode, framesInFlight, drawCount,
+                             instanceCount, output);
+          }
+        }
+      }
+    }
+    std::cout << "wrote results to " << bench.outputPath << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
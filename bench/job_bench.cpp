@@ -0,0 +1,173 @@
+//===================================================================
+// File: job_bench.cpp
+//
+// Desc: Times how a parallel workload on the job system scales with the
+//       worker count.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/job_system.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const size_t JOB_BENCH_DEFAULT_ITEMS = 1 << 14;  // chunks in the workload
+const uint32_t JOB_BENCH_DEFAULT_REPEATS = 10;   // timed runs per worker count
+const uint32_t JOB_BENCH_WORK_PER_ITEM = 2000;   // iterations per chunk
+const char *JOB_BENCH_DEFAULT_OUTPUT = "job_bench_results.jsonl";
+
+//-------------------------------------------------------------------
+// JobBenchOptions (Struct Definition)
+//-------------------------------------------------------------------
+struct JobBenchOptions {
+  size_t items = JOB_BENCH_DEFAULT_ITEMS;
+  uint32_t repeats = JOB_BENCH_DEFAULT_REPEATS;
+  uint32_t maxWorkers = 0; // 0 = one per hardware thread besides main
+  std::string outputPath = JOB_BENCH_DEFAULT_OUTPUT;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Parses command line arguments into benchmark options.
+// ~Returns: JobBenchOptions struct with parsed options.
+static JobBenchOptions parseJobBenchOptions(int argc, char **argv) {
+  JobBenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("missing value for option " + arg + "!");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--items") {
+      options.items = std::stoul(value());
+    } else if (arg == "--repeats") {
+      options.repeats = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--max-workers") {
+      options.maxWorkers = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--output") {
+      options.outputPath = value();
+    } else if (arg == "--help") {
+      std::cout << "usage: " << argv[0] << " [options]\n"
+                << "  --items <n>         chunks in the timed workload\n"
+                << "                      (default "
+                << JOB_BENCH_DEFAULT_ITEMS << ")\n"
+                << "  --repeats <n>       timed runs per worker count\n"
+                << "                      (default "
+                << JOB_BENCH_DEFAULT_REPEATS << ")\n"
+                << "  --max-workers <n>   largest worker count timed\n"
+                << "                      (default: hardware threads - 1)\n"
+                << "  --output <file>     where to write the JSON lines\n"
+                << "                      (default "
+                << JOB_BENCH_DEFAULT_OUTPUT << ")\n";
+      std::exit(EXIT_SUCCESS);
+    } else {
+      throw std::runtime_error("unknown option " + arg + "!");
+    }
+  }
+  if (options.items == 0 || options.repeats == 0) {
+    throw std::runtime_error("--items and --repeats must be at least 1!");
+  }
+  return options;
+}
+
+// Stands in for per-item frame work: a dependent chain of float math
+// that the compiler can't remove.
+static float busyWork(size_t item) {
+  float value = static_cast<float>(item % 97) * 0.01f;
+  for (uint32_t i = 0; i < JOB_BENCH_WORK_PER_ITEM; i++) {
+    value = value * 0.999f + std::sqrt(value + 1.0f) * 0.001f;
+  }
+  return value;
+}
+
+// Times the workload on worker counts from 0 up to maxWorkers, doubling,
+// and writes a JSON line per count.
+static void benchScaling(const JobBenchOptions &options, std::ostream &output) {
+  uint32_t maxWorkers = options.maxWorkers;
+  if (maxWorkers == 0) {
+    maxWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  }
+  std::vector<uint32_t> workerCounts = {0};
+  for (uint32_t count = 1; count <= maxWorkers; count *= 2) {
+    workerCounts.push_back(count);
+  }
+  if (workerCounts.back() != maxWorkers) {
+    workerCounts.push_back(maxWorkers);
+  }
+
+  std::vector<float> results(options.items);
+  double baseline = 0.0;
+  for (uint32_t workers : workerCounts) {
+    JobSystem jobs(workers);
+    double best = 0.0;
+    for (uint32_t r = 0; r <= options.repeats; r++) {
+      auto start = std::chrono::steady_clock::now();
+      jobs.parallelFor(options.items, [&](size_t i, uint32_t) {
+        results[i] = busyWork(i);
+      });
+      double ms = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      // the first run is a warmup
+      if (r == 1 || (r > 1 && ms < best)) {
+        best = ms;
+      }
+    }
+    if (workers == 0) {
+      baseline = best;
+    }
+
+    char line[256];
+    std::snprintf(line, sizeof(line),
+                  "{\"workers\":%u,\"threads\":%u,\"items\":%zu,"
+                  "\"ms\":%.3f,\"speedup\":%.3f}",
+                  workers, jobs.size(), options.items, best,
+                  best > 0.0 ? baseline / best : 0.0);
+    output << line << std::endl;
+    std::cout << line << std::endl;
+  }
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  try {
+    JobBenchOptions options = parseJobBenchOptions(argc, argv);
+    std::ofstream output(options.outputPath, std::ios::trunc);
+    if (!output) {
+      throw std::runtime_error("failed to open " + options.outputPath + "!");
+    }
+
+    benchScaling(options, output);
+    std::cout << "wrote results to " << options.outputPath << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+//===================================================================
+// File: math_bench.cpp
+//
+// Desc: Times the SIMD math kernels against the scalar path, writing
+//       the results as JSON lines. vec_math_test checks they agree.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/vec_math.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const size_t MATH_BENCH_DEFAULT_COUNT = 1 << 20;  // items per batch
+const uint32_t MATH_BENCH_DEFAULT_REPEATS = 20;   // timed batches per kernel
+const char *MATH_BENCH_DEFAULT_OUTPUT = "math_bench_results.jsonl";
+
+//-------------------------------------------------------------------
+// MathBenchOptions (Struct Definition)
+//-------------------------------------------------------------------
+struct MathBenchOptions {
+  size_t count = MATH_BENCH_DEFAULT_COUNT;
+  uint32_t repeats = MATH_BENCH_DEFAULT_REPEATS;
+  std::string outputPath = MATH_BENCH_DEFAULT_OUTPUT;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Parses command line arguments into benchmark options.
+// ~Returns: MathBenchOptions struct with parsed options.
+static MathBenchOptions parseMathBenchOptions(int argc, char **argv) {
+  MathBenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("missing value for option " + arg + "!");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--count") {
+      options.count = std::stoul(value());
+    } else if (arg == "--repeats") {
+      options.repeats = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--output") {
+      options.outputPath = value();
+    } else if (arg == "--help") {
+      std::cout << "usage: " << argv[0] << " [options]\n"
+                << "  --count <n>         items per batch (default "
+                << MATH_BENCH_DEFAULT_COUNT << ")\n"
+                << "  --repeats <n>       timed batches per kernel (default "
+                << MATH_BENCH_DEFAULT_REPEATS << ")\n"
+                << "  --output <file>     where to write the JSON lines\n"
+                << "                      (default "
+                << MATH_BENCH_DEFAULT_OUTPUT << ")\n";
+      std::exit(EXIT_SUCCESS);
+    } else {
+      throw std::runtime_error("unknown option " + arg + "!");
+    }
+  }
+  if (options.count == 0 || options.repeats == 0) {
+    throw std::runtime_error("--count and --repeats must be at least 1!");
+  }
+  return options;
+}
+
+// Fills matrices with the transforms of randomly placed, rotated and
+// scaled objects, the workload the batch kernels are meant for.
+static void randomTransforms(std::mt19937 &random, Mat4 *out, size_t count) {
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+  std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+  for (size_t i = 0; i < count; i++) {
+    Vec3 axis = vec3(position(random), position(random), position(random));
+    out[i] = mat4Compose(
+        vec3(position(random), position(random), position(random)),
+        quatFromAxisAngle(axis, angle(random)),
+        vec3(scale(random), scale(random), scale(random)));
+  }
+}
+
+// Runs a batch repeats times after one warmup run.
+// ~Returns: the fastest run in nanoseconds per item.
+static double timeKernel(const std::function<void()> &kernel, size_t count,
+                         uint32_t repeats) {
+  kernel();
+  double best = 0.0;
+  for (uint32_t r = 0; r < repeats; r++) {
+    auto start = std::chrono::steady_clock::now();
+    kernel();
+    double ns = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start)
+                    .count() /
+                double(count);
+    best = r == 0 ? ns : std::min(best, ns);
+  }
+  return best;
+}
+
+// Times a kernel and its scalar reference and writes a JSON line.
+static void benchKernel(const char *name, const MathBenchOptions &options,
+                        const std::function<void()> &simd,
+                        const std::function<void()> &scalar,
+                        std::ostream &output) {
+  double simdNs = timeKernel(simd, options.count, options.repeats);
+  double scalarNs = timeKernel(scalar, options.count, options.repeats);
+
+  char line[512];
+  std::snprintf(line, sizeof(line),
+                "{\"kernel\":\"%s\",\"backend\":\"%s\",\"count\":%zu,"
+                "\"ns_per_item\":%.4f,\"scalar_ns_per_item\":%.4f,"
+                "\"speedup\":%.3f}",
+                name, vecMathBackend(), options.count, simdNs, scalarNs,
+                simdNs > 0.0 ? scalarNs / simdNs : 0.0);
+  output << line << std::endl;
+  std::cout << line << std::endl;
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  try {
+    MathBenchOptions options = parseMathBenchOptions(argc, argv);
+    std::ofstream output(options.outputPath, std::ios::trunc);
+    if (!output) {
+      throw std::runtime_error("failed to open " + options.outputPath + "!");
+    }
+
+    // fixed seed, so runs are comparable
+    std::mt19937 random(1234);
+
+    size_t count = options.count;
+    std::vector<Mat4> a(count), b(count), simdOut(count), scalarOut(count);
+    randomTransforms(random, a.data(), count);
+    randomTransforms(random, b.data(), count);
+    Mat4 viewProjection = a[0];
+    std::vector<Vec4> points(count), simdPoints(count), scalarPoints(count);
+    for (size_t i = 0; i < count; i++) {
+      points[i] = mat4MulVec4Scalar(b[i], vec4(0.0f, 0.0f, 0.0f, 1.0f));
+    }
+
+    benchKernel(
+        "mat4MulBatch", options,
+        [&]() {
+          mat4MulBatch(viewProjection, b.data(), simdOut.data(), count);
+        },
+        [&]() {
+          mat4MulBatchScalar(viewProjection, b.data(), scalarOut.data(),
+                             count);
+        },
+        output);
+    benchKernel(
+        "mat4MulPairs", options,
+        [&]() { mat4MulPairs(a.data(), b.data(), simdOut.data(), count); },
+        [&]() {
+          mat4MulPairsScalar(a.data(), b.data(), scalarOut.data(), count);
+        },
+        output);
+    benchKernel(
+        "mat4TransformBatch", options,
+        [&]() {
+          mat4TransformBatch(viewProjection, points.data(), simdPoints.data(),
+                             count);
+        },
+        [&]() {
+          mat4TransformBatchScalar(viewProjection, points.data(),
+                                   scalarPoints.data(), count);
+        },
+        output);
+
+    std::cout << "wrote results to " << options.outputPath << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,494 @@
+//===================================================================
+// File: mesh_bench.cpp
+//
+// Desc: Checks the mesh loader against generated OBJ and glTF files and
+//       times how loading a large mesh scales with the worker count.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/mesh_loader.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t MESH_BENCH_DEFAULT_GRID = 1024;  // quads per side, 2M triangles
+const uint32_t MESH_BENCH_CHECK_GRID = 7;       // grid of the format checks
+const uint32_t MESH_BENCH_DEFAULT_REPEATS = 3;  // timed loads per worker count
+const char *MESH_BENCH_DEFAULT_OUTPUT = "mesh_bench_results.jsonl";
+const char *MESH_BENCH_FILE_PREFIX = "mesh_bench_grid";
+
+//-------------------------------------------------------------------
+// MeshBenchOptions (Struct Definition)
+//-------------------------------------------------------------------
+struct MeshBenchOptions {
+  uint32_t grid = MESH_BENCH_DEFAULT_GRID;
+  uint32_t repeats = MESH_BENCH_DEFAULT_REPEATS;
+  uint32_t maxWorkers = 0; // 0 = one per hardware thread besides main
+  std::string outputPath = MESH_BENCH_DEFAULT_OUTPUT;
+};
+
+//-------------------------------------------------------------------
+// GltfLayout (Enum Definition)
+//-------------------------------------------------------------------
+
+// Where a generated glTF file keeps its buffer.
+enum GltfLayout {
+  GLTF_LAYOUT_EXTERNAL, // .gltf next to a .bin
+  GLTF_LAYOUT_DATA_URI, // .gltf with the buffer in base64
+  GLTF_LAYOUT_BINARY    // .glb
+};
+
+//-------------------------------------------------------------------
+// GridTransform (Struct Definition)
+//-------------------------------------------------------------------
+
+// Node transform written into generated glTF files, a uniform scale
+// followed by a translation along x.
+struct GridTransform {
+  float scale = 1.0f;
+  float offset = 0.0f;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Parses command line arguments into benchmark options.
+// ~Returns: MeshBenchOptions struct with parsed options.
+static MeshBenchOptions parseMeshBenchOptions(int argc, char **argv) {
+  MeshBenchOptions options;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("missing value for option " + arg + "!");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--grid") {
+      options.grid = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--repeats") {
+      options.repeats = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--max-workers") {
+      options.maxWorkers = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--output") {
+      options.outputPath = value();
+    } else if (arg == "--help") {
+      std::cout << "usage: " << argv[0] << " [options]\n"
+                << "  --grid <n>          quads per side of the timed mesh\n"
+                << "                      (default "
+                << MESH_BENCH_DEFAULT_GRID << ")\n"
+                << "  --repeats <n>       timed loads per worker count\n"
+                << "                      (default "
+                << MESH_BENCH_DEFAULT_REPEATS << ")\n"
+                << "  --max-workers <n>   largest worker count timed\n"
+                << "                      (default: hardware threads - 1)\n"
+                << "  --output <file>     where to write the JSON lines\n"
+                << "                      (default "
+                << MESH_BENCH_DEFAULT_OUTPUT << ")\n";
+      std::exit(EXIT_SUCCESS);
+    } else {
+      throw std::runtime_error("unknown option " + arg + "!");
+    }
+  }
+  if (options.grid == 0 || options.repeats == 0) {
+    throw std::runtime_error("--grid and --repeats must be at least 1!");
+  }
+  return options;
+}
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + "!");
+  }
+}
+
+// Writes bytes to a new file at path.
+static void writeBytes(const std::string &path, const std::string &bytes) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(bytes.data(), bytes.size());
+  if (!file) {
+    throw std::runtime_error("failed to write " + path + "!");
+  }
+}
+
+// Writes a grid of grid x grid unit quads in the xy plane as an OBJ file,
+// with shared positions and uvs and a single normal. Faces are quads the
+// loader has to triangulate, and the last row uses relative indices.
+static void writeGridObj(const std::string &path, uint32_t grid) {
+  std::string text = "# generated grid\no grid\n";
+  text.reserve(size_t(grid + 1) * (grid + 1) * 40 + size_t(grid) * grid * 40);
+  char line[128];
+  for (uint32_t y = 0; y <= grid; y++) {
+    for (uint32_t x = 0; x <= grid; x++) {
+      text.append(line, std::snprintf(line, sizeof(line), "v %u %u 0\n", x, y));
+    }
+  }
+  for (uint32_t y = 0; y <= grid; y++) {
+    for (uint32_t x = 0; x <= grid; x++) {
+      text.append(line, std::snprintf(line, sizeof(line), "vt %.6f %.6f\n",
+                                      float(x) / grid, float(y) / grid));
+    }
+  }
+  text += "vn 0 0 1\ns off\n";
+
+  uint32_t row = grid + 1;
+  uint32_t vertexCount = row * row;
+  for (uint32_t y = 0; y < grid; y++) {
+    for (uint32_t x = 0; x < grid; x++) {
+      uint32_t a = y * row + x + 1;
+      uint32_t corners[4] = {a, a + 1, a + row + 1, a + row};
+      text += "f";
+      for (uint32_t corner : corners) {
+        if (y + 1 == grid) {
+          int relative = int(corner) - int(vertexCount) - 1;
+          text.append(line, std::snprintf(line, sizeof(line), " %d/%d/-1",
+                                          relative, relative));
+        } else {
+          text.append(line, std::snprintf(line, sizeof(line), " %u/%u/1",
+                                          corner, corner));
+        }
+      }
+      text += "\n";
+    }
+  }
+  writeBytes(path, text);
+}
+
+// Appends the raw bytes of values to a buffer.
+template <typename T>
+static void appendValues(std::string &buffer, const std::vector<T> &values) {
+  buffer.append(reinterpret_cast<const char *>(values.data()),
+                values.size() * sizeof(T));
+}
+
+// Writes the same grid as writeGridObj() as glTF in layout. Unindexed
+// grids repeat every corner. The mesh is placed by a child node, the
+// parent translating and the child scaling.
+static void writeGridGltf(const std::string &path, uint32_t grid,
+                          GltfLayout layout, bool indexed,
+                          const GridTransform &transform) {
+  uint32_t row = grid + 1;
+  std::vector<float> positions, normals, uvs;
+  std::vector<uint32_t> indices;
+  for (uint32_t y = 0; y <= grid; y++) {
+    for (uint32_t x = 0; x <= grid; x++) {
+      positions.insert(positions.end(), {float(x), float(y), 0.0f});
+      normals.insert(normals.end(), {0.0f, 0.0f, 1.0f});
+      uvs.insert(uvs.end(), {float(x) / grid, 1.0f - float(y) / grid});
+    }
+  }
+  for (uint32_t y = 0; y < grid; y++) {
+    for (uint32_t x = 0; x < grid; x++) {
+      uint32_t a = y * row + x;
+      indices.insert(indices.end(),
+                     {a, a + 1, a + row + 1, a, a + row + 1, a + row});
+    }
+  }
+  if (!indexed) {
+    std::vector<float> p, n, t;
+    for (uint32_t i : indices) {
+      auto position = positions.begin() + i * 3;
+      auto normal = normals.begin() + i * 3;
+      auto uv = uvs.begin() + i * 2;
+      p.insert(p.end(), position, position + 3);
+      n.insert(n.end(), normal, normal + 3);
+      t.insert(t.end(), uv, uv + 2);
+    }
+    positions.swap(p);
+    normals.swap(n);
+    uvs.swap(t);
+  }
+
+  std::string bin;
+  appendValues(bin, positions);
+  appendValues(bin, normals);
+  appendValues(bin, uvs);
+  if (indexed) {
+    appendValues(bin, indices);
+  }
+  size_t count = positions.size() / 3;
+  size_t views[4] = {positions.size() * 4, normals.size() * 4,
+                     uvs.size() * 4, indexed ? indices.size() * 4 : 0};
+
+  bool binary = layout == GLTF_LAYOUT_BINARY;
+  std::string uri;
+  if (layout == GLTF_LAYOUT_DATA_URI) {
+    static const char *alphabet =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    uri = "data:application/octet-stream;base64,";
+    for (size_t i = 0; i < bin.size(); i += 3) {
+      uint32_t bits = uint8_t(bin[i]) << 16;
+      bits |= i + 1 < bin.size() ? uint8_t(bin[i + 1]) << 8 : 0;
+      bits |= i + 2 < bin.size() ? uint8_t(bin[i + 2]) : 0;
+      for (size_t c = 0; c < 4; c++) {
+        uri += i + c <= bin.size() ? alphabet[(bits >> (18 - 6 * c)) & 63]
+                                   : '=';
+      }
+    }
+  } else if (!binary) {
+    // the space makes the loader decode the URI
+    std::string binPath = path.substr(0, path.find_last_of('.')) + " data.bin";
+    writeBytes(binPath, bin);
+    uri = binPath.substr(binPath.find_last_of('/') + 1);
+    uri.replace(uri.find(' '), 1, "%20");
+  }
+
+  char text[2048];
+  std::string json = "{\"asset\":{\"version\":\"2.0\"},\"scene\":0,"
+                     "\"scenes\":[{\"nodes\":[0]}],";
+  std::snprintf(text, sizeof(text),
+                "\"nodes\":[{\"children\":[1],\"translation\":[%g,0,0]},"
+                "{\"mesh\":0,\"scale\":[%g,%g,%g]}],",
+                transform.offset, transform.scale, transform.scale,
+                transform.scale);
+  json += text;
+  json += indexed ? "\"meshes\":[{\"primitives\":[{\"attributes\":"
+                    "{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},"
+                    "\"indices\":3}]}],"
+                  : "\"meshes\":[{\"primitives\":[{\"attributes\":"
+                    "{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2}}]}],";
+  json += "\"buffers\":[{" +
+          (binary ? std::string() : "\"uri\":\"" + uri + "\",") +
+          "\"byteLength\":" + std::to_string(bin.size()) + "}],";
+  json += "\"bufferViews\":[";
+  size_t offset = 0;
+  for (size_t i = 0; i < (indexed ? 4u : 3u); i++) {
+    std::snprintf(text, sizeof(text),
+                  "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}",
+                  i > 0 ? "," : "", offset, views[i]);
+    json += text;
+    offset += views[i];
+  }
+  std::snprintf(text, sizeof(text),
+                "],\"accessors\":["
+                "{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,"
+                "\"type\":\"VEC3\"},"
+                "{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,"
+                "\"type\":\"VEC3\"},"
+                "{\"bufferView\":2,\"componentType\":5126,\"count\":%zu,"
+                "\"type\":\"VEC2\"}",
+                count, count, count);
+  json += text;
+  if (indexed) {
+    std::snprintf(text, sizeof(text),
+                  ",{\"bufferView\":3,\"componentType\":5125,\"count\":%zu,"
+                  "\"type\":\"SCALAR\"}",
+                  indices.size());
+    json += text;
+  }
+  json += "]}";
+
+  if (!binary) {
+    writeBytes(path, json);
+    return;
+  }
+
+  // chunks are padded to four bytes, JSON with spaces and BIN with zeros
+  json.resize((json.size() + 3) & ~size_t(3), ' ');
+  bin.resize((bin.size() + 3) & ~size_t(3), '\0');
+  uint32_t header[5] = {0x46546c67, 2,
+                        uint32_t(12 + 8 + json.size() + 8 + bin.size()),
+                        uint32_t(json.size()), 0x4e4f534a};
+  uint32_t binHeader[2] = {uint32_t(bin.size()), 0x004e4942};
+  std::string glb(reinterpret_cast<const char *>(header), sizeof(header));
+  glb += json;
+  glb.append(reinterpret_cast<const char *>(binHeader), sizeof(binHeader));
+  glb += bin;
+  writeBytes(path, glb);
+}
+
+// Checks a loaded grid: the vertices are the unique grid points, every
+// index is valid, the triangles face +z and cover the grid exactly once,
+// and the bounds match the transform.
+static void checkGrid(const MeshData &mesh, uint32_t grid,
+                      const GridTransform &transform,
+                      const std::string &name) {
+  size_t row = grid + 1;
+  check(mesh.vertices.size() == row * row,
+        name + ": expected " + std::to_string(row * row) +
+            " unique vertices, got " + std::to_string(mesh.vertices.size()));
+  check(mesh.indices.size() == size_t(grid) * grid * 6,
+        name + ": wrong index count " + std::to_string(mesh.indices.size()));
+
+  double area = 0.0;
+  for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+    const float *p[3];
+    for (size_t c = 0; c < 3; c++) {
+      check(mesh.indices[i + c] < mesh.vertices.size(),
+            name + ": index out of range");
+      p[c] = mesh.vertices[mesh.indices[i + c]].position;
+    }
+    double cross = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) -
+                   (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+    check(cross > 0.0, name + ": a triangle is flipped or degenerate");
+    area += cross * 0.5;
+  }
+  double side = double(grid) * transform.scale;
+  check(std::fabs(area - side * side) <= 1e-3 * side * side,
+        name + ": triangles cover " + std::to_string(area) +
+            " instead of " + std::to_string(side * side));
+  check(std::fabs(mesh.boundsMin[0] - transform.offset) < 1e-3f &&
+            std::fabs(mesh.boundsMax[0] - transform.offset - side) < 1e-3 &&
+            std::fabs(mesh.boundsMax[1] - side) < 1e-3,
+        name + ": wrong bounds");
+  for (const MeshVertex &vertex : mesh.vertices) {
+    check(vertex.normal[2] > 0.999f, name + ": wrong normal");
+    check(vertex.uv[0] >= 0.0f && vertex.uv[0] <= 1.0f,
+          name + ": wrong uv");
+  }
+}
+
+// Loads small grids in every supported layout and checks them.
+static void checkFormats(JobSystem &jobs, const std::string &directory) {
+  uint32_t grid = MESH_BENCH_CHECK_GRID;
+  std::string base = directory + "/" + MESH_BENCH_FILE_PREFIX + "_check";
+  GridTransform identity;
+  GridTransform moved = {2.5f, 3.0f};
+
+  writeGridObj(base + ".obj", grid);
+  checkGrid(loadMesh(base + ".obj", jobs), grid, identity, "obj");
+
+  struct GltfCase {
+    const char *suffix;
+    GltfLayout layout;
+    bool indexed;
+  };
+  for (GltfCase c : {GltfCase{".gltf", GLTF_LAYOUT_EXTERNAL, true},
+                     GltfCase{"_data.gltf", GLTF_LAYOUT_DATA_URI, true},
+                     GltfCase{".glb", GLTF_LAYOUT_BINARY, true},
+                     GltfCase{"_flat.glb", GLTF_LAYOUT_BINARY, false}}) {
+    std::string path = base + c.suffix;
+    writeGridGltf(path, grid, c.layout, c.indexed, moved);
+    checkGrid(loadMesh(path, jobs), grid, moved, path);
+    std::remove(path.c_str());
+  }
+  std::remove((base + " data.bin").c_str());
+  std::remove((base + ".obj").c_str());
+
+  // malformed input is reported instead of read past
+  std::string broken = base + "_broken.obj";
+  writeBytes(broken, "v 0 0 0\nv 1 0 0\nf 1 2 3\n");
+  bool caught = false;
+  try {
+    loadMesh(broken, jobs);
+  } catch (const std::runtime_error &) {
+    caught = true;
+  }
+  std::remove(broken.c_str());
+  check(caught, "a face referencing a missing vertex was accepted");
+}
+
+// Times loading the large grid as OBJ and GLB on worker counts from 0 up
+// to maxWorkers, doubling, and writes a JSON line per format and count.
+static void benchLoading(const MeshBenchOptions &options,
+                         const std::string &directory, std::ostream &output) {
+  uint32_t maxWorkers = options.maxWorkers;
+  if (maxWorkers == 0) {
+    maxWorkers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+  }
+  std::vector<uint32_t> workerCounts = {0};
+  for (uint32_t count = 1; count <= maxWorkers; count *= 2) {
+    workerCounts.push_back(count);
+  }
+  if (workerCounts.back() != maxWorkers) {
+    workerCounts.push_back(maxWorkers);
+  }
+
+  std::string base = directory + "/" + MESH_BENCH_FILE_PREFIX;
+  writeGridObj(base + ".obj", options.grid);
+  writeGridGltf(base + ".glb", options.grid, GLTF_LAYOUT_BINARY, true,
+                GridTransform());
+
+  for (const char *format : {"obj", "glb"}) {
+    std::string path = base + "." + format;
+    double baseline = 0.0;
+    for (uint32_t workers : workerCounts) {
+      JobSystem jobs(workers);
+      double best = 0.0;
+      for (uint32_t r = 0; r < options.repeats; r++) {
+        auto start = std::chrono::steady_clock::now();
+        MeshData mesh = loadMesh(path, jobs);
+        double ms = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+        if (r == 0) {
+          checkGrid(mesh, options.grid, GridTransform(), path);
+        }
+        if (r == 0 || ms < best) {
+          best = ms;
+        }
+      }
+      if (workers == 0) {
+        baseline = best;
+      }
+
+      char line[256];
+      std::snprintf(line, sizeof(line),
+                    "{\"format\":\"%s\",\"workers\":%u,\"threads\":%u,"
+                    "\"triangles\":%zu,\"ms\":%.3f,\"speedup\":%.3f}",
+                    format, workers, jobs.size(),
+                    size_t(options.grid) * options.grid * 2, best,
+                    best > 0.0 ? baseline / best : 0.0);
+      output << line << std::endl;
+      std::cout << line << std::endl;
+    }
+    std::remove(path.c_str());
+  }
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main(int argc, char **argv) {
+  try {
+    MeshBenchOptions options = parseMeshBenchOptions(argc, argv);
+    std::ofstream output(options.outputPath, std::ios::trunc);
+    if (!output) {
+      throw std::runtime_error("failed to open " + options.outputPath + "!");
+    }
+
+    // the generated files go next to the results
+    std::string directory = ".";
+    size_t slash = options.outputPath.find_last_of('/');
+    if (slash != std::string::npos) {
+      directory = options.outputPath.substr(0, slash);
+    }
+
+    for (uint32_t workers : {0u, 3u}) {
+      JobSystem jobs(workers);
+      checkFormats(jobs, directory);
+      std::cout << "format checks passed with " << workers << " worker(s)"
+                << std::endl;
+    }
+
+    benchLoading(options, directory, output);
+    std::cout << "wrote results to " << options.outputPath << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+# Embeds SPIR-V modules into a C++ include file as aligned constexpr word
+# arrays plus a table naming them, consumed by src/embedded_shaders.cpp.
+#
+# usage: cmake -DOUTPUT=<file> -DINPUTS=<a.spv,b.spv,...> -P embed_spirv.cmake
+#
+# Inputs are comma separated, a semicolon list would be split into several
+# arguments on its way through add_custom_command.
+
+string(REPLACE "," ";" INPUTS "${INPUTS}")
+
+set(ARRAYS "")
+set(TABLE "")
+foreach(INPUT ${INPUTS})
+  get_filename_component(NAME ${INPUT} NAME)
+  string(MAKE_C_IDENTIFIER "SPIRV_${NAME}" IDENTIFIER)
+
+  file(READ ${INPUT} HEX HEX)
+  string(LENGTH "${HEX}" HEX_LENGTH)
+  math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+  if(HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${INPUT} is not a stream of 32-bit words")
+  endif()
+
+  # SPIR-V words are little endian, five of them per line
+  string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u, " WORDS "${HEX}")
+  set(WORD "0x[0-9a-f]+u, ")
+  string(REGEX REPLACE "(${WORD}${WORD}${WORD}${WORD}${WORD})" "\\1\n    "
+         WORDS "${WORDS}")
+  string(REPLACE ", \n" ",\n" WORDS "${WORDS}")
+  string(REGEX REPLACE "[ \n]+$" "" WORDS "${WORDS}")
+  string(REGEX REPLACE ",$" "" WORDS "${WORDS}")
+
+  string(APPEND ARRAYS
+    "alignas(16) constexpr uint32_t ${IDENTIFIER}[] = {\n    ${WORDS}};\n\n")
+  string(APPEND TABLE
+    "    {\"${NAME}\", ${IDENTIFIER}, sizeof(${IDENTIFIER})},\n")
+endforeach()
+
+set(CONTENT "// Generated by cmake/embed_spirv.cmake, do not edit.\n\n")
+string(APPEND CONTENT "${ARRAYS}")
+string(APPEND CONTENT "constexpr EmbeddedShader EMBEDDED_SHADERS[] = {\n")
+string(APPEND CONTENT "${TABLE}};\n")
+
+# keep the timestamp when nothing changed, so dependents aren't rebuilt
+if(EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} PREVIOUS)
+endif()
+if(NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+  file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
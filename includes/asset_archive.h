@@ -0,0 +1,127 @@
+//===================================================================
+// File: asset_archive.h
+//
+// Desc: Packed asset archive that is memory mapped and read in place.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t ASSET_ARCHIVE_MAGIC = 0x4b505648; // "HVPK"
+const uint32_t ASSET_ARCHIVE_VERSION = 1;
+const size_t ASSET_ARCHIVE_NAME_SIZE = 48; // including the terminator
+const size_t ASSET_ARCHIVE_ALIGNMENT = 16; // blob alignment, SPIR-V needs 4
+
+//-------------------------------------------------------------------
+// AssetArchiveHeader (Struct Definition)
+//-------------------------------------------------------------------
+
+// Start of an archive. It is followed by entryCount AssetArchiveEntry
+// records sorted by name, then by the blobs, each starting at a multiple of
+// ASSET_ARCHIVE_ALIGNMENT from the start of the file.
+struct AssetArchiveHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+};
+
+//-------------------------------------------------------------------
+// AssetArchiveEntry (Struct Definition)
+//-------------------------------------------------------------------
+struct AssetArchiveEntry {
+  char name[ASSET_ARCHIVE_NAME_SIZE]; // zero padded
+  uint64_t offset;                    // from the start of the file
+  uint64_t size;                      // in bytes
+};
+
+//-------------------------------------------------------------------
+// AssetBlob (Struct Definition)
+//-------------------------------------------------------------------
+
+// View of an asset inside a mapped archive, valid until it is closed.
+struct AssetBlob {
+  const void *data = nullptr; // aligned to ASSET_ARCHIVE_ALIGNMENT
+  size_t size = 0;
+};
+
+//-------------------------------------------------------------------
+// AssetSource (Struct Definition)
+//-------------------------------------------------------------------
+
+// Asset handed to writeAssetArchive().
+struct AssetSource {
+  std::string name;
+  std::vector<char> data;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+void writeAssetArchive(const std::string &path,
+                       std::vector<AssetSource> assets);
+
+//-------------------------------------------------------------------
+// AssetArchive (Class Definition)
+//-------------------------------------------------------------------
+
+// Read-only archive mapped into memory with a single open. Lookups binary
+// search the index and return pointers into the mapping, so blobs reach
+// Vulkan without being copied. Where mmap is unavailable the file is read
+// into one aligned buffer instead.
+class AssetArchive {
+public:
+  //-----------------------------------------------------------------
+  // AssetArchive - Public Methods
+  //-----------------------------------------------------------------
+
+  AssetArchive() = default;
+  ~AssetArchive();
+  AssetArchive(const AssetArchive &) = delete;
+  AssetArchive &operator=(const AssetArchive &) = delete;
+
+  bool open(const std::string &path);
+  void close();
+  bool isOpen() const { return base != nullptr; }
+  uint32_t size() const { return entryCount; }
+  AssetBlob find(const std::string &name) const;
+
+private:
+  //-----------------------------------------------------------------
+  // AssetArchive - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct alignas(ASSET_ARCHIVE_ALIGNMENT) AlignedChunk {
+    char bytes[ASSET_ARCHIVE_ALIGNMENT];
+  };
+
+  //-----------------------------------------------------------------
+  // AssetArchive - Private Member Variables
+  //-----------------------------------------------------------------
+  const char *base = nullptr; // start of the mapped file
+  size_t fileSize = 0;
+  const AssetArchiveEntry *entries = nullptr;
+  uint32_t entryCount = 0;
+  std::vector<AlignedChunk> fallbackBuffer; // backs base without mmap
+
+  //-----------------------------------------------------------------
+  // AssetArchive - Private Methods
+  //-----------------------------------------------------------------
+
+  void validate();
+};
@@ -0,0 +1,81 @@
+//===================================================================
+// File: async_compute.h
+//
+// Desc: Submits per-frame compute work on a dedicated compute queue
+//       that overlaps with graphics work.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "timeline_semaphore.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+
+//-------------------------------------------------------------------
+// AsyncCompute (Class Definition)
+//-------------------------------------------------------------------
+
+// Records and submits one compute command buffer per frame in flight. Each
+// submission signals a semaphore that the frame's graphics submit waits on,
+// so compute for the next frame runs while the GPU is still rasterizing the
+// previous one. The frame's fence, or its graphics timeline value, guards
+// reuse of its command buffer, since the graphics submit that signals it
+// waited on the compute submission. With timeline semaphores every frame
+// signals the next value of a single semaphore instead of a binary
+// semaphore of its own.
+//
+// With a compute family separate from graphics, every buffer the graphics
+// queue reads must be handed over with releaseBuffer(), and the graphics
+// command buffer must start with recordAcquireBarriers(). Without one,
+// compute is submitted to the graphics queue and the semaphore alone orders
+// the two submissions.
+class AsyncCompute {
+public:
+  //-----------------------------------------------------------------
+  // AsyncCompute - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, uint32_t graphicsFamily, uint32_t computeFamily,
+            VkQueue computeQueue, uint32_t framesInFlight, bool timeline);
+  void destroy();
+  bool isAsync() const { return computeFamily != graphicsFamily; }
+  VkCommandBuffer begin(uint32_t frame);
+  void releaseBuffer(uint32_t frame, const VkDescriptorBufferInfo &range,
+                     VkPipelineStageFlags srcStages, VkAccessFlags srcAccess,
+                     VkPipelineStageFlags dstStages, VkAccessFlags dstAccess);
+  VkSemaphore submit(uint32_t frame, VkPipelineStageFlags *waitStages,
+                     uint64_t *waitValue);
+  void recordAcquireBarriers(VkCommandBuffer commandBuffer, uint32_t frame);
+
+private:
+  //-----------------------------------------------------------------
+  // AsyncCompute - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct Frame {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkSemaphore semaphore = VK_NULL_HANDLE; // binary semaphores only
+    VkPipelineStageFlags srcStages = 0; // stages writing released buffers
+    VkPipelineStageFlags dstStages = 0; // graphics stages reading them
+    std::vector<VkBufferMemoryBarrier> releaseBarriers;
+    std::vector<VkBufferMemoryBarrier> acquireBarriers;
+  };
+
+  //-----------------------------------------------------------------
+  // AsyncCompute - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  uint32_t graphicsFamily = 0;
+  uint32_t computeFamily = 0;
+  VkQueue computeQueue = VK_NULL_HANDLE;
+  bool timeline = false;
+  TimelineSemaphore timelineSemaphore;
+  std::vector<Frame> frames;
+};
@@ -0,0 +1,88 @@
+//===================================================================
+// File: command_recorder.h
+//
+// Desc: Records slices of a draw list into secondary command buffers
+//       on worker threads.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "job_system.h"
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <memory>
+#include <vector>
+
+//-------------------------------------------------------------------
+// DrawCommand (Struct Definition)
+//-------------------------------------------------------------------
+struct DrawCommand {
+  uint32_t vertexCount;
+  uint32_t instanceCount;
+  uint32_t firstVertex;
+  uint32_t firstInstance;
+};
+
+//-------------------------------------------------------------------
+// ParallelCommandRecorder (Class Definition)
+//-------------------------------------------------------------------
+class ParallelCommandRecorder {
+public:
+  //-----------------------------------------------------------------
+  // ParallelCommandRecorder - Public Types
+  //-----------------------------------------------------------------
+
+  // Records draws [begin, end) into a secondary command buffer that has
+  // already been begun inside the render pass.
+  using RecordSlice =
+      std::function<void(VkCommandBuffer commandBuffer, size_t begin,
+                         size_t end)>;
+
+  //-----------------------------------------------------------------
+  // ParallelCommandRecorder - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, uint32_t queueFamilyIndex, JobSystem *jobs,
+            uint32_t maxSlices, uint32_t framesInFlight);
+  void destroy();
+  bool isEnabled() const { return jobs != nullptr; }
+  uint32_t sliceCount() const { return jobs ? maxSlices : 0; }
+  void resetFrame(uint32_t frame);
+  const std::vector<VkCommandBuffer> &
+  record(uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance,
+         size_t drawCount, const RecordSlice &recordSlice);
+
+private:
+  //-----------------------------------------------------------------
+  // ParallelCommandRecorder - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  // Command pool owned by one worker for one frame in flight. Buffers are
+  // allocated on first use and reused after the pool is reset.
+  struct WorkerFrame {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers;
+    size_t buffersUsed = 0;
+  };
+
+  //-----------------------------------------------------------------
+  // ParallelCommandRecorder - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  JobSystem *jobs = nullptr;
+  uint32_t maxSlices = 0;
+  std::vector<std::vector<WorkerFrame>> workerFrames; // [thread][frame]
+  std::vector<VkCommandBuffer> secondaryBuffers;
+
+  //-----------------------------------------------------------------
+  // ParallelCommandRecorder - Private Methods
+  //-----------------------------------------------------------------
+
+  VkCommandBuffer acquireBuffer(WorkerFrame &workerFrame);
+};
@@ -0,0 +1,115 @@
+//===================================================================
+// File: descriptor_allocator.h
+//
+// Desc: Descriptor set layout cache and descriptor pools that grow on
+//       demand and are recycled per frame in flight.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <map>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t DESCRIPTOR_POOL_SETS = 64; // sets per pool
+
+// Descriptors per pool for each type, as a multiple of the set count.
+const std::vector<std::pair<VkDescriptorType, float>> descriptorPoolRatios = {
+    {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+    {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f}};
+
+//-------------------------------------------------------------------
+// DescriptorLayoutCache (Class Definition)
+//-------------------------------------------------------------------
+
+// Creates each distinct descriptor set layout once. Layouts are looked up
+// by their bindings, so passes asking for the same interface share one
+// handle, and all of them are destroyed together.
+class DescriptorLayoutCache {
+public:
+  //-----------------------------------------------------------------
+  // DescriptorLayoutCache - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device);
+  void destroy();
+  VkDescriptorSetLayout
+  get(std::vector<VkDescriptorSetLayoutBinding> bindings);
+  size_t size() const { return layouts.size(); }
+
+private:
+  //-----------------------------------------------------------------
+  // DescriptorLayoutCache - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  // binding, type, count and stages of every binding, ordered by binding
+  using LayoutKey = std::vector<
+      std::tuple<uint32_t, VkDescriptorType, uint32_t, VkShaderStageFlags>>;
+
+  //-----------------------------------------------------------------
+  // DescriptorLayoutCache - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  std::map<LayoutKey, VkDescriptorSetLayout> layouts;
+};
+
+//-------------------------------------------------------------------
+// DescriptorAllocator (Class Definition)
+//-------------------------------------------------------------------
+
+// Allocates descriptor sets from fixed size pools, adding a pool whenever
+// the current one runs out. Persistent sets live until destroy(); frame
+// sets come from pools owned by one frame in flight, which resetFrame()
+// recycles in bulk once that frame's previous submission has completed,
+// so transient sets are never freed one by one.
+class DescriptorAllocator {
+public:
+  //-----------------------------------------------------------------
+  // DescriptorAllocator - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, uint32_t framesInFlight);
+  void destroy();
+  VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+  VkDescriptorSet allocateFrame(uint32_t frame, VkDescriptorSetLayout layout);
+  void resetFrame(uint32_t frame);
+
+private:
+  //-----------------------------------------------------------------
+  // DescriptorAllocator - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct PoolChain {
+    std::vector<VkDescriptorPool> pools;
+    size_t current = 0; // pool sets are allocated from
+    bool used = false;  // anything allocated since the last reset
+  };
+
+  //-----------------------------------------------------------------
+  // DescriptorAllocator - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  PoolChain persistentPools;
+  std::vector<PoolChain> framePools; // one chain per frame in flight
+
+  //-----------------------------------------------------------------
+  // DescriptorAllocator - Private Methods
+  //-----------------------------------------------------------------
+
+  VkDescriptorSet allocateFrom(PoolChain &chain, VkDescriptorSetLayout layout);
+  VkDescriptorPool createPool();
+};
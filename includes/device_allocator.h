@@ -0,0 +1,185 @@
+//===================================================================
+// File: device_allocator.h
+//
+// Desc: Sub-allocates buffers and images from large device memory
+//       blocks.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <vulkan/vulkan.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const VkDeviceSize DEVICE_ALLOCATOR_BLOCK_SIZE = 64ull << 20; // 64 MiB
+
+//-------------------------------------------------------------------
+// Enums
+//-------------------------------------------------------------------
+
+// How a block hands out its space.
+enum AllocationStrategy {
+  ALLOCATION_STRATEGY_FREE_LIST, // best fit, freed ranges are reused
+  ALLOCATION_STRATEGY_LINEAR     // bump pointer, reset once a block empties
+};
+
+// Resources of different kinds may not share a bufferImageGranularity page.
+enum AllocationKind {
+  ALLOCATION_KIND_LINEAR, // buffers and linear tiled images
+  ALLOCATION_KIND_OPTIMAL // optimal tiled images
+};
+
+//-------------------------------------------------------------------
+// MemoryBackend (Class Definition)
+//-------------------------------------------------------------------
+
+// Source of the allocator's memory blocks. The allocator only talks to the
+// device through this interface, so it can run against a fake backend.
+class MemoryBackend {
+public:
+  virtual ~MemoryBackend() = default;
+  virtual VkResult allocate(uint32_t memoryTypeIndex, VkDeviceSize size,
+                            VkDeviceMemory *memory) = 0;
+  virtual void free(VkDeviceMemory memory) = 0;
+  virtual void *map(VkDeviceMemory memory) = 0;
+  virtual void unmap(VkDeviceMemory memory) = 0;
+};
+
+// Backend allocating real device memory.
+class VulkanMemoryBackend : public MemoryBackend {
+public:
+  explicit VulkanMemoryBackend(VkDevice device) : device(device) {}
+  VkResult allocate(uint32_t memoryTypeIndex, VkDeviceSize size,
+                    VkDeviceMemory *memory) override;
+  void free(VkDeviceMemory memory) override;
+  void *map(VkDeviceMemory memory) override;
+  void unmap(VkDeviceMemory memory) override;
+
+private:
+  VkDevice device;
+};
+
+//-------------------------------------------------------------------
+// Structs
+//-------------------------------------------------------------------
+
+// A range of a memory block. mapped is set for host visible memory, which
+// stays mapped for the lifetime of its block.
+struct MemoryAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  uint32_t memoryTypeIndex = 0;
+  void *mapped = nullptr;
+};
+
+struct AllocationStats {
+  size_t blockCount = 0;         // vkAllocateMemory calls currently live
+  size_t allocationCount = 0;    // sub-allocations currently live
+  VkDeviceSize blockBytes = 0;   // total size of all blocks
+  VkDeviceSize usedBytes = 0;    // bytes handed out to allocations
+  VkDeviceSize freeBytes = 0;    // bytes that can still be handed out
+  size_t freeRegionCount = 0;    // separate free ranges
+  VkDeviceSize largestFreeRegion = 0;
+
+  // Share of free space outside the largest free range; 0 when all free
+  // space is contiguous, close to 1 when it is scattered.
+  double fragmentation() const {
+    return freeBytes == 0
+               ? 0.0
+               : 1.0 - double(largestFreeRegion) / double(freeBytes);
+  }
+};
+
+//-------------------------------------------------------------------
+// DeviceAllocator (Class Definition)
+//-------------------------------------------------------------------
+
+// Carves allocations out of blocks of DEVICE_ALLOCATOR_BLOCK_SIZE bytes, one
+// set of blocks per memory type, keeping the number of vkAllocateMemory calls
+// far below maxMemoryAllocationCount. Requests larger than half a block get a
+// dedicated block. Thread safe.
+class DeviceAllocator {
+public:
+  //-----------------------------------------------------------------
+  // DeviceAllocator - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(MemoryBackend *backend,
+            const VkPhysicalDeviceMemoryProperties &memoryProperties,
+            const VkPhysicalDeviceLimits &limits,
+            AllocationStrategy strategy = ALLOCATION_STRATEGY_FREE_LIST,
+            VkDeviceSize blockSize = DEVICE_ALLOCATOR_BLOCK_SIZE);
+  void destroy();
+  MemoryAllocation allocate(const VkMemoryRequirements &requirements,
+                            VkMemoryPropertyFlags properties,
+                            AllocationKind kind);
+  void free(const MemoryAllocation &allocation);
+  AllocationStats stats() const;
+
+private:
+  //-----------------------------------------------------------------
+  // DeviceAllocator - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct Region {
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    bool free;
+    AllocationKind kind;
+  };
+
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    uint32_t memoryTypeIndex = 0;
+    VkDeviceSize size = 0;
+    bool dedicated = false; // holds a single large resource
+    void *mapped = nullptr;
+    size_t allocationCount = 0;
+    VkDeviceSize usedBytes = 0;
+    std::vector<Region> regions; // free list strategy, sorted by offset
+    VkDeviceSize head = 0;       // linear strategy, next free byte
+    Region last = {};            // linear strategy, newest allocation
+  };
+
+  //-----------------------------------------------------------------
+  // DeviceAllocator - Private Member Variables
+  //-----------------------------------------------------------------
+  MemoryBackend *backend = nullptr;
+  VkPhysicalDeviceMemoryProperties memoryProperties = {};
+  VkDeviceSize bufferImageGranularity = 1;
+  uint32_t maxAllocationCount = 0;
+  AllocationStrategy strategy = ALLOCATION_STRATEGY_FREE_LIST;
+  VkDeviceSize blockSize = DEVICE_ALLOCATOR_BLOCK_SIZE;
+  std::vector<std::unique_ptr<Block>> blocks;
+  mutable std::mutex mutex;
+
+  //-----------------------------------------------------------------
+  // DeviceAllocator - Private Methods
+  //-----------------------------------------------------------------
+
+  uint32_t findMemoryType(uint32_t typeFilter,
+                          VkMemoryPropertyFlags properties) const;
+  Block *createBlock(uint32_t memoryTypeIndex, VkDeviceSize size);
+  void releaseBlock(Block *block);
+  bool fitFreeList(const Block &block, size_t regionIndex, VkDeviceSize size,
+                   VkDeviceSize alignment, AllocationKind kind,
+                   VkDeviceSize *offset) const;
+  bool fitLinear(const Block &block, VkDeviceSize size,
+                 VkDeviceSize alignment, AllocationKind kind,
+                 VkDeviceSize *offset) const;
+  void commitFreeList(Block &block, size_t regionIndex, VkDeviceSize offset,
+                      VkDeviceSize size, AllocationKind kind);
+  void freeRegion(Block &block, VkDeviceSize offset);
+};
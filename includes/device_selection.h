@@ -0,0 +1,81 @@
+//===================================================================
+// File: device_selection.h
+//
+// Desc: Scores physical devices and picks the one to render with,
+//       honouring an explicit choice by index or name.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+// Environment variable naming the device when --gpu is not given.
+const char *const DEVICE_OVERRIDE_ENV = "HELLOVULKAN_GPU";
+
+// Score weights. Device type dominates: any discrete GPU outranks any
+// integrated one, which outranks virtual and software devices, and the
+// remaining terms order devices of the same type.
+const int64_t DEVICE_SCORE_UNSUITABLE = -1;
+const int64_t DEVICE_SCORE_DISCRETE = 8000;
+const int64_t DEVICE_SCORE_INTEGRATED = 4000;
+const int64_t DEVICE_SCORE_VIRTUAL = 2000;
+const int64_t DEVICE_SCORE_CPU = 100;
+const int64_t DEVICE_SCORE_HEAP_MIB_PER_POINT = 16; // device local memory
+const int64_t DEVICE_SCORE_HEAP_MAX = 2000;
+const int64_t DEVICE_SCORE_TRANSFER_FAMILY = 300; // transfer only family
+const int64_t DEVICE_SCORE_COMPUTE_FAMILY = 300;  // compute without graphics
+const int64_t DEVICE_SCORE_VULKAN_1_2 = 200;      // timeline semaphores
+const int64_t DEVICE_SCORE_EXTENSION = 100;       // per optional extension
+
+// Extensions the renderer uses when present.
+const std::vector<const char *> optionalDeviceExtensions = {
+    VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME};
+
+//-------------------------------------------------------------------
+// DeviceCandidate (Struct Definition)
+//-------------------------------------------------------------------
+
+// What scoring knows about a physical device. The application fills it in
+// from Vulkan; anything else can fill it in by hand.
+struct DeviceCandidate {
+  uint32_t index = 0; // position in vkEnumeratePhysicalDevices() order
+  VkPhysicalDeviceProperties properties = {};
+  VkPhysicalDeviceMemoryProperties memoryProperties = {};
+  std::vector<VkQueueFamilyProperties> queueFamilies;
+  std::vector<std::string> extensions;
+  bool suitable = false; // has the queues, extensions and surface support
+                         // the renderer requires
+};
+
+//-------------------------------------------------------------------
+// DeviceRanking (Struct Definition)
+//-------------------------------------------------------------------
+struct DeviceRanking {
+  uint32_t index = 0; // candidate index
+  int64_t score = DEVICE_SCORE_UNSUITABLE;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+uint64_t deviceLocalHeapSize(const VkPhysicalDeviceMemoryProperties &memory);
+int64_t scoreDevice(const DeviceCandidate &candidate);
+std::vector<DeviceRanking>
+rankDevices(const std::vector<DeviceCandidate> &candidates);
+uint32_t selectDevice(const std::vector<DeviceCandidate> &candidates,
+                      const std::string &override);
+const char *deviceTypeName(VkPhysicalDeviceType type);
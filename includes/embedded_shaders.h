@@ -0,0 +1,36 @@
+//===================================================================
+// File: embedded_shaders.h
+//
+// Desc: SPIR-V compiled at build time and linked into the executable.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//-------------------------------------------------------------------
+// EmbeddedShader (Struct Definition)
+//-------------------------------------------------------------------
+
+// A SPIR-V module compiled by CMake from shaders/ and embedded as an
+// aligned word array, named like the file compile.sh would write.
+struct EmbeddedShader {
+  const char *name;     // SPIR-V file name, e.g. "vert.spv"
+  const uint32_t *code; // null if no such shader was embedded
+  size_t size;          // in bytes
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+EmbeddedShader findEmbeddedShader(const std::string &name);
+size_t embeddedShaderCount();
@@ -0,0 +1,118 @@
+//===================================================================
+// File: frame_stats.h
+//
+// Desc: Fixed size history of frame durations and summary statistics.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <vector>
+
+//-------------------------------------------------------------------
+// FrameTimeStats (Struct Definition)
+//-------------------------------------------------------------------
+struct FrameTimeStats {
+  size_t count = 0;  // number of samples summarized
+  double min = 0.0;  // milliseconds
+  double avg = 0.0;  // milliseconds
+  double max = 0.0;  // milliseconds
+  double p50 = 0.0;  // milliseconds
+  double p95 = 0.0;  // milliseconds
+  double p99 = 0.0;  // milliseconds
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Summarizes a set of frame durations given in milliseconds.
+// ~Returns: FrameTimeStats struct, zeroed if there are no samples.
+inline FrameTimeStats summarizeFrameTimes(std::vector<double> samples) {
+  FrameTimeStats stats;
+  stats.count = samples.size();
+  if (samples.empty()) {
+    return stats;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  double total = 0.0;
+  for (double sample : samples) {
+    total += sample;
+  }
+
+  // nearest-rank percentile
+  auto percentile = [&](double p) {
+    size_t rank = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    return samples[std::min(rank, samples.size() - 1)];
+  };
+
+  stats.min = samples.front();
+  stats.max = samples.back();
+  stats.avg = total / samples.size();
+  stats.p50 = percentile(0.50);
+  stats.p95 = percentile(0.95);
+  stats.p99 = percentile(0.99);
+  return stats;
+}
+
+//-------------------------------------------------------------------
+// FrameTimeRing (Class Definition)
+//-------------------------------------------------------------------
+
+// Ring buffer holding the most recent Capacity frame durations. Pushing
+// never allocates, so it is safe to use from the render loop.
+template <size_t Capacity = 1024> class FrameTimeRing {
+public:
+  //-----------------------------------------------------------------
+  // FrameTimeRing - Public Methods
+  //-----------------------------------------------------------------
+
+  void push(double milliseconds) {
+    samples[next] = milliseconds;
+    next = (next + 1) % Capacity;
+    count = std::min(count + 1, Capacity);
+  }
+
+  void clear() {
+    next = 0;
+    count = 0;
+  }
+
+  size_t size() const { return count; }
+  static constexpr size_t capacity() { return Capacity; }
+
+  // Copies the samples out, oldest first.
+  std::vector<double> values() const {
+    std::vector<double> result;
+    result.reserve(count);
+    size_t first = (next + Capacity - count) % Capacity;
+    for (size_t i = 0; i < count; i++) {
+      result.push_back(samples[(first + i) % Capacity]);
+    }
+    return result;
+  }
+
+  // The most recent sample, or zero if there are none.
+  double latest() const {
+    return count == 0 ? 0.0 : samples[(next + Capacity - 1) % Capacity];
+  }
+
+  FrameTimeStats stats() const { return summarizeFrameTimes(values()); }
+
+private:
+  //-----------------------------------------------------------------
+  // FrameTimeRing - Private Member Variables
+  //-----------------------------------------------------------------
+  std::array<double, Capacity> samples = {};
+  size_t next = 0;
+  size_t count = 0;
+};
@@ -0,0 +1,109 @@
+//===================================================================
+// File: gpu_culling.h
+//
+// Desc: Buffers and constants for culling instances on the GPU and
+//       drawing the survivors with indirect draws.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "device_allocator.h"
+#include "instance_buffer.h"
+#include <vulkan/vulkan.h>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t CULL_WORKGROUP_SIZE = 64; // local_size_x of shaders/cull.comp
+
+//-------------------------------------------------------------------
+// Structs
+//-------------------------------------------------------------------
+
+// Push constants of shaders/cull.comp. The shader runs twice per frame:
+// CULL_PASS_INSTANCES compacts the visible instances, CULL_PASS_COMMANDS
+// turns the visible count into draw commands.
+struct CullPushConstants {
+  float planes[6][4];     // normalized frustum planes, xyz normal and w
+  uint32_t instanceCount; // instances to test
+  uint32_t maxDrawCount;  // draw commands in the frame's region
+  uint32_t pass;          // CULL_PASS_INSTANCES or CULL_PASS_COMMANDS
+  uint32_t padding;
+};
+
+const uint32_t CULL_PASS_INSTANCES = 0;
+const uint32_t CULL_PASS_COMMANDS = 1;
+
+// Head of a frame's draw region, followed by maxDrawCount
+// VkDrawIndexedIndirectCommand structs. drawCount is the count buffer read by
+// vkCmdDrawIndexedIndirectCountKHR.
+struct CullCounters {
+  uint32_t drawCount;    // draw commands with at least one instance
+  uint32_t visibleCount; // instances that survived culling
+  uint32_t padding[2];
+};
+
+static_assert(sizeof(CullCounters) == 16, "must match the shader's layout");
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+void extractFrustumPlanes(const float viewProjection[16],
+                          float planes[6][4]);
+
+//-------------------------------------------------------------------
+// CullBuffers (Class Definition)
+//-------------------------------------------------------------------
+
+// Device local outputs of the cull pass, one region per frame in flight: the
+// compacted list of visible instances read by the vertex shader, and the
+// counters and indexed indirect draw commands consumed by the graphics pass.
+// Visible instances are split into draws of at most INSTANCES_PER_DRAW like
+// the CPU driven path; commands past the last visible instance are empty.
+class CullBuffers {
+public:
+  //-----------------------------------------------------------------
+  // CullBuffers - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, DeviceAllocator *allocator,
+            uint32_t instanceCount, uint32_t framesInFlight,
+            VkDeviceSize minOffsetAlignment);
+  void destroy();
+  uint32_t maxDrawCount() const { return drawCapacity; }
+  VkBuffer drawBuffer() const { return draws; }
+  VkDeviceSize countersOffset(uint32_t frame) const;
+  VkDeviceSize commandsOffset(uint32_t frame) const;
+  VkDescriptorBufferInfo visibleInfo(uint32_t frame) const;
+  VkDescriptorBufferInfo drawInfo(uint32_t frame) const;
+
+private:
+  //-----------------------------------------------------------------
+  // CullBuffers - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  DeviceAllocator *allocator = nullptr;
+  VkBuffer visible = VK_NULL_HANDLE;
+  MemoryAllocation visibleMemory;
+  VkDeviceSize visibleRegionSize = 0;
+  VkBuffer draws = VK_NULL_HANDLE;
+  MemoryAllocation drawMemory;
+  VkDeviceSize drawRegionSize = 0;
+  uint32_t instanceCapacity = 0;
+  uint32_t drawCapacity = 0;
+
+  //-----------------------------------------------------------------
+  // CullBuffers - Private Methods
+  //-----------------------------------------------------------------
+
+  VkBuffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                        MemoryAllocation *memory);
+};
@@ -0,0 +1,51 @@
+//===================================================================
+// File: gpu_timer.h
+//
+// Desc: Measures GPU time spent per frame with timestamp queries.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "frame_stats.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+
+//-------------------------------------------------------------------
+// GpuTimer (Class Definition)
+//-------------------------------------------------------------------
+
+// Owns a timestamp query pool with a begin/end pair per frame in flight.
+// Results are only read once the frame's fence has signaled and are never
+// waited on, so timing adds no stalls to the frame loop.
+class GpuTimer {
+public:
+  //-----------------------------------------------------------------
+  // GpuTimer - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, VkPhysicalDevice physicalDevice,
+            uint32_t queueFamilyIndex, uint32_t framesInFlight);
+  void destroy();
+  bool isSupported() const { return queryPool != VK_NULL_HANDLE; }
+  void begin(VkCommandBuffer commandBuffer, uint32_t frame);
+  void end(VkCommandBuffer commandBuffer, uint32_t frame);
+  void collect(uint32_t frame);
+  const FrameTimeRing<> &frameTimes() const { return history; }
+
+private:
+  //-----------------------------------------------------------------
+  // GpuTimer - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  VkQueryPool queryPool = VK_NULL_HANDLE;
+  double timestampPeriod = 1.0; // nanoseconds per tick
+  uint64_t timestampMask = ~0ull;
+  std::vector<bool> pending; // per frame, timestamps written but not read
+  FrameTimeRing<> history;
+};
@@ -0,0 +1,98 @@
+//===================================================================
+// File: init_graph.h
+//
+// Desc: Dependency graph of startup steps, run across threads and
+//       timed for a startup trace.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+//-------------------------------------------------------------------
+// InitGraph (Class Definition)
+//-------------------------------------------------------------------
+
+// Runs a set of steps once, each as soon as the steps it depends on have
+// finished. Steps may only depend on steps added before them, so the graph
+// can't have cycles. Ready steps are taken by short-lived worker threads
+// and the calling thread; steps marked main thread only run on the caller,
+// for APIs such as GLFW that must not be used from other threads.
+//
+// Every step is timed and, while the profiler is enabled, recorded as a
+// span under its name. If a step throws no further steps are started, the
+// running ones are finished and the first error is rethrown by run().
+class InitGraph {
+public:
+  //-----------------------------------------------------------------
+  // InitGraph - Public Types
+  //-----------------------------------------------------------------
+
+  using StepId = size_t;
+  using Step = std::function<void()>;
+
+  //-----------------------------------------------------------------
+  // InitGraph - Public Methods
+  //-----------------------------------------------------------------
+
+  InitGraph() = default;
+  InitGraph(const InitGraph &) = delete;
+  InitGraph &operator=(const InitGraph &) = delete;
+
+  StepId add(const char *name, std::vector<StepId> dependencies, Step step,
+             bool mainThread = false);
+  void run(uint32_t threadCount);
+  size_t size() const { return nodes.size(); }
+  double wallMilliseconds() const;
+  double stepMilliseconds() const;
+  double criticalPathMilliseconds() const;
+
+private:
+  //-----------------------------------------------------------------
+  // InitGraph - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct Node {
+    const char *name; // string literal, the profiler keeps the pointer
+    Step step;
+    std::vector<StepId> dependencies;
+    std::vector<StepId> dependents;
+    size_t pendingDependencies = 0;
+    bool mainThread = false;
+    uint64_t startNs = 0;
+    uint64_t endNs = 0;
+  };
+
+  //-----------------------------------------------------------------
+  // InitGraph - Private Member Variables
+  //-----------------------------------------------------------------
+  std::vector<Node> nodes;
+  std::mutex mutex;
+  std::condition_variable stepsChanged;
+  std::deque<StepId> readySteps;     // any thread may run these
+  std::deque<StepId> readyMainSteps; // only the calling thread runs these
+  size_t finishedSteps = 0;
+  std::exception_ptr stepError;
+  uint64_t runStartNs = 0;
+  uint64_t runEndNs = 0;
+
+  //-----------------------------------------------------------------
+  // InitGraph - Private Methods
+  //-----------------------------------------------------------------
+
+  void runSteps(bool mainThread);
+  double durationMilliseconds(const Node &node) const;
+};
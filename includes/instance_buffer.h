@@ -0,0 +1,69 @@
+//===================================================================
+// File: instance_buffer.h
+//
+// Desc: Per-instance transforms and colors in a storage buffer with
+//       one persistently mapped region per frame in flight.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "device_allocator.h"
+#include <vulkan/vulkan.h>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t INSTANCES_PER_DRAW = 65536; // instances per instanced draw
+
+//-------------------------------------------------------------------
+// InstanceData (Struct Definition)
+//-------------------------------------------------------------------
+
+// One instance as laid out in the std430 Instances buffer of
+// shaders/instanced.vert.
+struct InstanceData {
+  float transform[16]; // column major
+  float color[4];
+};
+
+static_assert(sizeof(InstanceData) == 80, "must match the shader's layout");
+
+//-------------------------------------------------------------------
+// InstanceBuffer (Class Definition)
+//-------------------------------------------------------------------
+
+// Host visible storage buffer split into one region per frame in flight.
+// The CPU rewrites a frame's region once that frame's fence has signaled,
+// while the GPU may still be reading the other regions.
+class InstanceBuffer {
+public:
+  //-----------------------------------------------------------------
+  // InstanceBuffer - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, DeviceAllocator *allocator,
+            uint32_t instanceCount, uint32_t framesInFlight,
+            VkDeviceSize minOffsetAlignment);
+  void destroy();
+  uint32_t instanceCount() const { return count; }
+  InstanceData *frameData(uint32_t frame);
+  VkDescriptorBufferInfo descriptorInfo(uint32_t frame) const;
+
+private:
+  //-----------------------------------------------------------------
+  // InstanceBuffer - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  DeviceAllocator *allocator = nullptr;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  MemoryAllocation memory;
+  uint32_t count = 0;
+  VkDeviceSize regionSize = 0; // bytes per frame, aligned for descriptors
+};
@@ -0,0 +1,170 @@
+//===================================================================
+// File: job_system.h
+//
+// Desc: Fixed size pool of worker threads that run jobs from per-thread
+//       lock-free deques, stealing from each other when idle.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const size_t JOB_QUEUE_CAPACITY = 4096; // jobs per worker deque, power of 2
+const uint32_t JOB_IDLE_SPINS = 64;     // failed takes before a worker sleeps
+
+//-------------------------------------------------------------------
+// JobCounter (Class Definition)
+//-------------------------------------------------------------------
+
+// Counts the unfinished jobs submitted against it. Waiting on a counter
+// returns once it reaches zero, and rethrows the first exception any of
+// its jobs threw. A counter can be reused once waited on.
+class JobCounter {
+public:
+  //-----------------------------------------------------------------
+  // JobCounter - Public Methods
+  //-----------------------------------------------------------------
+
+  JobCounter() = default;
+  JobCounter(const JobCounter &) = delete;
+  JobCounter &operator=(const JobCounter &) = delete;
+
+  bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+  //-----------------------------------------------------------------
+  // JobCounter - Private Member Variables
+  //-----------------------------------------------------------------
+  std::atomic<uint32_t> pending{0};
+  std::mutex errorMutex;
+  std::exception_ptr error;
+
+  friend class JobSystem;
+};
+
+//-------------------------------------------------------------------
+// JobSystem (Class Definition)
+//-------------------------------------------------------------------
+
+// Runs jobs on a fixed set of worker threads. Each worker pushes and pops
+// jobs at the bottom of its own Chase-Lev deque without locking, and idle
+// workers steal from the top of the others' deques, so work spawned by a
+// job stays on the thread that is already warm with its data. Threads
+// that aren't workers, such as the main thread, submit through a shared
+// queue.
+//
+// wait() never blocks: the waiting thread runs queued jobs until its
+// counter reaches zero, so the main thread does useful work instead of
+// idling, and jobs may wait on jobs they spawned. Workers sleep only when
+// nothing is queued anywhere.
+//
+// Background jobs, and every job they submit, only run on workers, after
+// the frame's jobs: a thread that isn't a worker never picks one up while
+// it waits, so long running work can't stall the frame. Without workers
+// they run at once on the submitting thread.
+class JobSystem {
+public:
+  //-----------------------------------------------------------------
+  // JobSystem - Public Types
+  //-----------------------------------------------------------------
+
+  // Job callback, receives the index of the thread running it. Workers
+  // have indices [0, workerCount()); every other thread shares index
+  // workerCount(), so per-thread resources indexed by it are only safe
+  // while a single non-worker thread waits at a time.
+  using Job = std::function<void(uint32_t threadIndex)>;
+
+  // Parallel loop body, receives the item index and the thread index.
+  using Task = std::function<void(size_t index, uint32_t threadIndex)>;
+
+  //-----------------------------------------------------------------
+  // JobSystem - Public Methods
+  //-----------------------------------------------------------------
+
+  explicit JobSystem(uint32_t workerCount);
+  ~JobSystem();
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  uint32_t workerCount() const { return threadCount; }
+  uint32_t size() const { return threadCount + 1; }
+  void submit(JobCounter &counter, Job job);
+  void submitBackground(JobCounter &counter, Job job);
+  void wait(JobCounter &counter);
+  void parallelFor(size_t count, const Task &task);
+
+private:
+  //-----------------------------------------------------------------
+  // JobSystem - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct QueuedJob {
+    Job run;
+    JobCounter *counter;
+    bool background; // only run by workers
+  };
+
+  // Chase-Lev deque: the owner pushes and pops at the bottom, thieves
+  // take from the top, and only a contended last item needs a CAS.
+  class WorkDeque {
+  public:
+    bool push(QueuedJob *job);
+    QueuedJob *pop();
+    QueuedJob *steal();
+
+  private:
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<QueuedJob *> slots[JOB_QUEUE_CAPACITY] = {};
+  };
+
+  //-----------------------------------------------------------------
+  // JobSystem - Private Member Variables
+  //-----------------------------------------------------------------
+  uint32_t threadCount = 0; // fixed before the workers start
+  std::vector<std::thread> workers;
+  std::vector<std::unique_ptr<WorkDeque>> deques; // one per worker
+  std::mutex sharedMutex;
+  std::deque<QueuedJob *> sharedJobs; // submitted by other threads
+  std::atomic<size_t> sharedCount{0};
+  std::deque<QueuedJob *> backgroundJobs; // only taken by workers
+  std::atomic<size_t> backgroundCount{0};
+  std::atomic<int64_t> queuedJobs{0}; // submitted and not yet taken
+  std::mutex sleepMutex;
+  std::condition_variable wake;
+  std::atomic<uint32_t> sleepers{0};
+  bool stopping = false;
+
+  //-----------------------------------------------------------------
+  // JobSystem - Private Methods
+  //-----------------------------------------------------------------
+
+  uint32_t currentThreadIndex() const;
+  void enqueue(JobCounter &counter, Job job, bool background);
+  void wakeWorker();
+  QueuedJob *take(uint32_t threadIndex);
+  void execute(QueuedJob *job, uint32_t threadIndex);
+  void workerLoop(uint32_t workerIndex);
+  void splitRange(JobCounter &counter, size_t begin, size_t end,
+                  const Task &task, uint32_t threadIndex);
+};
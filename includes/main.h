@@ -20,14 +20,45 @@
 //-------------------------------------------------------------------
 
 #include <GLFW/glfw3.h>
+#include "asset_archive.h"
+#include "embedded_shaders.h"
+#include "async_compute.h"
+#include "command_recorder.h"
+#include "descriptor_allocator.h"
+#include "device_allocator.h"
+#include "device_selection.h"
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "mesh_loader.h"
+#include "gpu_culling.h"
+#include "gpu_timer.h"
+#include "init_graph.h"
+#include "pipeline_cache.h"
+#include "presentation_profile.h"
+#include "upload_queue.h"
+#include "profiler.h"
+#include "scene_store.h"
+#include "shader_watcher.h"
+#include "timeline_semaphore.h"
+#include "uniform_ring.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <csignal>
 #include <cstdlib>
 #include <cstring>
+#include <ctime>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <set>
 #include <stdexcept>
+#include <string>
 #include <vector>
 
 //-------------------------------------------------------------------
@@ -50,7 +81,83 @@ const std::vector<const char *> validationLayers = {
     "VK_LAYER_KHRONOS_validation"};
 const std::vector<const char *> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-const int MAX_FRAMES_IN_FLIGHT = 2;
+const uint32_t HEADLESS_DEFAULT_FRAMES = 1000; // Frames rendered by --headless
+const VkFormat HEADLESS_IMAGE_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;
+const uint32_t INIT_DEFAULT_THREADS = 3; // startup workers next to main
+
+//-------------------------------------------------------------------
+// ApplicationOptions (Struct Definition)
+//-------------------------------------------------------------------
+struct ApplicationOptions {
+  bool headless = false;    // render offscreen without a window or surface
+  uint32_t frameCount = 0;  // frames to render before exiting (0 = no limit)
+  double duration = 0.0;    // seconds to render before exiting (0 = no limit)
+  std::string readbackPath; // copy frames to host, save the last one as PPM
+  std::string pipelineCachePath =
+      PIPELINE_CACHE_DEFAULT_PATH; // empty disables the on-disk cache
+  std::string assetArchivePath; // archive to take shaders from, if any
+  std::string shaderDirectory;  // loads SPIR-V from here, for development
+  std::string gpu; // device index or name part, overrides the scoring
+  uint32_t recordThreads = 0;  // secondary buffers recorded in parallel
+                               // (0 = record inline)
+  std::optional<uint32_t> jobThreads; // job workers, unset = one per core
+                                      // besides the main thread
+  uint32_t drawCount = 1;      // draws recorded per frame
+  uint32_t instanceCount = 0;  // instanced triangles (0 = plain draws)
+  bool gpuCulling = false;     // cull instances in compute, draw indirect
+  std::string meshPath;        // OBJ or glTF mesh drawn instead of triangles
+  double movingInstances = 1.0; // fraction of instances that spin
+  bool benchRecording = false; // time recording across thread counts
+  double statsInterval = 0.0;  // seconds between stats dumps (0 = off)
+  std::string tracePath = "trace.json"; // where on-demand traces are written
+  bool traceOnExit = false;             // write a trace when exiting
+  bool profiler = true;                 // record CPU spans
+  std::string startupTracePath;         // trace of the startup steps
+  uint32_t initThreads = INIT_DEFAULT_THREADS; // 0 = sequential startup
+  bool transferQueue = true; // upload on a dedicated transfer queue if any
+  bool computeQueue = true;  // compute on a dedicated compute queue if any
+  bool timelineSemaphores = true; // synchronize frames with timeline
+                                  // semaphores on Vulkan 1.2 devices
+  bool watchShaders = false; // recompile and reload shaders as they change
+  PresentationProfileType presentationProfile = PRESENTATION_PROFILE_BALANCED;
+  uint32_t framesInFlight = 0; // overrides the profile when non-zero
+  std::optional<VkPresentModeKHR> presentMode; // overrides the profile
+  bool collectFrameTimes = false; // keep every frame's times in the report
+};
+
+//-------------------------------------------------------------------
+// FrameReport (Struct Definition)
+//-------------------------------------------------------------------
+struct FrameReport {
+  uint64_t frames = 0;     // frames rendered by the main loop
+  double seconds = 0.0;    // wall time spent in the main loop
+  double cpuSeconds = 0.0; // process CPU time spent in the main loop
+  std::vector<double> frameTimes;    // per frame wall time in milliseconds
+  std::vector<double> cpuFrameTimes; // per frame CPU time in milliseconds
+  std::optional<VkPresentModeKHR> presentMode; // unset when headless
+};
+
+//-------------------------------------------------------------------
+// RetiredPipeline (Struct Definition)
+//-------------------------------------------------------------------
+struct RetiredPipeline {
+  VkPipeline pipeline = VK_NULL_HANDLE; // replaced by a hot reload
+  uint64_t destroyFrame = 0; // frame whose wait proves the pipeline unused
+};
+
+//-------------------------------------------------------------------
+// ShaderCode (Struct Definition)
+//-------------------------------------------------------------------
+
+// SPIR-V of a shader, either viewed in place or copied out of a file.
+struct ShaderCode {
+  const uint32_t *view = nullptr; // archive or embedded code
+  std::vector<uint32_t> words;    // loose file contents
+  size_t size = 0;                // in bytes
+  const uint32_t *data() const { return words.empty() ? view : words.data(); }
+};
+
+ApplicationOptions parseOptions(int argc, char **argv);
 
 //-------------------------------------------------------------------
 // HelloTriangleApplication (Class Definition)
@@ -61,36 +168,111 @@ public:
   // HelloTriangleApplication - Public Methods
   //-----------------------------------------------------------------
 
+  explicit HelloTriangleApplication(const ApplicationOptions &options);
   void run();
+  const FrameTimeRing<> &gpuFrameTimes() const;
+  FrameTimeStats gpuFrameStats() const;
+  const FrameReport &frameReport() const;
 
 private:
   //-----------------------------------------------------------------
   // HelloTriangleApplication - Private Member Variables
   //-----------------------------------------------------------------
-  GLFWwindow *window;
+  ApplicationOptions options;
+  GLFWwindow *window = nullptr;
   VkInstance instance;
+  uint32_t instanceApiVersion = VK_API_VERSION_1_0;
   VkDebugUtilsMessengerEXT debugMessenger;
   VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
   VkDevice device;
   VkQueue graphicsQueue;
   VkQueue presentQueue;
-  VkSurfaceKHR surface;
-  VkSwapchainKHR swapChain;
+  VkQueue transferQueue;
+  VkQueue computeQueue;
+  VkSurfaceKHR surface = VK_NULL_HANDLE;
+  VkSwapchainKHR swapChain = VK_NULL_HANDLE;
   std::vector<VkImage> swapChainImages;
   VkFormat swapChainImageFormat;
+  VkSurfaceFormatKHR swapChainSurfaceFormat;
+  VkPresentModeKHR swapChainPresentMode;
   VkExtent2D swapChainExtent;
   std::vector<VkImageView> swapChainImageViews;
+  DescriptorLayoutCache descriptorLayouts;
+  DescriptorAllocator descriptorAllocator;
+  UniformRing uniformRing;
+  VkDescriptorSetLayout frameSetLayout = VK_NULL_HANDLE;
+  VkDescriptorSet frameDescriptorSet = VK_NULL_HANDLE; // dynamic offset
+  uint32_t frameUniformOffset = 0; // this frame's FrameUniforms
+  std::chrono::steady_clock::time_point uniformStartTime =
+      std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point lastUniformTime;
+  VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> descriptorSets; // frame sets, per frame
+  VkDescriptorSetLayout cullDescriptorSetLayout = VK_NULL_HANDLE;
+  std::vector<VkDescriptorSet> cullDescriptorSets; // frame sets, per frame
+  VkPipelineLayout cullPipelineLayout = VK_NULL_HANDLE;
+  VkPipeline cullPipeline = VK_NULL_HANDLE;
+  uint32_t maxCullGroupCount = 0;
+  bool multiDrawIndirect = false;
+  PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
   VkPipelineLayout pipelineLayout;
   VkRenderPass renderPass;
   VkPipeline graphicsPipeline;
+  VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+  bool pipelineCacheLoaded = false;
+  uint32_t pipelineBuildCount = 0;
+  AssetArchive assetArchive;
+  std::map<std::string, ShaderCode> preloadedShaders; // during startup only
+  ShaderWatcher shaderWatcher;
+  std::mutex shaderReloadMutex; // guards pending pipelines and renderPass
+  VkPipeline pendingGraphicsPipeline = VK_NULL_HANDLE; // built by the watcher
+  VkPipeline pendingCullPipeline = VK_NULL_HANDLE;     // built by the watcher
   std::vector<VkFramebuffer> swapChainFrameBuffers;
-  VkCommandPool commandPool;
-  std::vector<VkCommandBuffer> commandBuffers;
+  std::vector<VkCommandPool> commandPools;     // one per frame in flight
+  std::vector<VkCommandBuffer> commandBuffers; // one per frame in flight
+  std::vector<DrawCommand> drawList;
+  std::unique_ptr<JobSystem> jobs;
+  ParallelCommandRecorder commandRecorder;
+  GpuTimer gpuTimer;
   std::vector<VkSemaphore> imageAvailableSemaphores;
   std::vector<VkSemaphore> renderFinishedSemaphores;
   size_t currentFrame = 0;
-  std::vector<VkFence> inFlightFences;
+  std::vector<VkFence> inFlightFences; // without timeline semaphores
+  bool timelineEnabled = false;
+  TimelineSemaphore graphicsTimeline;
+  std::vector<uint64_t> frameTimelineValues; // last value each frame signaled
   bool framebufferResized = false;
+  PresentationProfileType presentationProfile = PRESENTATION_PROFILE_BALANCED;
+  uint32_t framesInFlight = 0;
+  bool profileSwitchRequested = false;
+  std::unique_ptr<VulkanMemoryBackend> memoryBackend;
+  DeviceAllocator allocator;
+  UploadQueue uploadQueue;
+  AsyncCompute asyncCompute;
+  InstanceBuffer instanceBuffer;
+  SceneStore scene;
+  CullBuffers cullBuffers;
+  VkBuffer indexBuffer = VK_NULL_HANDLE;
+  MemoryAllocation indexBufferMemory;
+  UploadTicket indexUpload = 0;
+  MeshLoader meshLoader;
+  VkBuffer meshVertexBuffer = VK_NULL_HANDLE;
+  MemoryAllocation meshVertexBufferMemory;
+  VkBuffer meshIndexBuffer = VK_NULL_HANDLE;
+  MemoryAllocation meshIndexBufferMemory;
+  UploadTicket meshUpload = 0;  // last of the mesh's uploads
+  uint32_t meshIndexCount = 0;  // zero until the mesh has been loaded
+  Vec3 meshCenter = {};         // center of the mesh's bounds
+  float meshScale = 1.0f;       // fits the bounds into clip space
+  Mat4 meshTransform = {};      // pushed to mesh.vert every frame
+  std::vector<MemoryAllocation> headlessImageMemory;
+  std::vector<VkBuffer> readbackBuffers;
+  std::vector<MemoryAllocation> readbackBufferMemory;
+  uint64_t framesRendered = 0;
+  FrameReport report;
+  bool traceRequested = false;
+  std::vector<RetiredPipeline> retiredPipelines;
+  static volatile std::sig_atomic_t traceSignaled;
 
   //-----------------------------------------------------------------
   // HelloTriangleApplication - Private Member Substructures
@@ -99,6 +281,8 @@ private:
   struct QueueFamilyIndices {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    std::optional<uint32_t> transferFamily; // falls back to graphicsFamily
+    std::optional<uint32_t> computeFamily;  // falls back to graphicsFamily
     bool isComplete() {
       return graphicsFamily.has_value() && presentFamily.has_value();
     }
@@ -122,6 +306,9 @@ private:
   static std::vector<char> readFile(const std::string &filename);
   static void framebufferResizeCallback(GLFWwindow *window, int width,
                                         int height);
+  static void keyCallback(GLFWwindow *window, int key, int scancode,
+                          int action, int mods);
+  static void traceSignalHandler(int signal);
 
   //-----------------------------------------------------------------
   // HelloTriangleApplication - Private Methods
@@ -132,32 +319,91 @@ private:
   void setupDebugMessenger();
   void createInstance();
   std::vector<const char *> getRequiredExtensions();
+  std::vector<const char *> getRequiredDeviceExtensions();
   void checkSupportedExtensions();
   bool checkValidationLayerSupport();
   void mainLoop();
   void cleanup();
   void pickPhysicalDevice();
+  DeviceCandidate describeDevice(VkPhysicalDevice device, uint32_t index);
   bool isDeviceSuitable(VkPhysicalDevice device);
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
   void createLogicalDevice();
   void createSurface();
   bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool isDeviceExtensionAvailable(VkPhysicalDevice device,
+                                  const char *extensionName);
   SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
       const std::vector<VkSurfaceFormatKHR> &availableFormats);
   VkPresentModeKHR chooseSwapPresentMode(
       const std::vector<VkPresentModeKHR> &availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
+  void selectImageFormat();
   void createSwapChain();
+  void createHeadlessRenderTargets();
+  void createReadbackBuffers();
+  void writeReadbackImage(uint32_t imageIndex);
   void createImageViews();
+  void createPipelineCache();
+  void createDeviceAllocator();
+  void createUploadQueue();
+  void createAsyncCompute();
+  VkSemaphore submitCulling(VkPipelineStageFlags *waitStages,
+                            uint64_t *waitValue);
+  void dumpMemoryStats();
+  void savePipelineCache();
   void createGraphicsPipeline();
-  VkShaderModule createShaderModule(const std::vector<char> &code);
+  VkPipeline buildGraphicsPipeline();
+  void createCullPipeline();
+  VkPipeline buildCullPipeline();
+  void startShaderWatcher();
+  void reloadShader(const std::string &spirvPath);
+  void applyShaderReloads();
+  void destroyRetiredPipelines(bool all);
+  void openAssetArchive();
+  std::string vertexShaderName() const;
+  void preloadShaders();
+  ShaderCode readShaderCode(const std::string &name);
+  VkShaderModule loadShaderModule(const std::string &name);
+  VkShaderModule createShaderModule(const uint32_t *code, size_t size);
   void createRenderPass();
   void createFrameBuffers();
-  void createCommandPool();
+  void createCommandPools();
   void createCommandBuffers();
+  void createDrawList();
+  void createDescriptorSetLayout();
+  void createInstanceBuffer();
+  void createScene();
+  void createIndexBuffer();
+  void receiveMesh();
+  void updateMeshTransform();
+  void createFrameUniforms();
+  void updateFrameUniforms();
+  void createDescriptorSets();
+  void allocateFrameDescriptorSets(uint32_t frame);
+  void updateInstances();
+  void createJobSystem(uint32_t workerCount);
+  void createCommandRecorder(uint32_t sliceCount);
+  void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+  void recordDraws(VkCommandBuffer commandBuffer, size_t begin, size_t end);
+  void recordCulling(VkCommandBuffer commandBuffer);
+  void recordIndirectDraws(VkCommandBuffer commandBuffer);
+  void recordMeshDraws(VkCommandBuffer commandBuffer, size_t begin,
+                       size_t end);
+  void benchmarkRecording();
+  void createGpuTimer();
+  void dumpFrameStats();
+  void exportTrace();
+  void waitForFrame();
   void drawFrame();
   void createSyncObjects();
+  void selectPresentationProfile(PresentationProfileType type);
+  void switchPresentationProfile(PresentationProfileType type);
+  void createFrameResources();
+  void cleanupFrameResources();
   void recreateSwapChain();
   void cleanupSwapChain();
+  void cleanupGraphicsPipeline();
+  void cleanupHeadlessRenderTargets();
 };
\ No newline at end of file
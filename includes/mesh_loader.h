@@ -0,0 +1,137 @@
+//===================================================================
+// File: mesh_loader.h
+//
+// Desc: Loads OBJ and glTF 2.0 meshes from memory mapped files, parsing
+//       and deduplicating them as parallel jobs.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "job_system.h"
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const size_t MESH_CHUNK_BYTES = 1 << 20; // OBJ text parsed per job
+const size_t MESH_CHUNK_ITEMS = 1 << 16; // vertices or corners per job
+const uint32_t MESH_DEDUP_BUCKETS = 64;  // partitions deduplicated as jobs
+
+//-------------------------------------------------------------------
+// MeshVertex (Struct Definition)
+//-------------------------------------------------------------------
+
+// Interleaved vertex every loaded mesh is converted to. Attributes a file
+// doesn't have are zero.
+struct MeshVertex {
+  float position[3];
+  float normal[3];
+  float uv[2];
+};
+
+//-------------------------------------------------------------------
+// MeshAttribute (Struct Definition)
+//-------------------------------------------------------------------
+
+// One attribute of MeshVertex, as the vertex shader reads it.
+struct MeshAttribute {
+  uint32_t location;       // shader input location
+  uint32_t componentCount; // 32 bit floats
+  uint32_t offset;         // from the start of the vertex
+};
+
+const MeshAttribute MESH_VERTEX_ATTRIBUTES[] = {
+    {0, 3, offsetof(MeshVertex, position)},
+    {1, 3, offsetof(MeshVertex, normal)},
+    {2, 2, offsetof(MeshVertex, uv)}};
+const uint32_t MESH_VERTEX_ATTRIBUTE_COUNT =
+    sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(MESH_VERTEX_ATTRIBUTES[0]);
+
+//-------------------------------------------------------------------
+// MeshData (Struct Definition)
+//-------------------------------------------------------------------
+
+// Indexed triangle list with unique vertices.
+struct MeshData {
+  std::vector<MeshVertex> vertices;
+  std::vector<uint32_t> indices; // three per triangle
+  float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+  float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+};
+
+//-------------------------------------------------------------------
+// MeshUpload (Struct Definition)
+//-------------------------------------------------------------------
+
+// Loaded mesh packed into the bytes of its vertex and index buffers, so
+// the thread creating the buffers only has to move them into uploads.
+struct MeshUpload {
+  std::vector<char> vertexData;
+  std::vector<char> indexData; // uint32_t indices
+  uint32_t vertexCount = 0;
+  uint32_t indexCount = 0;
+  float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+  float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+  double milliseconds = 0.0; // time the load took
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+MeshData loadMesh(const std::string &path, JobSystem &jobs);
+MeshData loadObjMesh(const std::string &path, JobSystem &jobs);
+MeshData loadGltfMesh(const std::string &path, JobSystem &jobs);
+
+//-------------------------------------------------------------------
+// MeshLoader (Class Definition)
+//-------------------------------------------------------------------
+
+// Loads a mesh as background jobs, which parse it and pack the result for
+// upload on the job system's workers while the render thread keeps
+// drawing frames. poll() returns the mesh once, when it is ready, and
+// isPending() holds until then. The job system must outlive the load;
+// stop() waits for it.
+class MeshLoader {
+public:
+  //-----------------------------------------------------------------
+  // MeshLoader - Public Methods
+  //-----------------------------------------------------------------
+
+  MeshLoader() = default;
+  ~MeshLoader();
+  MeshLoader(const MeshLoader &) = delete;
+  MeshLoader &operator=(const MeshLoader &) = delete;
+
+  void start(const std::string &path, JobSystem *jobs);
+  bool poll(MeshUpload *mesh);
+  void stop();
+  bool isPending() const { return loadJobs != nullptr || finished; }
+
+private:
+  //-----------------------------------------------------------------
+  // MeshLoader - Private Member Variables
+  //-----------------------------------------------------------------
+  JobSystem *loadJobs = nullptr; // running the load, until waited on
+  JobCounter counter;
+  MeshUpload result;        // read once the counter has been waited on
+  std::exception_ptr error; // thrown by the load, rethrown by poll()
+  bool finished = false;    // waited on and not handed out yet
+
+  //-----------------------------------------------------------------
+  // MeshLoader - Private Methods
+  //-----------------------------------------------------------------
+
+  void load(const std::string &path, JobSystem *jobs);
+};
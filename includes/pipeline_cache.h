@@ -0,0 +1,54 @@
+//===================================================================
+// File: pipeline_cache.h
+//
+// Desc: On-disk persistence for the Vulkan pipeline cache.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const char *const PIPELINE_CACHE_DEFAULT_PATH = "pipeline_cache.bin";
+const uint32_t PIPELINE_CACHE_FILE_MAGIC = 0x43505648; // "HVPC"
+const uint32_t PIPELINE_CACHE_FILE_VERSION = 1;
+
+//-------------------------------------------------------------------
+// PipelineCacheFileHeader (Struct Definition)
+//-------------------------------------------------------------------
+
+// Header written in front of the driver's cache blob. It records which
+// device and driver produced the blob so a cache from another GPU or an
+// older driver is discarded instead of handed to the driver.
+struct PipelineCacheFileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t vendorID;
+  uint32_t deviceID;
+  uint32_t driverVersion;
+  uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+  uint64_t dataSize;
+  uint64_t checksum;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+std::vector<char>
+loadPipelineCacheData(const std::string &path,
+                      const VkPhysicalDeviceProperties &properties);
+void savePipelineCacheData(const std::string &path,
+                           const VkPhysicalDeviceProperties &properties,
+                           const std::vector<char> &data);
@@ -0,0 +1,54 @@
+//===================================================================
+// File: presentation_profile.h
+//
+// Desc: Presets trading input latency against throughput when
+//       presenting frames.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <vulkan/vulkan.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// PresentationProfileType (Enum Definition)
+//-------------------------------------------------------------------
+enum PresentationProfileType {
+  PRESENTATION_PROFILE_LATENCY,    // interactive use, shortest queue
+  PRESENTATION_PROFILE_BALANCED,   // the default
+  PRESENTATION_PROFILE_THROUGHPUT, // unattended playback, deepest queue
+  PRESENTATION_PROFILE_COUNT
+};
+
+//-------------------------------------------------------------------
+// PresentationProfile (Struct Definition)
+//-------------------------------------------------------------------
+
+// How far the CPU may run ahead of the display. Fewer frames in flight and
+// swap chain images shorten the time from input to photons; more of them
+// keep the GPU fed when the CPU or the display stalls.
+struct PresentationProfile {
+  const char *name;
+  uint32_t framesInFlight;
+  uint32_t extraImages; // swap chain images requested above the minimum
+  std::vector<VkPresentModeKHR> presentModes; // most preferred first
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+const PresentationProfile &getPresentationProfile(PresentationProfileType type);
+std::optional<PresentationProfileType>
+parsePresentationProfile(const std::string &name);
+PresentationProfileType nextPresentationProfile(PresentationProfileType type);
+std::optional<VkPresentModeKHR> parsePresentMode(const std::string &name);
+const char *presentModeName(VkPresentModeKHR presentMode);
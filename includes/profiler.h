@@ -0,0 +1,96 @@
+//===================================================================
+// File: profiler.h
+//
+// Desc: Low overhead scoped CPU timers recorded into per-thread ring
+//       buffers and exported as Chrome trace JSON.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+//-------------------------------------------------------------------
+// Hash Defines
+//-------------------------------------------------------------------
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the enclosing scope. The name must be a string literal, only the
+// pointer is stored.
+#define PROFILE_SCOPE(name)                                                   \
+  ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const size_t PROFILER_EVENTS_PER_THREAD = 1 << 16; // ring buffer capacity
+
+//-------------------------------------------------------------------
+// Profiler (Class Definition)
+//-------------------------------------------------------------------
+
+// Process wide profiler. Each thread writes completed spans into its own
+// ring buffer without locking; exporting reads every thread's buffer and
+// skips any span that was overwritten while it was being copied.
+class Profiler {
+public:
+  //-----------------------------------------------------------------
+  // Profiler - Public Static Methods
+  //-----------------------------------------------------------------
+
+  static void setEnabled(bool enabled) {
+    enabledFlag.store(enabled, std::memory_order_relaxed);
+  }
+  static bool isEnabled() {
+    return enabledFlag.load(std::memory_order_relaxed);
+  }
+  static uint64_t now() {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  }
+  static void record(const char *name, uint64_t startNs, uint64_t endNs);
+  static void setThreadName(const std::string &name);
+  static bool exportChromeTrace(const std::string &path);
+
+private:
+  //-----------------------------------------------------------------
+  // Profiler - Private Static Member Variables
+  //-----------------------------------------------------------------
+  static std::atomic<bool> enabledFlag;
+};
+
+//-------------------------------------------------------------------
+// ProfileScope (Class Definition)
+//-------------------------------------------------------------------
+
+// Records a span from construction to destruction. Costs two clock reads
+// and a store into the calling thread's ring buffer.
+class ProfileScope {
+public:
+  explicit ProfileScope(const char *name)
+      : name(name), start(Profiler::isEnabled() ? Profiler::now() : 0) {}
+  ~ProfileScope() {
+    if (start != 0) {
+      Profiler::record(name, start, Profiler::now());
+    }
+  }
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+  const char *name;
+  uint64_t start;
+};
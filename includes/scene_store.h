@@ -0,0 +1,106 @@
+//===================================================================
+// File: scene_store.h
+//
+// Desc: Scene objects stored as separate arrays per attribute, with
+//       world matrices propagated level by level as parallel jobs.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "instance_buffer.h"
+#include "job_system.h"
+#include "vec_math.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t SCENE_NO_PARENT = UINT32_MAX;
+const size_t SCENE_CHUNK_SIZE = 4096; // objects per job
+
+//-------------------------------------------------------------------
+// SceneStore (Class Definition)
+//-------------------------------------------------------------------
+
+// Keeps positions, rotations, scales, colors, parents and world matrices in
+// one contiguous array each, with objects ordered by depth so every level
+// of the hierarchy is a contiguous range. propagate() walks the levels in
+// order and splits each into chunks run as jobs, since an object only
+// depends on its parent one level up.
+//
+// Setters mark objects dirty. Only dirty objects and the descendants of
+// changed objects are recomputed, levels without either are skipped, and a
+// scene where nothing moved costs nothing. writeInstances() copies only
+// what changed since a region of the instance buffer was last written.
+//
+// Objects are addressed by the id add() returns; reordering after adding
+// a shallower object keeps ids stable but moves the instance slots. None
+// of the methods may be called concurrently.
+class SceneStore {
+public:
+  //-----------------------------------------------------------------
+  // SceneStore - Public Types
+  //-----------------------------------------------------------------
+  using ObjectId = uint32_t;
+
+  //-----------------------------------------------------------------
+  // SceneStore - Public Methods
+  //-----------------------------------------------------------------
+
+  void reserve(size_t count);
+  ObjectId add(ObjectId parent, const Vec3 &position, const Quat &rotation,
+               const Vec3 &scale, const Vec4 &color);
+  void setPosition(ObjectId id, const Vec3 &position);
+  void setRotation(ObjectId id, const Quat &rotation);
+  void setScale(ObjectId id, const Vec3 &scale);
+  void setColor(ObjectId id, const Vec4 &color);
+  const Mat4 &worldMatrix(ObjectId id) const;
+  size_t size() const { return positions.size(); }
+  uint32_t levelCount() const {
+    return static_cast<uint32_t>(levelDirtyCounts.size());
+  }
+  size_t propagate(JobSystem &jobs);
+  size_t writeInstances(InstanceData *out, size_t capacity, uint32_t region,
+                        JobSystem &jobs);
+
+private:
+  //-----------------------------------------------------------------
+  // SceneStore - Private Member Variables
+  //-----------------------------------------------------------------
+
+  // per object, indexed by slot
+  std::vector<Vec3> positions;
+  std::vector<Quat> rotations;
+  std::vector<Vec3> scales;
+  std::vector<Vec4> colors;
+  std::vector<uint32_t> parents; // slot of the parent or SCENE_NO_PARENT
+  std::vector<uint32_t> levels;  // depth in the hierarchy, roots are 0
+  std::vector<Mat4> worldMatrices;
+  std::vector<uint8_t> dirty;      // local attributes changed
+  std::vector<uint32_t> versions;  // version that last changed the world
+  std::vector<ObjectId> slotToId;
+
+  std::vector<uint32_t> idToSlot;
+  std::vector<size_t> levelStarts; // first slot of each level, plus end
+  std::vector<uint32_t> levelDirtyCounts;
+  size_t dirtyCount = 0;
+  bool ordered = true;  // slots are sorted by level
+  uint32_t version = 0; // bumped by every propagate() that changes anything
+  std::vector<uint32_t> regionVersions; // version each region holds
+
+  //-----------------------------------------------------------------
+  // SceneStore - Private Methods
+  //-----------------------------------------------------------------
+
+  void markDirty(uint32_t slot);
+  void sortByLevel();
+};
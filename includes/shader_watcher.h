@@ -0,0 +1,86 @@
+//===================================================================
+// File: shader_watcher.h
+//
+// Desc: Watches the shader directory and recompiles changed GLSL to
+//       SPIR-V on a background thread.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+// Quiet period after the last change before compiling, so an editor's
+// burst of writes and renames triggers a single build.
+const int SHADER_WATCH_DEBOUNCE_MS = 100;
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+std::string spirvPathForShader(const std::string &sourcePath);
+
+//-------------------------------------------------------------------
+// ShaderWatcher (Class Definition)
+//-------------------------------------------------------------------
+
+// Recompiles .vert, .frag and .comp sources with glslangValidator whenever
+// they are written or moved into the watched directory, using the output
+// names of shaders/compile.sh. Every SPIR-V file that compiled is handed
+// to the callback, which runs on the watcher thread and so may build
+// pipelines without stalling the render thread. The SPIR-V is written to a
+// temporary file and renamed, so readers never see a partial module.
+//
+// Watching relies on inotify; on other platforms start() reports that
+// hot reload is unavailable and does nothing.
+class ShaderWatcher {
+public:
+  //-----------------------------------------------------------------
+  // ShaderWatcher - Public Types
+  //-----------------------------------------------------------------
+
+  using Callback = std::function<void(const std::string &spirvPath)>;
+
+  //-----------------------------------------------------------------
+  // ShaderWatcher - Public Methods
+  //-----------------------------------------------------------------
+
+  ShaderWatcher() = default;
+  ~ShaderWatcher();
+  ShaderWatcher(const ShaderWatcher &) = delete;
+  ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+  bool start(const std::string &directory, Callback onCompiled);
+  void stop();
+  bool isRunning() const { return thread.joinable(); }
+
+private:
+  //-----------------------------------------------------------------
+  // ShaderWatcher - Private Member Variables
+  //-----------------------------------------------------------------
+  std::string directory;
+  Callback onCompiled;
+  std::thread thread;
+  int inotifyFd = -1;
+  int wakeFds[2] = {-1, -1}; // pipe that interrupts the wait on stop()
+  std::atomic<bool> stopping{false};
+
+  //-----------------------------------------------------------------
+  // ShaderWatcher - Private Methods
+  //-----------------------------------------------------------------
+
+  void watchLoop();
+  bool compile(const std::string &sourcePath, const std::string &spirvPath);
+};
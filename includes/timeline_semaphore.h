@@ -0,0 +1,46 @@
+//===================================================================
+// File: timeline_semaphore.h
+//
+// Desc: Vulkan 1.2 timeline semaphore with a monotonically increasing
+//       signal value.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <vulkan/vulkan.h>
+
+//-------------------------------------------------------------------
+// TimelineSemaphore (Class Definition)
+//-------------------------------------------------------------------
+
+// One timeline semaphore per queue replaces a fence and a binary semaphore
+// per submission. Every submit signals nextValue(); the CPU waits for or
+// polls a value, and other queues wait on the same semaphore at that value.
+class TimelineSemaphore {
+public:
+  //-----------------------------------------------------------------
+  // TimelineSemaphore - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device);
+  void destroy();
+  VkSemaphore handle() const { return semaphore; }
+  uint64_t nextValue() { return ++lastValue; }
+  uint64_t completedValue() const;
+  bool isComplete(uint64_t value) const { return value <= completedValue(); }
+  void wait(uint64_t value) const;
+
+private:
+  //-----------------------------------------------------------------
+  // TimelineSemaphore - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  VkSemaphore semaphore = VK_NULL_HANDLE;
+  uint64_t lastValue = 0; // last value handed out by nextValue()
+};
@@ -0,0 +1,74 @@
+//===================================================================
+// File: uniform_ring.h
+//
+// Desc: Per-frame uniform data written into one persistently mapped
+//       buffer and addressed with dynamic offsets.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "device_allocator.h"
+#include <vulkan/vulkan.h>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 64 << 10; // bytes per frame
+
+//-------------------------------------------------------------------
+// FrameUniforms (Struct Definition)
+//-------------------------------------------------------------------
+
+// Per-frame constants as laid out in the std140 Frame block of the vertex
+// shaders.
+struct FrameUniforms {
+  float viewProjection[16]; // column major
+  float time;               // seconds since startup
+  float deltaTime;          // seconds since the previous frame
+  float extent[2];          // render target size in pixels
+};
+
+static_assert(sizeof(FrameUniforms) == 80, "must match the shader's layout");
+
+//-------------------------------------------------------------------
+// UniformRing (Class Definition)
+//-------------------------------------------------------------------
+
+// Host visible uniform buffer split into one region per frame in flight.
+// Each frame's blocks are appended to its region and bound through a
+// single dynamic uniform buffer descriptor by their offset, so updating
+// them is a copy into mapped memory with no allocation or descriptor
+// writes. A region is rewritten once its frame's previous submission has
+// completed.
+class UniformRing {
+public:
+  //-----------------------------------------------------------------
+  // UniformRing - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, DeviceAllocator *allocator,
+            uint32_t framesInFlight, VkDeviceSize minOffsetAlignment);
+  void destroy();
+  void beginFrame(uint32_t frame);
+  uint32_t push(const void *data, VkDeviceSize size);
+  VkDescriptorBufferInfo descriptorInfo(VkDeviceSize range) const;
+
+private:
+  //-----------------------------------------------------------------
+  // UniformRing - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  DeviceAllocator *allocator = nullptr;
+  VkBuffer buffer = VK_NULL_HANDLE;
+  MemoryAllocation memory;
+  VkDeviceSize alignment = 1;   // minUniformBufferOffsetAlignment
+  VkDeviceSize regionStart = 0; // current frame's region
+  VkDeviceSize head = 0;        // next free byte in the region
+};
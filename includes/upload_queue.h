@@ -0,0 +1,141 @@
+//===================================================================
+// File: upload_queue.h
+//
+// Desc: Streams buffer data to the GPU through a staging ring on a
+//       transfer queue.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include "device_allocator.h"
+#include "timeline_semaphore.h"
+#include <vulkan/vulkan.h>
+#include <deque>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const VkDeviceSize UPLOAD_RING_SIZE = 16ull << 20;   // staging ring bytes
+const VkDeviceSize UPLOAD_FRAME_BUDGET = 4ull << 20; // bytes copied per flush
+const uint32_t UPLOAD_BATCH_COUNT = 4;               // batches in flight
+
+// Stages and accesses that read uploaded data on the graphics queue.
+const VkPipelineStageFlags UPLOAD_CONSUMER_STAGES =
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+const VkAccessFlags UPLOAD_CONSUMER_ACCESS =
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+    VK_ACCESS_SHADER_READ_BIT;
+
+//-------------------------------------------------------------------
+// Types
+//-------------------------------------------------------------------
+
+typedef uint64_t UploadTicket; // identifies an upload, increases by one each
+
+//-------------------------------------------------------------------
+// UploadQueue (Class Definition)
+//-------------------------------------------------------------------
+
+// Copies data into device local buffers without stalling the frame loop.
+// Uploads are queued on the CPU and copied through a persistently mapped
+// staging ring, at most UPLOAD_FRAME_BUDGET bytes per flush, so a large mesh
+// streams in over several frames instead of causing a hitch. Batches are
+// tracked with fences, or with the values of one timeline semaphore, and
+// never waited on; when the ring or every batch is busy the flush simply
+// copies less.
+//
+// With a dedicated transfer family, batches run on the transfer queue and
+// ownership of every written range is released to the graphics family. The
+// semaphore returned by flush() must be waited on by the next graphics submit,
+// whose command buffer must start with recordAcquireBarriers(). Without one,
+// batches go to the graphics queue ahead of the frame and end with a plain
+// barrier.
+class UploadQueue {
+public:
+  //-----------------------------------------------------------------
+  // UploadQueue - Public Methods
+  //-----------------------------------------------------------------
+
+  void init(VkDevice device, DeviceAllocator *allocator,
+            uint32_t graphicsFamily, uint32_t transferFamily,
+            VkQueue transferQueue, bool timeline,
+            VkDeviceSize ringSize = UPLOAD_RING_SIZE,
+            VkDeviceSize frameBudget = UPLOAD_FRAME_BUDGET);
+  void destroy();
+  bool usesTransferQueue() const { return transferFamily != graphicsFamily; }
+  UploadTicket upload(VkBuffer buffer, VkDeviceSize offset,
+                      std::vector<char> data);
+  bool isComplete(UploadTicket ticket) const {
+    return ticket <= completedTicket;
+  }
+  bool isIdle() const { return pending.empty() && inFlight.empty(); }
+  void collect();
+  VkSemaphore flush(uint64_t *waitValue);
+  void recordAcquireBarriers(VkCommandBuffer commandBuffer);
+
+private:
+  //-----------------------------------------------------------------
+  // UploadQueue - Private Member Substructures
+  //-----------------------------------------------------------------
+
+  struct PendingUpload {
+    UploadTicket ticket;
+    VkBuffer buffer;
+    VkDeviceSize offset;
+    std::vector<char> data;
+    VkDeviceSize copied; // bytes already staged
+  };
+
+  struct Batch {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;         // binary semaphores only
+    VkSemaphore semaphore = VK_NULL_HANDLE; // binary semaphores only
+    uint64_t timelineValue = 0;             // value signaled on completion
+    uint64_t ringEnd = 0;         // ring position freed once the batch retires
+    UploadTicket lastTicket = 0;  // last upload the batch finished
+  };
+
+  //-----------------------------------------------------------------
+  // UploadQueue - Private Member Variables
+  //-----------------------------------------------------------------
+  VkDevice device = VK_NULL_HANDLE;
+  DeviceAllocator *allocator = nullptr;
+  uint32_t graphicsFamily = 0;
+  uint32_t transferFamily = 0;
+  VkQueue transferQueue = VK_NULL_HANDLE;
+  bool timeline = false;
+  TimelineSemaphore timelineSemaphore;
+  VkDeviceSize frameBudget = UPLOAD_FRAME_BUDGET;
+
+  VkBuffer ringBuffer = VK_NULL_HANDLE;
+  MemoryAllocation ringMemory;
+  VkDeviceSize ringSize = 0;
+  uint64_t ringHead = 0; // total bytes ever reserved
+  uint64_t ringTail = 0; // total bytes ever retired
+
+  std::deque<PendingUpload> pending;
+  std::vector<Batch> batches;
+  std::deque<size_t> inFlight; // batch indices in submission order
+  size_t nextBatch = 0;
+  UploadTicket nextTicket = 1;
+  UploadTicket completedTicket = 0;
+  std::vector<VkBufferMemoryBarrier> acquireBarriers;
+
+  //-----------------------------------------------------------------
+  // UploadQueue - Private Methods
+  //-----------------------------------------------------------------
+
+  bool reserveRing(VkDeviceSize size, VkDeviceSize *offset);
+};
@@ -0,0 +1,300 @@
+//===================================================================
+// File: vec_math.h
+//
+// Desc: 16 byte aligned vector, matrix and quaternion types with SSE
+//       and AVX2 kernels and a scalar fallback.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+#pragma once
+
+//-------------------------------------------------------------------
+// Hash Defines
+//-------------------------------------------------------------------
+
+// The kernels are picked at compile time from the instruction sets the
+// compiler targets. HELLOVULKAN_SCALAR_MATH forces the scalar fallback.
+#if !defined(HELLOVULKAN_SCALAR_MATH) && defined(__AVX2__)
+#define VEC_MATH_AVX2 1
+#define VEC_MATH_SSE 1
+#elif !defined(HELLOVULKAN_SCALAR_MATH) &&                                    \
+    (defined(__SSE2__) || defined(_M_X64) ||                                  \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define VEC_MATH_SSE 1
+#endif
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+
+#include <cmath>
+#include <cstddef>
+
+#if defined(VEC_MATH_AVX2)
+#include <immintrin.h>
+#elif defined(VEC_MATH_SSE)
+#include <emmintrin.h>
+#endif
+
+//-------------------------------------------------------------------
+// Vec3 (Struct Definition)
+//-------------------------------------------------------------------
+
+// Padded to 16 bytes so arrays of it stay aligned; the padding is ignored.
+struct alignas(16) Vec3 {
+  float x, y, z, pad;
+};
+
+//-------------------------------------------------------------------
+// Vec4 (Struct Definition)
+//-------------------------------------------------------------------
+struct alignas(16) Vec4 {
+  float x, y, z, w;
+};
+
+//-------------------------------------------------------------------
+// Quat (Struct Definition)
+//-------------------------------------------------------------------
+
+// Rotation quaternion, xyz is the vector part and w the scalar part.
+struct alignas(16) Quat {
+  float x, y, z, w;
+};
+
+//-------------------------------------------------------------------
+// Mat4 (Struct Definition)
+//-------------------------------------------------------------------
+
+// Column major 4x4 matrix, laid out like a GLSL mat4 so it can be copied
+// into buffers as is.
+struct alignas(16) Mat4 {
+  Vec4 columns[4];
+};
+
+static_assert(sizeof(Vec3) == 16 && sizeof(Vec4) == 16 &&
+                  sizeof(Quat) == 16 && sizeof(Mat4) == 64,
+              "math types must match the shader layouts");
+
+//-------------------------------------------------------------------
+// Global Functions (Vectors)
+//-------------------------------------------------------------------
+
+inline Vec3 vec3(float x, float y, float z) { return {x, y, z, 0.0f}; }
+inline Vec4 vec4(float x, float y, float z, float w) { return {x, y, z, w}; }
+inline Vec4 vec4(const Vec3 &v, float w) { return {v.x, v.y, v.z, w}; }
+
+inline Vec3 operator+(const Vec3 &a, const Vec3 &b) {
+  return vec3(a.x + b.x, a.y + b.y, a.z + b.z);
+}
+inline Vec3 operator-(const Vec3 &a, const Vec3 &b) {
+  return vec3(a.x - b.x, a.y - b.y, a.z - b.z);
+}
+inline Vec3 operator*(const Vec3 &v, float s) {
+  return vec3(v.x * s, v.y * s, v.z * s);
+}
+inline float dot(const Vec3 &a, const Vec3 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline Vec3 cross(const Vec3 &a, const Vec3 &b) {
+  return vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z,
+              a.x * b.y - a.y * b.x);
+}
+inline float length(const Vec3 &v) { return std::sqrt(dot(v, v)); }
+
+// Scales v to unit length.
+// ~Returns: v normalized, or v itself if it has no length.
+inline Vec3 normalize(const Vec3 &v) {
+  float l = length(v);
+  return l > 0.0f ? v * (1.0f / l) : v;
+}
+
+inline Vec4 operator+(const Vec4 &a, const Vec4 &b) {
+  return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+}
+inline Vec4 operator*(const Vec4 &v, float s) {
+  return {v.x * s, v.y * s, v.z * s, v.w * s};
+}
+inline float dot(const Vec4 &a, const Vec4 &b) {
+  return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+//-------------------------------------------------------------------
+// Global Functions (Quaternions)
+//-------------------------------------------------------------------
+
+inline Quat quatIdentity() { return {0.0f, 0.0f, 0.0f, 1.0f}; }
+
+// Builds the rotation of angle radians around axis.
+// ~Returns: unit quaternion.
+inline Quat quatFromAxisAngle(const Vec3 &axis, float angle) {
+  Vec3 n = normalize(axis);
+  float s = std::sin(angle * 0.5f);
+  return {n.x * s, n.y * s, n.z * s, std::cos(angle * 0.5f)};
+}
+
+// Combines two rotations, b is applied first.
+// ~Returns: the product a * b.
+inline Quat operator*(const Quat &a, const Quat &b) {
+  return {a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+          a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+          a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+          a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+// Scales q to unit length, undoing drift from repeated products.
+// ~Returns: q normalized, or the identity if it has no length.
+inline Quat normalize(const Quat &q) {
+  float l = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+  if (l <= 0.0f) {
+    return quatIdentity();
+  }
+  float s = 1.0f / l;
+  return {q.x * s, q.y * s, q.z * s, q.w * s};
+}
+
+//-------------------------------------------------------------------
+// Global Functions (Matrices)
+//-------------------------------------------------------------------
+
+inline Mat4 mat4Identity() {
+  return {{{1.0f, 0.0f, 0.0f, 0.0f},
+           {0.0f, 1.0f, 0.0f, 0.0f},
+           {0.0f, 0.0f, 1.0f, 0.0f},
+           {0.0f, 0.0f, 0.0f, 1.0f}}};
+}
+
+// Builds translation * rotation * scale, the usual local transform of an
+// object. rotation must be a unit quaternion.
+// ~Returns: the composed matrix.
+inline Mat4 mat4Compose(const Vec3 &translation, const Quat &rotation,
+                        const Vec3 &scale) {
+  float x = rotation.x, y = rotation.y, z = rotation.z, w = rotation.w;
+  float xx = x * x, yy = y * y, zz = z * z;
+  float xy = x * y, xz = x * z, yz = y * z;
+  float wx = w * x, wy = w * y, wz = w * z;
+
+  Mat4 m;
+  m.columns[0] = {(1.0f - 2.0f * (yy + zz)) * scale.x,
+                  2.0f * (xy + wz) * scale.x, 2.0f * (xz - wy) * scale.x,
+                  0.0f};
+  m.columns[1] = {2.0f * (xy - wz) * scale.y,
+                  (1.0f - 2.0f * (xx + zz)) * scale.y,
+                  2.0f * (yz + wx) * scale.y, 0.0f};
+  m.columns[2] = {2.0f * (xz + wy) * scale.z, 2.0f * (yz - wx) * scale.z,
+                  (1.0f - 2.0f * (xx + yy)) * scale.z, 0.0f};
+  m.columns[3] = {translation.x, translation.y, translation.z, 1.0f};
+  return m;
+}
+
+// Reference product of two matrices, always computed without SIMD.
+// ~Returns: a * b.
+inline Mat4 mat4MulScalar(const Mat4 &a, const Mat4 &b) {
+  Mat4 r;
+  for (int j = 0; j < 4; j++) {
+    const Vec4 &c = b.columns[j];
+    r.columns[j] = a.columns[0] * c.x + a.columns[1] * c.y +
+                   a.columns[2] * c.z + a.columns[3] * c.w;
+  }
+  return r;
+}
+
+// Reference product of a matrix and a vector, always computed without
+// SIMD.
+// ~Returns: m * v.
+inline Vec4 mat4MulVec4Scalar(const Mat4 &m, const Vec4 &v) {
+  return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z +
+         m.columns[3] * v.w;
+}
+
+// Multiplies two matrices with the widest kernel compiled in.
+// ~Returns: a * b.
+inline Mat4 mat4Mul(const Mat4 &a, const Mat4 &b) {
+#if defined(VEC_MATH_AVX2)
+  // each 256 bit register holds two columns of b and of the result; the
+  // columns of a are repeated in both halves. Mat4 is only 16 byte
+  // aligned, so the 256 bit accesses are unaligned ones
+  Mat4 r;
+  const float *bf = &b.columns[0].x;
+  float *rf = &r.columns[0].x;
+  const __m128 *ac = reinterpret_cast<const __m128 *>(a.columns);
+  __m256 a0 = _mm256_broadcast_ps(ac + 0);
+  __m256 a1 = _mm256_broadcast_ps(ac + 1);
+  __m256 a2 = _mm256_broadcast_ps(ac + 2);
+  __m256 a3 = _mm256_broadcast_ps(ac + 3);
+  for (int j = 0; j < 16; j += 8) {
+    __m256 c = _mm256_loadu_ps(bf + j);
+    __m256 s = _mm256_mul_ps(a0, _mm256_permute_ps(c, 0x00));
+#if defined(__FMA__)
+    s = _mm256_fmadd_ps(a1, _mm256_permute_ps(c, 0x55), s);
+    s = _mm256_fmadd_ps(a2, _mm256_permute_ps(c, 0xaa), s);
+    s = _mm256_fmadd_ps(a3, _mm256_permute_ps(c, 0xff), s);
+#else
+    s = _mm256_add_ps(s, _mm256_mul_ps(a1, _mm256_permute_ps(c, 0x55)));
+    s = _mm256_add_ps(s, _mm256_mul_ps(a2, _mm256_permute_ps(c, 0xaa)));
+    s = _mm256_add_ps(s, _mm256_mul_ps(a3, _mm256_permute_ps(c, 0xff)));
+#endif
+    _mm256_storeu_ps(rf + j, s);
+  }
+  return r;
+#elif defined(VEC_MATH_SSE)
+  Mat4 r;
+  __m128 a0 = _mm_load_ps(&a.columns[0].x);
+  __m128 a1 = _mm_load_ps(&a.columns[1].x);
+  __m128 a2 = _mm_load_ps(&a.columns[2].x);
+  __m128 a3 = _mm_load_ps(&a.columns[3].x);
+  for (int j = 0; j < 4; j++) {
+    __m128 c = _mm_load_ps(&b.columns[j].x);
+    __m128 s = _mm_mul_ps(a0, _mm_shuffle_ps(c, c, 0x00));
+    s = _mm_add_ps(s, _mm_mul_ps(a1, _mm_shuffle_ps(c, c, 0x55)));
+    s = _mm_add_ps(s, _mm_mul_ps(a2, _mm_shuffle_ps(c, c, 0xaa)));
+    s = _mm_add_ps(s, _mm_mul_ps(a3, _mm_shuffle_ps(c, c, 0xff)));
+    _mm_store_ps(&r.columns[j].x, s);
+  }
+  return r;
+#else
+  return mat4MulScalar(a, b);
+#endif
+}
+
+// Multiplies a matrix and a vector with the widest kernel compiled in.
+// ~Returns: m * v.
+inline Vec4 mat4MulVec4(const Mat4 &m, const Vec4 &v) {
+#if defined(VEC_MATH_SSE)
+  Vec4 r;
+  __m128 c = _mm_load_ps(&v.x);
+  __m128 s = _mm_mul_ps(_mm_load_ps(&m.columns[0].x),
+                        _mm_shuffle_ps(c, c, 0x00));
+  s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(&m.columns[1].x),
+                               _mm_shuffle_ps(c, c, 0x55)));
+  s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(&m.columns[2].x),
+                               _mm_shuffle_ps(c, c, 0xaa)));
+  s = _mm_add_ps(s, _mm_mul_ps(_mm_load_ps(&m.columns[3].x),
+                               _mm_shuffle_ps(c, c, 0xff)));
+  _mm_store_ps(&r.x, s);
+  return r;
+#else
+  return mat4MulVec4Scalar(m, v);
+#endif
+}
+
+inline Mat4 operator*(const Mat4 &a, const Mat4 &b) { return mat4Mul(a, b); }
+inline Vec4 operator*(const Mat4 &m, const Vec4 &v) {
+  return mat4MulVec4(m, v);
+}
+
+//-------------------------------------------------------------------
+// Global Functions (Batches)
+//-------------------------------------------------------------------
+
+const char *vecMathBackend();
+void mat4MulBatch(const Mat4 &a, const Mat4 *b, Mat4 *out, size_t count);
+void mat4MulPairs(const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count);
+void mat4TransformBatch(const Mat4 &m, const Vec4 *in, Vec4 *out,
+                        size_t count);
+void mat4MulBatchScalar(const Mat4 &a, const Mat4 *b, Mat4 *out,
+                        size_t count);
+void mat4MulPairsScalar(const Mat4 *a, const Mat4 *b, Mat4 *out,
+                        size_t count);
+void mat4TransformBatchScalar(const Mat4 &m, const Vec4 *in, Vec4 *out,
+                              size_t count);
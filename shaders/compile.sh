@@ -1,2 +1,6 @@
-~/VulkanSDK/x86_64/bin/glslangValidator -V shader.vert
-~/VulkanSDK/x86_64/bin/glslangValidator -V shader.frag
\ No newline at end of file
+GLSLANG="${VULKAN_SDK:-$HOME/VulkanSDK/x86_64}/bin/glslangValidator"
+"$GLSLANG" -V shader.vert
+"$GLSLANG" -V shader.frag
+"$GLSLANG" -V instanced.vert -o instanced.spv
+"$GLSLANG" -V cull.comp -o cull.spv
+"$GLSLANG" -V mesh.vert -o mesh.spv
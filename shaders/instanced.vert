@@ -0,0 +1,39 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+struct Instance {
+    mat4 transform;
+    vec4 color;
+};
+
+layout(std140, set = 0, binding = 0) uniform Frame {
+    mat4 viewProjection;
+    float time;
+    float deltaTime;
+    vec2 extent;
+} frame;
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(location = 0) out vec3 fragColor;
+
+vec2 positions[3] = vec2[](
+    vec2(0.0, -0.5),
+    vec2(0.5, 0.5),
+    vec2(-0.5, 0.5)
+);
+
+vec3 colors[3] = vec3[](
+    vec3(1.0, 0.0, 0.0),
+    vec3(0.0, 1.0, 0.0),
+    vec3(0.0, 0.0, 1.0)
+);
+
+void main() {
+    Instance instance = instances[gl_InstanceIndex];
+    gl_Position = frame.viewProjection * instance.transform *
+                  vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    fragColor = mix(colors[gl_VertexIndex], instance.color.rgb, 0.5);
+}
@@ -0,0 +1,31 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(std140, set = 0, binding = 0) uniform Frame {
+    mat4 viewProjection;
+    float time;
+    float deltaTime;
+    vec2 extent;
+} frame;
+
+layout(push_constant) uniform Mesh {
+    mat4 transform;
+} mesh;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec2 inUv;
+
+layout(location = 0) out vec3 fragColor;
+
+void main() {
+    gl_Position =
+        frame.viewProjection * mesh.transform * vec4(inPosition, 1.0);
+
+    // shade by normal, or by uv for meshes without normals
+    if (dot(inNormal, inNormal) > 0.0) {
+        fragColor = normalize(inNormal) * 0.5 + 0.5;
+    } else {
+        fragColor = vec3(inUv, 0.5);
+    }
+}
@@ -1,6 +1,13 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout(std140, set = 0, binding = 0) uniform Frame {
+    mat4 viewProjection;
+    float time;
+    float deltaTime;
+    vec2 extent;
+} frame;
+
 layout(location = 0) out vec3 fragColor;
 
 vec2 positions[3] = vec2[](
@@ -16,6 +23,7 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
+    gl_Position =
+        frame.viewProjection * vec4(positions[gl_VertexIndex], 0.0, 1.0);
     fragColor = colors[gl_VertexIndex];
 }
\ No newline at end of file
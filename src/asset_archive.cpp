@@ -0,0 +1,224 @@
+//===================================================================
+// File: asset_archive.cpp
+//
+// Desc: Packed asset archive that is memory mapped and read in place.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/asset_archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Rounds offset up to the next blob boundary.
+// ~Returns: aligned offset.
+static uint64_t alignBlobOffset(uint64_t offset) {
+  return (offset + ASSET_ARCHIVE_ALIGNMENT - 1) &
+         ~static_cast<uint64_t>(ASSET_ARCHIVE_ALIGNMENT - 1);
+}
+
+// Writes assets into a new archive at path, replacing any existing file.
+// Names must be unique and shorter than ASSET_ARCHIVE_NAME_SIZE.
+void writeAssetArchive(const std::string &path,
+                       std::vector<AssetSource> assets) {
+  // the reader binary searches the index
+  std::sort(assets.begin(), assets.end(),
+            [](const AssetSource &a, const AssetSource &b) {
+              return a.name < b.name;
+            });
+
+  AssetArchiveHeader header = {};
+  header.magic = ASSET_ARCHIVE_MAGIC;
+  header.version = ASSET_ARCHIVE_VERSION;
+  header.entryCount = static_cast<uint32_t>(assets.size());
+
+  // lay the blobs out behind the index
+  std::vector<AssetArchiveEntry> entries(assets.size());
+  uint64_t offset = alignBlobOffset(sizeof(AssetArchiveHeader) +
+                                    entries.size() * sizeof(AssetArchiveEntry));
+  for (size_t i = 0; i < assets.size(); i++) {
+    const std::string &name = assets[i].name;
+    if (name.empty() || name.size() >= ASSET_ARCHIVE_NAME_SIZE) {
+      throw std::runtime_error("asset name " + name +
+                               " is empty or too long!");
+    }
+    if (i > 0 && name == assets[i - 1].name) {
+      throw std::runtime_error("duplicate asset " + name + "!");
+    }
+    std::memset(&entries[i], 0, sizeof(AssetArchiveEntry));
+    std::memcpy(entries[i].name, name.data(), name.size());
+    entries[i].offset = offset;
+    entries[i].size = assets[i].data.size();
+    offset = alignBlobOffset(offset + entries[i].size);
+  }
+
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to create asset archive " + path + "!");
+  }
+  file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  file.write(reinterpret_cast<const char *>(entries.data()),
+             entries.size() * sizeof(AssetArchiveEntry));
+
+  // zero pad up to every blob
+  const char padding[ASSET_ARCHIVE_ALIGNMENT] = {};
+  uint64_t written =
+      sizeof(header) + entries.size() * sizeof(AssetArchiveEntry);
+  for (size_t i = 0; i < assets.size(); i++) {
+    file.write(padding, entries[i].offset - written);
+    file.write(assets[i].data.data(), assets[i].data.size());
+    written = entries[i].offset + entries[i].size;
+  }
+  file.write(padding, alignBlobOffset(written) - written);
+  if (!file) {
+    throw std::runtime_error("failed to write asset archive " + path + "!");
+  }
+}
+
+//-------------------------------------------------------------------
+// AssetArchive (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Unmaps the archive.
+AssetArchive::~AssetArchive() { close(); }
+
+// Maps the archive at path and checks its index.
+// ~Returns: false if there is no file at path.
+bool AssetArchive::open(const std::string &path) {
+  close();
+
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("asset archive " + path + " is empty!");
+  }
+  fileSize = static_cast<size_t>(status.st_size);
+
+  // the mapping stays valid after the descriptor is closed
+  void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("failed to map asset archive " + path + "!");
+  }
+  base = static_cast<const char *>(mapping);
+#else
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  fileSize = static_cast<size_t>(file.tellg());
+  fallbackBuffer.resize((fileSize + sizeof(AlignedChunk) - 1) /
+                        sizeof(AlignedChunk));
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(fallbackBuffer.data()), fileSize);
+  base = reinterpret_cast<const char *>(fallbackBuffer.data());
+#endif
+
+  try {
+    validate();
+  } catch (...) {
+    close();
+    throw;
+  }
+  return true;
+}
+
+// Unmaps the archive. Blobs returned by find() become invalid.
+void AssetArchive::close() {
+  if (base == nullptr) {
+    return;
+  }
+#ifndef _WIN32
+  munmap(const_cast<char *>(base), fileSize);
+#else
+  fallbackBuffer.clear();
+#endif
+  base = nullptr;
+  fileSize = 0;
+  entries = nullptr;
+  entryCount = 0;
+}
+
+// Looks an asset up by name.
+// ~Returns: view of the asset, with null data if it isn't in the archive.
+AssetBlob AssetArchive::find(const std::string &name) const {
+  AssetBlob blob;
+  if (base == nullptr || name.size() >= ASSET_ARCHIVE_NAME_SIZE) {
+    return blob;
+  }
+  auto end = entries + entryCount;
+  auto entry = std::lower_bound(entries, end, name,
+                                [](const AssetArchiveEntry &entry,
+                                   const std::string &name) {
+                                  return name.compare(entry.name) > 0;
+                                });
+  if (entry != end && name == entry->name) {
+    blob.data = base + entry->offset;
+    blob.size = static_cast<size_t>(entry->size);
+  }
+  return blob;
+}
+
+//-------------------------------------------------------------------
+// AssetArchive (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Checks the header and that every entry is named, sorted, aligned and
+// inside the file, so find() can trust the index.
+void AssetArchive::validate() {
+  if (fileSize < sizeof(AssetArchiveHeader)) {
+    throw std::runtime_error("asset archive is truncated!");
+  }
+  AssetArchiveHeader header;
+  std::memcpy(&header, base, sizeof(header));
+  if (header.magic != ASSET_ARCHIVE_MAGIC ||
+      header.version != ASSET_ARCHIVE_VERSION) {
+    throw std::runtime_error("asset archive has an unknown format!");
+  }
+  uint64_t indexEnd = sizeof(AssetArchiveHeader) +
+                      uint64_t(header.entryCount) * sizeof(AssetArchiveEntry);
+  if (indexEnd > fileSize) {
+    throw std::runtime_error("asset archive index is truncated!");
+  }
+
+  entries = reinterpret_cast<const AssetArchiveEntry *>(
+      base + sizeof(AssetArchiveHeader));
+  entryCount = header.entryCount;
+  for (uint32_t i = 0; i < entryCount; i++) {
+    const AssetArchiveEntry &entry = entries[i];
+    if (entry.name[0] == '\0' ||
+        std::memchr(entry.name, '\0', ASSET_ARCHIVE_NAME_SIZE) == nullptr ||
+        (i > 0 && std::strcmp(entries[i - 1].name, entry.name) >= 0)) {
+      throw std::runtime_error("asset archive index is corrupt!");
+    }
+    if (entry.offset % ASSET_ARCHIVE_ALIGNMENT != 0 ||
+        entry.offset < indexEnd || entry.size > fileSize ||
+        entry.offset > fileSize - entry.size) {
+      throw std::runtime_error("asset archive entry " +
+                               std::string(entry.name) +
+                               " lies outside the file!");
+    }
+  }
+}
@@ -0,0 +1,197 @@
+//===================================================================
+// File: async_compute.cpp
+//
+// Desc: Submits per-frame compute work on a dedicated compute queue
+//       that overlaps with graphics work.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/async_compute.h"
+#include "../includes/profiler.h"
+
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// AsyncCompute (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the command pool and command buffer of each frame in flight, and
+// either a binary semaphore per frame or one timeline semaphore.
+// computeQueue is the graphics queue when the families match.
+void AsyncCompute::init(VkDevice device, uint32_t graphicsFamily,
+                        uint32_t computeFamily, VkQueue computeQueue,
+                        uint32_t framesInFlight, bool timeline) {
+  this->device = device;
+  this->graphicsFamily = graphicsFamily;
+  this->computeFamily = computeFamily;
+  this->computeQueue = computeQueue;
+  this->timeline = timeline;
+  if (timeline) {
+    timelineSemaphore.init(device);
+  }
+
+  // one transient pool per frame, reset whenever the frame is recorded
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = computeFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  frames.resize(framesInFlight);
+  for (auto &frame : frames) {
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &frame.pool) !=
+            VK_SUCCESS ||
+        (!timeline && vkCreateSemaphore(device, &semaphoreInfo, nullptr,
+                                        &frame.semaphore) != VK_SUCCESS)) {
+      throw std::runtime_error("failed to create async compute frame!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frame.pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &frame.commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate compute command buffer!");
+    }
+  }
+}
+
+// Destroys the frames' pools and semaphores. The device must be idle.
+void AsyncCompute::destroy() {
+  for (auto &frame : frames) {
+    vkDestroySemaphore(device, frame.semaphore, nullptr);
+    vkDestroyCommandPool(device, frame.pool, nullptr);
+  }
+  frames.clear();
+  timelineSemaphore.destroy();
+}
+
+// Starts recording a frame's compute work. The frame's previous graphics
+// submission must have completed.
+// ~Returns: compute command buffer to record into.
+VkCommandBuffer AsyncCompute::begin(uint32_t frame) {
+  Frame &current = frames[frame];
+  current.srcStages = 0;
+  current.dstStages = 0;
+  // acquires left by a frame that submitted compute work but never
+  // recorded its graphics commands mustn't carry over to this one
+  current.releaseBarriers.clear();
+  current.acquireBarriers.clear();
+
+  vkResetCommandPool(device, current.pool, 0);
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(current.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin compute command buffer!");
+  }
+  return current.commandBuffer;
+}
+
+// Hands a range written by this frame's compute work over to the graphics
+// queue, which reads it in dstStages with dstAccess.
+void AsyncCompute::releaseBuffer(uint32_t frame,
+                                 const VkDescriptorBufferInfo &range,
+                                 VkPipelineStageFlags srcStages,
+                                 VkAccessFlags srcAccess,
+                                 VkPipelineStageFlags dstStages,
+                                 VkAccessFlags dstAccess) {
+  Frame &current = frames[frame];
+  current.srcStages |= srcStages;
+  current.dstStages |= dstStages;
+
+  // on a shared queue the semaphore already makes the writes visible
+  if (!isAsync()) {
+    return;
+  }
+
+  // release on the compute queue, the matching acquire is recorded on the
+  // graphics queue by recordAcquireBarriers()
+  VkBufferMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstAccessMask = 0;
+  barrier.srcQueueFamilyIndex = computeFamily;
+  barrier.dstQueueFamilyIndex = graphicsFamily;
+  barrier.buffer = range.buffer;
+  barrier.offset = range.offset;
+  barrier.size = range.range;
+  current.releaseBarriers.push_back(barrier);
+
+  VkBufferMemoryBarrier acquire = barrier;
+  acquire.srcAccessMask = 0;
+  acquire.dstAccessMask = dstAccess;
+  current.acquireBarriers.push_back(acquire);
+}
+
+// Ends recording and submits a frame's compute work.
+// ~Returns: semaphore the frame's graphics submit must wait on, with the
+// stages to wait at in waitStages and, for a timeline semaphore, the value
+// to wait for in waitValue.
+VkSemaphore AsyncCompute::submit(uint32_t frame,
+                                 VkPipelineStageFlags *waitStages,
+                                 uint64_t *waitValue) {
+  PROFILE_SCOPE("AsyncCompute::submit");
+  Frame &current = frames[frame];
+  if (!current.releaseBarriers.empty()) {
+    vkCmdPipelineBarrier(
+        current.commandBuffer, current.srcStages,
+        VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+        static_cast<uint32_t>(current.releaseBarriers.size()),
+        current.releaseBarriers.data(), 0, nullptr);
+  }
+  if (vkEndCommandBuffer(current.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record compute command buffer!");
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &current.commandBuffer;
+  VkSemaphore signalSemaphore = current.semaphore;
+  *waitValue = 0;
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  if (timeline) {
+    signalSemaphore = timelineSemaphore.handle();
+    *waitValue = timelineSemaphore.nextValue();
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = waitValue;
+    submitInfo.pNext = &timelineInfo;
+  }
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &signalSemaphore;
+  if (vkQueueSubmit(computeQueue, 1, &submitInfo, VK_NULL_HANDLE) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit compute command buffer!");
+  }
+
+  // nothing released means graphics reads nothing, but still waits in order
+  *waitStages = current.dstStages != 0 ? current.dstStages
+                                       : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+  return signalSemaphore;
+}
+
+// Records the acquire half of the ownership transfers released by a frame's
+// compute work. Must go into the frame's graphics command buffer, outside of
+// a render pass.
+void AsyncCompute::recordAcquireBarriers(VkCommandBuffer commandBuffer,
+                                         uint32_t frame) {
+  Frame &current = frames[frame];
+  if (current.acquireBarriers.empty()) {
+    return;
+  }
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       current.dstStages, 0, 0, nullptr,
+                       static_cast<uint32_t>(current.acquireBarriers.size()),
+                       current.acquireBarriers.data(), 0, nullptr);
+  current.acquireBarriers.clear();
+}
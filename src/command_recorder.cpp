@@ -0,0 +1,144 @@
+//===================================================================
+// File: command_recorder.cpp
+//
+// Desc: Records slices of a draw list into secondary command buffers
+//       on worker threads.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/command_recorder.h"
+#include "../includes/profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Local Constants
+//-------------------------------------------------------------------
+
+// Slices smaller than this cost more to hand out than to record.
+static const size_t MIN_DRAWS_PER_SLICE = 64;
+
+//-------------------------------------------------------------------
+// ParallelCommandRecorder (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Prepares to record up to maxSlices secondary buffers in parallel on
+// jobs, creating a command pool for every combination of job thread and
+// frame in flight.
+void ParallelCommandRecorder::init(VkDevice device, uint32_t queueFamilyIndex,
+                                   JobSystem *jobs, uint32_t maxSlices,
+                                   uint32_t framesInFlight) {
+  this->device = device;
+  this->jobs = jobs;
+  this->maxSlices = std::max(maxSlices, 1u);
+
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = queueFamilyIndex;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  workerFrames.resize(jobs->size());
+  for (auto &frames : workerFrames) {
+    frames.resize(framesInFlight);
+    for (auto &workerFrame : frames) {
+      if (vkCreateCommandPool(device, &poolInfo, nullptr, &workerFrame.pool) !=
+          VK_SUCCESS) {
+        throw std::runtime_error("failed to create worker command pool!");
+      }
+    }
+  }
+}
+
+// Destroys the command pools of every job thread.
+void ParallelCommandRecorder::destroy() {
+  jobs = nullptr;
+  for (auto &frames : workerFrames) {
+    for (auto &workerFrame : frames) {
+      vkDestroyCommandPool(device, workerFrame.pool, nullptr);
+    }
+  }
+  workerFrames.clear();
+  secondaryBuffers.clear();
+}
+
+// Resets every worker's pool for a frame whose fence has signaled.
+void ParallelCommandRecorder::resetFrame(uint32_t frame) {
+  for (auto &frames : workerFrames) {
+    vkResetCommandPool(device, frames[frame].pool, 0);
+    frames[frame].buffersUsed = 0;
+  }
+}
+
+// Splits drawCount draws into slices and records each slice into a
+// secondary command buffer in a job. The calling thread records slices too
+// while it waits.
+// ~Returns: secondary command buffers in draw order, ready for
+// vkCmdExecuteCommands.
+const std::vector<VkCommandBuffer> &ParallelCommandRecorder::record(
+    uint32_t frame, const VkCommandBufferInheritanceInfo &inheritance,
+    size_t drawCount, const RecordSlice &recordSlice) {
+  // up to maxSlices, unless the draw list is too short to be worth it
+  size_t sliceCount = std::max<size_t>(
+      1, std::min<size_t>(maxSlices,
+                          (drawCount + MIN_DRAWS_PER_SLICE - 1) /
+                              MIN_DRAWS_PER_SLICE));
+  size_t sliceSize = (drawCount + sliceCount - 1) / sliceCount;
+  secondaryBuffers.assign(sliceCount, VK_NULL_HANDLE);
+
+  jobs->parallelFor(sliceCount, [&](size_t slice, uint32_t thread) {
+    PROFILE_SCOPE("recordSecondary");
+    VkCommandBuffer commandBuffer =
+        acquireBuffer(workerFrames[thread][frame]);
+
+    // secondary buffers run entirely inside the primary's render pass
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT |
+                      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin secondary command buffer!");
+    }
+
+    size_t begin = std::min(drawCount, slice * sliceSize);
+    size_t end = std::min(drawCount, begin + sliceSize);
+    recordSlice(commandBuffer, begin, end);
+
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record secondary command buffer!");
+    }
+    secondaryBuffers[slice] = commandBuffer;
+  });
+
+  return secondaryBuffers;
+}
+
+//-------------------------------------------------------------------
+// ParallelCommandRecorder (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Hands out the next unused secondary buffer of a thread's pool, allocating
+// a new one the first time the pool needs more buffers than before.
+VkCommandBuffer
+ParallelCommandRecorder::acquireBuffer(WorkerFrame &workerFrame) {
+  if (workerFrame.buffersUsed == workerFrame.buffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = workerFrame.pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate secondary command buffer!");
+    }
+    workerFrame.buffers.push_back(commandBuffer);
+  }
+  return workerFrame.buffers[workerFrame.buffersUsed++];
+}
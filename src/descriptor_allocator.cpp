@@ -0,0 +1,185 @@
+//===================================================================
+// File: descriptor_allocator.cpp
+//
+// Desc: Descriptor set layout cache and descriptor pools that grow on
+//       demand and are recycled per frame in flight.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/descriptor_allocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// DescriptorLayoutCache (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Starts an empty cache for device.
+void DescriptorLayoutCache::init(VkDevice device) {
+  this->device = device;
+}
+
+// Destroys every cached layout.
+void DescriptorLayoutCache::destroy() {
+  for (auto &entry : layouts) {
+    vkDestroyDescriptorSetLayout(device, entry.second, nullptr);
+  }
+  layouts.clear();
+}
+
+// Gets the layout with the given bindings, creating it on first use.
+// ~Returns: layout owned by the cache.
+VkDescriptorSetLayout
+DescriptorLayoutCache::get(std::vector<VkDescriptorSetLayoutBinding> bindings) {
+  // the order bindings are listed in doesn't change the layout
+  std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding &a,
+               const VkDescriptorSetLayoutBinding &b) {
+              return a.binding < b.binding;
+            });
+  LayoutKey key;
+  for (const VkDescriptorSetLayoutBinding &binding : bindings) {
+    key.emplace_back(binding.binding, binding.descriptorType,
+                     binding.descriptorCount, binding.stageFlags);
+  }
+  auto cached = layouts.find(key);
+  if (cached != layouts.end()) {
+    return cached->second;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+  layoutInfo.pBindings = bindings.data();
+  VkDescriptorSetLayout layout;
+  if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor set layout!");
+  }
+  layouts.emplace(std::move(key), layout);
+  return layout;
+}
+
+//-------------------------------------------------------------------
+// DescriptorAllocator (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Prepares a pool chain for persistent sets and one per frame in flight.
+// Pools are created on first use.
+void DescriptorAllocator::init(VkDevice device, uint32_t framesInFlight) {
+  this->device = device;
+  persistentPools = PoolChain();
+  framePools.assign(framesInFlight, PoolChain());
+}
+
+// Destroys every pool, freeing all sets allocated from them.
+void DescriptorAllocator::destroy() {
+  auto destroyChain = [this](PoolChain &chain) {
+    for (VkDescriptorPool pool : chain.pools) {
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+    chain = PoolChain();
+  };
+  destroyChain(persistentPools);
+  for (PoolChain &chain : framePools) {
+    destroyChain(chain);
+  }
+  framePools.clear();
+}
+
+// Allocates a set that lives until destroy().
+// ~Returns: the new descriptor set.
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout) {
+  return allocateFrom(persistentPools, layout);
+}
+
+// Allocates a set for one frame in flight, valid until that frame is
+// reset.
+// ~Returns: the new descriptor set.
+VkDescriptorSet
+DescriptorAllocator::allocateFrame(uint32_t frame,
+                                   VkDescriptorSetLayout layout) {
+  return allocateFrom(framePools[frame], layout);
+}
+
+// Recycles the sets of a frame in flight. The frame's previous submission
+// must have completed.
+void DescriptorAllocator::resetFrame(uint32_t frame) {
+  PoolChain &chain = framePools[frame];
+  if (!chain.used) {
+    return;
+  }
+  for (size_t i = 0; i <= chain.current && i < chain.pools.size(); i++) {
+    vkResetDescriptorPool(device, chain.pools[i], 0);
+  }
+  chain.current = 0;
+  chain.used = false;
+}
+
+//-------------------------------------------------------------------
+// DescriptorAllocator (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Allocates a set from the chain's current pool, moving on to the next
+// pool, or a new one, when it is exhausted.
+// ~Returns: the new descriptor set.
+VkDescriptorSet
+DescriptorAllocator::allocateFrom(PoolChain &chain,
+                                  VkDescriptorSetLayout layout) {
+  VkDescriptorSetAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &layout;
+
+  while (true) {
+    bool newPool = chain.current == chain.pools.size();
+    if (newPool) {
+      chain.pools.push_back(createPool());
+    }
+    allocInfo.descriptorPool = chain.pools[chain.current];
+    VkDescriptorSet set;
+    VkResult result = vkAllocateDescriptorSets(device, &allocInfo, &set);
+    if (result == VK_SUCCESS) {
+      chain.used = true;
+      return set;
+    }
+    if (result != VK_ERROR_OUT_OF_POOL_MEMORY &&
+        result != VK_ERROR_FRAGMENTED_POOL) {
+      throw std::runtime_error("failed to allocate descriptor set!");
+    }
+
+    // a set that doesn't fit an empty pool never will
+    if (newPool) {
+      throw std::runtime_error("descriptor set is larger than a pool!");
+    }
+    chain.current++;
+  }
+}
+
+// Creates a pool sized by DESCRIPTOR_POOL_SETS and descriptorPoolRatios.
+// ~Returns: the new pool.
+VkDescriptorPool DescriptorAllocator::createPool() {
+  std::vector<VkDescriptorPoolSize> poolSizes;
+  for (const auto &ratio : descriptorPoolRatios) {
+    poolSizes.push_back(
+        {ratio.first, static_cast<uint32_t>(ratio.second *
+                                            DESCRIPTOR_POOL_SETS)});
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.maxSets = DESCRIPTOR_POOL_SETS;
+  poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+  poolInfo.pPoolSizes = poolSizes.data();
+  VkDescriptorPool pool;
+  if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create descriptor pool!");
+  }
+  return pool;
+}
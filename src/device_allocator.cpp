@@ -0,0 +1,422 @@
+//===================================================================
+// File: device_allocator.cpp
+//
+// Desc: Sub-allocates buffers and images from large device memory
+//       blocks.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/device_allocator.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Local Functions
+//-------------------------------------------------------------------
+
+// Rounds value up to a multiple of alignment, which must be a power of two.
+// ~Returns: the aligned value.
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Checks whether the last byte of one resource and the first byte of the
+// next one fall on the same bufferImageGranularity page.
+// ~Returns: true if they share a page.
+static bool onSamePage(VkDeviceSize lastByte, VkDeviceSize firstByte,
+                       VkDeviceSize granularity) {
+  return (lastByte & ~(granularity - 1)) == (firstByte & ~(granularity - 1));
+}
+
+//-------------------------------------------------------------------
+// VulkanMemoryBackend (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Allocates a block of device memory.
+// ~Returns: result of vkAllocateMemory.
+VkResult VulkanMemoryBackend::allocate(uint32_t memoryTypeIndex,
+                                       VkDeviceSize size,
+                                       VkDeviceMemory *memory) {
+  VkMemoryAllocateInfo allocInfo = {};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryTypeIndex;
+  return vkAllocateMemory(device, &allocInfo, nullptr, memory);
+}
+
+// Frees a block of device memory.
+void VulkanMemoryBackend::free(VkDeviceMemory memory) {
+  vkFreeMemory(device, memory, nullptr);
+}
+
+// Maps a whole block of host visible memory.
+// ~Returns: host pointer to the start of the block.
+void *VulkanMemoryBackend::map(VkDeviceMemory memory) {
+  void *data = nullptr;
+  if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+    throw std::runtime_error("failed to map device memory block!");
+  }
+  return data;
+}
+
+// Unmaps a block mapped by map().
+void VulkanMemoryBackend::unmap(VkDeviceMemory memory) {
+  vkUnmapMemory(device, memory);
+}
+
+//-------------------------------------------------------------------
+// DeviceAllocator (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Prepares the allocator. No memory is allocated until the first request.
+void DeviceAllocator::init(
+    MemoryBackend *backend,
+    const VkPhysicalDeviceMemoryProperties &memoryProperties,
+    const VkPhysicalDeviceLimits &limits, AllocationStrategy strategy,
+    VkDeviceSize blockSize) {
+  this->backend = backend;
+  this->memoryProperties = memoryProperties;
+  this->strategy = strategy;
+  this->blockSize = blockSize;
+  bufferImageGranularity =
+      std::max<VkDeviceSize>(limits.bufferImageGranularity, 1);
+  maxAllocationCount = limits.maxMemoryAllocationCount;
+}
+
+// Frees every block. Allocations still pointing into them become invalid.
+void DeviceAllocator::destroy() {
+  std::lock_guard<std::mutex> lock(mutex);
+  for (auto &block : blocks) {
+    if (block->mapped != nullptr) {
+      backend->unmap(block->memory);
+    }
+    backend->free(block->memory);
+  }
+  blocks.clear();
+}
+
+// Finds space for a resource with the given requirements in a block of a
+// memory type with the requested properties, creating a block if none has
+// room.
+// ~Returns: MemoryAllocation to bind the resource to.
+MemoryAllocation
+DeviceAllocator::allocate(const VkMemoryRequirements &requirements,
+                          VkMemoryPropertyFlags properties,
+                          AllocationKind kind) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  uint32_t memoryTypeIndex =
+      findMemoryType(requirements.memoryTypeBits, properties);
+  VkDeviceSize size = std::max<VkDeviceSize>(requirements.size, 1);
+  VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+
+  Block *target = nullptr;
+  size_t targetRegion = 0;
+  VkDeviceSize targetOffset = 0;
+
+  // large resources get a block of their own instead of wasting most of a
+  // shared one, even when they happen to be exactly a block in size
+  bool dedicated = size > blockSize / 2;
+  if (!dedicated) {
+    VkDeviceSize bestLeftover = std::numeric_limits<VkDeviceSize>::max();
+    for (auto &block : blocks) {
+      if (block->memoryTypeIndex != memoryTypeIndex || block->dedicated) {
+        continue;
+      }
+
+      if (strategy == ALLOCATION_STRATEGY_LINEAR) {
+        if (fitLinear(*block, size, alignment, kind, &targetOffset)) {
+          target = block.get();
+          break;
+        }
+        continue;
+      }
+
+      // best fit over every free region keeps large ranges intact. The
+      // leftover is measured after the placement's alignment and granularity
+      // padding, which can make a tighter looking region the worse fit
+      for (size_t i = 0; i < block->regions.size(); i++) {
+        VkDeviceSize offset;
+        if (!fitFreeList(*block, i, size, alignment, kind, &offset)) {
+          continue;
+        }
+        const Region &region = block->regions[i];
+        VkDeviceSize leftover = region.offset + region.size - (offset + size);
+        if (leftover < bestLeftover) {
+          bestLeftover = leftover;
+          target = block.get();
+          targetRegion = i;
+          targetOffset = offset;
+        }
+      }
+    }
+  }
+
+  // nothing fits, start a new block, whose first byte satisfies any alignment
+  if (target == nullptr) {
+    target = createBlock(memoryTypeIndex, dedicated ? size : blockSize);
+    target->dedicated = dedicated;
+    targetRegion = 0;
+    targetOffset = 0;
+  }
+
+  if (strategy == ALLOCATION_STRATEGY_LINEAR) {
+    target->head = targetOffset + size;
+    target->last = {targetOffset, size, false, kind};
+  } else {
+    commitFreeList(*target, targetRegion, targetOffset, size, kind);
+  }
+  target->allocationCount++;
+  target->usedBytes += size;
+
+  MemoryAllocation allocation;
+  allocation.memory = target->memory;
+  allocation.offset = targetOffset;
+  allocation.size = size;
+  allocation.memoryTypeIndex = memoryTypeIndex;
+  if (target->mapped != nullptr) {
+    allocation.mapped = static_cast<char *>(target->mapped) + targetOffset;
+  }
+  return allocation;
+}
+
+// Returns an allocation's range to its block. Empty dedicated blocks are
+// released; one empty shared block per memory type is kept for reuse.
+void DeviceAllocator::free(const MemoryAllocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto found = std::find_if(blocks.begin(), blocks.end(), [&](const auto &b) {
+    return b->memory == allocation.memory;
+  });
+  if (found == blocks.end()) {
+    throw std::runtime_error("freed memory that isn't from this allocator!");
+  }
+  Block *block = found->get();
+
+  if (strategy == ALLOCATION_STRATEGY_LINEAR) {
+    // space is only reclaimed once the whole block is empty
+    if (block->allocationCount == 1) {
+      block->head = 0;
+    }
+  } else {
+    freeRegion(*block, allocation.offset);
+  }
+  block->allocationCount--;
+  block->usedBytes -= allocation.size;
+
+  if (block->allocationCount > 0) {
+    return;
+  }
+  bool spareExists =
+      std::any_of(blocks.begin(), blocks.end(), [&](const auto &b) {
+        return b.get() != block && b->allocationCount == 0 &&
+               b->memoryTypeIndex == block->memoryTypeIndex &&
+               !b->dedicated;
+      });
+  if (block->dedicated || spareExists) {
+    releaseBlock(block);
+  }
+}
+
+// Gathers usage and fragmentation figures across all blocks.
+// ~Returns: AllocationStats struct.
+AllocationStats DeviceAllocator::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  AllocationStats stats;
+  auto addFreeRegion = [&](VkDeviceSize size) {
+    stats.freeBytes += size;
+    stats.freeRegionCount++;
+    stats.largestFreeRegion = std::max(stats.largestFreeRegion, size);
+  };
+
+  for (const auto &block : blocks) {
+    stats.blockCount++;
+    stats.allocationCount += block->allocationCount;
+    stats.blockBytes += block->size;
+    stats.usedBytes += block->usedBytes;
+    if (strategy == ALLOCATION_STRATEGY_LINEAR) {
+      if (block->head < block->size) {
+        addFreeRegion(block->size - block->head);
+      }
+    } else {
+      for (const auto &region : block->regions) {
+        if (region.free) {
+          addFreeRegion(region.size);
+        }
+      }
+    }
+  }
+  return stats;
+}
+
+//-------------------------------------------------------------------
+// DeviceAllocator (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Finds a memory type that matches the type filter and has all the
+// requested properties.
+// ~Returns: index of the memory type.
+uint32_t
+DeviceAllocator::findMemoryType(uint32_t typeFilter,
+                                VkMemoryPropertyFlags properties) const {
+  for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+    if ((typeFilter & (1u << i)) &&
+        (memoryProperties.memoryTypes[i].propertyFlags & properties) ==
+            properties) {
+      return i;
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+// Allocates a block from the backend and maps it if it is host visible.
+// ~Returns: the new block, owned by the allocator.
+DeviceAllocator::Block *DeviceAllocator::createBlock(uint32_t memoryTypeIndex,
+                                                     VkDeviceSize size) {
+  if (maxAllocationCount != 0 && blocks.size() >= maxAllocationCount) {
+    throw std::runtime_error("device memory allocation limit reached!");
+  }
+
+  auto block = std::make_unique<Block>();
+  block->memoryTypeIndex = memoryTypeIndex;
+  block->size = size;
+  if (backend->allocate(memoryTypeIndex, size, &block->memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory block!");
+  }
+  if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    block->mapped = backend->map(block->memory);
+  }
+  block->regions.push_back({0, size, true, ALLOCATION_KIND_LINEAR});
+
+  blocks.push_back(std::move(block));
+  return blocks.back().get();
+}
+
+// Unmaps and frees an empty block.
+void DeviceAllocator::releaseBlock(Block *block) {
+  if (block->mapped != nullptr) {
+    backend->unmap(block->memory);
+  }
+  backend->free(block->memory);
+  blocks.erase(std::find_if(blocks.begin(), blocks.end(),
+                            [&](const auto &b) { return b.get() == block; }));
+}
+
+// Checks whether a resource fits into a free region of a free list block,
+// keeping it off pages shared with a neighbour of the other kind.
+// ~Returns: true and the offset to place it at if it fits.
+bool DeviceAllocator::fitFreeList(const Block &block, size_t regionIndex,
+                                  VkDeviceSize size, VkDeviceSize alignment,
+                                  AllocationKind kind,
+                                  VkDeviceSize *offset) const {
+  const Region &region = block.regions[regionIndex];
+  if (!region.free || region.size < size) {
+    return false;
+  }
+
+  // free regions are coalesced, so their neighbours are always in use
+  VkDeviceSize start = alignUp(region.offset, alignment);
+  if (regionIndex > 0) {
+    const Region &previous = block.regions[regionIndex - 1];
+    if (previous.kind != kind &&
+        onSamePage(previous.offset + previous.size - 1, start,
+                   bufferImageGranularity)) {
+      start = alignUp(start, bufferImageGranularity);
+    }
+  }
+  if (start + size > region.offset + region.size) {
+    return false;
+  }
+  if (regionIndex + 1 < block.regions.size()) {
+    const Region &next = block.regions[regionIndex + 1];
+    if (next.kind != kind &&
+        onSamePage(start + size - 1, next.offset, bufferImageGranularity)) {
+      return false;
+    }
+  }
+
+  *offset = start;
+  return true;
+}
+
+// Checks whether a resource fits behind the newest allocation of a linear
+// block.
+// ~Returns: true and the offset to place it at if it fits.
+bool DeviceAllocator::fitLinear(const Block &block, VkDeviceSize size,
+                                VkDeviceSize alignment, AllocationKind kind,
+                                VkDeviceSize *offset) const {
+  VkDeviceSize start = alignUp(block.head, alignment);
+  if (block.allocationCount > 0 && block.last.kind != kind &&
+      onSamePage(block.last.offset + block.last.size - 1, start,
+                 bufferImageGranularity)) {
+    start = alignUp(start, bufferImageGranularity);
+  }
+  if (start + size > block.size) {
+    return false;
+  }
+
+  *offset = start;
+  return true;
+}
+
+// Splits a free region into the used range and whatever is left on either
+// side of it.
+void DeviceAllocator::commitFreeList(Block &block, size_t regionIndex,
+                                     VkDeviceSize offset, VkDeviceSize size,
+                                     AllocationKind kind) {
+  Region region = block.regions[regionIndex];
+  std::vector<Region> pieces;
+  if (offset > region.offset) {
+    pieces.push_back(
+        {region.offset, offset - region.offset, true, ALLOCATION_KIND_LINEAR});
+  }
+  pieces.push_back({offset, size, false, kind});
+  VkDeviceSize end = offset + size;
+  if (end < region.offset + region.size) {
+    pieces.push_back(
+        {end, region.offset + region.size - end, true, ALLOCATION_KIND_LINEAR});
+  }
+
+  block.regions.erase(block.regions.begin() + regionIndex);
+  block.regions.insert(block.regions.begin() + regionIndex, pieces.begin(),
+                       pieces.end());
+}
+
+// Marks the region at offset free and merges it with free neighbours.
+void DeviceAllocator::freeRegion(Block &block, VkDeviceSize offset) {
+  auto &regions = block.regions;
+  auto it = std::lower_bound(
+      regions.begin(), regions.end(), offset,
+      [](const Region &region, VkDeviceSize value) {
+        return region.offset < value;
+      });
+  if (it == regions.end() || it->offset != offset || it->free) {
+    throw std::runtime_error("freed an allocation that isn't live!");
+  }
+  it->free = true;
+
+  auto next = it + 1;
+  if (next != regions.end() && next->free) {
+    it->size += next->size;
+    regions.erase(next);
+  }
+  if (it != regions.begin()) {
+    auto previous = it - 1;
+    if (previous->free) {
+      previous->size += it->size;
+      regions.erase(it);
+    }
+  }
+}
@@ -0,0 +1,199 @@
+//===================================================================
+// File: device_selection.cpp
+//
+// Desc: Scores physical devices and picks the one to render with,
+//       honouring an explicit choice by index or name.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/device_selection.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Local Functions
+//-------------------------------------------------------------------
+
+// Lower cases text for case insensitive name matching.
+// ~Returns: lower case copy of text.
+static std::string toLower(std::string text) {
+  std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+    return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  });
+  return text;
+}
+
+// Checks whether override is a device index rather than a name.
+// ~Returns: true if override is all digits.
+static bool isDeviceIndex(const std::string &override) {
+  return !override.empty() &&
+         std::all_of(override.begin(), override.end(),
+                     [](char c) { return c >= '0' && c <= '9'; });
+}
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Sums the heaps that are local to the device.
+// ~Returns: device local memory in bytes.
+uint64_t deviceLocalHeapSize(const VkPhysicalDeviceMemoryProperties &memory) {
+  uint64_t size = 0;
+  for (uint32_t i = 0; i < memory.memoryHeapCount; i++) {
+    if (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      size += memory.memoryHeaps[i].size;
+    }
+  }
+  return size;
+}
+
+// Scores how well a device suits the renderer from its type, device local
+// memory, queue families, API version and optional extensions.
+// ~Returns: the score, DEVICE_SCORE_UNSUITABLE if it can't render at all.
+int64_t scoreDevice(const DeviceCandidate &candidate) {
+  if (!candidate.suitable) {
+    return DEVICE_SCORE_UNSUITABLE;
+  }
+
+  int64_t score = 0;
+  switch (candidate.properties.deviceType) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    score += DEVICE_SCORE_DISCRETE;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    score += DEVICE_SCORE_INTEGRATED;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    score += DEVICE_SCORE_VIRTUAL;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_CPU:
+    score += DEVICE_SCORE_CPU;
+    break;
+  default:
+    break;
+  }
+
+  // integrated GPUs report shared system memory, the cap keeps a large one
+  // from catching up with a discrete GPU
+  int64_t heapMiB =
+      static_cast<int64_t>(deviceLocalHeapSize(candidate.memoryProperties) >>
+                           20);
+  score += std::min(heapMiB / DEVICE_SCORE_HEAP_MIB_PER_POINT,
+                    DEVICE_SCORE_HEAP_MAX);
+
+  // separate families let uploads and compute overlap with rendering
+  bool transferFamily = false;
+  bool computeFamily = false;
+  for (const VkQueueFamilyProperties &family : candidate.queueFamilies) {
+    if (family.queueCount == 0) {
+      continue;
+    }
+    VkQueueFlags flags = family.queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) &&
+        !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+      transferFamily = true;
+    }
+    if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+      computeFamily = true;
+    }
+  }
+  score += transferFamily ? DEVICE_SCORE_TRANSFER_FAMILY : 0;
+  score += computeFamily ? DEVICE_SCORE_COMPUTE_FAMILY : 0;
+
+  if (candidate.properties.apiVersion >= VK_API_VERSION_1_2) {
+    score += DEVICE_SCORE_VULKAN_1_2;
+  }
+  for (const char *extension : optionalDeviceExtensions) {
+    if (std::find(candidate.extensions.begin(), candidate.extensions.end(),
+                  extension) != candidate.extensions.end()) {
+      score += DEVICE_SCORE_EXTENSION;
+    }
+  }
+
+  return score;
+}
+
+// Scores every candidate and orders them best first. Equal scores keep the
+// enumeration order.
+// ~Returns: rankings of all candidates, unsuitable ones last.
+std::vector<DeviceRanking>
+rankDevices(const std::vector<DeviceCandidate> &candidates) {
+  std::vector<DeviceRanking> rankings;
+  rankings.reserve(candidates.size());
+  for (uint32_t i = 0; i < candidates.size(); i++) {
+    rankings.push_back({i, scoreDevice(candidates[i])});
+  }
+  std::stable_sort(rankings.begin(), rankings.end(),
+                   [](const DeviceRanking &a, const DeviceRanking &b) {
+                     return a.score > b.score;
+                   });
+  return rankings;
+}
+
+// Picks the device to render with. A non-empty override names it either by
+// enumeration index or by a case insensitive part of its name; otherwise
+// the best scoring suitable device wins.
+// ~Returns: index of the chosen candidate.
+uint32_t selectDevice(const std::vector<DeviceCandidate> &candidates,
+                      const std::string &override) {
+  if (override.empty()) {
+    std::vector<DeviceRanking> rankings = rankDevices(candidates);
+    if (rankings.empty() || rankings[0].score == DEVICE_SCORE_UNSUITABLE) {
+      throw std::runtime_error("failed to find a suitable GPU!");
+    }
+    return rankings[0].index;
+  }
+
+  const DeviceCandidate *chosen = nullptr;
+  if (isDeviceIndex(override)) {
+    unsigned long index = std::stoul(override);
+    for (const DeviceCandidate &candidate : candidates) {
+      if (candidate.index == index) {
+        chosen = &candidate;
+        break;
+      }
+    }
+  } else {
+    std::string name = toLower(override);
+    for (const DeviceCandidate &candidate : candidates) {
+      if (toLower(candidate.properties.deviceName).find(name) !=
+          std::string::npos) {
+        chosen = &candidate;
+        break;
+      }
+    }
+  }
+
+  if (chosen == nullptr) {
+    throw std::runtime_error("no GPU matches " + override + "!");
+  }
+  if (!chosen->suitable) {
+    throw std::runtime_error("GPU " +
+                             std::string(chosen->properties.deviceName) +
+                             " can't run the renderer!");
+  }
+  return static_cast<uint32_t>(chosen - candidates.data());
+}
+
+// Gets a short name for a device type, used when logging the ranking.
+// ~Returns: name of the type.
+const char *deviceTypeName(VkPhysicalDeviceType type) {
+  switch (type) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    return "discrete";
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    return "integrated";
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    return "virtual";
+  case VK_PHYSICAL_DEVICE_TYPE_CPU:
+    return "cpu";
+  default:
+    return "other";
+  }
+}
@@ -0,0 +1,49 @@
+//===================================================================
+// File: embedded_shaders.cpp
+//
+// Desc: SPIR-V compiled at build time and linked into the executable.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/embedded_shaders.h"
+
+//-------------------------------------------------------------------
+// Embedded Shaders
+//-------------------------------------------------------------------
+
+// CMake generates the arrays and the EMBEDDED_SHADERS table with
+// cmake/embed_spirv.cmake. Builds without it embed nothing and load
+// SPIR-V from disk.
+#ifdef HELLOVULKAN_EMBEDDED_SHADERS
+#include "embedded_shaders.inc"
+#else
+constexpr EmbeddedShader EMBEDDED_SHADERS[] = {{"", nullptr, 0}};
+#endif
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Looks an embedded shader up by its SPIR-V file name.
+// ~Returns: the shader, with null code if it wasn't embedded.
+EmbeddedShader findEmbeddedShader(const std::string &name) {
+  for (const auto &shader : EMBEDDED_SHADERS) {
+    if (shader.code != nullptr && name == shader.name) {
+      return shader;
+    }
+  }
+  return EmbeddedShader{nullptr, nullptr, 0};
+}
+
+// ~Returns: number of shaders linked into the executable.
+size_t embeddedShaderCount() {
+  size_t count = 0;
+  for (const auto &shader : EMBEDDED_SHADERS) {
+    count += shader.code != nullptr ? 1 : 0;
+  }
+  return count;
+}
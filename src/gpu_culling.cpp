@@ -0,0 +1,163 @@
+//===================================================================
+// File: gpu_culling.cpp
+//
+// Desc: Buffers and constants for culling instances on the GPU and
+//       drawing the survivors with indirect draws.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/gpu_culling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Extracts the six planes bounding the view volume of a column major
+// view-projection matrix with Vulkan's 0 to 1 depth range. Planes point
+// inwards and are normalized, so dot(plane, point) is a signed distance.
+void extractFrustumPlanes(const float viewProjection[16],
+                          float planes[6][4]) {
+  // row r of the matrix
+  auto row = [&](int r, int c) { return viewProjection[c * 4 + r]; };
+
+  for (int c = 0; c < 4; c++) {
+    planes[0][c] = row(3, c) + row(0, c); // left
+    planes[1][c] = row(3, c) - row(0, c); // right
+    planes[2][c] = row(3, c) + row(1, c); // bottom
+    planes[3][c] = row(3, c) - row(1, c); // top
+    planes[4][c] = row(2, c);             // near
+    planes[5][c] = row(3, c) - row(2, c); // far
+  }
+
+  for (int p = 0; p < 6; p++) {
+    float length = std::sqrt(planes[p][0] * planes[p][0] +
+                             planes[p][1] * planes[p][1] +
+                             planes[p][2] * planes[p][2]);
+    if (length > 0.0f) {
+      for (int c = 0; c < 4; c++) {
+        planes[p][c] /= length;
+      }
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// CullBuffers (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the visible instance and draw command buffers with a region for
+// each frame in flight.
+void CullBuffers::init(VkDevice device, DeviceAllocator *allocator,
+                       uint32_t instanceCount, uint32_t framesInFlight,
+                       VkDeviceSize minOffsetAlignment) {
+  this->device = device;
+  this->allocator = allocator;
+  instanceCapacity = instanceCount;
+  drawCapacity = (instanceCount + INSTANCES_PER_DRAW - 1) / INSTANCES_PER_DRAW;
+
+  VkDeviceSize alignment = std::max<VkDeviceSize>(minOffsetAlignment, 1);
+  auto align = [&](VkDeviceSize size) {
+    return (size + alignment - 1) / alignment * alignment;
+  };
+
+  visibleRegionSize = align(VkDeviceSize(instanceCount) * sizeof(InstanceData));
+  visible = createBuffer(visibleRegionSize * framesInFlight,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, &visibleMemory);
+
+  // the counters are cleared with vkCmdFillBuffer at the start of each frame
+  drawRegionSize = align(sizeof(CullCounters) +
+                         VkDeviceSize(drawCapacity) *
+                             sizeof(VkDrawIndexedIndirectCommand));
+  draws = createBuffer(drawRegionSize * framesInFlight,
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                           VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                           VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                       &drawMemory);
+}
+
+// Destroys both buffers and returns their memory.
+void CullBuffers::destroy() {
+  if (visible != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, visible, nullptr);
+    allocator->free(visibleMemory);
+    visible = VK_NULL_HANDLE;
+  }
+  if (draws != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, draws, nullptr);
+    allocator->free(drawMemory);
+    draws = VK_NULL_HANDLE;
+  }
+  instanceCapacity = 0;
+  drawCapacity = 0;
+}
+
+// Gets where a frame's counters start in the draw buffer.
+// ~Returns: byte offset of the frame's CullCounters.
+VkDeviceSize CullBuffers::countersOffset(uint32_t frame) const {
+  return frame * drawRegionSize;
+}
+
+// Gets where a frame's draw commands start in the draw buffer.
+// ~Returns: byte offset of the frame's first VkDrawIndexedIndirectCommand.
+VkDeviceSize CullBuffers::commandsOffset(uint32_t frame) const {
+  return frame * drawRegionSize + sizeof(CullCounters);
+}
+
+// Describes a frame's visible instance list for a storage buffer descriptor.
+// ~Returns: VkDescriptorBufferInfo struct for the region.
+VkDescriptorBufferInfo CullBuffers::visibleInfo(uint32_t frame) const {
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = visible;
+  bufferInfo.offset = frame * visibleRegionSize;
+  bufferInfo.range = VkDeviceSize(instanceCapacity) * sizeof(InstanceData);
+  return bufferInfo;
+}
+
+// Describes a frame's counters and draw commands for a storage buffer
+// descriptor.
+// ~Returns: VkDescriptorBufferInfo struct for the region.
+VkDescriptorBufferInfo CullBuffers::drawInfo(uint32_t frame) const {
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = draws;
+  bufferInfo.offset = countersOffset(frame);
+  bufferInfo.range = sizeof(CullCounters) +
+                     VkDeviceSize(drawCapacity) *
+                         sizeof(VkDrawIndexedIndirectCommand);
+  return bufferInfo;
+}
+
+//-------------------------------------------------------------------
+// CullBuffers (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Creates a device local buffer and binds memory from the allocator.
+// ~Returns: the new buffer.
+VkBuffer CullBuffers::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                                   MemoryAllocation *memory) {
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  VkBuffer buffer;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create cull buffer!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+  *memory = allocator->allocate(memRequirements,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                ALLOCATION_KIND_LINEAR);
+  vkBindBufferMemory(device, buffer, memory->memory, memory->offset);
+  return buffer;
+}
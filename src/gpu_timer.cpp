@@ -0,0 +1,108 @@
+//===================================================================
+// File: gpu_timer.cpp
+//
+// Desc: Measures GPU time spent per frame with timestamp queries.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/gpu_timer.h"
+
+#include <iostream>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// GpuTimer (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the query pool if the queue family supports timestamps.
+void GpuTimer::init(VkDevice device, VkPhysicalDevice physicalDevice,
+                    uint32_t queueFamilyIndex, uint32_t framesInFlight) {
+  this->device = device;
+
+  // timestamps are only valid on queues reporting valid bits
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount,
+                                           queueFamilies.data());
+  uint32_t validBits = queueFamilies[queueFamilyIndex].timestampValidBits;
+  if (validBits == 0) {
+    std::cerr << "gpu timer: queue family has no timestamp support"
+              << std::endl;
+    return;
+  }
+  timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+  // the tick length comes from the device limits
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  timestampPeriod = properties.limits.timestampPeriod;
+
+  VkQueryPoolCreateInfo queryPoolInfo = {};
+  queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  queryPoolInfo.queryCount = framesInFlight * 2;
+  if (vkCreateQueryPool(device, &queryPoolInfo, nullptr, &queryPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timestamp query pool!");
+  }
+  pending.assign(framesInFlight, false);
+}
+
+// Destroys the query pool.
+void GpuTimer::destroy() {
+  if (queryPool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device, queryPool, nullptr);
+    queryPool = VK_NULL_HANDLE;
+  }
+  pending.clear();
+}
+
+// Resets the frame's queries and writes the starting timestamp. Must be
+// recorded outside of a render pass.
+void GpuTimer::begin(VkCommandBuffer commandBuffer, uint32_t frame) {
+  if (!isSupported()) {
+    return;
+  }
+  vkCmdResetQueryPool(commandBuffer, queryPool, frame * 2, 2);
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      queryPool, frame * 2);
+}
+
+// Writes the ending timestamp once all prior work has completed.
+void GpuTimer::end(VkCommandBuffer commandBuffer, uint32_t frame) {
+  if (!isSupported()) {
+    return;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      queryPool, frame * 2 + 1);
+  pending[frame] = true;
+}
+
+// Reads the frame's timestamps without waiting and records the duration.
+// Called after the frame's fence has signaled, before it is recorded again.
+void GpuTimer::collect(uint32_t frame) {
+  if (!isSupported() || !pending[frame]) {
+    return;
+  }
+
+  // two timestamps, each followed by its availability word
+  uint64_t results[4] = {};
+  VkResult result = vkGetQueryPoolResults(
+      device, queryPool, frame * 2, 2, sizeof(results), results,
+      2 * sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  pending[frame] = false;
+  if ((result != VK_SUCCESS && result != VK_NOT_READY) || results[1] == 0 ||
+      results[3] == 0) {
+    return;
+  }
+
+  uint64_t ticks = (results[2] - results[0]) & timestampMask;
+  history.push(ticks * timestampPeriod / 1e6);
+}
@@ -0,0 +1,177 @@
+//===================================================================
+// File: init_graph.cpp
+//
+// Desc: Dependency graph of startup steps, run across threads and
+//       timed for a startup trace.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/init_graph.h"
+#include "../includes/profiler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+//-------------------------------------------------------------------
+// InitGraph (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Adds a step that runs after all of its dependencies have finished.
+// ~Returns: id that later steps can depend on.
+InitGraph::StepId InitGraph::add(const char *name,
+                                 std::vector<StepId> dependencies, Step step,
+                                 bool mainThread) {
+  StepId id = nodes.size();
+  for (StepId dependency : dependencies) {
+    if (dependency >= id) {
+      throw std::runtime_error(std::string("init step ") + name +
+                               " depends on a step added after it!");
+    }
+    nodes[dependency].dependents.push_back(id);
+  }
+
+  Node node;
+  node.name = name;
+  node.step = std::move(step);
+  node.dependencies = std::move(dependencies);
+  node.mainThread = mainThread;
+  nodes.push_back(std::move(node));
+  return id;
+}
+
+// Runs every step on the calling thread and up to threadCount workers, and
+// returns once all of them have finished. With no workers the steps run
+// on the calling thread in the order they were added.
+void InitGraph::run(uint32_t threadCount) {
+  readySteps.clear();
+  readyMainSteps.clear();
+  finishedSteps = 0;
+  stepError = nullptr;
+  for (StepId id = 0; id < nodes.size(); id++) {
+    nodes[id].pendingDependencies = nodes[id].dependencies.size();
+    if (nodes[id].pendingDependencies == 0) {
+      (nodes[id].mainThread ? readyMainSteps : readySteps).push_back(id);
+    }
+  }
+
+  runStartNs = Profiler::now();
+  std::vector<std::thread> workers;
+  threadCount = static_cast<uint32_t>(
+      std::min<size_t>(threadCount, nodes.size() > 0 ? nodes.size() - 1 : 0));
+  for (uint32_t i = 0; i < threadCount; i++) {
+    workers.emplace_back([this, i]() {
+      Profiler::setThreadName("init worker " + std::to_string(i));
+      runSteps(false);
+    });
+  }
+  runSteps(true);
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  runEndNs = Profiler::now();
+
+  if (stepError) {
+    std::rethrow_exception(stepError);
+  }
+}
+
+// Gets the time run() took from start to finish.
+// ~Returns: wall time in milliseconds.
+double InitGraph::wallMilliseconds() const {
+  return double(runEndNs - runStartNs) / 1e6;
+}
+
+// Gets the time all steps took together, the cost of running them in
+// sequence.
+// ~Returns: summed step time in milliseconds.
+double InitGraph::stepMilliseconds() const {
+  double total = 0.0;
+  for (const Node &node : nodes) {
+    total += durationMilliseconds(node);
+  }
+  return total;
+}
+
+// Gets the duration of the longest chain of dependent steps, the shortest
+// wall time any number of threads could reach.
+// ~Returns: critical path in milliseconds.
+double InitGraph::criticalPathMilliseconds() const {
+  // dependencies always precede their dependents, so one pass suffices
+  std::vector<double> finish(nodes.size(), 0.0);
+  double longest = 0.0;
+  for (StepId id = 0; id < nodes.size(); id++) {
+    double start = 0.0;
+    for (StepId dependency : nodes[id].dependencies) {
+      start = std::max(start, finish[dependency]);
+    }
+    finish[id] = start + durationMilliseconds(nodes[id]);
+    longest = std::max(longest, finish[id]);
+  }
+  return longest;
+}
+
+//-------------------------------------------------------------------
+// InitGraph (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Takes ready steps until the graph is finished or a step has failed. The
+// calling thread prefers the steps only it may run.
+void InitGraph::runSteps(bool mainThread) {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    stepsChanged.wait(lock, [&]() {
+      return stepError || finishedSteps == nodes.size() ||
+             !readySteps.empty() || (mainThread && !readyMainSteps.empty());
+    });
+    if (stepError || finishedSteps == nodes.size()) {
+      return;
+    }
+
+    std::deque<StepId> &queue =
+        mainThread && !readyMainSteps.empty() ? readyMainSteps : readySteps;
+    StepId id = queue.front();
+    queue.pop_front();
+    lock.unlock();
+
+    Node &node = nodes[id];
+    std::exception_ptr error;
+    node.startNs = Profiler::now();
+    try {
+      node.step();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    node.endNs = Profiler::now();
+    if (Profiler::isEnabled()) {
+      Profiler::record(node.name, node.startNs, node.endNs);
+    }
+
+    lock.lock();
+    finishedSteps++;
+    if (error) {
+      if (!stepError) {
+        stepError = error;
+      }
+    } else {
+      for (StepId dependent : node.dependents) {
+        Node &next = nodes[dependent];
+        if (--next.pendingDependencies == 0) {
+          (next.mainThread ? readyMainSteps : readySteps).push_back(dependent);
+        }
+      }
+    }
+    stepsChanged.notify_all();
+  }
+}
+
+// Gets how long a step ran.
+// ~Returns: duration in milliseconds.
+double InitGraph::durationMilliseconds(const Node &node) const {
+  return double(node.endNs - node.startNs) / 1e6;
+}
@@ -0,0 +1,78 @@
+//===================================================================
+// File: instance_buffer.cpp
+//
+// Desc: Per-instance transforms and colors in a storage buffer with
+//       one persistently mapped region per frame in flight.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/instance_buffer.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// InstanceBuffer (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the buffer with a region of instanceCount instances for each
+// frame in flight.
+void InstanceBuffer::init(VkDevice device, DeviceAllocator *allocator,
+                          uint32_t instanceCount, uint32_t framesInFlight,
+                          VkDeviceSize minOffsetAlignment) {
+  this->device = device;
+  this->allocator = allocator;
+  count = instanceCount;
+
+  VkDeviceSize alignment = std::max<VkDeviceSize>(minOffsetAlignment, 1);
+  regionSize = VkDeviceSize(instanceCount) * sizeof(InstanceData);
+  regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = regionSize * framesInFlight;
+  bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create instance buffer!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+  memory = allocator->allocate(memRequirements,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               ALLOCATION_KIND_LINEAR);
+  vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+}
+
+// Destroys the buffer and returns its memory.
+void InstanceBuffer::destroy() {
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator->free(memory);
+    buffer = VK_NULL_HANDLE;
+  }
+  count = 0;
+}
+
+// Gets the mapped region of a frame in flight.
+// ~Returns: pointer to instanceCount() instances.
+InstanceData *InstanceBuffer::frameData(uint32_t frame) {
+  return reinterpret_cast<InstanceData *>(static_cast<char *>(memory.mapped) +
+                                          frame * regionSize);
+}
+
+// Describes a frame's region for a storage buffer descriptor.
+// ~Returns: VkDescriptorBufferInfo struct for the region.
+VkDescriptorBufferInfo InstanceBuffer::descriptorInfo(uint32_t frame) const {
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = frame * regionSize;
+  bufferInfo.range = VkDeviceSize(count) * sizeof(InstanceData);
+  return bufferInfo;
+}
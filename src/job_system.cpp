@@ -0,0 +1,360 @@
+//===================================================================
+// File: job_system.cpp
+//
+// Desc: Fixed size pool of worker threads that run jobs from per-thread
+//       lock-free deques, stealing from each other when idle.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/job_system.h"
+#include "../includes/profiler.h"
+
+#include <string>
+
+static_assert((JOB_QUEUE_CAPACITY & (JOB_QUEUE_CAPACITY - 1)) == 0,
+              "JOB_QUEUE_CAPACITY must be a power of two");
+
+//-------------------------------------------------------------------
+// Local Variables
+//-------------------------------------------------------------------
+
+// The job system the current thread works for, if any, and its index.
+static thread_local const JobSystem *threadSystem = nullptr;
+static thread_local uint32_t threadWorker = 0;
+
+// Whether the job the current thread runs is a background job, which the
+// jobs it submits inherit.
+static thread_local bool threadBackground = false;
+
+//-------------------------------------------------------------------
+// JobSystem (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Starts the worker threads, each with an empty deque.
+JobSystem::JobSystem(uint32_t workerCount) : threadCount(workerCount) {
+  for (uint32_t i = 0; i < workerCount; i++) {
+    deques.push_back(std::make_unique<WorkDeque>());
+  }
+  for (uint32_t i = 0; i < workerCount; i++) {
+    workers.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+// Stops and joins the worker threads. Every counter must have been waited
+// on, jobs still queued are not run.
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+// Queues job against counter. Workers push onto their own deque; other
+// threads go through the shared queue. A full deque runs the job at once.
+void JobSystem::submit(JobCounter &counter, Job job) {
+  enqueue(counter, std::move(job), threadBackground);
+}
+
+// Queues job against counter as a background job, which only workers
+// run. Without workers it runs at once, as an ordinary job so that the
+// jobs it submits can be run by its waits.
+void JobSystem::submitBackground(JobCounter &counter, Job job) {
+  if (workerCount() == 0) {
+    counter.pending.fetch_add(1, std::memory_order_relaxed);
+    execute(new QueuedJob{std::move(job), &counter, false}, 0);
+    return;
+  }
+  enqueue(counter, std::move(job), true);
+}
+
+// Runs queued jobs on the calling thread until every job submitted against
+// counter has finished. Rethrows the first exception one of them threw.
+void JobSystem::wait(JobCounter &counter) {
+  uint32_t index = currentThreadIndex();
+  while (!counter.isDone()) {
+    QueuedJob *job = take(index);
+    if (job != nullptr) {
+      execute(job, index);
+    } else {
+      // the remaining jobs are running elsewhere
+      std::this_thread::yield();
+    }
+  }
+
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(counter.errorMutex);
+    std::swap(error, counter.error);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+// Runs task for every index in [0, count) and returns once all of them
+// have finished. The range is split in halves, the upper half queued and
+// the lower half kept, so idle threads steal large ranges first. Rethrows
+// the first exception a task threw.
+void JobSystem::parallelFor(size_t count, const Task &task) {
+  if (count == 0) {
+    return;
+  }
+
+  JobCounter counter;
+  std::exception_ptr error;
+  try {
+    splitRange(counter, 0, count, task, currentThreadIndex());
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  // queued halves refer to counter and task, so they must finish first
+  if (error) {
+    try {
+      wait(counter);
+    } catch (...) {
+    }
+    std::rethrow_exception(error);
+  }
+  wait(counter);
+}
+
+//-------------------------------------------------------------------
+// JobSystem (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Gets the index jobs run by the calling thread receive.
+// ~Returns: the worker index, or workerCount() for other threads.
+uint32_t JobSystem::currentThreadIndex() const {
+  return threadSystem == this ? threadWorker : workerCount();
+}
+
+// Queues job against counter on the calling worker's deque, or for other
+// threads on the shared or background queue, and wakes a sleeping worker.
+void JobSystem::enqueue(JobCounter &counter, Job job, bool background) {
+  counter.pending.fetch_add(1, std::memory_order_relaxed);
+  QueuedJob *queued = new QueuedJob{std::move(job), &counter, background};
+  queuedJobs.fetch_add(1);
+
+  uint32_t index = currentThreadIndex();
+  if (index < workerCount()) {
+    if (!deques[index]->push(queued)) {
+      queuedJobs.fetch_sub(1);
+      execute(queued, index);
+      return;
+    }
+  } else if (background) {
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    backgroundJobs.push_back(queued);
+    backgroundCount.fetch_add(1, std::memory_order_release);
+  } else {
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    sharedJobs.push_back(queued);
+    sharedCount.fetch_add(1, std::memory_order_release);
+  }
+
+  wakeWorker();
+}
+
+// Wakes a sleeping worker, if any, after a job has been queued. Sleepers
+// are counted before they check for jobs, so either they see the job or
+// this sees them.
+void JobSystem::wakeWorker() {
+  if (sleepers.load() > 0) {
+    std::lock_guard<std::mutex> lock(sleepMutex);
+    wake.notify_one();
+  }
+}
+
+// Takes a job for a thread to run: the newest one from its own deque, then
+// the oldest shared one, then the oldest one of another worker, then for
+// workers the oldest background one. A background job stolen by another
+// thread is queued again on the background queue instead.
+// ~Returns: the job, or nullptr if none could be taken.
+JobSystem::QueuedJob *JobSystem::take(uint32_t threadIndex) {
+  uint32_t count = workerCount();
+  QueuedJob *job = nullptr;
+  if (threadIndex < count) {
+    job = deques[threadIndex]->pop();
+  }
+
+  if (job == nullptr && sharedCount.load(std::memory_order_acquire) > 0) {
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    if (!sharedJobs.empty()) {
+      job = sharedJobs.front();
+      sharedJobs.pop_front();
+      sharedCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  // start after the thread's own index so thieves spread over victims
+  for (uint32_t i = 1; job == nullptr && i <= count; i++) {
+    uint32_t victim = (threadIndex + i) % count;
+    if (victim != threadIndex) {
+      job = deques[victim]->steal();
+    }
+  }
+
+  if (job == nullptr && threadIndex < count &&
+      backgroundCount.load(std::memory_order_acquire) > 0) {
+    std::lock_guard<std::mutex> lock(sharedMutex);
+    if (!backgroundJobs.empty()) {
+      job = backgroundJobs.front();
+      backgroundJobs.pop_front();
+      backgroundCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  if (job != nullptr) {
+    queuedJobs.fetch_sub(1);
+  }
+
+  // a thread that isn't a worker hands background jobs back to them
+  if (job != nullptr && job->background && threadIndex >= count) {
+    {
+      std::lock_guard<std::mutex> lock(sharedMutex);
+      backgroundJobs.push_back(job);
+      backgroundCount.fetch_add(1, std::memory_order_release);
+    }
+    queuedJobs.fetch_add(1);
+    wakeWorker();
+    return nullptr;
+  }
+  return job;
+}
+
+// Runs a job, records its exception in its counter and retires it. The
+// counter may be destroyed by its waiter as soon as it reaches zero.
+void JobSystem::execute(QueuedJob *job, uint32_t threadIndex) {
+  JobCounter *counter = job->counter;
+  bool outerBackground = threadBackground;
+  threadBackground = job->background;
+  try {
+    job->run(threadIndex);
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(counter->errorMutex);
+    if (!counter->error) {
+      counter->error = std::current_exception();
+    }
+  }
+  threadBackground = outerBackground;
+  delete job;
+  counter->pending.fetch_sub(1, std::memory_order_acq_rel);
+}
+
+// Takes and runs jobs, spinning briefly when there are none and sleeping
+// once nothing is queued anywhere.
+void JobSystem::workerLoop(uint32_t workerIndex) {
+  threadSystem = this;
+  threadWorker = workerIndex;
+  Profiler::setThreadName("job worker " + std::to_string(workerIndex));
+
+  uint32_t idle = 0;
+  for (;;) {
+    QueuedJob *job = take(workerIndex);
+    if (job != nullptr) {
+      execute(job, workerIndex);
+      idle = 0;
+      continue;
+    }
+    if (++idle < JOB_IDLE_SPINS) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    idle = 0;
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    sleepers.fetch_add(1);
+    wake.wait(lock, [this] { return stopping || queuedJobs.load() > 0; });
+    sleepers.fetch_sub(1);
+    if (stopping) {
+      return;
+    }
+  }
+}
+
+// Queues the upper half of [begin, end) until one index is left, then
+// runs it. Every queued half splits itself the same way.
+void JobSystem::splitRange(JobCounter &counter, size_t begin, size_t end,
+                           const Task &task, uint32_t threadIndex) {
+  while (end - begin > 1) {
+    size_t middle = begin + (end - begin) / 2;
+    submit(counter, [this, &counter, &task, middle, end](uint32_t thread) {
+      splitRange(counter, middle, end, task, thread);
+    });
+    end = middle;
+  }
+  task(begin, threadIndex);
+}
+
+//-------------------------------------------------------------------
+// JobSystem::WorkDeque (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Pushes a job at the bottom. Only the owning worker may push.
+// ~Returns: false if the deque is full.
+bool JobSystem::WorkDeque::push(QueuedJob *job) {
+  int64_t b = bottom.load(std::memory_order_relaxed);
+  int64_t t = top.load(std::memory_order_acquire);
+  if (b - t >= static_cast<int64_t>(JOB_QUEUE_CAPACITY)) {
+    return false;
+  }
+  slots[b & (JOB_QUEUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  bottom.store(b + 1, std::memory_order_relaxed);
+  return true;
+}
+
+// Pops the newest job from the bottom. Only the owning worker may pop.
+// ~Returns: the job, or nullptr if the deque is empty or a thief won the
+// last job.
+JobSystem::QueuedJob *JobSystem::WorkDeque::pop() {
+  int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+  bottom.store(b, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t t = top.load(std::memory_order_relaxed);
+  if (t > b) {
+    bottom.store(b + 1, std::memory_order_relaxed);
+    return nullptr;
+  }
+
+  QueuedJob *job =
+      slots[b & (JOB_QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+  if (t == b) {
+    // the last job, race thieves for it
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                     std::memory_order_relaxed)) {
+      job = nullptr;
+    }
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+  return job;
+}
+
+// Steals the oldest job from the top. Any thread may steal.
+// ~Returns: the job, or nullptr if the deque is empty or another thread
+// took it first.
+JobSystem::QueuedJob *JobSystem::WorkDeque::steal() {
+  int64_t t = top.load(std::memory_order_acquire);
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  int64_t b = bottom.load(std::memory_order_acquire);
+  if (t >= b) {
+    return nullptr;
+  }
+
+  QueuedJob *job =
+      slots[t & (JOB_QUEUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+  if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                   std::memory_order_relaxed)) {
+    return nullptr;
+  }
+  return job;
+}
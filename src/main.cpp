@@ -43,15 +43,239 @@ void DestroyDebugUtilsMessengerEXT(VkInstance instance,
   }
 }
 
+// Parses command line arguments into application options.
+// ~Returns: ApplicationOptions struct with parsed options.
+ApplicationOptions parseOptions(int argc, char **argv) {
+  ApplicationOptions options;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+
+    // fetch the value following an option that requires one
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) {
+        throw std::runtime_error("missing value for option " + arg + "!");
+      }
+      return argv[++i];
+    };
+
+    if (arg == "--headless") {
+      options.headless = true;
+    } else if (arg == "--frames") {
+      options.frameCount = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--duration") {
+      options.duration = std::stod(value());
+    } else if (arg == "--frames-in-flight") {
+      options.framesInFlight = static_cast<uint32_t>(std::stoul(value()));
+      if (options.framesInFlight == 0) {
+        throw std::runtime_error("--frames-in-flight must be at least 1!");
+      }
+    } else if (arg == "--profile") {
+      std::string name = value();
+      auto profile = parsePresentationProfile(name);
+      if (!profile) {
+        throw std::runtime_error("unknown presentation profile " + name + "!");
+      }
+      options.presentationProfile = *profile;
+    } else if (arg == "--present-mode") {
+      std::string name = value();
+      options.presentMode = parsePresentMode(name);
+      if (!options.presentMode) {
+        throw std::runtime_error("unknown present mode " + name + "!");
+      }
+    } else if (arg == "--readback") {
+      options.readbackPath = value();
+    } else if (arg == "--pipeline-cache") {
+      options.pipelineCachePath = value();
+    } else if (arg == "--no-pipeline-cache") {
+      options.pipelineCachePath.clear();
+    } else if (arg == "--assets") {
+      options.assetArchivePath = value();
+    } else if (arg == "--shader-dir") {
+      options.shaderDirectory = value();
+    } else if (arg == "--gpu") {
+      options.gpu = value();
+    } else if (arg == "--record-threads") {
+      options.recordThreads = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--draws") {
+      options.drawCount = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--instances") {
+      options.instanceCount = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--gpu-culling") {
+      options.gpuCulling = true;
+    } else if (arg == "--mesh") {
+      options.meshPath = value();
+    } else if (arg == "--moving-instances") {
+      options.movingInstances = std::stod(value());
+    } else if (arg == "--job-threads") {
+      options.jobThreads = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--bench-recording") {
+      options.benchRecording = true;
+    } else if (arg == "--stats-interval") {
+      options.statsInterval = std::stod(value());
+    } else if (arg == "--no-transfer-queue") {
+      options.transferQueue = false;
+    } else if (arg == "--no-compute-queue") {
+      options.computeQueue = false;
+    } else if (arg == "--no-timeline-semaphores") {
+      options.timelineSemaphores = false;
+    } else if (arg == "--watch-shaders") {
+      options.watchShaders = true;
+    } else if (arg == "--trace") {
+      options.tracePath = value();
+      options.traceOnExit = true;
+    } else if (arg == "--no-profiler") {
+      options.profiler = false;
+    } else if (arg == "--init-threads") {
+      options.initThreads = static_cast<uint32_t>(std::stoul(value()));
+    } else if (arg == "--startup-trace") {
+      options.startupTracePath = value();
+    } else if (arg == "--help") {
+      std::cout << "usage: " << argv[0] << " [options]\n"
+                << "  --headless          render offscreen without a window\n"
+                << "  --frames <n>        exit after rendering n frames\n"
+                << "  --duration <s>      exit after rendering for s seconds\n"
+                << "  --profile <latency|balanced|throughput>\n"
+                << "                      presentation profile to start with,\n"
+                << "                      P cycles profiles at runtime\n"
+                << "                      (default balanced)\n"
+                << "  --frames-in-flight <n>\n"
+                << "                      frames recorded ahead of the GPU,\n"
+                << "                      overrides the profile\n"
+                << "  --present-mode <immediate|mailbox|fifo|fifo-relaxed>\n"
+                << "                      present mode to use if supported,\n"
+                << "                      overrides the profile\n"
+                << "  --readback <file>   copy frames to host memory and save\n"
+                << "                      the last one as a PPM image\n"
+                << "  --pipeline-cache <file>\n"
+                << "                      pipeline cache location (default "
+                << PIPELINE_CACHE_DEFAULT_PATH << ")\n"
+                << "  --no-pipeline-cache don't load or save a pipeline cache\n"
+                << "  --assets <file>     load shaders from an asset archive\n"
+                << "                      instead of the built-in ones\n"
+                << "  --shader-dir <dir>  load SPIR-V files from dir instead\n"
+                << "                      of the built-in shaders\n"
+                << "  --gpu <index|name>  render on this GPU instead of the\n"
+                << "                      best scoring one (also "
+                << DEVICE_OVERRIDE_ENV << ")\n"
+                << "  --record-threads <n>\n"
+                << "                      record draws into n secondary\n"
+                << "                      command buffers in parallel\n"
+                << "  --job-threads <n>   worker threads that run scene\n"
+                << "                      updates, recording and loading\n"
+                << "                      next to the main thread (default\n"
+                << "                      one per core besides main)\n"
+                << "  --draws <n>         number of draws recorded per frame\n"
+                << "  --instances <n>     draw n instanced triangles whose\n"
+                << "                      transforms are updated every frame\n"
+                << "  --moving-instances <f>\n"
+                << "                      fraction of the instances that\n"
+                << "                      spin, the rest stay still\n"
+                << "                      (default 1)\n"
+                << "  --gpu-culling       cull instances on the GPU and draw\n"
+                << "                      the survivors indirectly\n"
+                << "  --mesh <file>       load an OBJ or glTF mesh in the\n"
+                << "                      background and draw it once it has\n"
+                << "                      been streamed to the GPU\n"
+                << "  --bench-recording   time command recording for a range\n"
+                << "                      of thread counts and exit\n"
+                << "  --stats-interval <s>\n"
+                << "                      print GPU frame time statistics\n"
+                << "                      every s seconds\n"
+                << "  --no-transfer-queue upload on the graphics queue even if\n"
+                << "                      a dedicated transfer queue exists\n"
+                << "  --no-compute-queue  run compute on the graphics queue\n"
+                << "                      even if a compute queue exists\n"
+                << "  --no-timeline-semaphores\n"
+                << "                      synchronize frames with fences and\n"
+                << "                      binary semaphores on any device\n"
+                << "  --watch-shaders     recompile shaders when their GLSL\n"
+                << "                      changes and swap in new pipelines,\n"
+                << "                      implies --shader-dir shaders\n"
+                << "  --trace <file>      write a Chrome trace of CPU frame\n"
+                << "                      phases on exit (F12 or SIGUSR1\n"
+                << "                      write one at any time)\n"
+                << "  --no-profiler       don't record CPU frame phases\n"
+                << "  --init-threads <n>  worker threads that run independent\n"
+                << "                      startup steps (default "
+                << INIT_DEFAULT_THREADS << ", 0 runs\n"
+                << "                      them in sequence)\n"
+                << "  --startup-trace <file>\n"
+                << "                      write a Chrome trace of the startup\n"
+                << "                      steps once initialized\n";
+      std::exit(EXIT_SUCCESS);
+    } else {
+      throw std::runtime_error("unknown option " + arg + "!");
+    }
+  }
+
+  if (options.gpuCulling && options.instanceCount == 0) {
+    throw std::runtime_error("--gpu-culling needs --instances!");
+  }
+  if (!options.meshPath.empty() && options.instanceCount > 0) {
+    throw std::runtime_error("--mesh can't be combined with --instances!");
+  }
+  if (options.movingInstances < 0.0 || options.movingInstances > 1.0) {
+    throw std::runtime_error("--moving-instances must be between 0 and 1!");
+  }
+
+  // hot reload recompiles the sources next to the SPIR-V it loads
+  if (options.watchShaders && options.shaderDirectory.empty()) {
+    options.shaderDirectory = "shaders";
+  }
+
+  // headless runs need an end, default to a fixed batch of frames
+  if (options.headless && options.frameCount == 0 && options.duration <= 0.0) {
+    options.frameCount = HEADLESS_DEFAULT_FRAMES;
+  }
+
+  return options;
+}
+
 //-------------------------------------------------------------------
 // HelloTriangleApplication ( Public Class Methods)
 //-------------------------------------------------------------------
 
+HelloTriangleApplication::HelloTriangleApplication(
+    const ApplicationOptions &options)
+    : options(options) {}
+
+// Gets the GPU durations of the most recent frames in milliseconds.
+// ~Returns: ring buffer of GPU frame times.
+const FrameTimeRing<> &HelloTriangleApplication::gpuFrameTimes() const {
+  return gpuTimer.frameTimes();
+}
+
+// Summarizes the GPU durations of the most recent frames.
+// ~Returns: FrameTimeStats struct with min/avg/percentiles in milliseconds.
+FrameTimeStats HelloTriangleApplication::gpuFrameStats() const {
+  return gpuTimer.frameTimes().stats();
+}
+
+// Gets the frame count and timings of the last run. Per frame times are only
+// filled in when collectFrameTimes is set.
+// ~Returns: FrameReport struct for the main loop.
+const FrameReport &HelloTriangleApplication::frameReport() const {
+  return report;
+}
+
 // Runs application.
 void HelloTriangleApplication::run() {
-  initWindow();
+  Profiler::setEnabled(options.profiler);
+  Profiler::setThreadName("main");
+#ifdef SIGUSR1
+  std::signal(SIGUSR1, traceSignalHandler);
+#endif
+
+  if (!options.headless) {
+    initWindow();
+  }
   initVulkan();
-  mainLoop();
+  if (options.benchRecording) {
+    benchmarkRecording();
+  } else {
+    mainLoop();
+  }
   cleanup();
 }
 
@@ -59,6 +283,8 @@ void HelloTriangleApplication::run() {
 // HelloTriangleApplication (Static Class Methods)
 //-----------------------------------------------------------------
 
+volatile std::sig_atomic_t HelloTriangleApplication::traceSignaled = 0;
+
 // Prints validation layer debug messages to stdout.
 // ~Returns: 0
 VKAPI_ATTR VkBool32 VKAPI_CALL HelloTriangleApplication::debugCallback(
@@ -104,6 +330,28 @@ void HelloTriangleApplication::framebufferResizeCallback(GLFWwindow *window,
   app->framebufferResized = true;
 }
 
+// Requests a trace export when F12 is pressed and a switch to the next
+// presentation profile when P is pressed.
+void HelloTriangleApplication::keyCallback(GLFWwindow *window, int key,
+                                           int scancode, int action,
+                                           int mods) {
+  auto app = reinterpret_cast<HelloTriangleApplication *>(
+      glfwGetWindowUserPointer(window));
+  if (action != GLFW_PRESS) {
+    return;
+  }
+  if (key == GLFW_KEY_F12) {
+    app->traceRequested = true;
+  } else if (key == GLFW_KEY_P) {
+    app->profileSwitchRequested = true;
+  }
+}
+
+// Requests a trace export on SIGUSR1, for runs without a window.
+void HelloTriangleApplication::traceSignalHandler(int signal) {
+  traceSignaled = 1;
+}
+
 //-----------------------------------------------------------------
 // HelloTriangleApplication (Private Class Methods)
 //-----------------------------------------------------------------
@@ -121,23 +369,138 @@ void HelloTriangleApplication::initWindow() {
   window = glfwCreateWindow(WIDTH, HEIGHT, "Vulkan", nullptr, nullptr);
   glfwSetWindowUserPointer(window, this);
   glfwSetFramebufferSizeCallback(window, framebufferResizeCallback);
+  glfwSetKeyCallback(window, keyCallback);
 }
 
-// Initializes Vulkan instance.
+// Initializes Vulkan. The steps form a dependency graph, so shader
+// loading, pipeline compilation and buffer creation overlap with swap
+// chain setup instead of waiting for it.
 void HelloTriangleApplication::initVulkan() {
-  createInstance();
-  setupDebugMessenger();
-  createSurface();
-  pickPhysicalDevice();
-  createLogicalDevice();
-  createSwapChain();
-  createImageViews();
-  createRenderPass();
-  createGraphicsPipeline();
-  createFrameBuffers();
-  createCommandPool();
-  createCommandBuffers();
-  createSyncObjects();
+  // a startup trace needs the spans even if frame profiling is off
+  bool traceStartup = !options.startupTracePath.empty();
+  if (traceStartup) {
+    Profiler::setEnabled(true);
+  }
+  selectPresentationProfile(options.presentationProfile);
+  createJobSystem(options.jobThreads.value_or(
+      std::max(1u, std::thread::hardware_concurrency()) - 1));
+
+  // the mesh is parsed on the job system while the device comes up
+  if (!options.meshPath.empty()) {
+    meshLoader.start(options.meshPath, jobs.get());
+  }
+
+  InitGraph graph;
+  auto step = [this](void (HelloTriangleApplication::*create)()) {
+    return [this, create]() { (this->*create)(); };
+  };
+
+  // GLFW calls stay on the main thread
+  auto instanceStep = graph.add("createInstance", {},
+                                step(&HelloTriangleApplication::createInstance),
+                                true);
+  auto debugStep =
+      graph.add("setupDebugMessenger", {instanceStep},
+                step(&HelloTriangleApplication::setupDebugMessenger));
+  std::vector<InitGraph::StepId> pickDependencies = {debugStep};
+  if (!options.headless) {
+    pickDependencies.push_back(
+        graph.add("createSurface", {instanceStep},
+                  step(&HelloTriangleApplication::createSurface), true));
+  }
+  auto pickStep =
+      graph.add("pickPhysicalDevice", pickDependencies,
+                step(&HelloTriangleApplication::pickPhysicalDevice));
+  auto deviceStep =
+      graph.add("createLogicalDevice", {pickStep},
+                step(&HelloTriangleApplication::createLogicalDevice));
+
+  // SPIR-V is read while the instance and device are created
+  auto archiveStep =
+      graph.add("openAssetArchive", {},
+                step(&HelloTriangleApplication::openAssetArchive));
+  auto shadersStep =
+      graph.add("loadShaders", {archiveStep},
+                step(&HelloTriangleApplication::preloadShaders));
+
+  auto cacheStep =
+      graph.add("createPipelineCache", {deviceStep},
+                step(&HelloTriangleApplication::createPipelineCache));
+  auto allocatorStep =
+      graph.add("createDeviceAllocator", {deviceStep},
+                step(&HelloTriangleApplication::createDeviceAllocator));
+  auto uploadStep =
+      graph.add("createUploadQueue", {allocatorStep},
+                step(&HelloTriangleApplication::createUploadQueue));
+
+  // the allocator is thread safe, so steps that only allocate memory just
+  // wait for it; the upload queue isn't, so steps that queue uploads are
+  // chained behind it and each other
+  InitGraph::StepId uploadChainStep = uploadStep;
+
+  auto formatStep =
+      graph.add("selectImageFormat", {pickStep},
+                step(&HelloTriangleApplication::selectImageFormat));
+  InitGraph::StepId targetsStep;
+  if (options.headless) {
+    targetsStep = graph.add(
+        "createHeadlessRenderTargets", {formatStep, allocatorStep},
+        step(&HelloTriangleApplication::createHeadlessRenderTargets));
+  } else {
+    targetsStep =
+        graph.add("createSwapChain", {formatStep, deviceStep},
+                  step(&HelloTriangleApplication::createSwapChain), true);
+  }
+  auto viewsStep =
+      graph.add("createImageViews", {targetsStep},
+                step(&HelloTriangleApplication::createImageViews));
+
+  // pipelines only need the image format, not the swap chain images
+  auto renderPassStep =
+      graph.add("createRenderPass", {formatStep, deviceStep},
+                step(&HelloTriangleApplication::createRenderPass));
+  auto layoutStep =
+      graph.add("createDescriptorSetLayout", {deviceStep},
+                step(&HelloTriangleApplication::createDescriptorSetLayout));
+  graph.add("createGraphicsPipeline",
+            {renderPassStep, layoutStep, cacheStep, shadersStep},
+            step(&HelloTriangleApplication::createGraphicsPipeline));
+  if (options.gpuCulling) {
+    graph.add("createCullPipeline", {layoutStep, cacheStep, shadersStep},
+              step(&HelloTriangleApplication::createCullPipeline));
+    uploadChainStep =
+        graph.add("createIndexBuffer", {uploadChainStep},
+                  step(&HelloTriangleApplication::createIndexBuffer));
+  }
+  graph.add("createFrameBuffers", {viewsStep, renderPassStep},
+            step(&HelloTriangleApplication::createFrameBuffers));
+  auto drawListStep = graph.add(
+      "createDrawList", {}, step(&HelloTriangleApplication::createDrawList));
+  graph.add("createFrameResources", {layoutStep, drawListStep, allocatorStep},
+            step(&HelloTriangleApplication::createFrameResources));
+
+  graph.run(options.initThreads);
+  preloadedShaders.clear();
+
+  std::cout << "initialized " << graph.size() << " steps in "
+            << graph.wallMilliseconds() << " ms on "
+            << options.initThreads + 1 << " thread(s) (steps took "
+            << graph.stepMilliseconds() << " ms, critical path "
+            << graph.criticalPathMilliseconds() << " ms)" << std::endl;
+  if (traceStartup) {
+    if (Profiler::exportChromeTrace(options.startupTracePath)) {
+      std::cout << "wrote startup trace to " << options.startupTracePath
+                << std::endl;
+    } else {
+      std::cerr << "failed to write startup trace to "
+                << options.startupTracePath << std::endl;
+    }
+    Profiler::setEnabled(options.profiler);
+  }
+
+  if (options.watchShaders) {
+    startShaderWatcher();
+  }
 }
 
 // Sets up debug messenger extension.
@@ -178,7 +541,20 @@ void HelloTriangleApplication::createInstance() {
   appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.pEngineName = "No Engine";
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-  appInfo.apiVersion = VK_API_VERSION_1_0;
+
+  // timeline semaphores need Vulkan 1.2, which any loader newer than 1.0
+  // accepts; 1.0 loaders lack vkEnumerateInstanceVersion
+  auto enumerateInstanceVersion =
+      (PFN_vkEnumerateInstanceVersion)vkGetInstanceProcAddr(
+          nullptr, "vkEnumerateInstanceVersion");
+  uint32_t loaderVersion = VK_API_VERSION_1_0;
+  if (enumerateInstanceVersion) {
+    enumerateInstanceVersion(&loaderVersion);
+  }
+  if (options.timelineSemaphores && loaderVersion >= VK_API_VERSION_1_1) {
+    instanceApiVersion = VK_API_VERSION_1_2;
+  }
+  appInfo.apiVersion = instanceApiVersion;
 
   // Instance Info (required)
   VkInstanceCreateInfo createInfo = {};
@@ -219,11 +595,15 @@ void HelloTriangleApplication::createInstance() {
 // Gets a list of required extensions needed.
 // ~Returns: Vector of extensions.
 std::vector<const char *> HelloTriangleApplication::getRequiredExtensions() {
-  uint32_t glfwExtensionCount = 0;
-  const char **glfwExtensions =
-      glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  std::vector<const char *> extensions(glfwExtensions,
-                                       glfwExtensions + glfwExtensionCount);
+  std::vector<const char *> extensions;
+
+  // surface extensions are only needed when presenting to a window
+  if (!options.headless) {
+    uint32_t glfwExtensionCount = 0;
+    const char **glfwExtensions =
+        glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+  }
 
   if (enableValidationLayers)
     extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -231,6 +611,17 @@ std::vector<const char *> HelloTriangleApplication::getRequiredExtensions() {
   return extensions;
 }
 
+// Gets a list of device extensions needed for the current mode.
+// ~Returns: Vector of device extensions.
+std::vector<const char *>
+HelloTriangleApplication::getRequiredDeviceExtensions() {
+  // headless rendering never presents, so it has no need for a swap chain
+  if (options.headless) {
+    return {};
+  }
+  return deviceExtensions;
+}
+
 // Gets a list of supported extensions.
 void HelloTriangleApplication::checkSupportedExtensions() {
   uint32_t extensionCount = 0;
@@ -275,34 +666,160 @@ bool HelloTriangleApplication::checkValidationLayerSupport() {
   return true;
 }
 
-// Listens for events until GLFW window closes.
+// Listens for events until GLFW window closes, or renders the requested
+// number of frames as fast as possible when running headless.
 void HelloTriangleApplication::mainLoop() {
-  while (!glfwWindowShouldClose(window)) {
-    glfwPollEvents();
+  auto startTime = std::chrono::steady_clock::now();
+  auto lastStatsTime = startTime;
+
+  // dump frame statistics when the interval has elapsed, and export a trace
+  // when one was asked for
+  auto updateStats = [&]() {
+    if (traceRequested || traceSignaled) {
+      traceRequested = false;
+      traceSignaled = 0;
+      exportTrace();
+    }
+    if (options.statsInterval <= 0.0) {
+      return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<double>(now - lastStatsTime).count() >=
+        options.statsInterval) {
+      dumpFrameStats();
+      lastStatsTime = now;
+    }
+  };
+
+  auto startClock = std::clock();
+
+  // stop at the requested frame count or duration, or when the window closes
+  auto running = [&]() {
+    if (options.frameCount != 0 && framesRendered >= options.frameCount) {
+      return false;
+    }
+    if (options.duration > 0.0 &&
+        std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                      startTime)
+                .count() >= options.duration) {
+      return false;
+    }
+    return options.headless || !glfwWindowShouldClose(window);
+  };
+
+  report = FrameReport();
+  if (options.collectFrameTimes && options.frameCount != 0) {
+    report.frameTimes.reserve(options.frameCount);
+    report.cpuFrameTimes.reserve(options.frameCount);
+  }
+
+  auto frameStart = startTime;
+  auto frameStartClock = startClock;
+  while (running()) {
+    if (!options.headless) {
+      PROFILE_SCOPE("glfwPollEvents");
+      glfwPollEvents();
+    }
+    if (profileSwitchRequested) {
+      profileSwitchRequested = false;
+      switchPresentationProfile(nextPresentationProfile(presentationProfile));
+    }
     drawFrame();
+
+    // time the whole iteration, so waits on the GPU count towards the frame
+    if (options.collectFrameTimes) {
+      auto frameEnd = std::chrono::steady_clock::now();
+      auto frameEndClock = std::clock();
+      report.frameTimes.push_back(
+          std::chrono::duration<double, std::milli>(frameEnd - frameStart)
+              .count());
+      report.cpuFrameTimes.push_back(
+          1000.0 * (frameEndClock - frameStartClock) / CLOCKS_PER_SEC);
+      frameStart = frameEnd;
+      frameStartClock = frameEndClock;
+    }
+    updateStats();
   }
   vkDeviceWaitIdle(device);
+
+  // report throughput so batch runs can be compared
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+  report.frames = framesRendered;
+  report.seconds = seconds;
+  report.cpuSeconds =
+      static_cast<double>(std::clock() - startClock) / CLOCKS_PER_SEC;
+  if (!options.headless) {
+    report.presentMode = swapChainPresentMode;
+  }
+  std::cout << "rendered " << framesRendered << " frames in " << seconds
+            << " s (" << (seconds > 0.0 ? framesRendered / seconds : 0.0)
+            << " fps)" << std::endl;
+  dumpFrameStats();
+  dumpMemoryStats();
+  if (options.traceOnExit) {
+    exportTrace();
+  }
+
+  // save the most recently rendered frame
+  if (options.headless && !options.readbackPath.empty() &&
+      framesRendered > 0) {
+    writeReadbackImage(static_cast<uint32_t>(
+        (currentFrame + framesInFlight - 1) %
+        framesInFlight));
+  }
 }
 
 // Cleans up after GLFW window has been closed.
 void HelloTriangleApplication::cleanup() {
+  shaderWatcher.stop();
+  meshLoader.stop();
+  destroyRetiredPipelines(true);
+  vkDestroyPipeline(device, pendingGraphicsPipeline, nullptr);
+  vkDestroyPipeline(device, pendingCullPipeline, nullptr);
   cleanupSwapChain();
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
-    vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
-    vkDestroyFence(device, inFlightFences[i], nullptr);
+  cleanupGraphicsPipeline();
+  if (options.headless) {
+    cleanupHeadlessRenderTargets();
+  } else {
+    vkDestroySwapchainKHR(device, swapChain, nullptr);
+  }
+  cleanupFrameResources();
+  vkDestroyPipeline(device, cullPipeline, nullptr);
+  vkDestroyPipelineLayout(device, cullPipelineLayout, nullptr);
+  descriptorLayouts.destroy();
+  if (indexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, indexBuffer, nullptr);
+    allocator.free(indexBufferMemory);
+  }
+  if (meshVertexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, meshVertexBuffer, nullptr);
+    allocator.free(meshVertexBufferMemory);
+  }
+  if (meshIndexBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, meshIndexBuffer, nullptr);
+    allocator.free(meshIndexBufferMemory);
   }
-  vkDestroyCommandPool(device, commandPool, nullptr);
 
-  cleanupSwapChain();
+  uploadQueue.destroy();
+  allocator.destroy();
+  memoryBackend.reset();
+  savePipelineCache();
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
+  assetArchive.close();
   vkDestroyDevice(device, nullptr);
   if (enableValidationLayers) {
     DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
   }
-  vkDestroySurfaceKHR(instance, surface, nullptr);
+  if (!options.headless) {
+    vkDestroySurfaceKHR(instance, surface, nullptr);
+  }
   vkDestroyInstance(instance, nullptr);
-  glfwDestroyWindow(window);
-  glfwTerminate();
+  if (!options.headless) {
+    glfwDestroyWindow(window);
+    glfwTerminate();
+  }
 }
 
 // Selects a graphics device that supports needed features.
@@ -317,39 +834,80 @@ void HelloTriangleApplication::pickPhysicalDevice() {
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data());
 
-  // find the first suitable device
-  for (const VkPhysicalDevice &device : devices) {
-    if (isDeviceSuitable(device)) {
-      physicalDevice = device;
-      break;
+  std::vector<DeviceCandidate> candidates;
+  for (uint32_t i = 0; i < deviceCount; i++) {
+    candidates.push_back(describeDevice(devices[i], i));
+  }
+
+  // log the ranking before choosing, so a failed choice can be corrected
+  for (const DeviceRanking &ranking : rankDevices(candidates)) {
+    const DeviceCandidate &candidate = candidates[ranking.index];
+    std::cout << "gpu " << candidate.index << ": "
+              << candidate.properties.deviceName << " ("
+              << deviceTypeName(candidate.properties.deviceType) << ", "
+              << (deviceLocalHeapSize(candidate.memoryProperties) >> 20)
+              << " MiB) ";
+    if (ranking.score == DEVICE_SCORE_UNSUITABLE) {
+      std::cout << "unsuitable" << std::endl;
+    } else {
+      std::cout << "score " << ranking.score << std::endl;
     }
   }
 
-  // throw exception if no suitable device found
-  if (physicalDevice == VK_NULL_HANDLE) {
-    throw std::runtime_error("failed to find a suitable GPU!");
+  // the command line takes precedence over the environment
+  std::string override = options.gpu;
+  const char *environmentOverride = std::getenv(DEVICE_OVERRIDE_ENV);
+  if (override.empty() && environmentOverride != nullptr) {
+    override = environmentOverride;
+  }
+  uint32_t chosen = selectDevice(candidates, override);
+  physicalDevice = devices[chosen];
+  std::cout << "using gpu " << chosen << ": "
+            << candidates[chosen].properties.deviceName
+            << (override.empty() ? "" : " (chosen explicitly)") << std::endl;
+}
+
+// Gathers what device scoring needs to know about a physical device.
+// ~Returns: DeviceCandidate struct for the device.
+DeviceCandidate
+HelloTriangleApplication::describeDevice(VkPhysicalDevice device,
+                                         uint32_t index) {
+  DeviceCandidate candidate;
+  candidate.index = index;
+  vkGetPhysicalDeviceProperties(device, &candidate.properties);
+  vkGetPhysicalDeviceMemoryProperties(device, &candidate.memoryProperties);
+
+  uint32_t queueFamilyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+  candidate.queueFamilies.resize(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
+                                           candidate.queueFamilies.data());
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  std::vector<VkExtensionProperties> extensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       extensions.data());
+  for (const VkExtensionProperties &extension : extensions) {
+    candidate.extensions.push_back(extension.extensionName);
   }
+
+  candidate.suitable = isDeviceSuitable(device);
+  return candidate;
 }
 
 // Checks to see if a specified physical graphics device is suitable for the
 // application to use.
 // ~Returns: true if device is suitable, false otherwise
 bool HelloTriangleApplication::isDeviceSuitable(VkPhysicalDevice device) {
-
-  // // get device properties
-  // VkPhysicalDeviceProperties deviceProperties;
-  // vkGetPhysicalDeviceProperties(device, &deviceProperties);
-
-  // // get device features
-  // VkPhysicalDeviceFeatures deviceFeatures;
-  // vkGetPhysicalDeviceFeatures(device, &deviceFeatures);
-
   QueueFamilyIndices indices = findQueueFamilies(device);
 
   bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
+  // headless rendering uses its own images instead of a swap chain
+  bool swapChainAdequate = options.headless;
+  if (extensionsSupported && !options.headless) {
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
     swapChainAdequate = !swapChainSupport.formats.empty() &&
                         !swapChainSupport.presentModes.empty();
@@ -380,6 +938,18 @@ HelloTriangleApplication::findQueueFamilies(VkPhysicalDevice device) {
         queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
       indices.graphicsFamily = i;
     }
+
+    // without a surface nothing is presented, so the graphics family stands
+    // in for the present family
+    if (options.headless) {
+      indices.presentFamily = indices.graphicsFamily;
+      if (indices.isComplete()) {
+        break;
+      }
+      i++;
+      continue;
+    }
+
     VkBool32 presentSupport = false;
     vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
     if (queueFamily.queueCount > 0 && presentSupport) {
@@ -391,6 +961,34 @@ HelloTriangleApplication::findQueueFamilies(VkPhysicalDevice device) {
     i++;
   }
 
+  // uploads prefer a transfer only family, which usually maps to a DMA engine
+  // that copies alongside rendering, and otherwise share the graphics family
+  indices.transferFamily = indices.graphicsFamily;
+  if (options.transferQueue) {
+    for (uint32_t j = 0; j < queueFamilyCount; j++) {
+      VkQueueFlags flags = queueFamilies[j].queueFlags;
+      if (queueFamilies[j].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+          !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+        indices.transferFamily = j;
+        break;
+      }
+    }
+  }
+
+  // compute prefers a family without graphics, whose queue the GPU can run
+  // alongside rendering, and otherwise shares the graphics family
+  indices.computeFamily = indices.graphicsFamily;
+  if (options.computeQueue) {
+    for (uint32_t j = 0; j < queueFamilyCount; j++) {
+      VkQueueFlags flags = queueFamilies[j].queueFlags;
+      if (queueFamilies[j].queueCount > 0 && (flags & VK_QUEUE_COMPUTE_BIT) &&
+          !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+        indices.computeFamily = j;
+        break;
+      }
+    }
+  }
+
   return indices;
 }
 
@@ -400,7 +998,9 @@ void HelloTriangleApplication::createLogicalDevice() {
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
   std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
-                                            indices.presentFamily.value()};
+                                            indices.presentFamily.value(),
+                                            indices.transferFamily.value(),
+                                            indices.computeFamily.value()};
 
   // assign a queue priority to influence scheduling of command buffer execution
   // (0.0f-1.0f)
@@ -416,17 +1016,75 @@ void HelloTriangleApplication::createLogicalDevice() {
 
   // specify set of device features to use
   VkPhysicalDeviceFeatures deviceFeatures = {};
+  std::vector<const char *> extensions = getRequiredDeviceExtensions();
+  bool drawIndirectCount = false;
+  if (options.gpuCulling) {
+    // the cull pass is submitted to the compute family, which is a
+    // compute-only family when the device has one and otherwise the
+    // graphics family
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                             &queueFamilyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice,
+                                             &queueFamilyCount,
+                                             queueFamilies.data());
+    if (!(queueFamilies[indices.computeFamily.value()].queueFlags &
+          VK_QUEUE_COMPUTE_BIT)) {
+      throw std::runtime_error("GPU culling needs a queue with compute "
+                               "support!");
+    }
+
+    // indirect draws past the first start at a non-zero instance
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    if (!supportedFeatures.drawIndirectFirstInstance) {
+      throw std::runtime_error(
+          "GPU culling needs drawIndirectFirstInstance support!");
+    }
+    deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    multiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
+    // with the count variant the GPU also decides how many draws to issue
+    drawIndirectCount = isDeviceExtensionAvailable(
+        physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    if (drawIndirectCount) {
+      extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
+  }
+
+  // use timeline semaphores when both instance and device are Vulkan 1.2
+  VkPhysicalDeviceVulkan12Features vulkan12Features = {};
+  vulkan12Features.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  if (instanceApiVersion >= VK_API_VERSION_1_2 &&
+      properties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &vulkan12Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+    timelineEnabled = vulkan12Features.timelineSemaphore == VK_TRUE;
+
+    // enable nothing else the query reported
+    vulkan12Features = {};
+    vulkan12Features.sType =
+        VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+    vulkan12Features.timelineSemaphore = VK_TRUE;
+  }
 
   // configure logical device
   VkDeviceCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = timelineEnabled ? &vulkan12Features : nullptr;
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pEnabledFeatures = &deviceFeatures;
-  createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+  createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+  createInfo.ppEnabledExtensionNames = extensions.data();
 
   // enable validation layers if in debug
   // in newer versions of Vulkan these settings are completely ignored for
@@ -452,6 +1110,34 @@ void HelloTriangleApplication::createLogicalDevice() {
 
   // register present queue with logical device
   vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
+
+  // register transfer queue, the graphics queue when there is no dedicated one
+  vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+
+  // register compute queue, the graphics queue when there is no dedicated one
+  vkGetDeviceQueue(device, indices.computeFamily.value(), 0, &computeQueue);
+
+  std::cout << "frames are synchronized with "
+            << (timelineEnabled ? "timeline semaphores"
+                                : "fences and binary semaphores")
+            << std::endl;
+
+  if (options.gpuCulling) {
+    if (drawIndirectCount) {
+      cmdDrawIndexedIndirectCount =
+          (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(
+              device, "vkCmdDrawIndexedIndirectCountKHR");
+    }
+    std::cout << "GPU culling runs on the "
+              << (indices.computeFamily != indices.graphicsFamily
+                      ? "dedicated compute"
+                      : "graphics")
+              << " queue and draws with "
+              << (cmdDrawIndexedIndirectCount
+                      ? "vkCmdDrawIndexedIndirectCount"
+                      : "vkCmdDrawIndexedIndirect")
+              << std::endl;
+  }
 }
 
 // Creates a window surface, establishing a connection between the Vulkan API
@@ -476,8 +1162,9 @@ bool HelloTriangleApplication::checkDeviceExtensionSupport(
   vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
                                        availableExtensions.data());
 
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                           deviceExtensions.end());
+  std::vector<const char *> extensions = getRequiredDeviceExtensions();
+  std::set<std::string> requiredExtensions(extensions.begin(),
+                                           extensions.end());
 
   for (const VkExtensionProperties &extension : availableExtensions) {
     requiredExtensions.erase(extension.extensionName);
@@ -488,6 +1175,26 @@ bool HelloTriangleApplication::checkDeviceExtensionSupport(
   return true;
 }
 
+// Checks whether the physical graphics device offers an optional extension.
+// ~Returns: true if the extension is available, false otherwise.
+bool HelloTriangleApplication::isDeviceExtensionAvailable(
+    VkPhysicalDevice device, const char *extensionName) {
+  uint32_t extensionCount;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+
+  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       availableExtensions.data());
+
+  for (const VkExtensionProperties &extension : availableExtensions) {
+    if (std::strcmp(extension.extensionName, extensionName) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // Queries device for supported swap chain details.
 // ~Returns: SwapChainSupportDetails struct with swap chain support details.
 HelloTriangleApplication::SwapChainSupportDetails
@@ -543,20 +1250,29 @@ VkSurfaceFormatKHR HelloTriangleApplication::chooseSwapSurfaceFormat(
 // Returns an appropriate swap presentation mode.
 VkPresentModeKHR HelloTriangleApplication::chooseSwapPresentMode(
     const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  // FIFO is a first-in-first out queue mode (basically vertical sync)
-  VkPresentModeKHR bestMode = VK_PRESENT_MODE_FIFO_KHR;
-
-  // try to use triple-buffering, or fallback to immediate rendering for
-  // compatibility
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return availablePresentMode;
-    } else if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-      bestMode = availablePresentMode;
+  // honour an explicitly requested mode when the surface supports it
+  if (options.presentMode) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(),
+                  *options.presentMode) != availablePresentModes.end()) {
+      return *options.presentMode;
+    }
+    std::cerr << "present mode " << presentModeName(*options.presentMode)
+              << " is not supported, choosing another" << std::endl;
+  }
+
+  // take the profile's most preferred mode that the surface supports
+  const PresentationProfile &profile =
+      getPresentationProfile(presentationProfile);
+  for (VkPresentModeKHR presentMode : profile.presentModes) {
+    if (std::find(availablePresentModes.begin(), availablePresentModes.end(),
+                  presentMode) != availablePresentModes.end()) {
+      return presentMode;
     }
   }
 
-  return bestMode;
+  // FIFO is a first-in-first out queue mode (basically vertical sync) and
+  // the only mode every surface supports
+  return VK_PRESENT_MODE_FIFO_KHR;
 }
 
 // Returns the best resolution of images for the swap chain based on current
@@ -575,28 +1291,43 @@ VkExtent2D HelloTriangleApplication::chooseSwapExtent(
 
     actualExtent.width = std::max(
         capabilities.minImageExtent.width,
-        std::min(capabilities.minImageExtent.width, actualExtent.width));
+        std::min(capabilities.maxImageExtent.width, actualExtent.width));
     actualExtent.height = std::max(
         capabilities.minImageExtent.height,
-        std::min(capabilities.minImageExtent.height, actualExtent.height));
+        std::min(capabilities.maxImageExtent.height, actualExtent.height));
 
     return actualExtent;
   }
 }
 
-// Creates the swap chain to store a buffer of images to be rendered.
+// Picks the format of the images rendered to. It is known before any of
+// them exist, so the render pass and pipeline don't wait for the swap
+// chain.
+void HelloTriangleApplication::selectImageFormat() {
+  if (options.headless) {
+    swapChainImageFormat = HEADLESS_IMAGE_FORMAT;
+    return;
+  }
+  swapChainSurfaceFormat =
+      chooseSwapSurfaceFormat(querySwapChainSupport(physicalDevice).formats);
+  swapChainImageFormat = swapChainSurfaceFormat.format;
+}
+
+// Creates the swap chain to store a buffer of images to be rendered, in the
+// format picked by selectImageFormat().
 void HelloTriangleApplication::createSwapChain() {
   SwapChainSupportDetails swapChainSupport =
       querySwapChainSupport(physicalDevice);
 
-  VkSurfaceFormatKHR surfaceFormat =
-      chooseSwapSurfaceFormat(swapChainSupport.formats);
   VkPresentModeKHR presentMode =
       chooseSwapPresentMode(swapChainSupport.presentModes);
+  swapChainPresentMode = presentMode;
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-  // min number of images for swap chain buffering
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+  // min number of images for swap chain buffering, plus what the profile
+  // asks for on top
+  uint32_t imageCount = swapChainSupport.capabilities.minImageCount +
+                        getPresentationProfile(presentationProfile).extraImages;
   if (swapChainSupport.capabilities.maxImageCount > 0 &&
       imageCount > swapChainSupport.capabilities.maxImageCount) {
     imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -607,8 +1338,8 @@ void HelloTriangleApplication::createSwapChain() {
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
   createInfo.surface = surface;
   createInfo.minImageCount = imageCount;
-  createInfo.imageFormat = surfaceFormat.format;
-  createInfo.imageColorSpace = surfaceFormat.colorSpace;
+  createInfo.imageFormat = swapChainSurfaceFormat.format;
+  createInfo.imageColorSpace = swapChainSurfaceFormat.colorSpace;
   createInfo.imageExtent = extent;
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
@@ -638,9 +1369,10 @@ void HelloTriangleApplication::createSwapChain() {
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
 
-  // in case window in resizes, recreate swap chain (pass in handle of null as
-  // old swap chain)
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // when the window resizes, hand the current swap chain over so the driver
+  // can reuse its resources and keep presenting while we rebuild
+  VkSwapchainKHR oldSwapChain = swapChain;
+  createInfo.oldSwapchain = oldSwapChain;
 
   // create the swap chain
   if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &swapChain) !=
@@ -648,17 +1380,126 @@ void HelloTriangleApplication::createSwapChain() {
     throw std::runtime_error("unable to create swap chain!");
   }
 
+  // the old swap chain is retired and can be destroyed
+  if (oldSwapChain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(device, oldSwapChain, nullptr);
+  }
+
   // get swap chain images
   vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr);
   swapChainImages.resize(imageCount);
   vkGetSwapchainImagesKHR(device, swapChain, &imageCount,
                           swapChainImages.data());
 
-  // set swap chain image format and extent
-  swapChainImageFormat = surfaceFormat.format;
   swapChainExtent = extent;
 }
 
+// Creates device owned images to render into when running without a window.
+// One image is created per frame in flight, so the frame's fence also guards
+// reuse of its image.
+void HelloTriangleApplication::createHeadlessRenderTargets() {
+  swapChainExtent = {static_cast<uint32_t>(WIDTH),
+                     static_cast<uint32_t>(HEIGHT)};
+
+  swapChainImages.resize(framesInFlight);
+  headlessImageMemory.resize(framesInFlight);
+
+  for (size_t i = 0; i < swapChainImages.size(); i++) {
+    // configure render target image
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.format = swapChainImageFormat;
+    imageInfo.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageInfo.usage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    if (vkCreateImage(device, &imageInfo, nullptr, &swapChainImages[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create headless image!");
+    }
+
+    // back the image with device local memory
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, swapChainImages[i], &memRequirements);
+    headlessImageMemory[i] =
+        allocator.allocate(memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                           ALLOCATION_KIND_OPTIMAL);
+    vkBindImageMemory(device, swapChainImages[i],
+                      headlessImageMemory[i].memory,
+                      headlessImageMemory[i].offset);
+  }
+
+  if (!options.readbackPath.empty()) {
+    createReadbackBuffers();
+  }
+}
+
+// Creates persistently mapped host visible buffers that headless frames are
+// copied into at the end of each frame.
+void HelloTriangleApplication::createReadbackBuffers() {
+  VkDeviceSize bufferSize =
+      VkDeviceSize(swapChainExtent.width) * swapChainExtent.height * 4;
+
+  readbackBuffers.resize(swapChainImages.size());
+  readbackBufferMemory.resize(swapChainImages.size());
+
+  for (size_t i = 0; i < swapChainImages.size(); i++) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = bufferSize;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &readbackBuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create readback buffer!");
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, readbackBuffers[i],
+                                  &memRequirements);
+
+    readbackBufferMemory[i] = allocator.allocate(
+        memRequirements,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        ALLOCATION_KIND_LINEAR);
+    vkBindBufferMemory(device, readbackBuffers[i],
+                       readbackBufferMemory[i].memory,
+                       readbackBufferMemory[i].offset);
+  }
+}
+
+// Writes the contents of a readback buffer to disk as a binary PPM image.
+void HelloTriangleApplication::writeReadbackImage(uint32_t imageIndex) {
+  std::ofstream file(options.readbackPath, std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open readback output file!");
+  }
+
+  file << "P6\n"
+       << swapChainExtent.width << " " << swapChainExtent.height << "\n255\n";
+
+  // headless images are BGRA, PPM wants RGB
+  const uint8_t *pixels =
+      static_cast<const uint8_t *>(readbackBufferMemory[imageIndex].mapped);
+  size_t pixelCount = size_t(swapChainExtent.width) * swapChainExtent.height;
+  std::vector<char> row(pixelCount * 3);
+  for (size_t p = 0; p < pixelCount; p++) {
+    row[p * 3 + 0] = static_cast<char>(pixels[p * 4 + 2]);
+    row[p * 3 + 1] = static_cast<char>(pixels[p * 4 + 1]);
+    row[p * 3 + 2] = static_cast<char>(pixels[p * 4 + 0]);
+  }
+  file.write(row.data(), row.size());
+}
+
 // Creates an image view from the created swap chain so we can access the images
 // from the render pipeline.
 void HelloTriangleApplication::createImageViews() {
@@ -693,15 +1534,120 @@ void HelloTriangleApplication::createImageViews() {
   }
 }
 
-// Creates the graphics pipeline.
+// Creates the pipeline cache, seeding it from disk when a cache written by
+// this device and driver is available.
+void HelloTriangleApplication::createPipelineCache() {
+  std::vector<char> cacheData;
+  if (!options.pipelineCachePath.empty()) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    cacheData = loadPipelineCacheData(options.pipelineCachePath, properties);
+  }
+
+  VkPipelineCacheCreateInfo cacheInfo = {};
+  cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  cacheInfo.initialDataSize = cacheData.size();
+  cacheInfo.pInitialData = cacheData.empty() ? nullptr : cacheData.data();
+
+  // a driver may still reject data that passed our checks, so retry empty
+  if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) !=
+      VK_SUCCESS) {
+    cacheData.clear();
+    cacheInfo.initialDataSize = 0;
+    cacheInfo.pInitialData = nullptr;
+    if (vkCreatePipelineCache(device, &cacheInfo, nullptr, &pipelineCache) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create pipeline cache!");
+    }
+  }
+  pipelineCacheLoaded = !cacheData.empty();
+}
+
+// Writes the pipeline cache to disk so the next launch skips shader
+// compilation.
+void HelloTriangleApplication::savePipelineCache() {
+  if (options.pipelineCachePath.empty()) {
+    return;
+  }
+
+  size_t dataSize = 0;
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) !=
+          VK_SUCCESS ||
+      dataSize == 0) {
+    return;
+  }
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) !=
+      VK_SUCCESS) {
+    return;
+  }
+  data.resize(dataSize);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  savePipelineCacheData(options.pipelineCachePath, properties, data);
+}
+
+// Creates the graphics pipeline and its layout.
 void HelloTriangleApplication::createGraphicsPipeline() {
-  // loader shaders
-  auto vertexShaderCode = readFile("shaders/vert.spv");
-  auto fragShaderCode = readFile("shaders/frag.spv");
+  auto startTime = std::chrono::steady_clock::now();
+
+  // set 0 holds the frame uniforms, set 1 the instances if there are any
+  std::vector<VkDescriptorSetLayout> setLayouts = {frameSetLayout};
+  if (descriptorSetLayout != VK_NULL_HANDLE) {
+    setLayouts.push_back(descriptorSetLayout);
+  }
+
+  // configure pipeline layout
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount =
+      static_cast<uint32_t>(setLayouts.size());
+  pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+  pipelineLayoutInfo.pushConstantRangeCount = 0;
+  pipelineLayoutInfo.pPushConstantRanges = nullptr;
+
+  // the mesh's transform is pushed with its draws
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(Mat4);
+  if (!options.meshPath.empty()) {
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+  }
+
+  // create pipeline layout
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
+                             &pipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  graphicsPipeline = buildGraphicsPipeline();
 
-  // create shader modules
-  VkShaderModule vertShaderModule = createShaderModule(vertexShaderCode);
-  VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
+  // report how long the build took and where its cache came from
+  double milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - startTime)
+                            .count();
+  const char *cacheState = "in-memory cache";
+  if (pipelineBuildCount == 0) {
+    cacheState = pipelineCacheLoaded ? "warm start, cache loaded from disk"
+                                     : "cold start";
+  }
+  std::cout << "graphics pipeline created in " << milliseconds << " ms ("
+            << cacheState << ")" << std::endl;
+  pipelineBuildCount++;
+}
+
+// Builds the graphics pipeline from the SPIR-V on disk, against the current
+// layout and render pass. The shader watcher thread calls it with
+// shaderReloadMutex held, so the render pass can't be replaced meanwhile.
+// ~Returns: the new pipeline.
+VkPipeline HelloTriangleApplication::buildGraphicsPipeline() {
+  // load shader modules, the instanced path reads its transforms from a
+  // storage buffer and the mesh path its vertices from a vertex buffer
+  VkShaderModule vertShaderModule = loadShaderModule(vertexShaderName());
+  VkShaderModule fragShaderModule = loadShaderModule("frag.spv");
 
   // configure vertex shader stage
   VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
@@ -732,6 +1678,30 @@ void HelloTriangleApplication::createGraphicsPipeline() {
   vertexInputInfo.vertexAttributeDescriptionCount = 0;
   vertexInputInfo.pVertexAttributeDescriptions = nullptr;
 
+  // meshes read interleaved MeshVertex attributes from binding 0
+  VkVertexInputBindingDescription meshBinding = {};
+  meshBinding.binding = 0;
+  meshBinding.stride = sizeof(MeshVertex);
+  meshBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+  VkVertexInputAttributeDescription
+      meshAttributes[MESH_VERTEX_ATTRIBUTE_COUNT] = {};
+  for (uint32_t i = 0; i < MESH_VERTEX_ATTRIBUTE_COUNT; i++) {
+    meshAttributes[i].location = MESH_VERTEX_ATTRIBUTES[i].location;
+    meshAttributes[i].binding = 0;
+    meshAttributes[i].format =
+        MESH_VERTEX_ATTRIBUTES[i].componentCount == 3
+            ? VK_FORMAT_R32G32B32_SFLOAT
+            : VK_FORMAT_R32G32_SFLOAT;
+    meshAttributes[i].offset = MESH_VERTEX_ATTRIBUTES[i].offset;
+  }
+  if (!options.meshPath.empty()) {
+    vertexInputInfo.vertexBindingDescriptionCount = 1;
+    vertexInputInfo.pVertexBindingDescriptions = &meshBinding;
+    vertexInputInfo.vertexAttributeDescriptionCount =
+        MESH_VERTEX_ATTRIBUTE_COUNT;
+    vertexInputInfo.pVertexAttributeDescriptions = meshAttributes;
+  }
+
   // input assembly config
   VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
   inputAssembly.sType =
@@ -739,27 +1709,14 @@ void HelloTriangleApplication::createGraphicsPipeline() {
   inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
   inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-  // configure viewport
-  VkViewport viewport = {};
-  viewport.x = 0.0f;
-  viewport.y = 0.0f;
-  viewport.width = (float)swapChainExtent.width;
-  viewport.height = (float)swapChainExtent.height;
-  viewport.maxDepth = 0.0f;
-  viewport.minDepth = 1.0f;
-
-  // configure scissor rectangle (only pixels inside will be rendered)
-  VkRect2D scissor = {};
-  scissor.offset = {0, 0};
-  scissor.extent = swapChainExtent;
-
-  // combine viewport and scissor rectangle into viewport state configuration
+  // viewport and scissor rectangle are dynamic state set while recording,
+  // so the pipeline does not depend on the swap chain extent
   VkPipelineViewportStateCreateInfo viewportState = {};
   viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewportState.viewportCount = 1;
-  viewportState.pViewports = &viewport;
+  viewportState.pViewports = nullptr;
   viewportState.scissorCount = 1;
-  viewportState.pScissors = &scissor;
+  viewportState.pScissors = nullptr;
 
   // configure rasterizer
   VkPipelineRasterizationStateCreateInfo rasterizer = {};
@@ -771,6 +1728,10 @@ void HelloTriangleApplication::createGraphicsPipeline() {
   rasterizer.lineWidth = 1.0f;
   rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
   rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+  if (!options.meshPath.empty()) {
+    // meshes wind counter-clockwise and their transform flips y
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  }
   rasterizer.depthBiasEnable = VK_FALSE;
   rasterizer.depthBiasConstantFactor = 0.0f;
   rasterizer.depthBiasClamp = 0.0f;
@@ -807,27 +1768,13 @@ void HelloTriangleApplication::createGraphicsPipeline() {
   colorBlending.blendConstants[2] = 0.0f;
   colorBlending.blendConstants[3] = 0.0f;
 
-  // // configure dynamic state
-  // VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
-  //                                   VK_DYNAMIC_STATE_LINE_WIDTH};
-  // VkPipelineDynamicStateCreateInfo dynamicState = {};
-  // dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-  // dynamicState.dynamicStateCount = 2;
-  // dynamicState.pDynamicStates = dynamicStates;
-
-  // configure pipeline layout
-  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-  pipelineLayoutInfo.setLayoutCount = 0;
-  pipelineLayoutInfo.pSetLayouts = nullptr;
-  pipelineLayoutInfo.pushConstantRangeCount = 0;
-  pipelineLayoutInfo.pPushConstantRanges = nullptr;
-
-  // create pipeline layout
-  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
-                             &pipelineLayout) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create pipeline layout!");
-  }
+  // configure dynamic state
+  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                    VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState = {};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
 
   // configure graphics pipeline
   VkGraphicsPipelineCreateInfo pipelineInfo = {};
@@ -841,7 +1788,7 @@ void HelloTriangleApplication::createGraphicsPipeline() {
   pipelineInfo.pMultisampleState = &multisampling;
   pipelineInfo.pDepthStencilState = nullptr;
   pipelineInfo.pColorBlendState = &colorBlending;
-  pipelineInfo.pDynamicState = nullptr;
+  pipelineInfo.pDynamicState = &dynamicState;
   pipelineInfo.layout = pipelineLayout;
   pipelineInfo.renderPass = renderPass;
   pipelineInfo.subpass = 0;
@@ -849,24 +1796,281 @@ void HelloTriangleApplication::createGraphicsPipeline() {
   pipelineInfo.basePipelineIndex = -1;
 
   // create graphics pipeline
-  if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
-                                nullptr, &graphicsPipeline) != VK_SUCCESS) {
-    throw std::runtime_error("failed to create graphics pipeline!");
-  }
+  VkPipeline pipeline;
+  VkResult result = vkCreateGraphicsPipelines(
+      device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
 
-  // cleanup shader modules
+  // cleanup shader modules, also when a reloaded shader failed to link
   vkDestroyShaderModule(device, fragShaderModule, nullptr);
   vkDestroyShaderModule(device, vertShaderModule, nullptr);
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create graphics pipeline!");
+  }
+
+  return pipeline;
+}
+
+// Creates the compute pipeline of the cull pass and its layout. It does not
+// depend on the render pass or swap chain, so it is only rebuilt when its
+// shader is reloaded.
+void HelloTriangleApplication::createCullPipeline() {
+  // frustum planes, counts and the pass are pushed per dispatch
+  VkPushConstantRange pushConstantRange = {};
+  pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  pushConstantRange.offset = 0;
+  pushConstantRange.size = sizeof(CullPushConstants);
+
+  // configure pipeline layout
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+  pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  pipelineLayoutInfo.setLayoutCount = 1;
+  pipelineLayoutInfo.pSetLayouts = &cullDescriptorSetLayout;
+  pipelineLayoutInfo.pushConstantRangeCount = 1;
+  pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+  // create pipeline layout
+  if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr,
+                             &cullPipelineLayout) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create cull pipeline layout!");
+  }
+
+  cullPipeline = buildCullPipeline();
+
+  // dispatches larger than the device allows stride over their items instead
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  maxCullGroupCount = properties.limits.maxComputeWorkGroupCount[0];
+}
+
+// Builds the cull pipeline from the SPIR-V on disk against the current
+// layout. Also called on the shader watcher thread.
+// ~Returns: the new pipeline.
+VkPipeline HelloTriangleApplication::buildCullPipeline() {
+  VkShaderModule cullShaderModule = loadShaderModule("cull.spv");
+
+  // configure compute shader stage
+  VkPipelineShaderStageCreateInfo cullShaderStageInfo = {};
+  cullShaderStageInfo.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  cullShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  cullShaderStageInfo.module = cullShaderModule;
+  cullShaderStageInfo.pName = "main";
+
+  // configure compute pipeline
+  VkComputePipelineCreateInfo pipelineInfo = {};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage = cullShaderStageInfo;
+  pipelineInfo.layout = cullPipelineLayout;
+  pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+  pipelineInfo.basePipelineIndex = -1;
+
+  // create compute pipeline
+  VkPipeline pipeline;
+  VkResult result = vkCreateComputePipelines(
+      device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+
+  // cleanup shader module
+  vkDestroyShaderModule(device, cullShaderModule, nullptr);
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create cull pipeline!");
+  }
+
+  return pipeline;
+}
+
+// Starts recompiling shaders whenever their sources in the shader
+// directory change. Pipelines are rebuilt on the watcher thread and swapped
+// in by applyShaderReloads() at the next frame boundary.
+void HelloTriangleApplication::startShaderWatcher() {
+  if (shaderWatcher.start(options.shaderDirectory,
+                          [this](const std::string &spirvPath) {
+                            reloadShader(spirvPath);
+                          })) {
+    std::cout << "watching " << options.shaderDirectory << " for changes"
+              << std::endl;
+  }
+}
+
+// Rebuilds the pipelines that use a freshly compiled SPIR-V file and
+// queues them for applyShaderReloads(). Runs on the shader watcher thread.
+void HelloTriangleApplication::reloadShader(const std::string &spirvPath) {
+  std::string name = spirvPath.substr(spirvPath.find_last_of('/') + 1);
+  std::string vertexName = vertexShaderName();
+  auto startTime = std::chrono::steady_clock::now();
+
+  if (name == vertexName || name == "frag.spv") {
+    // hold the lock while building, the render pass must not change
+    std::lock_guard<std::mutex> lock(shaderReloadMutex);
+    VkPipeline pipeline = buildGraphicsPipeline();
+    vkDestroyPipeline(device, pendingGraphicsPipeline, nullptr);
+    pendingGraphicsPipeline = pipeline;
+  } else if (name == "cull.spv" && options.gpuCulling) {
+    VkPipeline pipeline = buildCullPipeline();
+    std::lock_guard<std::mutex> lock(shaderReloadMutex);
+    vkDestroyPipeline(device, pendingCullPipeline, nullptr);
+    pendingCullPipeline = pipeline;
+  } else {
+    return;
+  }
+
+  double milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - startTime)
+                            .count();
+  std::cout << "reloaded " << spirvPath << ", pipeline rebuilt in "
+            << milliseconds << " ms" << std::endl;
+}
+
+// Swaps in pipelines rebuilt by the shader watcher. Called at a frame
+// boundary, before anything of the frame is recorded. The replaced
+// pipelines are retired until the frames that used them have completed.
+void HelloTriangleApplication::applyShaderReloads() {
+  destroyRetiredPipelines(false);
+
+  // never wait for a build in progress, its result is picked up later
+  std::unique_lock<std::mutex> lock(shaderReloadMutex, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    return;
+  }
+
+  // the previous frame is the last one using the old pipeline, and waiting
+  // for each of the next framesInFlight - 1 frames covers every frame slot
+  auto swap = [&](VkPipeline &current, VkPipeline &pending) {
+    if (pending == VK_NULL_HANDLE) {
+      return;
+    }
+    RetiredPipeline retired;
+    retired.pipeline = current;
+    retired.destroyFrame = framesRendered + framesInFlight - 1;
+    retiredPipelines.push_back(retired);
+    current = pending;
+    pending = VK_NULL_HANDLE;
+  };
+  swap(graphicsPipeline, pendingGraphicsPipeline);
+  swap(cullPipeline, pendingCullPipeline);
 }
 
-// Creates and returns a shader module from given shader buffer.
+// Destroys retired pipelines no frame in flight can use anymore. Must be
+// called after waiting for the current frame, or with all set once the
+// device is idle.
+void HelloTriangleApplication::destroyRetiredPipelines(bool all) {
+  auto unused = [&](const RetiredPipeline &retired) {
+    return all || framesRendered >= retired.destroyFrame;
+  };
+  for (const auto &retired : retiredPipelines) {
+    if (unused(retired)) {
+      vkDestroyPipeline(device, retired.pipeline, nullptr);
+    }
+  }
+  retiredPipelines.erase(std::remove_if(retiredPipelines.begin(),
+                                        retiredPipelines.end(), unused),
+                         retiredPipelines.end());
+}
+
+// Maps the asset archive so shaders are created straight from it. A shader
+// directory takes precedence, so the archive is skipped then.
+void HelloTriangleApplication::openAssetArchive() {
+  if (options.assetArchivePath.empty() || !options.shaderDirectory.empty()) {
+    return;
+  }
+  auto startTime = std::chrono::steady_clock::now();
+  if (!assetArchive.open(options.assetArchivePath)) {
+    throw std::runtime_error("no asset archive at " +
+                             options.assetArchivePath + "!");
+  }
+  double milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - startTime)
+                            .count();
+  std::cout << "mapped " << assetArchive.size() << " assets from "
+            << options.assetArchivePath << " in " << milliseconds << " ms"
+            << std::endl;
+}
+
+// Gets the vertex shader of the graphics pipeline, the instanced path
+// reads its transforms from a storage buffer and the mesh path its
+// vertices from a vertex buffer.
+// ~Returns: SPIR-V file name.
+std::string HelloTriangleApplication::vertexShaderName() const {
+  if (!options.meshPath.empty()) {
+    return "mesh.spv";
+  }
+  return options.instanceCount > 0 ? "instanced.spv" : "vert.spv";
+}
+
+// Loads the SPIR-V of every shader the pipelines are built from, so startup
+// reads files while the device is being created. Runs before the device
+// exists and needs only the asset archive.
+void HelloTriangleApplication::preloadShaders() {
+  std::vector<std::string> names = {vertexShaderName(), "frag.spv"};
+  if (options.gpuCulling) {
+    names.push_back("cull.spv");
+  }
+
+  // each file is read in its own job, the waiting step reads one too
+  std::vector<ShaderCode> codes(names.size());
+  jobs->parallelFor(names.size(), [&](size_t i, uint32_t) {
+    codes[i] = readShaderCode(names[i]);
+  });
+  for (size_t i = 0; i < names.size(); i++) {
+    preloadedShaders.emplace(names[i], std::move(codes[i]));
+  }
+}
+
+// Finds the SPIR-V of a shader file name. The shader directory overrides
+// everything for development; otherwise the code is viewed in place in the
+// asset archive or the executable itself, neither of which is copied.
+// ~Returns: the shader's code.
+ShaderCode HelloTriangleApplication::readShaderCode(const std::string &name) {
+  ShaderCode code;
+  std::string directory = options.shaderDirectory;
+  if (directory.empty()) {
+    AssetBlob blob = assetArchive.find(name);
+    if (blob.data != nullptr) {
+      code.view = static_cast<const uint32_t *>(blob.data);
+      code.size = blob.size;
+      return code;
+    }
+    EmbeddedShader embedded = findEmbeddedShader(name);
+    if (embedded.code != nullptr) {
+      code.view = embedded.code;
+      code.size = embedded.size;
+      return code;
+    }
+
+    // builds outside CMake embed nothing
+    directory = "shaders";
+  }
+
+  // copy loose files into words, a char buffer has no alignment guarantee
+  auto bytes = readFile(directory + "/" + name);
+  code.words.resize((bytes.size() + 3) / 4);
+  std::memcpy(code.words.data(), bytes.data(), bytes.size());
+  code.size = bytes.size();
+  return code;
+}
+
+// Creates a shader module from the SPIR-V file name, using the code loaded
+// by preloadShaders() during startup and reading it afresh afterwards.
+// ~Returns: the new shader module.
+VkShaderModule
+HelloTriangleApplication::loadShaderModule(const std::string &name) {
+  auto preloaded = preloadedShaders.find(name);
+  if (preloaded != preloadedShaders.end()) {
+    return createShaderModule(preloaded->second.data(),
+                              preloaded->second.size);
+  }
+  ShaderCode code = readShaderCode(name);
+  return createShaderModule(code.data(), code.size);
+}
+
+// Creates and returns a shader module from size bytes of SPIR-V at code.
 VkShaderModule
-HelloTriangleApplication::createShaderModule(const std::vector<char> &code) {
+HelloTriangleApplication::createShaderModule(const uint32_t *code,
+                                             size_t size) {
   // configure shader module
   VkShaderModuleCreateInfo createInfo = {};
   createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  createInfo.codeSize = code.size();
-  createInfo.pCode = reinterpret_cast<const uint32_t *>(code.data());
+  createInfo.codeSize = size;
+  createInfo.pCode = code;
 
   // create shader module
   VkShaderModule shaderModule;
@@ -900,6 +2104,11 @@ void HelloTriangleApplication::createRenderPass() {
   colorAttachment.finalLayout =
       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // images will be presented from the swap
                                        // chain
+  if (options.headless) {
+    colorAttachment.finalLayout =
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; // headless images are only ever
+                                              // read back
+  }
 
   // configure attachment reference
   VkAttachmentReference colorAttachmentRef = {};
@@ -922,6 +2131,18 @@ void HelloTriangleApplication::createRenderPass() {
   dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT |
                              VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+  // headless images are copied out after the render pass, so the final
+  // layout transition has to complete before the transfer reads them
+  VkSubpassDependency readbackDependency = {};
+  readbackDependency.srcSubpass = 0;
+  readbackDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+  readbackDependency.srcStageMask =
+      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  readbackDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+  readbackDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+  readbackDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+  VkSubpassDependency dependencies[] = {dependency, readbackDependency};
+
   // configure render pass
   VkRenderPassCreateInfo renderPassInfo = {};
   renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -929,8 +2150,8 @@ void HelloTriangleApplication::createRenderPass() {
   renderPassInfo.pAttachments = &colorAttachment;
   renderPassInfo.subpassCount = 1;
   renderPassInfo.pSubpasses = &subpass;
-  renderPassInfo.dependencyCount = 1;
-  renderPassInfo.pDependencies = &dependency;
+  renderPassInfo.dependencyCount = options.headless ? 2 : 1;
+  renderPassInfo.pDependencies = dependencies;
 
   // create render pass
   if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) !=
@@ -962,82 +2183,818 @@ void HelloTriangleApplication::createFrameBuffers() {
   }
 }
 
-// Creates command pools to manage the command buffers for drawing objects on
-// the screen.
-void HelloTriangleApplication::createCommandPool() {
+// Creates one command pool per frame in flight. Pools are transient and
+// reset in bulk once their frame's fence signals, which is cheaper than
+// resetting or freeing individual command buffers.
+void HelloTriangleApplication::createCommandPools() {
   QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
 
   VkCommandPoolCreateInfo poolInfo = {};
   poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
   poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
-  poolInfo.flags = 0;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-  if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) !=
-      VK_SUCCESS) {
-    throw std::runtime_error("failed to create command pool!");
+  commandPools.resize(framesInFlight);
+  for (size_t i = 0; i < commandPools.size(); i++) {
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPools[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create command pool!");
+    }
   }
 }
 
-// Creates command buffers which are commands to draw on the screen.
+// Allocates one primary command buffer from each frame's command pool. The
+// buffers are re-recorded every frame by recordCommandBuffer().
 void HelloTriangleApplication::createCommandBuffers() {
-  commandBuffers.resize(swapChainFrameBuffers.size());
-
-  // allocate command buffers
-  VkCommandBufferAllocateInfo allocInfo = {};
-  allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocInfo.commandPool = commandPool;
-  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-  allocInfo.commandBufferCount = (uint32_t)commandBuffers.size();
-  if (vkAllocateCommandBuffers(device, &allocInfo, commandBuffers.data()) !=
+  commandBuffers.resize(commandPools.size());
+
+  for (size_t i = 0; i < commandBuffers.size(); i++) {
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = commandPools[i];
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffers[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+  }
+}
+
+// Builds the list of draws recorded every frame. Every draw is the same
+// triangle, or the whole mesh when one is loaded; the count exists to put
+// load on command recording.
+void HelloTriangleApplication::createDrawList() {
+  // with GPU culling the draws are generated on the GPU, a single entry
+  // stands for the indirect draws
+  if (options.gpuCulling) {
+    drawList.assign(1, DrawCommand{3, 0, 0, 0});
+    return;
+  }
+
+  if (options.instanceCount == 0) {
+    drawList.assign(std::max(options.drawCount, 1u), DrawCommand{3, 1, 0, 0});
+    return;
+  }
+
+  // the instanced path covers the whole population with a few large draws,
+  // which still gives the recorder slices to spread across threads
+  drawList.clear();
+  for (uint32_t first = 0; first < options.instanceCount;
+       first += INSTANCES_PER_DRAW) {
+    uint32_t count =
+        std::min(INSTANCES_PER_DRAW, options.instanceCount - first);
+    drawList.push_back(DrawCommand{3, count, 0, first});
+  }
+}
+
+// Creates the descriptor set layouts through the layout cache: the frame
+// uniforms every graphics pipeline reads, and the instance and cull
+// buffers when those paths are enabled.
+void HelloTriangleApplication::createDescriptorSetLayout() {
+  descriptorLayouts.init(device);
+
+  VkDescriptorSetLayoutBinding frameBinding = {};
+  frameBinding.binding = 0;
+  frameBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  frameBinding.descriptorCount = 1;
+  frameBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  frameSetLayout = descriptorLayouts.get({frameBinding});
+
+  if (options.instanceCount == 0) {
+    return;
+  }
+
+  if (options.gpuCulling) {
+    std::vector<VkDescriptorSetLayoutBinding> cullBindings(3);
+    for (uint32_t i = 0; i < 3; i++) {
+      cullBindings[i].binding = i;
+      cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+      cullBindings[i].descriptorCount = 1;
+      cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+    cullDescriptorSetLayout = descriptorLayouts.get(cullBindings);
+  }
+
+  VkDescriptorSetLayoutBinding instancesBinding = {};
+  instancesBinding.binding = 0;
+  instancesBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  instancesBinding.descriptorCount = 1;
+  instancesBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  descriptorSetLayout = descriptorLayouts.get({instancesBinding});
+}
+
+// Creates the instance buffer with a region per frame in flight, and the
+// cull pass's outputs when culling on the GPU.
+void HelloTriangleApplication::createInstanceBuffer() {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  instanceBuffer.init(device, &allocator, options.instanceCount,
+                      framesInFlight,
+                      properties.limits.minStorageBufferOffsetAlignment);
+  if (options.gpuCulling) {
+    cullBuffers.init(device, &allocator, options.instanceCount,
+                     framesInFlight,
+                     properties.limits.minStorageBufferOffsetAlignment);
+  }
+}
+
+// Creates the index buffer of the indirect draws and queues its upload.
+// Indirect draws are skipped until the upload has completed.
+void HelloTriangleApplication::createIndexBuffer() {
+  const uint16_t indices[] = {0, 1, 2};
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = sizeof(indices);
+  bufferInfo.usage =
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &indexBuffer) !=
       VK_SUCCESS) {
-    throw std::runtime_error("failed to allocate command buffers!");
+    throw std::runtime_error("failed to create index buffer!");
   }
 
-  // begin recording a command buffer
-  for (size_t i = 0; i < commandBuffers.size(); i++) {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    beginInfo.pInheritanceInfo = nullptr;
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, indexBuffer, &memRequirements);
+  indexBufferMemory = allocator.allocate(
+      memRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+      ALLOCATION_KIND_LINEAR);
+  vkBindBufferMemory(device, indexBuffer, indexBufferMemory.memory,
+                     indexBufferMemory.offset);
+
+  const char *bytes = reinterpret_cast<const char *>(indices);
+  indexUpload = uploadQueue.upload(
+      indexBuffer, 0, std::vector<char>(bytes, bytes + sizeof(indices)));
+}
+
+// Takes the mesh from the loader once it is ready, creates its vertex and
+// index buffers and queues their uploads. The upload queue streams them in
+// over as many frames as its budget needs; the mesh is drawn once the last
+// upload has completed.
+void HelloTriangleApplication::receiveMesh() {
+  MeshUpload mesh;
+  if (!meshLoader.poll(&mesh)) {
+    return;
+  }
 
-    if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS) {
-      throw std::runtime_error("failed to begin recording command buffer!");
+  auto createBuffer = [this](VkDeviceSize size, VkBufferUsageFlags usage,
+                             VkBuffer *buffer, MemoryAllocation *memory) {
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, buffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create mesh buffer!");
     }
 
-    // start a render pass
-    VkRenderPassBeginInfo renderPassInfo = {};
-    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    renderPassInfo.renderPass = renderPass;
-    renderPassInfo.framebuffer = swapChainFrameBuffers[i];
-    renderPassInfo.renderArea.offset = {0, 0};
-    renderPassInfo.renderArea.extent = swapChainExtent;
-    VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
-    renderPassInfo.clearValueCount = 1;
-    renderPassInfo.pClearValues = &clearColor;
-    vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo,
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, *buffer, &memRequirements);
+    *memory = allocator.allocate(memRequirements,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                 ALLOCATION_KIND_LINEAR);
+    vkBindBufferMemory(device, *buffer, memory->memory, memory->offset);
+  };
+  createBuffer(mesh.vertexData.size(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+               &meshVertexBuffer, &meshVertexBufferMemory);
+  createBuffer(mesh.indexData.size(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+               &meshIndexBuffer, &meshIndexBufferMemory);
+  uploadQueue.upload(meshVertexBuffer, 0, std::move(mesh.vertexData));
+  meshUpload =
+      uploadQueue.upload(meshIndexBuffer, 0, std::move(mesh.indexData));
+  meshIndexCount = mesh.indexCount;
+
+  // center the bounds on the origin and fit their bounding sphere into
+  // most of the viewport
+  Vec3 boundsMin = vec3(mesh.boundsMin[0], mesh.boundsMin[1],
+                        mesh.boundsMin[2]);
+  Vec3 boundsMax = vec3(mesh.boundsMax[0], mesh.boundsMax[1],
+                        mesh.boundsMax[2]);
+  meshCenter = (boundsMin + boundsMax) * 0.5f;
+  float radius = length(boundsMax - boundsMin) * 0.5f;
+  meshScale = radius > 0.0f ? 0.8f / radius : 1.0f;
+
+  std::cout << "loaded mesh " << options.meshPath << ": " << mesh.vertexCount
+            << " vertices, " << mesh.indexCount / 3 << " triangles in "
+            << mesh.milliseconds << " ms" << std::endl;
+}
+
+// Spins the mesh about its vertical axis and maps it into clip space:
+// y flipped to point up and z turned into depth.
+void HelloTriangleApplication::updateMeshTransform() {
+  float seconds = std::chrono::duration<float>(
+                      std::chrono::steady_clock::now() - uniformStartTime)
+                      .count();
+  Quat spin = quatFromAxisAngle(vec3(0.0f, 1.0f, 0.0f), seconds * 0.5f);
+  Mat4 center = mat4Compose(meshCenter * -1.0f, quatIdentity(),
+                            vec3(1.0f, 1.0f, 1.0f));
+  Mat4 model = mat4Compose(vec3(0.0f, 0.0f, 0.0f), spin,
+                           vec3(meshScale, meshScale, meshScale)) *
+               center;
+
+  Mat4 clip = mat4Identity();
+  clip.columns[1].y = -1.0f;
+  clip.columns[2].z = -0.5f;
+  clip.columns[3].z = 0.5f;
+  meshTransform = clip * model;
+}
+
+// Creates the descriptor allocator and the uniform ring with its single
+// dynamic descriptor, shared by every frame in flight.
+void HelloTriangleApplication::createFrameUniforms() {
+  descriptorAllocator.init(device, framesInFlight);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  uniformRing.init(device, &allocator, framesInFlight,
+                   properties.limits.minUniformBufferOffsetAlignment);
+  frameUniformOffset = 0;
+
+  frameDescriptorSet = descriptorAllocator.allocate(frameSetLayout);
+  VkDescriptorBufferInfo bufferInfo =
+      uniformRing.descriptorInfo(sizeof(FrameUniforms));
+  VkWriteDescriptorSet descriptorWrite = {};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = frameDescriptorSet;
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+// Writes this frame's constants into its region of the uniform ring. The
+// frame's previous submission has completed, so the region is free.
+void HelloTriangleApplication::updateFrameUniforms() {
+  auto now = std::chrono::steady_clock::now();
+  FrameUniforms uniforms = {};
+
+  // no camera moves yet, the identity keeps clip space coordinates
+  uniforms.viewProjection[0] = 1.0f;
+  uniforms.viewProjection[5] = 1.0f;
+  uniforms.viewProjection[10] = 1.0f;
+  uniforms.viewProjection[15] = 1.0f;
+  uniforms.time =
+      std::chrono::duration<float>(now - uniformStartTime).count();
+  uniforms.deltaTime =
+      framesRendered == 0
+          ? 0.0f
+          : std::chrono::duration<float>(now - lastUniformTime).count();
+  uniforms.extent[0] = static_cast<float>(swapChainExtent.width);
+  uniforms.extent[1] = static_cast<float>(swapChainExtent.height);
+  lastUniformTime = now;
+
+  uniformRing.beginFrame(static_cast<uint32_t>(currentFrame));
+  frameUniformOffset = uniformRing.push(&uniforms, sizeof(uniforms));
+}
+
+// Allocates the descriptor sets of every frame in flight, so each has
+// them before its first frame.
+void HelloTriangleApplication::createDescriptorSets() {
+  descriptorSets.assign(framesInFlight, VK_NULL_HANDLE);
+  if (options.gpuCulling) {
+    cullDescriptorSets.assign(framesInFlight, VK_NULL_HANDLE);
+  }
+  for (uint32_t i = 0; i < framesInFlight; i++) {
+    allocateFrameDescriptorSets(i);
+  }
+}
+
+// Allocates a frame's descriptor sets from its own pools, which
+// resetFrame() recycles, pointing at the frame's region of the instance
+// buffer, or of the visible instances when culling on the GPU. The cull
+// pass gets its own set.
+void HelloTriangleApplication::allocateFrameDescriptorSets(uint32_t frame) {
+  descriptorSets[frame] =
+      descriptorAllocator.allocateFrame(frame, descriptorSetLayout);
+  VkDescriptorBufferInfo bufferInfo =
+      options.gpuCulling ? cullBuffers.visibleInfo(frame)
+                         : instanceBuffer.descriptorInfo(frame);
+  VkWriteDescriptorSet descriptorWrite = {};
+  descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  descriptorWrite.dstSet = descriptorSets[frame];
+  descriptorWrite.dstBinding = 0;
+  descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  descriptorWrite.descriptorCount = 1;
+  descriptorWrite.pBufferInfo = &bufferInfo;
+  vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+
+  if (!options.gpuCulling) {
+    return;
+  }
+
+  cullDescriptorSets[frame] =
+      descriptorAllocator.allocateFrame(frame, cullDescriptorSetLayout);
+  VkDescriptorBufferInfo bufferInfos[3] = {
+      instanceBuffer.descriptorInfo(frame), cullBuffers.visibleInfo(frame),
+      cullBuffers.drawInfo(frame)};
+  VkWriteDescriptorSet descriptorWrites[3] = {};
+  for (uint32_t binding = 0; binding < 3; binding++) {
+    descriptorWrites[binding].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    descriptorWrites[binding].dstSet = cullDescriptorSets[frame];
+    descriptorWrites[binding].dstBinding = binding;
+    descriptorWrites[binding].descriptorType =
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptorWrites[binding].descriptorCount = 1;
+    descriptorWrites[binding].pBufferInfo = &bufferInfos[binding];
+  }
+  vkUpdateDescriptorSets(device, 3, descriptorWrites, 0, nullptr);
+}
+
+// Builds the scene drawn by the instanced path, a grid of triangles.
+void HelloTriangleApplication::createScene() {
+  uint32_t count = options.instanceCount;
+  uint32_t columns =
+      static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+  float cellSize = 2.0f / columns;
+  float scale = cellSize * 0.9f;
+
+  scene = SceneStore();
+  scene.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    float column = static_cast<float>(i % columns);
+    float row = static_cast<float>(i / columns);
+    scene.add(
+        SCENE_NO_PARENT,
+        vec3(-1.0f + (column + 0.5f) * cellSize,
+             -1.0f + (row + 0.5f) * cellSize, 0.0f),
+        quatIdentity(), vec3(scale, scale, 1.0f),
+        vec4(column / columns, row / columns, 1.0f - column / columns, 1.0f));
+  }
+}
+
+// Writes this frame's instance transforms: the moving part of the grid
+// spins, each triangle at its own rate, and only transforms that changed
+// since this frame's region was last written are copied into it. Animation
+// advances per frame rather than with wall time so benchmark runs do
+// identical work.
+void HelloTriangleApplication::updateInstances() {
+  PROFILE_SCOPE("updateInstances");
+  uint32_t count = instanceBuffer.instanceCount();
+  uint32_t moving = static_cast<uint32_t>(count * options.movingInstances);
+  float time = framesRendered * 0.01f;
+  Vec3 axis = vec3(0.0f, 0.0f, 1.0f);
+
+  // ids are handed out in order, so object i is the grid's triangle i
+  for (uint32_t i = 0; i < moving; i++) {
+    float angle = time * (1.0f + (i % 7) * 0.25f);
+    scene.setRotation(i, quatFromAxisAngle(axis, angle));
+  }
+  scene.propagate(*jobs);
+
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  scene.writeInstances(instanceBuffer.frameData(frame), count, frame, *jobs);
+}
+
+// Starts the job system's worker threads.
+void HelloTriangleApplication::createJobSystem(uint32_t workerCount) {
+  // a mesh still loading runs on the job system being replaced
+  meshLoader.stop();
+  jobs = std::make_unique<JobSystem>(workerCount);
+}
+
+// Prepares to record up to sliceCount secondary command buffers in
+// parallel on the job system.
+void HelloTriangleApplication::createCommandRecorder(uint32_t sliceCount) {
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+  commandRecorder.init(device, queueFamilyIndices.graphicsFamily.value(),
+                       jobs.get(), sliceCount, framesInFlight);
+}
+
+// Records the commands to draw a frame into the given swap chain image.
+void HelloTriangleApplication::recordCommandBuffer(
+    VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+  // begin recording the command buffer, it is submitted exactly once
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  beginInfo.pInheritanceInfo = nullptr;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+
+  // time the render pass on the GPU
+  gpuTimer.begin(commandBuffer, static_cast<uint32_t>(currentFrame));
+
+  // take ownership of buffers uploaded on the transfer queue
+  uploadQueue.recordAcquireBarriers(commandBuffer);
+
+  // take ownership of the cull pass's outputs from the compute queue
+  if (options.gpuCulling) {
+    asyncCompute.recordAcquireBarriers(commandBuffer,
+                                       static_cast<uint32_t>(currentFrame));
+  }
+
+  // start a render pass
+  VkRenderPassBeginInfo renderPassInfo = {};
+  renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+  renderPassInfo.renderPass = renderPass;
+  renderPassInfo.framebuffer = swapChainFrameBuffers[imageIndex];
+  renderPassInfo.renderArea.offset = {0, 0};
+  renderPassInfo.renderArea.extent = swapChainExtent;
+  VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+  renderPassInfo.clearValueCount = 1;
+  renderPassInfo.pClearValues = &clearColor;
+
+  if (commandRecorder.isEnabled()) {
+    // record the draw list on worker threads and execute the resulting
+    // secondary command buffers inside the render pass
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
+                         VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = swapChainFrameBuffers[imageIndex];
+
+    const std::vector<VkCommandBuffer> &secondaryBuffers =
+        commandRecorder.record(
+            static_cast<uint32_t>(currentFrame), inheritanceInfo,
+            drawList.size(),
+            [this](VkCommandBuffer secondary, size_t begin, size_t end) {
+              recordDraws(secondary, begin, end);
+            });
+    vkCmdExecuteCommands(commandBuffer,
+                         static_cast<uint32_t>(secondaryBuffers.size()),
+                         secondaryBuffers.data());
+  } else {
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo,
                          VK_SUBPASS_CONTENTS_INLINE);
+    recordDraws(commandBuffer, 0, drawList.size());
+  }
 
-    // bind to graphics pipeline
-    vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
-                      graphicsPipeline);
+  // end the render pass
+  vkCmdEndRenderPass(commandBuffer);
+  gpuTimer.end(commandBuffer, static_cast<uint32_t>(currentFrame));
+
+  // copy the rendered image into host visible memory
+  if (!readbackBuffers.empty()) {
+    VkBufferImageCopy region = {};
+    region.bufferOffset = 0;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageOffset = {0, 0, 0};
+    region.imageExtent = {swapChainExtent.width, swapChainExtent.height, 1};
+    vkCmdCopyImageToBuffer(commandBuffer, swapChainImages[imageIndex],
+                           VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                           readbackBuffers[imageIndex], 1, &region);
+
+    // make the copy visible to the host once the frame's fence signals
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = readbackBuffers[imageIndex];
+    barrier.offset = 0;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1,
+                         &barrier, 0, nullptr);
+  }
 
-    // draw a triangle
-    vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
+  // close the command buffer
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+}
+
+// Records a range of the draw list. Used for inline recording into the
+// primary command buffer as well as for each secondary command buffer, which
+// do not inherit any state and so bind everything themselves.
+void HelloTriangleApplication::recordDraws(VkCommandBuffer commandBuffer,
+                                           size_t begin, size_t end) {
+  // bind to graphics pipeline
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    graphicsPipeline);
+  VkDescriptorSet sets[2] = {frameDescriptorSet, VK_NULL_HANDLE};
+  uint32_t setCount = 1;
+  if (options.instanceCount > 0) {
+    sets[setCount++] = descriptorSets[currentFrame];
+  }
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipelineLayout, 0, setCount, sets, 1,
+                          &frameUniformOffset);
 
-    // end the render pass
-    vkCmdEndRenderPass(commandBuffers[i]);
+  // configure viewport
+  VkViewport viewport = {};
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = (float)swapChainExtent.width;
+  viewport.height = (float)swapChainExtent.height;
+  viewport.minDepth = 0.0f;
+  viewport.maxDepth = 1.0f;
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-    // close the command buffer
-    if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS) {
-      throw std::runtime_error("failed to record command buffer!");
+  // configure scissor rectangle (only pixels inside will be rendered)
+  VkRect2D scissor = {};
+  scissor.offset = {0, 0};
+  scissor.extent = swapChainExtent;
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  // issue the draws, or the draws generated by the cull pass
+  if (options.gpuCulling) {
+    if (begin < end) {
+      recordIndirectDraws(commandBuffer);
     }
+    return;
+  }
+  if (!options.meshPath.empty()) {
+    recordMeshDraws(commandBuffer, begin, end);
+    return;
+  }
+  for (size_t i = begin; i < end; i++) {
+    const DrawCommand &draw = drawList[i];
+    vkCmdDraw(commandBuffer, draw.vertexCount, draw.instanceCount,
+              draw.firstVertex, draw.firstInstance);
+  }
+}
+
+// Records the cull pass: clears the frame's counters, compacts the visible
+// instances, then turns the visible count into draw commands. Handing the
+// results to the graphics queue is left to submitCulling().
+void HelloTriangleApplication::recordCulling(VkCommandBuffer commandBuffer) {
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  vkCmdFillBuffer(commandBuffer, cullBuffers.drawBuffer(),
+                  cullBuffers.countersOffset(frame), sizeof(CullCounters), 0);
+
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  // the instanced scene is placed directly in clip space, so the frustum is
+  // the clip volume
+  const float viewProjection[16] = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f,
+                                    0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
+                                    0.0f, 0.0f, 0.0f, 1.0f};
+  CullPushConstants constants = {};
+  extractFrustumPlanes(viewProjection, constants.planes);
+  constants.instanceCount = instanceBuffer.instanceCount();
+  constants.maxDrawCount = cullBuffers.maxDrawCount();
+
+  // one invocation per item, capped at the device's dispatch limit
+  auto groupCount = [this](uint32_t items) {
+    return std::min((items + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE,
+                    maxCullGroupCount);
+  };
+
+  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                    cullPipeline);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          cullPipelineLayout, 0, 1, &cullDescriptorSets[frame],
+                          0, nullptr);
+
+  constants.pass = CULL_PASS_INSTANCES;
+  vkCmdPushConstants(commandBuffer, cullPipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(commandBuffer, groupCount(constants.instanceCount), 1, 1);
+
+  // the command pass reads the final visible count
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier,
+                       0, nullptr, 0, nullptr);
+
+  constants.pass = CULL_PASS_COMMANDS;
+  vkCmdPushConstants(commandBuffer, cullPipelineLayout,
+                     VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                     &constants);
+  vkCmdDispatch(commandBuffer, groupCount(constants.maxDrawCount), 1, 1);
+}
+
+// Records and submits this frame's cull pass on the compute queue, so it can
+// overlap with the previous frame's rendering.
+// ~Returns: semaphore the frame's graphics submit must wait on at waitStages,
+// for waitValue if it is a timeline semaphore.
+VkSemaphore
+HelloTriangleApplication::submitCulling(VkPipelineStageFlags *waitStages,
+                                        uint64_t *waitValue) {
+  PROFILE_SCOPE("submitCulling");
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  VkCommandBuffer commandBuffer = asyncCompute.begin(frame);
+  recordCulling(commandBuffer);
+
+  asyncCompute.releaseBuffer(frame, cullBuffers.visibleInfo(frame),
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_ACCESS_SHADER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                             VK_ACCESS_SHADER_READ_BIT);
+  asyncCompute.releaseBuffer(frame, cullBuffers.drawInfo(frame),
+                             VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             VK_ACCESS_SHADER_WRITE_BIT,
+                             VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                             VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+  return asyncCompute.submit(frame, waitStages, waitValue);
+}
+
+// Records the draws generated by this frame's cull pass. With
+// VK_KHR_draw_indirect_count the GPU also decides how many draws run;
+// otherwise every command is issued and the empty ones cost next to nothing.
+void HelloTriangleApplication::recordIndirectDraws(
+    VkCommandBuffer commandBuffer) {
+  // nothing to draw with until the indices have been uploaded
+  if (!uploadQueue.isComplete(indexUpload)) {
+    return;
+  }
+
+  uint32_t frame = static_cast<uint32_t>(currentFrame);
+  VkBuffer drawBuffer = cullBuffers.drawBuffer();
+  VkDeviceSize offset = cullBuffers.commandsOffset(frame);
+  uint32_t maxDrawCount = cullBuffers.maxDrawCount();
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+  vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+  if (cmdDrawIndexedIndirectCount) {
+    cmdDrawIndexedIndirectCount(commandBuffer, drawBuffer, offset, drawBuffer,
+                                cullBuffers.countersOffset(frame),
+                                maxDrawCount, stride);
+  } else if (multiDrawIndirect) {
+    vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset, maxDrawCount,
+                             stride);
+  } else {
+    for (uint32_t i = 0; i < maxDrawCount; i++) {
+      vkCmdDrawIndexedIndirect(commandBuffer, drawBuffer, offset + i * stride,
+                               1, stride);
+    }
+  }
+}
+
+// Records a range of the draw list against the mesh's buffers. Nothing is
+// drawn until the mesh has been loaded and its uploads have completed.
+void HelloTriangleApplication::recordMeshDraws(VkCommandBuffer commandBuffer,
+                                               size_t begin, size_t end) {
+  if (meshIndexCount == 0 || !uploadQueue.isComplete(meshUpload)) {
+    return;
+  }
+
+  VkDeviceSize offset = 0;
+  vkCmdBindVertexBuffers(commandBuffer, 0, 1, &meshVertexBuffer, &offset);
+  vkCmdBindIndexBuffer(commandBuffer, meshIndexBuffer, 0,
+                       VK_INDEX_TYPE_UINT32);
+  vkCmdPushConstants(commandBuffer, pipelineLayout,
+                     VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(meshTransform),
+                     &meshTransform);
+  for (size_t i = begin; i < end; i++) {
+    const DrawCommand &draw = drawList[i];
+    vkCmdDrawIndexed(commandBuffer, meshIndexCount, draw.instanceCount, 0, 0,
+                     draw.firstInstance);
+  }
+}
+
+// Measures how long recording a frame's command buffer takes without the
+// recorder and with an increasing number of recording threads. Each count
+// gets a job system with that many threads, the main thread included, and
+// one slice per thread.
+void HelloTriangleApplication::benchmarkRecording() {
+  const int iterations = 200;
+  uint32_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<uint32_t> threadCounts = {0};
+  for (uint32_t count = 1; count <= maxThreads; count *= 2) {
+    threadCounts.push_back(count);
+  }
+  if (threadCounts.back() != maxThreads) {
+    threadCounts.push_back(maxThreads);
+  }
+
+  std::cout << "recording " << drawList.size() << " draws, " << iterations
+            << " iterations" << std::endl;
+  std::cout << "threads\tms/frame" << std::endl;
+
+  vkDeviceWaitIdle(device);
+  for (uint32_t threadCount : threadCounts) {
+    commandRecorder.destroy();
+    if (threadCount > 0) {
+      createJobSystem(threadCount - 1);
+      createCommandRecorder(threadCount);
+    }
+
+    double totalMilliseconds = 0.0;
+    for (int i = 0; i < iterations; i++) {
+      vkResetCommandPool(device, commandPools[currentFrame], 0);
+      if (commandRecorder.isEnabled()) {
+        commandRecorder.resetFrame(static_cast<uint32_t>(currentFrame));
+      }
+
+      auto startTime = std::chrono::steady_clock::now();
+      recordCommandBuffer(commandBuffers[currentFrame], 0);
+      totalMilliseconds += std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - startTime)
+                               .count();
+    }
+
+    std::cout << (threadCount == 0 ? std::string("inline")
+                                   : std::to_string(threadCount))
+              << "\t" << totalMilliseconds / iterations << std::endl;
+  }
+}
+
+// Creates the timestamp queries used to time frames on the GPU.
+void HelloTriangleApplication::createGpuTimer() {
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+  gpuTimer.init(device, physicalDevice,
+                queueFamilyIndices.graphicsFamily.value(),
+                framesInFlight);
+}
+
+// Prints statistics for the GPU frame times currently in the history.
+void HelloTriangleApplication::dumpFrameStats() {
+  FrameTimeStats stats = gpuFrameStats();
+  if (stats.count == 0) {
+    return;
+  }
+  std::cout << "gpu frame time over " << stats.count
+            << " frames: min " << stats.min << " ms, avg " << stats.avg
+            << " ms, p99 " << stats.p99 << " ms" << std::endl;
+}
+
+// Creates the allocator that buffers and images take their memory from.
+void HelloTriangleApplication::createDeviceAllocator() {
+  VkPhysicalDeviceMemoryProperties memProperties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+  memoryBackend = std::make_unique<VulkanMemoryBackend>(device);
+  allocator.init(memoryBackend.get(), memProperties, properties.limits);
+}
+
+// Creates the staging ring and batches used to upload buffer data, on the
+// transfer queue if the device has a dedicated one.
+void HelloTriangleApplication::createUploadQueue() {
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+  uploadQueue.init(device, &allocator,
+                   queueFamilyIndices.graphicsFamily.value(),
+                   queueFamilyIndices.transferFamily.value(), transferQueue,
+                   timelineEnabled);
+  std::cout << "uploads use the "
+            << (uploadQueue.usesTransferQueue() ? "dedicated transfer"
+                                                : "graphics")
+            << " queue" << std::endl;
+}
+
+// Creates the per-frame command buffers and semaphores of compute work, on
+// the compute queue if the device has a dedicated one.
+void HelloTriangleApplication::createAsyncCompute() {
+  QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
+  asyncCompute.init(device, queueFamilyIndices.graphicsFamily.value(),
+                    queueFamilyIndices.computeFamily.value(), computeQueue,
+                    framesInFlight, timelineEnabled);
+}
+
+// Prints how much device memory the allocator holds and how scattered its
+// free space is.
+void HelloTriangleApplication::dumpMemoryStats() {
+  AllocationStats stats = allocator.stats();
+  if (stats.blockCount == 0) {
+    return;
+  }
+  std::cout << "device memory: " << stats.allocationCount << " allocations in "
+            << stats.blockCount << " blocks, " << (stats.usedBytes >> 10)
+            << " of " << (stats.blockBytes >> 10) << " KiB used, "
+            << stats.freeRegionCount << " free regions, fragmentation "
+            << stats.fragmentation() << std::endl;
+}
+
+// Writes the CPU spans recorded so far as a Chrome trace.
+void HelloTriangleApplication::exportTrace() {
+  if (Profiler::exportChromeTrace(options.tracePath)) {
+    std::cout << "wrote trace to " << options.tracePath << std::endl;
+  } else {
+    std::cerr << "failed to write trace to " << options.tracePath << std::endl;
   }
 }
 
+// Creates the binary semaphores the swap chain waits on and signals, and
+// either a fence per frame in flight or the graphics timeline semaphore.
 void HelloTriangleApplication::createSyncObjects() {
-  imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-  inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+  imageAvailableSemaphores.resize(framesInFlight);
+  renderFinishedSemaphores.resize(framesInFlight);
+
+  // a frame that has not been submitted yet waits for value 0, which the
+  // semaphore starts at
+  if (timelineEnabled) {
+    graphicsTimeline.init(device);
+    frameTimelineValues.assign(framesInFlight, 0);
+  } else {
+    inFlightFences.resize(framesInFlight);
+  }
 
   VkSemaphoreCreateInfo semaphoreInfo = {};
   semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -1047,85 +3004,208 @@ void HelloTriangleApplication::createSyncObjects() {
   fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
 
   // create semaphores
-  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+  for (size_t i = 0; i < framesInFlight; i++) {
     if (vkCreateSemaphore(device, &semaphoreInfo, nullptr,
                           &imageAvailableSemaphores[i]) != VK_SUCCESS ||
         vkCreateSemaphore(device, &semaphoreInfo, nullptr,
                           &renderFinishedSemaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) !=
-            VK_SUCCESS) {
+        (!timelineEnabled &&
+         vkCreateFence(device, &fenceInfo, nullptr, &inFlightFences[i]) !=
+             VK_SUCCESS)) {
       throw std::runtime_error(
           "failed to create synchronization objects for a frame!");
     }
   }
 }
 
+// Blocks until the GPU has finished the current frame's previous
+// submission, so everything kept for the frame in flight can be reused.
+void HelloTriangleApplication::waitForFrame() {
+  PROFILE_SCOPE("waitForFrame");
+  if (timelineEnabled) {
+    graphicsTimeline.wait(frameTimelineValues[currentFrame]);
+  } else {
+    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE,
+                    std::numeric_limits<uint64_t>::max());
+  }
+}
+
 void HelloTriangleApplication::drawFrame() {
-  vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE,
-                  std::numeric_limits<uint64_t>::max());
+  PROFILE_SCOPE("drawFrame");
+  waitForFrame();
 
-  uint32_t imageIndex;
-  VkResult result = vkAcquireNextImageKHR(
-      device, swapChain, std::numeric_limits<uint64_t>::max(),
-      imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+  // the frame's timestamps are final now that its submission has completed
+  gpuTimer.collect(static_cast<uint32_t>(currentFrame));
 
-  // if khr is out of data, recreate swap chain
-  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
-    recreateSwapChain();
-    return;
-  } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-    throw std::runtime_error("failed to acquire swap chain image!");
+  // frame boundary, nothing of this frame is recorded yet
+  if (options.watchShaders) {
+    applyShaderReloads();
+  }
+  // the frame's descriptor sets are recycled with its pools
+  descriptorAllocator.resetFrame(static_cast<uint32_t>(currentFrame));
+  if (options.instanceCount > 0) {
+    allocateFrameDescriptorSets(static_cast<uint32_t>(currentFrame));
+  }
+  updateFrameUniforms();
+  if (meshIndexCount > 0) {
+    updateMeshTransform();
   }
 
-  // configure frame submission info
+  // headless frames render into the image owned by the frame in flight,
+  // windowed frames render into the next available swap chain image
+  uint32_t imageIndex = static_cast<uint32_t>(currentFrame);
+  if (!options.headless) {
+    VkResult result;
+    {
+      PROFILE_SCOPE("vkAcquireNextImageKHR");
+      result = vkAcquireNextImageKHR(
+          device, swapChain, std::numeric_limits<uint64_t>::max(),
+          imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
+
+    // if khr is out of data, recreate swap chain
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      recreateSwapChain();
+      return;
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      throw std::runtime_error("failed to acquire swap chain image!");
+    }
+  }
+
+  // the frame's region of the instance buffer is no longer read by the GPU
+  if (options.instanceCount > 0) {
+    updateInstances();
+  }
+
+  // retire finished uploads and start the next batch, neither waits
+  if (meshLoader.isPending()) {
+    receiveMesh();
+  }
+  uploadQueue.collect();
+  uint64_t uploadWaitValue = 0;
+  VkSemaphore uploadSemaphore = uploadQueue.flush(&uploadWaitValue);
+
+  // cull ahead of recording, the graphics submit waits for the result
+  VkSemaphore computeSemaphore = VK_NULL_HANDLE;
+  VkPipelineStageFlags computeWaitStages = 0;
+  uint64_t computeWaitValue = 0;
+  if (options.gpuCulling) {
+    computeSemaphore = submitCulling(&computeWaitStages, &computeWaitValue);
+  }
+
+  // the frame's previous submission has completed, so its pools can be reset
+  // in bulk and the frame recorded from scratch
+  {
+    PROFILE_SCOPE("recordCommandBuffer");
+    vkResetCommandPool(device, commandPools[currentFrame], 0);
+    if (commandRecorder.isEnabled()) {
+      commandRecorder.resetFrame(static_cast<uint32_t>(currentFrame));
+    }
+    recordCommandBuffer(commandBuffers[currentFrame], imageIndex);
+  }
+
+  // configure frame submission info, values only matter for timeline
+  // semaphores and are ignored for binary ones
   VkSubmitInfo submitInfo = {};
   submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-  VkPipelineStageFlags waitStages[] = {
-      VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submitInfo.waitSemaphoreCount = 1;
-  submitInfo.pWaitSemaphores = waitSemaphores;
-  submitInfo.pWaitDstStageMask = waitStages;
+  std::vector<VkSemaphore> waitSemaphores;
+  std::vector<VkPipelineStageFlags> waitStages;
+  std::vector<uint64_t> waitValues;
+  if (!options.headless) {
+    waitSemaphores.push_back(imageAvailableSemaphores[currentFrame]);
+    waitStages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    waitValues.push_back(0);
+  }
+  if (uploadSemaphore != VK_NULL_HANDLE) {
+    waitSemaphores.push_back(uploadSemaphore);
+    waitStages.push_back(UPLOAD_CONSUMER_STAGES);
+    waitValues.push_back(uploadWaitValue);
+  }
+  if (computeSemaphore != VK_NULL_HANDLE) {
+    waitSemaphores.push_back(computeSemaphore);
+    waitStages.push_back(computeWaitStages);
+    waitValues.push_back(computeWaitValue);
+  }
+  submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
   submitInfo.commandBufferCount = 1;
-  submitInfo.pCommandBuffers = &commandBuffers[imageIndex];
-  VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
-  submitInfo.signalSemaphoreCount = 1;
-  submitInfo.pSignalSemaphores = signalSemaphores;
-
-  vkResetFences(device, 1, &inFlightFences[currentFrame]);
+  submitInfo.pCommandBuffers = &commandBuffers[currentFrame];
+
+  // the swap chain waits on a binary semaphore, the CPU on the timeline
+  std::vector<VkSemaphore> signalSemaphores;
+  std::vector<uint64_t> signalValues;
+  if (!options.headless) {
+    signalSemaphores.push_back(renderFinishedSemaphores[currentFrame]);
+    signalValues.push_back(0);
+  }
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  if (timelineEnabled) {
+    frameTimelineValues[currentFrame] = graphicsTimeline.nextValue();
+    signalSemaphores.push_back(graphicsTimeline.handle());
+    signalValues.push_back(frameTimelineValues[currentFrame]);
+
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount =
+        static_cast<uint32_t>(waitValues.size());
+    timelineInfo.pWaitSemaphoreValues = waitValues.data();
+    timelineInfo.signalSemaphoreValueCount =
+        static_cast<uint32_t>(signalValues.size());
+    timelineInfo.pSignalSemaphoreValues = signalValues.data();
+    submitInfo.pNext = &timelineInfo;
+  } else {
+    vkResetFences(device, 1, &inFlightFences[currentFrame]);
+  }
+  submitInfo.signalSemaphoreCount =
+      static_cast<uint32_t>(signalSemaphores.size());
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
 
   // submit command buffer to graphics queue
-  if (vkQueueSubmit(graphicsQueue, 1, &submitInfo,
-                    inFlightFences[currentFrame]) != VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
+  {
+    PROFILE_SCOPE("vkQueueSubmit");
+    VkFence fence =
+        timelineEnabled ? VK_NULL_HANDLE : inFlightFences[currentFrame];
+    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+      throw std::runtime_error("failed to submit draw command buffer!");
+    }
   }
 
-  // configure presentation
-  VkPresentInfoKHR presentInfo = {};
-  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-  presentInfo.waitSemaphoreCount = 1;
-  presentInfo.pWaitSemaphores = signalSemaphores;
-  VkSwapchainKHR swapChains[] = {swapChain};
-  presentInfo.swapchainCount = 1;
-  presentInfo.pSwapchains = swapChains;
-  presentInfo.pImageIndices = &imageIndex;
-  presentInfo.pResults = nullptr;
-
-  // present images to window
-  vkQueuePresentKHR(presentQueue, &presentInfo);
+  if (!options.headless) {
+    // configure presentation
+    VkPresentInfoKHR presentInfo = {};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &renderFinishedSemaphores[currentFrame];
+    VkSwapchainKHR swapChains[] = {swapChain};
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = swapChains;
+    presentInfo.pImageIndices = &imageIndex;
+    presentInfo.pResults = nullptr;
+
+    // present images to window
+    VkResult result;
+    {
+      PROFILE_SCOPE("vkQueuePresentKHR");
+      result = vkQueuePresentKHR(presentQueue, &presentInfo);
+    }
 
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
-      framebufferResized) {
-    framebufferResized = false;
-    recreateSwapChain();
-  } else if (result != VK_SUCCESS) {
-    throw std::runtime_error("failed to present swap chain image!");
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+        framebufferResized) {
+      framebufferResized = false;
+      recreateSwapChain();
+    } else if (result != VK_SUCCESS) {
+      throw std::runtime_error("failed to present swap chain image!");
+    }
   }
 
   // advance frame
-  currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+  framesRendered++;
+  currentFrame = (currentFrame + 1) % framesInFlight;
 }
 
+// Recreates the swap chain after a resize. Only the swap chain, its image
+// views and framebuffers are rebuilt; the render pass and
+// graphics pipeline are kept unless the surface format changed.
 void HelloTriangleApplication::recreateSwapChain() {
   int width = 0, height = 0;
   while (width == 0 || height == 0) {
@@ -1133,41 +3213,143 @@ void HelloTriangleApplication::recreateSwapChain() {
     glfwWaitEvents();
   }
   vkDeviceWaitIdle(device);
+  destroyRetiredPipelines(true);
+
+  VkFormat previousFormat = swapChainImageFormat;
+  cleanupSwapChain();
 
+  selectImageFormat();
   createSwapChain();
   createImageViews();
-  createRenderPass();
-  createGraphicsPipeline();
+  if (swapChainImageFormat != previousFormat) {
+    // a reloaded pipeline built against the old render pass is discarded
+    std::lock_guard<std::mutex> lock(shaderReloadMutex);
+    vkDestroyPipeline(device, pendingGraphicsPipeline, nullptr);
+    pendingGraphicsPipeline = VK_NULL_HANDLE;
+    cleanupGraphicsPipeline();
+    createRenderPass();
+    createGraphicsPipeline();
+  }
   createFrameBuffers();
-  createCommandBuffers();
 }
 
+// Destroys the objects that depend on the swap chain images. The swap chain
+// itself is retired by createSwapChain() when it is recreated.
 void HelloTriangleApplication::cleanupSwapChain() {
   for (auto framebuffer : swapChainFrameBuffers) {
     vkDestroyFramebuffer(device, framebuffer, nullptr);
   }
-  vkFreeCommandBuffers(device, commandPool,
-                       static_cast<uint32_t>(commandBuffers.size()),
-                       commandBuffers.data());
+  for (auto imageView : swapChainImageViews) {
+    vkDestroyImageView(device, imageView, nullptr);
+  }
+}
+
+// Picks the presentation profile and the frames in flight it implies. The
+// frames in flight option overrides the profile's count.
+void HelloTriangleApplication::selectPresentationProfile(
+    PresentationProfileType type) {
+  presentationProfile = type;
+  framesInFlight = options.framesInFlight != 0
+                       ? options.framesInFlight
+                       : getPresentationProfile(type).framesInFlight;
+}
+
+// Switches to another presentation profile between frames. Everything sized
+// by the frames in flight or the swap chain image count is rebuilt.
+void HelloTriangleApplication::switchPresentationProfile(
+    PresentationProfileType type) {
+  vkDeviceWaitIdle(device);
+  cleanupFrameResources();
+
+  // a profile picked at runtime replaces the command line overrides
+  options.framesInFlight = 0;
+  options.presentMode.reset();
+  selectPresentationProfile(type);
+
+  recreateSwapChain();
+  createFrameResources();
+  currentFrame = 0;
+
+  std::cout << "presentation profile " << getPresentationProfile(type).name
+            << ": " << framesInFlight << " frame(s) in flight, "
+            << swapChainImages.size() << " images, "
+            << presentModeName(swapChainPresentMode) << std::endl;
+}
+
+// Creates everything kept once per frame in flight.
+void HelloTriangleApplication::createFrameResources() {
+  createCommandPools();
+  createCommandBuffers();
+  if (options.recordThreads > 0) {
+    createCommandRecorder(options.recordThreads);
+  }
+  createFrameUniforms();
+  if (options.instanceCount > 0) {
+    createInstanceBuffer();
+    createScene();
+    createDescriptorSets();
+  }
+  if (options.gpuCulling) {
+    createAsyncCompute();
+  }
+  createGpuTimer();
+  createSyncObjects();
+}
+
+// Destroys the command pools, synchronization objects, queries and instance
+// data kept per frame in flight.
+void HelloTriangleApplication::cleanupFrameResources() {
+  for (size_t i = 0; i < imageAvailableSemaphores.size(); i++) {
+    vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
+    vkDestroySemaphore(device, imageAvailableSemaphores[i], nullptr);
+  }
+  for (auto fence : inFlightFences) {
+    vkDestroyFence(device, fence, nullptr);
+  }
+  inFlightFences.clear();
+  graphicsTimeline.destroy();
+  for (auto pool : commandPools) {
+    vkDestroyCommandPool(device, pool, nullptr);
+  }
+  commandRecorder.destroy();
+  gpuTimer.destroy();
+  descriptorAllocator.destroy();
+  uniformRing.destroy();
+  instanceBuffer.destroy();
+  cullBuffers.destroy();
+  asyncCompute.destroy();
+}
+
+// Destroys the graphics pipeline and the render pass it was built against.
+void HelloTriangleApplication::cleanupGraphicsPipeline() {
   vkDestroyPipeline(device, graphicsPipeline, nullptr);
   vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
   vkDestroyRenderPass(device, renderPass, nullptr);
-  for (auto imageView : swapChainImageViews) {
-    vkDestroyImageView(device, imageView, nullptr);
+}
+
+// Destroys the headless images and their readback buffers.
+void HelloTriangleApplication::cleanupHeadlessRenderTargets() {
+  for (size_t i = 0; i < readbackBuffers.size(); i++) {
+    vkDestroyBuffer(device, readbackBuffers[i], nullptr);
+    allocator.free(readbackBufferMemory[i]);
+  }
+  for (size_t i = 0; i < swapChainImages.size(); i++) {
+    vkDestroyImage(device, swapChainImages[i], nullptr);
+    allocator.free(headlessImageMemory[i]);
   }
-  vkDestroySwapchainKHR(device, swapChain, nullptr);
 }
 
 //-----------------------------------------------------------------
 // Main Function of Application
 //-----------------------------------------------------------------
-int main() {
-
-  // create instance of triangle app
-  HelloTriangleApplication app;
+// the benchmark target provides its own entry point
+#ifndef HELLOVULKAN_BENCH
+int main(int argc, char **argv) {
 
   // run the application -- safely checking for thrown exceptions
   try {
+    // create instance of triangle app
+    HelloTriangleApplication app(parseOptions(argc, argv));
     app.run();
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;
@@ -1176,4 +3358,5 @@ int main() {
 
   // return 0
   return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,1630 @@
+//===================================================================
+// File: mesh_loader.cpp
+//
+// Desc: Loads OBJ and glTF 2.0 meshes from memory mapped files, parsing
+//       and deduplicating them as parallel jobs.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/mesh_loader.h"
+#include "../includes/profiler.h"
+#include "../includes/vec_math.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//-------------------------------------------------------------------
+// Local Constants
+//-------------------------------------------------------------------
+
+static const uint32_t GLB_MAGIC = 0x46546c67;      // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4e4f534a; // "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004e4942;  // "BIN\0"
+static const uint32_t JSON_MAX_DEPTH = 64;
+static const size_t DEDUP_PREFETCH_DISTANCE = 16; // keys read ahead
+
+// glTF accessor component types
+static const uint32_t GLTF_BYTE = 5120;
+static const uint32_t GLTF_UNSIGNED_BYTE = 5121;
+static const uint32_t GLTF_SHORT = 5122;
+static const uint32_t GLTF_UNSIGNED_SHORT = 5123;
+static const uint32_t GLTF_UNSIGNED_INT = 5125;
+static const uint32_t GLTF_FLOAT = 5126;
+static const uint32_t GLTF_TRIANGLES = 4;
+
+//-------------------------------------------------------------------
+// Local Types
+//-------------------------------------------------------------------
+
+namespace {
+
+// Read-only view of a whole file. Mapping it lets the parse jobs fault in
+// the pages they touch in parallel, instead of one thread reading the file
+// up front.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  const char *data() const { return base; }
+  size_t size() const { return fileSize; }
+
+private:
+  const char *base = nullptr;
+  size_t fileSize = 0;
+  std::vector<char> fallbackBuffer; // where mapping isn't available
+};
+
+// Maps the file at path, or reads it where mapping isn't available.
+MappedFile::MappedFile(const std::string &path) {
+#ifndef _WIN32
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open mesh file " + path + "!");
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    ::close(fd);
+    throw std::runtime_error("failed to read mesh file " + path + "!");
+  }
+  fileSize = static_cast<size_t>(status.st_size);
+  if (fileSize == 0) {
+    ::close(fd);
+    return;
+  }
+
+  // the mapping stays valid after the descriptor is closed
+  void *mapping = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    throw std::runtime_error("failed to map mesh file " + path + "!");
+  }
+  // start reading ahead, every page is about to be parsed
+  madvise(mapping, fileSize, MADV_WILLNEED);
+  base = static_cast<const char *>(mapping);
+#else
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open mesh file " + path + "!");
+  }
+  fallbackBuffer.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(fallbackBuffer.data(), fallbackBuffer.size());
+  base = fallbackBuffer.data();
+  fileSize = fallbackBuffer.size();
+#endif
+}
+
+// Unmaps the file.
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (base != nullptr) {
+    munmap(const_cast<char *>(base), fileSize);
+  }
+#endif
+}
+
+// Kinds of OBJ lines the loader reads, everything else is skipped.
+enum ObjLineType {
+  OBJ_LINE_OTHER,
+  OBJ_LINE_POSITION, // v
+  OBJ_LINE_UV,       // vt
+  OBJ_LINE_NORMAL,   // vn
+  OBJ_LINE_FACE      // f
+};
+
+// Face corner of an OBJ file: the position, uv and normal it references
+// by their index in the whole file, -1 for a missing uv or normal.
+struct ObjCorner {
+  int32_t position;
+  int32_t uv;
+  int32_t normal;
+  bool operator==(const ObjCorner &other) const {
+    return position == other.position && uv == other.uv &&
+           normal == other.normal;
+  }
+};
+
+// Range of an OBJ file parsed by one job, with the vertex attributes
+// declared in it and before it.
+struct ObjChunk {
+  size_t begin = 0;
+  size_t end = 0;
+  size_t positionCount = 0;
+  size_t uvCount = 0;
+  size_t normalCount = 0;
+  size_t firstPosition = 0;
+  size_t firstUv = 0;
+  size_t firstNormal = 0;
+  std::vector<ObjCorner> corners; // three per triangle
+};
+
+// Finishes a 64 bit hash so that every input bit affects the top bits,
+// which pick the deduplication partition (splitmix64).
+uint64_t mixHash(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ull;
+  h ^= h >> 33;
+  return h;
+}
+
+struct ObjCornerHash {
+  size_t operator()(const ObjCorner &corner) const {
+    uint64_t key = static_cast<uint32_t>(corner.position) |
+                   static_cast<uint64_t>(static_cast<uint32_t>(corner.uv))
+                       << 32;
+    return static_cast<size_t>(
+        mixHash(key ^ mixHash(static_cast<uint32_t>(corner.normal))));
+  }
+};
+
+// Vertices compare and hash by their bits, which is what makes two
+// vertices interchangeable in a vertex buffer.
+struct MeshVertexHash {
+  size_t operator()(const MeshVertex &vertex) const {
+    uint64_t words[4];
+    std::memcpy(words, &vertex, sizeof(words));
+    uint64_t h = 0;
+    for (uint64_t word : words) {
+      h = mixHash(h ^ word);
+    }
+    return static_cast<size_t>(h);
+  }
+};
+
+struct MeshVertexEqual {
+  bool operator()(const MeshVertex &a, const MeshVertex &b) const {
+    return std::memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+  }
+};
+
+// Parsed JSON value. Objects keep their members in file order.
+struct JsonValue {
+  enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY,
+              JSON_OBJECT };
+  Type type = JSON_NULL;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<JsonValue> items;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  // Looks up a member of an object.
+  // ~Returns: the member, or nullptr if there is none or this isn't an
+  // object.
+  const JsonValue *find(const std::string &key) const {
+    for (const auto &member : members) {
+      if (member.first == key) {
+        return &member.second;
+      }
+    }
+    return nullptr;
+  }
+};
+
+// Recursive descent parser for the JSON part of a glTF file.
+class JsonParser {
+public:
+  JsonParser(const char *text, size_t size, const std::string &path)
+      : p(text), end(text + size), path(path) {}
+
+  // Parses the whole text as one value.
+  // ~Returns: the value.
+  JsonValue parse() {
+    JsonValue value = parseValue(0);
+    skipSpaces();
+    // GLB pads its JSON chunk with spaces, some writers with zeros
+    while (p < end && *p == '\0') {
+      p++;
+    }
+    if (p != end) {
+      fail();
+    }
+    return value;
+  }
+
+private:
+  const char *p;
+  const char *end;
+  const std::string &path;
+
+  [[noreturn]] void fail() {
+    throw std::runtime_error("invalid JSON in " + path + "!");
+  }
+
+  void skipSpaces() {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+      p++;
+    }
+  }
+
+  void expect(char c) {
+    skipSpaces();
+    if (p >= end || *p != c) {
+      fail();
+    }
+    p++;
+  }
+
+  bool consume(const char *word) {
+    size_t length = std::strlen(word);
+    if (static_cast<size_t>(end - p) < length ||
+        std::memcmp(p, word, length) != 0) {
+      return false;
+    }
+    p += length;
+    return true;
+  }
+
+  JsonValue parseValue(uint32_t depth) {
+    if (depth > JSON_MAX_DEPTH) {
+      fail();
+    }
+    skipSpaces();
+    if (p >= end) {
+      fail();
+    }
+
+    JsonValue value;
+    if (*p == '{') {
+      p++;
+      value.type = JsonValue::JSON_OBJECT;
+      skipSpaces();
+      if (p < end && *p == '}') {
+        p++;
+        return value;
+      }
+      for (;;) {
+        skipSpaces();
+        std::string key = parseString();
+        expect(':');
+        value.members.emplace_back(std::move(key), parseValue(depth + 1));
+        skipSpaces();
+        if (p < end && *p == ',') {
+          p++;
+          continue;
+        }
+        expect('}');
+        break;
+      }
+    } else if (*p == '[') {
+      p++;
+      value.type = JsonValue::JSON_ARRAY;
+      skipSpaces();
+      if (p < end && *p == ']') {
+        p++;
+        return value;
+      }
+      for (;;) {
+        value.items.push_back(parseValue(depth + 1));
+        skipSpaces();
+        if (p < end && *p == ',') {
+          p++;
+          continue;
+        }
+        expect(']');
+        break;
+      }
+    } else if (*p == '"') {
+      value.type = JsonValue::JSON_STRING;
+      value.string = parseString();
+    } else if (consume("true")) {
+      value.type = JsonValue::JSON_BOOL;
+      value.boolean = true;
+    } else if (consume("false")) {
+      value.type = JsonValue::JSON_BOOL;
+    } else if (consume("null")) {
+      value.type = JsonValue::JSON_NULL;
+    } else if (*p == '-' || std::isdigit(static_cast<unsigned char>(*p))) {
+      value.type = JsonValue::JSON_NUMBER;
+      auto result = std::from_chars(p, end, value.number);
+      if (result.ec != std::errc()) {
+        fail();
+      }
+      p = result.ptr;
+    } else {
+      fail();
+    }
+    return value;
+  }
+
+  // Reads four hex digits of a \u escape.
+  uint32_t parseHex4() {
+    if (end - p < 4) {
+      fail();
+    }
+    uint32_t code = 0;
+    auto result = std::from_chars(p, p + 4, code, 16);
+    if (result.ptr != p + 4) {
+      fail();
+    }
+    p += 4;
+    return code;
+  }
+
+  std::string parseString() {
+    if (p >= end || *p != '"') {
+      fail();
+    }
+    p++;
+    std::string text;
+    while (p < end && *p != '"') {
+      char c = *p++;
+      if (c != '\\') {
+        text += c;
+        continue;
+      }
+      if (p >= end) {
+        fail();
+      }
+      char escape = *p++;
+      switch (escape) {
+      case '"':
+      case '\\':
+      case '/':
+        text += escape;
+        break;
+      case 'b':
+        text += '\b';
+        break;
+      case 'f':
+        text += '\f';
+        break;
+      case 'n':
+        text += '\n';
+        break;
+      case 'r':
+        text += '\r';
+        break;
+      case 't':
+        text += '\t';
+        break;
+      case 'u': {
+        uint32_t code = parseHex4();
+        // a surrogate pair encodes one code point above the BMP
+        if (code >= 0xd800 && code < 0xdc00 && consume("\\u")) {
+          uint32_t low = parseHex4();
+          if (low < 0xdc00 || low >= 0xe000) {
+            fail();
+          }
+          code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+        }
+        if (code < 0x80) {
+          text += static_cast<char>(code);
+        } else if (code < 0x800) {
+          text += static_cast<char>(0xc0 | (code >> 6));
+          text += static_cast<char>(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+          text += static_cast<char>(0xe0 | (code >> 12));
+          text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+          text += static_cast<char>(0x80 | (code & 0x3f));
+        } else {
+          text += static_cast<char>(0xf0 | (code >> 18));
+          text += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+          text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+          text += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        break;
+      }
+      default:
+        fail();
+      }
+    }
+    if (p >= end) {
+      fail();
+    }
+    p++;
+    return text;
+  }
+};
+
+// Bytes of a glTF buffer, mapped, decoded or inside a GLB.
+struct GltfBuffer {
+  const char *data = nullptr;
+  size_t size = 0;
+};
+
+// Typed view of a glTF accessor's elements.
+struct GltfAccessor {
+  const char *data = nullptr; // first element
+  size_t count = 0;
+  size_t stride = 0;
+  uint32_t componentType = 0;
+  uint32_t componentCount = 0;
+  bool normalized = false;
+};
+
+// Triangle primitive of a mesh placed by a node, with the ranges of the
+// vertex and index arrays it fills.
+struct GltfPart {
+  GltfAccessor positions;
+  GltfAccessor normals; // count 0 if missing
+  GltfAccessor uvs;     // count 0 if missing
+  GltfAccessor indices; // count 0 if not indexed
+  Mat4 transform;
+  Vec3 normalColumns[3]; // cofactors of the transform, for normals
+  bool flipWinding = false; // the transform mirrors
+  size_t firstVertex = 0;
+  size_t firstIndex = 0;
+  size_t indexCount = 0;
+};
+
+// Range of a part converted by one job.
+struct GltfRange {
+  size_t part;
+  size_t begin;
+  size_t end;
+  bool indices; // triangles rather than vertices
+};
+
+} // namespace
+
+//-------------------------------------------------------------------
+// Local Functions
+//-------------------------------------------------------------------
+
+// Splits text into ranges of about MESH_CHUNK_BYTES that start at the
+// beginning of a line.
+// ~Returns: the start of every range, followed by size.
+static std::vector<size_t> splitLines(const char *text, size_t size) {
+  std::vector<size_t> starts = {0};
+  size_t next = MESH_CHUNK_BYTES;
+  while (next < size) {
+    const void *newline = std::memchr(text + next, '\n', size - next);
+    if (newline == nullptr) {
+      break;
+    }
+    size_t start = static_cast<const char *>(newline) - text + 1;
+    if (start >= size) {
+      break;
+    }
+    starts.push_back(start);
+    next = start + MESH_CHUNK_BYTES;
+  }
+  starts.push_back(size);
+  return starts;
+}
+
+// Calls function with the bounds of every line in [begin, end).
+template <typename LineFunction>
+static void forEachLine(const char *begin, const char *end,
+                        LineFunction function) {
+  while (begin < end) {
+    const char *newline =
+        static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+    const char *lineEnd = newline != nullptr ? newline : end;
+    function(begin, lineEnd);
+    begin = lineEnd + 1;
+  }
+}
+
+static const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+    p++;
+  }
+  return p;
+}
+
+// Reads the keyword starting an OBJ line and moves p past it.
+// ~Returns: what the line declares.
+static ObjLineType objLineType(const char **p, const char *end) {
+  const char *s = skipSpaces(*p, end);
+  size_t length = 0;
+  while (s + length < end && s[length] != ' ' && s[length] != '\t') {
+    length++;
+  }
+  *p = s + length;
+  if (length == 1 && s[0] == 'v') {
+    return OBJ_LINE_POSITION;
+  } else if (length == 1 && s[0] == 'f') {
+    return OBJ_LINE_FACE;
+  } else if (length == 2 && s[0] == 'v' && s[1] == 't') {
+    return OBJ_LINE_UV;
+  } else if (length == 2 && s[0] == 'v' && s[1] == 'n') {
+    return OBJ_LINE_NORMAL;
+  }
+  return OBJ_LINE_OTHER;
+}
+
+// Parses up to count space separated floats into values, leaving the rest
+// of the line alone. Values the line doesn't have are zero.
+// ~Returns: the number of floats parsed.
+static size_t parseFloats(const char *p, const char *end, float *values,
+                          size_t count) {
+  size_t parsed = 0;
+  for (; parsed < count; parsed++) {
+    p = skipSpaces(p, end);
+    if (p < end && *p == '+') {
+      p++;
+    }
+    auto result = std::from_chars(p, end, values[parsed]);
+    if (result.ptr == p) {
+      break;
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+      values[parsed] = 0.0f; // denormals, nothing a mesh would miss
+    }
+    p = result.ptr;
+  }
+  std::fill(values + parsed, values + count, 0.0f);
+  return parsed;
+}
+
+// Resolves an OBJ index, 1-based or relative to the end of the attributes
+// declared so far, to a 0-based one.
+// ~Returns: the index, or -1 if it is out of range.
+static int32_t resolveObjIndex(int64_t index, size_t declared,
+                               size_t total) {
+  int64_t resolved =
+      index > 0 ? index - 1 : static_cast<int64_t>(declared) + index;
+  if (index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(total)) {
+    return -1;
+  }
+  return static_cast<int32_t>(resolved);
+}
+
+// Hints that the cache line holding address will be read soon.
+static inline void prefetch(const void *address) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address);
+#else
+  (void)address;
+#endif
+}
+
+// Finds the distinct keys, keeps them in keys in order of first use and
+// writes, for every original key, the index of its distinct key into
+// remap. The keys are scattered into MESH_DEDUP_BUCKETS partitions by hash
+// and each partition is deduplicated by a job of its own, since equal keys
+// always land in the same partition.
+template <typename Key, typename Hash, typename Equal = std::equal_to<Key>>
+static void deduplicate(JobSystem &jobs, std::vector<Key> &keys,
+                        std::vector<uint32_t> &remap) {
+  PROFILE_SCOPE("deduplicate");
+  size_t count = keys.size();
+  size_t chunkCount = (count + MESH_CHUNK_ITEMS - 1) / MESH_CHUNK_ITEMS;
+  auto chunkEnd = [&](size_t chunk) {
+    return std::min(count, (chunk + 1) * MESH_CHUNK_ITEMS);
+  };
+
+  // scatter the key indices chunk by chunk, so every partition lists its
+  // keys in order once the chunks' lists are concatenated
+  std::vector<std::vector<uint32_t>> partitions(chunkCount *
+                                                MESH_DEDUP_BUCKETS);
+  jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+    Hash hash;
+    std::vector<uint32_t> *lists = &partitions[chunk * MESH_DEDUP_BUCKETS];
+    for (size_t i = chunk * MESH_CHUNK_ITEMS; i < chunkEnd(chunk); i++) {
+      uint64_t h = hash(keys[i]);
+      lists[(h >> 32) % MESH_DEDUP_BUCKETS].push_back(
+          static_cast<uint32_t>(i));
+    }
+  });
+
+  // number the distinct keys within each partition and mark where each
+  // is first used. The table is open addressed and holds the keys
+  // themselves, so probing stays within it instead of chasing the keys
+  // across the whole array; it doubles whenever it is half full. A
+  // partition's keys are spread thinly over the array, so they are
+  // prefetched a few iterations ahead
+  remap.resize(count);
+  std::vector<uint8_t> firstUse(count);
+  std::vector<size_t> bucketStarts(MESH_DEDUP_BUCKETS + 1, 0);
+  jobs.parallelFor(MESH_DEDUP_BUCKETS, [&](size_t bucket, uint32_t) {
+    Hash hash;
+    Equal equal;
+    size_t mask = 1023;
+    std::vector<Key> slotKeys(mask + 1);
+    std::vector<uint32_t> slotIds(mask + 1, UINT32_MAX);
+    uint32_t distinct = 0;
+
+    // the low bits of the hash pick the slot, the high ones picked the
+    // partition
+    auto findSlot = [&](const Key &key) {
+      size_t slot = hash(key) & mask;
+      while (slotIds[slot] != UINT32_MAX && !equal(slotKeys[slot], key)) {
+        slot = (slot + 1) & mask;
+      }
+      return slot;
+    };
+
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+      const std::vector<uint32_t> &list =
+          partitions[chunk * MESH_DEDUP_BUCKETS + bucket];
+      for (size_t j = 0; j < list.size(); j++) {
+        if (j + DEDUP_PREFETCH_DISTANCE < list.size()) {
+          prefetch(&keys[list[j + DEDUP_PREFETCH_DISTANCE]]);
+        }
+        uint32_t i = list[j];
+        size_t slot = findSlot(keys[i]);
+        if (slotIds[slot] == UINT32_MAX) {
+          slotKeys[slot] = keys[i];
+          slotIds[slot] = distinct++;
+          firstUse[i] = 1;
+
+          if (distinct * 2 > mask) {
+            std::vector<Key> oldKeys(std::move(slotKeys));
+            std::vector<uint32_t> oldIds(std::move(slotIds));
+            mask = mask * 2 + 1;
+            slotKeys.assign(mask + 1, Key());
+            slotIds.assign(mask + 1, UINT32_MAX);
+            for (size_t old = 0; old < oldIds.size(); old++) {
+              if (oldIds[old] != UINT32_MAX) {
+                size_t moved = findSlot(oldKeys[old]);
+                slotKeys[moved] = oldKeys[old];
+                slotIds[moved] = oldIds[old];
+              }
+            }
+            slot = findSlot(keys[i]);
+          }
+        }
+        remap[i] = slotIds[slot];
+      }
+    }
+    bucketStarts[bucket + 1] = distinct;
+  });
+  for (uint32_t bucket = 0; bucket < MESH_DEDUP_BUCKETS; bucket++) {
+    bucketStarts[bucket + 1] += bucketStarts[bucket];
+  }
+  jobs.parallelFor(MESH_DEDUP_BUCKETS, [&](size_t bucket, uint32_t) {
+    uint32_t start = static_cast<uint32_t>(bucketStarts[bucket]);
+    for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+      for (uint32_t i : partitions[chunk * MESH_DEDUP_BUCKETS + bucket]) {
+        remap[i] += start;
+      }
+    }
+  });
+  partitions.clear();
+  partitions.shrink_to_fit();
+
+  // renumber in order of first use, so consecutive triangles reference
+  // nearby vertices as they did in the file
+  std::vector<size_t> chunkStarts(chunkCount + 1, 0);
+  jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+    size_t firsts = 0;
+    for (size_t i = chunk * MESH_CHUNK_ITEMS; i < chunkEnd(chunk); i++) {
+      firsts += firstUse[i];
+    }
+    chunkStarts[chunk + 1] = firsts;
+  });
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    chunkStarts[chunk + 1] += chunkStarts[chunk];
+  }
+
+  std::vector<uint32_t> order(bucketStarts.back());
+  std::vector<Key> unique(bucketStarts.back());
+  jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+    size_t next = chunkStarts[chunk];
+    for (size_t i = chunk * MESH_CHUNK_ITEMS; i < chunkEnd(chunk); i++) {
+      if (firstUse[i]) {
+        order[remap[i]] = static_cast<uint32_t>(next);
+        unique[next++] = keys[i];
+      }
+    }
+  });
+  jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+    for (size_t i = chunk * MESH_CHUNK_ITEMS; i < chunkEnd(chunk); i++) {
+      remap[i] = order[remap[i]];
+    }
+  });
+  keys.swap(unique);
+}
+
+// Sets the bounds of a mesh to those of its vertices.
+static void computeBounds(MeshData &mesh, JobSystem &jobs) {
+  size_t count = mesh.vertices.size();
+  size_t chunkCount = (count + MESH_CHUNK_ITEMS - 1) / MESH_CHUNK_ITEMS;
+  std::vector<float> chunkBounds(chunkCount * 6);
+  jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+    float *bounds = &chunkBounds[chunk * 6];
+    const float *first = mesh.vertices[chunk * MESH_CHUNK_ITEMS].position;
+    std::copy(first, first + 3, bounds);
+    std::copy(first, first + 3, bounds + 3);
+    size_t end = std::min(count, (chunk + 1) * MESH_CHUNK_ITEMS);
+    for (size_t i = chunk * MESH_CHUNK_ITEMS; i < end; i++) {
+      for (int axis = 0; axis < 3; axis++) {
+        float value = mesh.vertices[i].position[axis];
+        bounds[axis] = std::min(bounds[axis], value);
+        bounds[axis + 3] = std::max(bounds[axis + 3], value);
+      }
+    }
+  });
+
+  for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+    for (int axis = 0; axis < 3; axis++) {
+      float low = chunkBounds[chunk * 6 + axis];
+      float high = chunkBounds[chunk * 6 + axis + 3];
+      mesh.boundsMin[axis] =
+          chunk == 0 ? low : std::min(mesh.boundsMin[axis], low);
+      mesh.boundsMax[axis] =
+          chunk == 0 ? high : std::max(mesh.boundsMax[axis], high);
+    }
+  }
+}
+
+// Throws unless the mesh has triangles and fits 32 bit indices.
+static void checkMeshSize(size_t vertexCount, size_t indexCount,
+                          const std::string &path) {
+  if (indexCount == 0) {
+    throw std::runtime_error("mesh " + path + " has no triangles!");
+  }
+  if (vertexCount > UINT32_MAX || indexCount > UINT32_MAX) {
+    throw std::runtime_error("mesh " + path + " is too large!");
+  }
+}
+
+// Looks up an element of one of the top level arrays of a glTF file.
+// ~Returns: the element.
+static const JsonValue &gltfElement(const JsonValue &root, const char *array,
+                                    double index, const std::string &path) {
+  const JsonValue *values = root.find(array);
+  if (values == nullptr || index < 0.0 || index != std::floor(index) ||
+      index >= static_cast<double>(values->items.size())) {
+    throw std::runtime_error("glTF file " + path + " references a missing " +
+                             array + " entry!");
+  }
+  return values->items[static_cast<size_t>(index)];
+}
+
+// Reads a numeric member of a glTF object.
+// ~Returns: the number, or fallback if the member is missing.
+static double gltfNumber(const JsonValue &object, const char *key,
+                         double fallback) {
+  const JsonValue *value = object.find(key);
+  return value != nullptr && value->type == JsonValue::JSON_NUMBER
+             ? value->number
+             : fallback;
+}
+
+// Decodes the %XX escapes of a relative URI into a file name.
+static std::string decodeUri(const std::string &uri) {
+  std::string name;
+  for (size_t i = 0; i < uri.size(); i++) {
+    uint32_t code = 0;
+    if (uri[i] == '%' && i + 2 < uri.size() &&
+        std::from_chars(uri.data() + i + 1, uri.data() + i + 3, code, 16)
+                .ptr == uri.data() + i + 3) {
+      name += static_cast<char>(code);
+      i += 2;
+    } else {
+      name += uri[i];
+    }
+  }
+  return name;
+}
+
+// Decodes base64 text, skipping anything that isn't part of the alphabet.
+// ~Returns: the decoded bytes.
+static std::vector<char> decodeBase64(const char *text, size_t size) {
+  std::vector<char> bytes;
+  bytes.reserve(size / 4 * 3);
+  uint32_t bits = 0;
+  int bitCount = 0;
+  for (size_t i = 0; i < size && text[i] != '='; i++) {
+    char c = text[i];
+    int value = c >= 'A' && c <= 'Z'   ? c - 'A'
+                : c >= 'a' && c <= 'z' ? c - 'a' + 26
+                : c >= '0' && c <= '9' ? c - '0' + 52
+                : c == '+'             ? 62
+                : c == '/'             ? 63
+                                       : -1;
+    if (value < 0) {
+      continue;
+    }
+    bits = (bits << 6) | static_cast<uint32_t>(value);
+    bitCount += 6;
+    if (bitCount >= 8) {
+      bitCount -= 8;
+      bytes.push_back(static_cast<char>((bits >> bitCount) & 0xff));
+    }
+  }
+  return bytes;
+}
+
+// Builds a view of accessor index and checks it lies within its buffer.
+// Sparse accessors and accessors without a buffer view aren't supported.
+// ~Returns: the view.
+static GltfAccessor gltfAccessor(const JsonValue &root,
+                                 const std::vector<GltfBuffer> &buffers,
+                                 double index, const std::string &path) {
+  const JsonValue &accessor = gltfElement(root, "accessors", index, path);
+  const JsonValue *viewIndex = accessor.find("bufferView");
+  if (viewIndex == nullptr || accessor.find("sparse") != nullptr) {
+    throw std::runtime_error("glTF file " + path +
+                             " uses sparse or empty accessors, which "
+                             "aren't supported!");
+  }
+
+  GltfAccessor view;
+  view.componentType =
+      static_cast<uint32_t>(gltfNumber(accessor, "componentType", 0.0));
+  view.count = static_cast<size_t>(gltfNumber(accessor, "count", 0.0));
+  const JsonValue *normalized = accessor.find("normalized");
+  view.normalized = normalized != nullptr && normalized->boolean;
+  const JsonValue *type = accessor.find("type");
+  std::string typeName = type != nullptr ? type->string : "";
+  if (typeName == "SCALAR") {
+    view.componentCount = 1;
+  } else if (typeName == "VEC2") {
+    view.componentCount = 2;
+  } else if (typeName == "VEC3") {
+    view.componentCount = 3;
+  } else if (typeName == "VEC4") {
+    view.componentCount = 4;
+  } else {
+    throw std::runtime_error("glTF file " + path +
+                             " has an accessor of unsupported type " +
+                             typeName + "!");
+  }
+
+  size_t componentSize = 0;
+  switch (view.componentType) {
+  case GLTF_BYTE:
+  case GLTF_UNSIGNED_BYTE:
+    componentSize = 1;
+    break;
+  case GLTF_SHORT:
+  case GLTF_UNSIGNED_SHORT:
+    componentSize = 2;
+    break;
+  case GLTF_UNSIGNED_INT:
+  case GLTF_FLOAT:
+    componentSize = 4;
+    break;
+  default:
+    throw std::runtime_error("glTF file " + path +
+                             " has an accessor of unknown component type!");
+  }
+  size_t elementSize = componentSize * view.componentCount;
+
+  const JsonValue &bufferView =
+      gltfElement(root, "bufferViews", viewIndex->number, path);
+  double bufferIndex = gltfNumber(bufferView, "buffer", -1.0);
+  if (bufferIndex < 0.0 || bufferIndex >= buffers.size()) {
+    throw std::runtime_error("glTF file " + path +
+                             " references a missing buffer!");
+  }
+  const GltfBuffer &buffer = buffers[static_cast<size_t>(bufferIndex)];
+  size_t viewOffset =
+      static_cast<size_t>(gltfNumber(bufferView, "byteOffset", 0.0));
+  size_t viewLength =
+      static_cast<size_t>(gltfNumber(bufferView, "byteLength", 0.0));
+  view.stride = static_cast<size_t>(
+      gltfNumber(bufferView, "byteStride", static_cast<double>(elementSize)));
+  size_t offset = static_cast<size_t>(gltfNumber(accessor, "byteOffset", 0.0));
+  size_t used =
+      view.count == 0 ? 0 : (view.count - 1) * view.stride + elementSize;
+  if (view.stride < elementSize || viewOffset + viewLength > buffer.size ||
+      offset + used > viewLength) {
+    throw std::runtime_error("glTF file " + path +
+                             " has an accessor outside its buffer!");
+  }
+  view.data = buffer.data + viewOffset + offset;
+  return view;
+}
+
+// Reads one component of an accessor element as a float, mapping
+// normalized integers into [0, 1] or [-1, 1].
+// ~Returns: the component.
+static float readGltfComponent(const GltfAccessor &accessor, size_t element,
+                               uint32_t component) {
+  const char *p = accessor.data + element * accessor.stride;
+  switch (accessor.componentType) {
+  case GLTF_FLOAT: {
+    float value;
+    std::memcpy(&value, p + component * 4, sizeof(value));
+    return value;
+  }
+  case GLTF_UNSIGNED_BYTE: {
+    float value = static_cast<uint8_t>(p[component]);
+    return accessor.normalized ? value / 255.0f : value;
+  }
+  case GLTF_BYTE: {
+    float value = static_cast<int8_t>(p[component]);
+    return accessor.normalized ? std::max(value / 127.0f, -1.0f) : value;
+  }
+  case GLTF_UNSIGNED_SHORT: {
+    uint16_t value;
+    std::memcpy(&value, p + component * 2, sizeof(value));
+    return accessor.normalized ? value / 65535.0f : value;
+  }
+  case GLTF_SHORT: {
+    int16_t value;
+    std::memcpy(&value, p + component * 2, sizeof(value));
+    return accessor.normalized ? std::max(value / 32767.0f, -1.0f) : value;
+  }
+  default: {
+    uint32_t value;
+    std::memcpy(&value, p + component * 4, sizeof(value));
+    return static_cast<float>(value);
+  }
+  }
+}
+
+// Reads element i of an index accessor.
+// ~Returns: the index.
+static uint32_t readGltfIndex(const GltfAccessor &accessor, size_t i) {
+  const char *p = accessor.data + i * accessor.stride;
+  if (accessor.componentType == GLTF_UNSIGNED_BYTE) {
+    return static_cast<uint8_t>(*p);
+  } else if (accessor.componentType == GLTF_UNSIGNED_SHORT) {
+    uint16_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  }
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+// Reads the local transform of a glTF node, either its matrix or its
+// translation, rotation and scale.
+// ~Returns: the transform.
+static Mat4 gltfNodeTransform(const JsonValue &node) {
+  const JsonValue *matrix = node.find("matrix");
+  if (matrix != nullptr && matrix->items.size() == 16) {
+    Mat4 m;
+    float *values = &m.columns[0].x; // column major, like glTF
+    for (size_t i = 0; i < 16; i++) {
+      values[i] = static_cast<float>(matrix->items[i].number);
+    }
+    return m;
+  }
+
+  auto components = [&](const char *key, std::vector<float> values) {
+    const JsonValue *array = node.find(key);
+    if (array != nullptr && array->items.size() == values.size()) {
+      for (size_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<float>(array->items[i].number);
+      }
+    }
+    return values;
+  };
+  std::vector<float> t = components("translation", {0.0f, 0.0f, 0.0f});
+  std::vector<float> r = components("rotation", {0.0f, 0.0f, 0.0f, 1.0f});
+  std::vector<float> s = components("scale", {1.0f, 1.0f, 1.0f});
+  return mat4Compose(vec3(t[0], t[1], t[2]),
+                     normalize(Quat{r[0], r[1], r[2], r[3]}),
+                     vec3(s[0], s[1], s[2]));
+}
+
+// Adds the meshes of a node and its descendants to draws, each with its
+// world transform.
+static void collectGltfNodes(const JsonValue &root, double nodeIndex,
+                             const Mat4 &parent, uint32_t depth,
+                             std::vector<std::pair<double, Mat4>> &draws,
+                             const std::string &path) {
+  if (depth > JSON_MAX_DEPTH) {
+    throw std::runtime_error("glTF file " + path +
+                             " has a node hierarchy that is too deep!");
+  }
+  const JsonValue &node = gltfElement(root, "nodes", nodeIndex, path);
+  Mat4 world = mat4Mul(parent, gltfNodeTransform(node));
+  const JsonValue *mesh = node.find("mesh");
+  if (mesh != nullptr) {
+    draws.emplace_back(mesh->number, world);
+  }
+  const JsonValue *children = node.find("children");
+  if (children != nullptr) {
+    for (const JsonValue &child : children->items) {
+      collectGltfNodes(root, child.number, world, depth + 1, draws, path);
+    }
+  }
+}
+
+// Converts one range of a glTF part into the mesh's vertex or index array.
+static void convertGltfRange(const GltfPart &part, const GltfRange &range,
+                             MeshData &mesh, const std::string &path) {
+  if (!range.indices) {
+    for (size_t i = range.begin; i < range.end; i++) {
+      MeshVertex &vertex = mesh.vertices[part.firstVertex + i];
+      Vec4 position = mat4MulVec4(
+          part.transform, vec4(readGltfComponent(part.positions, i, 0),
+                               readGltfComponent(part.positions, i, 1),
+                               readGltfComponent(part.positions, i, 2), 1.0f));
+      vertex.position[0] = position.x;
+      vertex.position[1] = position.y;
+      vertex.position[2] = position.z;
+
+      Vec3 normal = vec3(0.0f, 0.0f, 0.0f);
+      if (part.normals.count > 0) {
+        normal = normalize(
+            part.normalColumns[0] * readGltfComponent(part.normals, i, 0) +
+            part.normalColumns[1] * readGltfComponent(part.normals, i, 1) +
+            part.normalColumns[2] * readGltfComponent(part.normals, i, 2));
+      }
+      vertex.normal[0] = normal.x;
+      vertex.normal[1] = normal.y;
+      vertex.normal[2] = normal.z;
+      for (uint32_t c = 0; c < 2; c++) {
+        vertex.uv[c] =
+            part.uvs.count > 0 ? readGltfComponent(part.uvs, i, c) : 0.0f;
+      }
+    }
+    return;
+  }
+
+  size_t vertexCount = part.positions.count;
+  for (size_t triangle = range.begin; triangle < range.end; triangle++) {
+    uint32_t corners[3];
+    for (size_t c = 0; c < 3; c++) {
+      size_t i = triangle * 3 + c;
+      corners[c] = part.indices.count > 0
+                       ? readGltfIndex(part.indices, i)
+                       : static_cast<uint32_t>(i);
+      if (corners[c] >= vertexCount) {
+        throw std::runtime_error("glTF file " + path +
+                                 " has an index past its vertices!");
+      }
+    }
+    if (part.flipWinding) {
+      std::swap(corners[1], corners[2]);
+    }
+    for (size_t c = 0; c < 3; c++) {
+      mesh.indices[part.firstIndex + triangle * 3 + c] =
+          static_cast<uint32_t>(part.firstVertex + corners[c]);
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Loads the mesh at path, picking the format by the file extension.
+// ~Returns: the mesh.
+MeshData loadMesh(const std::string &path, JobSystem &jobs) {
+  size_t dot = path.find_last_of('.');
+  std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension == ".obj") {
+    return loadObjMesh(path, jobs);
+  } else if (extension == ".gltf" || extension == ".glb") {
+    return loadGltfMesh(path, jobs);
+  }
+  throw std::runtime_error("unsupported mesh format " + path +
+                           ", expected .obj, .gltf or .glb!");
+}
+
+// Loads the positions, uvs, normals and faces of an OBJ file. The file is
+// split into line aligned chunks parsed as jobs: a first pass counts the
+// vertex attributes of every chunk, so the second can resolve face indices
+// while writing attributes straight to their final place. Polygons are
+// triangulated as fans and the face corners deduplicated into vertices.
+// Materials, groups, lines and points are skipped.
+// ~Returns: the mesh.
+MeshData loadObjMesh(const std::string &path, JobSystem &jobs) {
+  PROFILE_SCOPE("loadObjMesh");
+  MappedFile file(path);
+  const char *text = file.data();
+  std::vector<size_t> starts = splitLines(text, file.size());
+  std::vector<ObjChunk> chunks(starts.size() - 1);
+
+  {
+    PROFILE_SCOPE("countObj");
+    jobs.parallelFor(chunks.size(), [&](size_t c, uint32_t) {
+      ObjChunk &chunk = chunks[c];
+      chunk.begin = starts[c];
+      chunk.end = starts[c + 1];
+      forEachLine(text + chunk.begin, text + chunk.end,
+                  [&](const char *p, const char *end) {
+                    switch (objLineType(&p, end)) {
+                    case OBJ_LINE_POSITION:
+                      chunk.positionCount++;
+                      break;
+                    case OBJ_LINE_UV:
+                      chunk.uvCount++;
+                      break;
+                    case OBJ_LINE_NORMAL:
+                      chunk.normalCount++;
+                      break;
+                    default:
+                      break;
+                    }
+                  });
+    });
+  }
+
+  size_t positionCount = 0, uvCount = 0, normalCount = 0;
+  for (ObjChunk &chunk : chunks) {
+    chunk.firstPosition = positionCount;
+    chunk.firstUv = uvCount;
+    chunk.firstNormal = normalCount;
+    positionCount += chunk.positionCount;
+    uvCount += chunk.uvCount;
+    normalCount += chunk.normalCount;
+  }
+  if (positionCount > INT32_MAX || uvCount > INT32_MAX ||
+      normalCount > INT32_MAX) {
+    throw std::runtime_error("mesh " + path + " is too large!");
+  }
+  std::vector<float> positions(positionCount * 3);
+  std::vector<float> uvs(uvCount * 2);
+  std::vector<float> normals(normalCount * 3);
+
+  {
+    PROFILE_SCOPE("parseObj");
+    jobs.parallelFor(chunks.size(), [&](size_t c, uint32_t) {
+      ObjChunk &chunk = chunks[c];
+      size_t position = chunk.firstPosition;
+      size_t uv = chunk.firstUv;
+      size_t normal = chunk.firstNormal;
+      std::vector<ObjCorner> face;
+      auto fail = [&](const char *problem) {
+        throw std::runtime_error("mesh " + path + " has " + problem + "!");
+      };
+
+      forEachLine(text + chunk.begin, text + chunk.end, [&](const char *p,
+                                                            const char *end) {
+        switch (objLineType(&p, end)) {
+        case OBJ_LINE_POSITION:
+          if (parseFloats(p, end, &positions[position++ * 3], 3) < 3) {
+            fail("a vertex position with fewer than three coordinates");
+          }
+          break;
+        case OBJ_LINE_UV:
+          parseFloats(p, end, &uvs[uv++ * 2], 2);
+          break;
+        case OBJ_LINE_NORMAL:
+          if (parseFloats(p, end, &normals[normal++ * 3], 3) < 3) {
+            fail("a normal with fewer than three coordinates");
+          }
+          break;
+        case OBJ_LINE_FACE:
+          // corners are v, v/vt, v//vn or v/vt/vn
+          face.clear();
+          for (p = skipSpaces(p, end); p < end; p = skipSpaces(p, end)) {
+            int64_t indices[3] = {0, 0, 0};
+            for (int i = 0; i < 3; i++) {
+              if (i > 0) {
+                if (p >= end || *p != '/') {
+                  break;
+                }
+                p++;
+              }
+              auto result = std::from_chars(p, end, indices[i]);
+              if (result.ptr == p && i == 0) {
+                fail("a malformed face");
+              }
+              p = result.ptr;
+            }
+            if (p < end && *p != ' ' && *p != '\t' && *p != '\r') {
+              fail("a malformed face");
+            }
+            ObjCorner corner;
+            corner.position =
+                resolveObjIndex(indices[0], position, positionCount);
+            corner.uv = indices[1] == 0
+                            ? -1
+                            : resolveObjIndex(indices[1], uv, uvCount);
+            corner.normal =
+                indices[2] == 0
+                    ? -1
+                    : resolveObjIndex(indices[2], normal, normalCount);
+            if (corner.position < 0 || (indices[1] != 0 && corner.uv < 0) ||
+                (indices[2] != 0 && corner.normal < 0)) {
+              fail("a face referencing a missing vertex");
+            }
+            face.push_back(corner);
+          }
+          for (size_t i = 2; i < face.size(); i++) {
+            chunk.corners.push_back(face[0]);
+            chunk.corners.push_back(face[i - 1]);
+            chunk.corners.push_back(face[i]);
+          }
+          break;
+        default:
+          break;
+        }
+      });
+    });
+  }
+
+  // gather the corners of all chunks in file order
+  std::vector<size_t> cornerStarts(chunks.size() + 1, 0);
+  for (size_t c = 0; c < chunks.size(); c++) {
+    cornerStarts[c + 1] = cornerStarts[c] + chunks[c].corners.size();
+  }
+  std::vector<ObjCorner> corners(cornerStarts.back());
+  jobs.parallelFor(chunks.size(), [&](size_t c, uint32_t) {
+    std::copy(chunks[c].corners.begin(), chunks[c].corners.end(),
+              corners.begin() + cornerStarts[c]);
+    std::vector<ObjCorner>().swap(chunks[c].corners);
+  });
+
+  MeshData mesh;
+  deduplicate<ObjCorner, ObjCornerHash>(jobs, corners, mesh.indices);
+  checkMeshSize(corners.size(), mesh.indices.size(), path);
+
+  PROFILE_SCOPE("buildObjVertices");
+  mesh.vertices.resize(corners.size());
+  size_t chunkCount = (corners.size() + MESH_CHUNK_ITEMS - 1) /
+                      MESH_CHUNK_ITEMS;
+  jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+    size_t end = std::min(corners.size(), (chunk + 1) * MESH_CHUNK_ITEMS);
+    for (size_t i = chunk * MESH_CHUNK_ITEMS; i < end; i++) {
+      const ObjCorner &corner = corners[i];
+      MeshVertex &vertex = mesh.vertices[i];
+      std::copy_n(&positions[corner.position * size_t(3)], 3,
+                  vertex.position);
+      if (corner.normal >= 0) {
+        std::copy_n(&normals[corner.normal * size_t(3)], 3, vertex.normal);
+      } else {
+        std::fill_n(vertex.normal, 3, 0.0f);
+      }
+      if (corner.uv >= 0) {
+        // OBJ puts the uv origin at the bottom left, Vulkan at the top
+        vertex.uv[0] = uvs[corner.uv * size_t(2)];
+        vertex.uv[1] = 1.0f - uvs[corner.uv * size_t(2) + 1];
+      } else {
+        std::fill_n(vertex.uv, 2, 0.0f);
+      }
+    }
+  });
+  computeBounds(mesh, jobs);
+  return mesh;
+}
+
+// Loads the triangle primitives of a glTF 2.0 file, either a .gltf with
+// external or data URI buffers or a binary .glb. Meshes are placed by the
+// nodes of the default scene, their transforms baked into the vertices,
+// and files without scenes get every mesh once. Every primitive's vertices
+// and triangles are converted in chunks run as jobs; primitives without
+// indices are deduplicated afterwards. Only POSITION, NORMAL and
+// TEXCOORD_0 are read, and sparse accessors aren't supported.
+// ~Returns: the mesh.
+MeshData loadGltfMesh(const std::string &path, JobSystem &jobs) {
+  PROFILE_SCOPE("loadGltfMesh");
+  MappedFile file(path);
+  const char *json = file.data();
+  size_t jsonSize = file.size();
+
+  // a .glb holds the JSON and the first buffer in chunks of one file
+  GltfBuffer glbBuffer;
+  uint32_t magic = 0;
+  if (file.size() >= 12) {
+    std::memcpy(&magic, file.data(), sizeof(magic));
+  }
+  if (magic == GLB_MAGIC) {
+    uint32_t header[3];
+    std::memcpy(header, file.data(), sizeof(header));
+    if (header[1] != 2 || header[2] > file.size()) {
+      throw std::runtime_error("mesh " + path + " is not a glTF 2.0 GLB!");
+    }
+    json = nullptr;
+    for (size_t offset = 12; offset + 8 <= header[2];) {
+      uint32_t chunk[2]; // length, type
+      std::memcpy(chunk, file.data() + offset, sizeof(chunk));
+      if (offset + 8 + chunk[0] > header[2]) {
+        throw std::runtime_error("mesh " + path + " has a truncated chunk!");
+      }
+      if (chunk[1] == GLB_CHUNK_JSON && json == nullptr) {
+        json = file.data() + offset + 8;
+        jsonSize = chunk[0];
+      } else if (chunk[1] == GLB_CHUNK_BIN && glbBuffer.data == nullptr) {
+        glbBuffer.data = file.data() + offset + 8;
+        glbBuffer.size = chunk[0];
+      }
+      offset += 8 + chunk[0];
+    }
+    if (json == nullptr) {
+      throw std::runtime_error("mesh " + path + " has no JSON chunk!");
+    }
+  }
+
+  JsonValue root;
+  {
+    PROFILE_SCOPE("parseGltfJson");
+    root = JsonParser(json, jsonSize, path).parse();
+  }
+  const JsonValue *asset = root.find("asset");
+  const JsonValue *version =
+      asset != nullptr ? asset->find("version") : nullptr;
+  if (version == nullptr || version->string.compare(0, 2, "2.") != 0) {
+    throw std::runtime_error("mesh " + path + " is not glTF 2.0!");
+  }
+
+  // resolve the buffers, external files are mapped as well
+  std::string directory;
+  size_t slash = path.find_last_of("/\\");
+  if (slash != std::string::npos) {
+    directory = path.substr(0, slash + 1);
+  }
+  std::vector<GltfBuffer> buffers;
+  std::vector<std::unique_ptr<MappedFile>> bufferFiles;
+  std::vector<std::vector<char>> decodedBuffers;
+  const JsonValue *bufferList = root.find("buffers");
+  if (bufferList != nullptr) {
+    for (const JsonValue &entry : bufferList->items) {
+      GltfBuffer buffer;
+      const JsonValue *uri = entry.find("uri");
+      if (uri == nullptr) {
+        if (!buffers.empty() || glbBuffer.data == nullptr) {
+          throw std::runtime_error("glTF file " + path +
+                                   " has a buffer without data!");
+        }
+        buffer = glbBuffer;
+      } else if (uri->string.compare(0, 5, "data:") == 0) {
+        size_t comma = uri->string.find(',');
+        if (comma == std::string::npos ||
+            uri->string.rfind(";base64", comma) == std::string::npos) {
+          throw std::runtime_error("glTF file " + path +
+                                   " has a data URI that isn't base64!");
+        }
+        decodedBuffers.push_back(decodeBase64(
+            uri->string.data() + comma + 1, uri->string.size() - comma - 1));
+        buffer.data = decodedBuffers.back().data();
+        buffer.size = decodedBuffers.back().size();
+      } else {
+        bufferFiles.push_back(std::make_unique<MappedFile>(
+            directory + decodeUri(uri->string)));
+        buffer.data = bufferFiles.back()->data();
+        buffer.size = bufferFiles.back()->size();
+      }
+
+      // GLB pads its binary chunk, so only the declared bytes count
+      double length = gltfNumber(entry, "byteLength", 0.0);
+      if (length > static_cast<double>(buffer.size)) {
+        throw std::runtime_error("glTF file " + path +
+                                 " has a buffer shorter than declared!");
+      }
+      buffer.size = static_cast<size_t>(length);
+      buffers.push_back(buffer);
+    }
+  }
+
+  // place the meshes by the nodes of the default scene
+  std::vector<std::pair<double, Mat4>> draws;
+  const JsonValue *scenes = root.find("scenes");
+  if (scenes != nullptr && !scenes->items.empty()) {
+    const JsonValue &scene =
+        gltfElement(root, "scenes", gltfNumber(root, "scene", 0.0), path);
+    const JsonValue *nodes = scene.find("nodes");
+    if (nodes != nullptr) {
+      for (const JsonValue &node : nodes->items) {
+        collectGltfNodes(root, node.number, mat4Identity(), 0, draws, path);
+      }
+    }
+  } else if (root.find("meshes") != nullptr) {
+    for (size_t i = 0; i < root.find("meshes")->items.size(); i++) {
+      draws.emplace_back(static_cast<double>(i), mat4Identity());
+    }
+  }
+
+  // every triangle primitive of every placed mesh becomes a part with
+  // ranges of its own in the vertex and index arrays
+  std::vector<GltfPart> parts;
+  size_t vertexCount = 0;
+  size_t indexCount = 0;
+  bool unindexed = false;
+  for (const auto &draw : draws) {
+    const JsonValue &gltfMesh = gltfElement(root, "meshes", draw.first, path);
+    const JsonValue *primitives = gltfMesh.find("primitives");
+    if (primitives == nullptr) {
+      continue;
+    }
+    for (const JsonValue &primitive : primitives->items) {
+      const JsonValue *attributes = primitive.find("attributes");
+      if (gltfNumber(primitive, "mode", GLTF_TRIANGLES) != GLTF_TRIANGLES ||
+          attributes == nullptr || attributes->find("POSITION") == nullptr) {
+        continue;
+      }
+
+      GltfPart part;
+      part.positions = gltfAccessor(
+          root, buffers, attributes->find("POSITION")->number, path);
+      const JsonValue *normal = attributes->find("NORMAL");
+      if (normal != nullptr) {
+        part.normals = gltfAccessor(root, buffers, normal->number, path);
+      }
+      const JsonValue *uv = attributes->find("TEXCOORD_0");
+      if (uv != nullptr) {
+        part.uvs = gltfAccessor(root, buffers, uv->number, path);
+      }
+      const JsonValue *indices = primitive.find("indices");
+      if (indices != nullptr) {
+        part.indices = gltfAccessor(root, buffers, indices->number, path);
+      }
+      if (part.positions.componentCount != 3 ||
+          (normal != nullptr && (part.normals.componentCount != 3 ||
+                                 part.normals.count !=
+                                     part.positions.count)) ||
+          (uv != nullptr && (part.uvs.componentCount != 2 ||
+                             part.uvs.count != part.positions.count)) ||
+          (indices != nullptr &&
+           (part.indices.componentCount != 1 ||
+            part.indices.componentType == GLTF_BYTE ||
+            part.indices.componentType == GLTF_SHORT ||
+            part.indices.componentType == GLTF_FLOAT))) {
+        throw std::runtime_error("glTF file " + path +
+                                 " has a primitive with malformed "
+                                 "attributes!");
+      }
+
+      part.indexCount =
+          indices != nullptr ? part.indices.count : part.positions.count;
+      if (part.indexCount % 3 != 0) {
+        throw std::runtime_error("glTF file " + path +
+                                 " has an incomplete triangle!");
+      }
+      unindexed = unindexed || indices == nullptr;
+
+      // normals go through the cofactor matrix, the inverse transpose
+      // scaled by the determinant, which stays valid for non-uniform scale
+      part.transform = draw.second;
+      Vec3 a = vec3(part.transform.columns[0].x, part.transform.columns[0].y,
+                    part.transform.columns[0].z);
+      Vec3 b = vec3(part.transform.columns[1].x, part.transform.columns[1].y,
+                    part.transform.columns[1].z);
+      Vec3 c = vec3(part.transform.columns[2].x, part.transform.columns[2].y,
+                    part.transform.columns[2].z);
+      float determinant = dot(a, cross(b, c));
+      float sign = determinant < 0.0f ? -1.0f : 1.0f;
+      part.normalColumns[0] = cross(b, c) * sign;
+      part.normalColumns[1] = cross(c, a) * sign;
+      part.normalColumns[2] = cross(a, b) * sign;
+      part.flipWinding = determinant < 0.0f;
+
+      part.firstVertex = vertexCount;
+      part.firstIndex = indexCount;
+      vertexCount += part.positions.count;
+      indexCount += part.indexCount;
+      parts.push_back(part);
+    }
+  }
+  checkMeshSize(vertexCount, indexCount, path);
+
+  // split large primitives so they spread over the workers too
+  std::vector<GltfRange> ranges;
+  for (size_t i = 0; i < parts.size(); i++) {
+    size_t triangles = parts[i].indexCount / 3;
+    for (size_t begin = 0; begin < parts[i].positions.count;
+         begin += MESH_CHUNK_ITEMS) {
+      ranges.push_back(GltfRange{
+          i, begin,
+          std::min(parts[i].positions.count, begin + MESH_CHUNK_ITEMS),
+          false});
+    }
+    for (size_t begin = 0; begin < triangles; begin += MESH_CHUNK_ITEMS) {
+      ranges.push_back(GltfRange{
+          i, begin, std::min(triangles, begin + MESH_CHUNK_ITEMS), true});
+    }
+  }
+
+  MeshData mesh;
+  mesh.vertices.resize(vertexCount);
+  mesh.indices.resize(indexCount);
+  {
+    PROFILE_SCOPE("convertGltf");
+    jobs.parallelFor(ranges.size(), [&](size_t i, uint32_t) {
+      convertGltfRange(parts[ranges[i].part], ranges[i], mesh, path);
+    });
+  }
+
+  // without indices every corner has a vertex of its own
+  if (unindexed) {
+    std::vector<uint32_t> remap;
+    deduplicate<MeshVertex, MeshVertexHash, MeshVertexEqual>(
+        jobs, mesh.vertices, remap);
+    size_t chunkCount =
+        (mesh.indices.size() + MESH_CHUNK_ITEMS - 1) / MESH_CHUNK_ITEMS;
+    jobs.parallelFor(chunkCount, [&](size_t chunk, uint32_t) {
+      size_t end =
+          std::min(mesh.indices.size(), (chunk + 1) * MESH_CHUNK_ITEMS);
+      for (size_t i = chunk * MESH_CHUNK_ITEMS; i < end; i++) {
+        mesh.indices[i] = remap[mesh.indices[i]];
+      }
+    });
+  }
+  computeBounds(mesh, jobs);
+  return mesh;
+}
+
+//-------------------------------------------------------------------
+// MeshLoader (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Waits for a load in progress.
+MeshLoader::~MeshLoader() { stop(); }
+
+// Starts loading the mesh at path as a background job, after waiting for
+// any earlier load. A job system without workers loads it at once.
+void MeshLoader::start(const std::string &path, JobSystem *jobs) {
+  stop();
+  finished = false;
+  error = nullptr;
+  result = MeshUpload();
+  loadJobs = jobs;
+  jobs->submitBackground(counter, [this, path, jobs](uint32_t) {
+    load(path, jobs);
+  });
+}
+
+// Hands over the loaded mesh once it is ready. Rethrows the exception the
+// load failed with.
+// ~Returns: true if mesh was filled in, false while still loading or if
+// nothing is waiting.
+bool MeshLoader::poll(MeshUpload *mesh) {
+  if (loadJobs != nullptr && !counter.isDone()) {
+    return false;
+  }
+  stop();
+  if (!finished) {
+    return false;
+  }
+  finished = false;
+  if (error) {
+    std::exception_ptr failure;
+    std::swap(failure, error);
+    std::rethrow_exception(failure);
+  }
+  *mesh = std::move(result);
+  result = MeshUpload();
+  return true;
+}
+
+// Waits for a load in progress. Its mesh is still handed out by poll().
+void MeshLoader::stop() {
+  if (loadJobs == nullptr) {
+    return;
+  }
+  try {
+    loadJobs->wait(counter);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  loadJobs = nullptr;
+  finished = true;
+}
+
+//-------------------------------------------------------------------
+// MeshLoader (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Loads the mesh and packs it into buffer contents.
+void MeshLoader::load(const std::string &path, JobSystem *jobs) {
+  auto startTime = std::chrono::steady_clock::now();
+  MeshData mesh = loadMesh(path, *jobs);
+
+  PROFILE_SCOPE("packMesh");
+  const char *vertices = reinterpret_cast<const char *>(mesh.vertices.data());
+  result.vertexData.assign(
+      vertices, vertices + mesh.vertices.size() * sizeof(MeshVertex));
+  std::vector<MeshVertex>().swap(mesh.vertices);
+  const char *indices = reinterpret_cast<const char *>(mesh.indices.data());
+  result.indexData.assign(
+      indices, indices + mesh.indices.size() * sizeof(uint32_t));
+  result.vertexCount =
+      static_cast<uint32_t>(result.vertexData.size() / sizeof(MeshVertex));
+  result.indexCount = static_cast<uint32_t>(mesh.indices.size());
+  std::copy_n(mesh.boundsMin, 3, result.boundsMin);
+  std::copy_n(mesh.boundsMax, 3, result.boundsMax);
+  result.milliseconds = std::chrono::duration<double, std::milli>(
+                            std::chrono::steady_clock::now() - startTime)
+                            .count();
+}
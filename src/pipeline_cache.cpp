@@ -0,0 +1,154 @@
+//===================================================================
+// File: pipeline_cache.cpp
+//
+// Desc: On-disk persistence for the Vulkan pipeline cache.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/pipeline_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+//-------------------------------------------------------------------
+// Local Functions
+//-------------------------------------------------------------------
+
+// Hashes a buffer with 64 bit FNV-1a to detect truncated or corrupt files.
+// ~Returns: 64 bit hash of the buffer.
+static uint64_t hashCacheData(const char *data, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+// Checks the header the driver places at the start of its own cache blob.
+// ~Returns: true if the blob was produced by this device, false otherwise.
+static bool
+isDriverHeaderValid(const std::vector<char> &data,
+                    const VkPhysicalDeviceProperties &properties) {
+  // headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+  const size_t driverHeaderSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (data.size() < driverHeaderSize) {
+    return false;
+  }
+
+  uint32_t fields[4];
+  std::memcpy(fields, data.data(), sizeof(fields));
+  return fields[0] >= driverHeaderSize &&
+         fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         fields[2] == properties.vendorID &&
+         fields[3] == properties.deviceID &&
+         std::memcmp(data.data() + sizeof(fields),
+                     properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Loads a previously saved pipeline cache blob. Missing, stale or corrupt
+// files are reported and ignored so the caller falls back to an empty cache.
+// ~Returns: cache blob to seed vkCreatePipelineCache with, or an empty
+// vector if there is nothing usable on disk.
+std::vector<char>
+loadPipelineCacheData(const std::string &path,
+                      const VkPhysicalDeviceProperties &properties) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    return {};
+  }
+
+  // read the file header
+  size_t fileSize = static_cast<size_t>(file.tellg());
+  PipelineCacheFileHeader header;
+  if (fileSize < sizeof(header)) {
+    std::cerr << "pipeline cache: " << path << " is truncated, ignoring"
+              << std::endl;
+    return {};
+  }
+  file.seekg(0);
+  file.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+  // reject caches from another device, driver or file format
+  if (header.magic != PIPELINE_CACHE_FILE_MAGIC ||
+      header.version != PIPELINE_CACHE_FILE_VERSION) {
+    std::cerr << "pipeline cache: " << path << " has an unknown format, ignoring"
+              << std::endl;
+    return {};
+  }
+  if (header.vendorID != properties.vendorID ||
+      header.deviceID != properties.deviceID ||
+      header.driverVersion != properties.driverVersion ||
+      std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                  VK_UUID_SIZE) != 0) {
+    std::cerr << "pipeline cache: " << path
+              << " was created by another device or driver, ignoring"
+              << std::endl;
+    return {};
+  }
+  if (header.dataSize != fileSize - sizeof(header)) {
+    std::cerr << "pipeline cache: " << path << " is truncated, ignoring"
+              << std::endl;
+    return {};
+  }
+
+  // read and verify the driver blob
+  std::vector<char> data(static_cast<size_t>(header.dataSize));
+  file.read(data.data(), data.size());
+  if (!file || hashCacheData(data.data(), data.size()) != header.checksum ||
+      !isDriverHeaderValid(data, properties)) {
+    std::cerr << "pipeline cache: " << path << " is corrupt, ignoring"
+              << std::endl;
+    return {};
+  }
+
+  return data;
+}
+
+// Saves a pipeline cache blob with a header identifying the device. The file
+// is written next to the destination and renamed into place so a crash
+// mid-write never leaves a half written cache behind.
+void savePipelineCacheData(const std::string &path,
+                           const VkPhysicalDeviceProperties &properties,
+                           const std::vector<char> &data) {
+  PipelineCacheFileHeader header = {};
+  header.magic = PIPELINE_CACHE_FILE_MAGIC;
+  header.version = PIPELINE_CACHE_FILE_VERSION;
+  header.vendorID = properties.vendorID;
+  header.deviceID = properties.deviceID;
+  header.driverVersion = properties.driverVersion;
+  std::memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+              VK_UUID_SIZE);
+  header.dataSize = data.size();
+  header.checksum = hashCacheData(data.data(), data.size());
+
+  std::string tempPath = path + ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      std::cerr << "pipeline cache: unable to write " << tempPath << std::endl;
+      return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(data.data(), data.size());
+    if (!file) {
+      std::cerr << "pipeline cache: unable to write " << tempPath << std::endl;
+      return;
+    }
+  }
+
+  if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+    std::cerr << "pipeline cache: unable to replace " << path << std::endl;
+    std::remove(tempPath.c_str());
+  }
+}
@@ -0,0 +1,102 @@
+//===================================================================
+// File: presentation_profile.cpp
+//
+// Desc: Presets trading input latency against throughput when
+//       presenting frames.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/presentation_profile.h"
+
+//-------------------------------------------------------------------
+// Local Constants
+//-------------------------------------------------------------------
+
+// FIFO is always supported, so every list ends with it.
+static const PresentationProfile presentationProfiles[] = {
+    {"latency",
+     1,
+     0,
+     {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+      VK_PRESENT_MODE_FIFO_KHR}},
+    {"balanced",
+     2,
+     1,
+     {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR,
+      VK_PRESENT_MODE_FIFO_KHR}},
+    {"throughput",
+     3,
+     2,
+     {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_KHR}},
+};
+
+static_assert(sizeof(presentationProfiles) /
+                      sizeof(presentationProfiles[0]) ==
+                  PRESENTATION_PROFILE_COUNT,
+              "every profile type needs an entry");
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Gets the settings of a presentation profile.
+// ~Returns: PresentationProfile struct for the type.
+const PresentationProfile &
+getPresentationProfile(PresentationProfileType type) {
+  return presentationProfiles[type];
+}
+
+// Looks up a presentation profile by its command line name.
+// ~Returns: the profile type, or nothing if the name is unknown.
+std::optional<PresentationProfileType>
+parsePresentationProfile(const std::string &name) {
+  for (int i = 0; i < PRESENTATION_PROFILE_COUNT; i++) {
+    if (name == presentationProfiles[i].name) {
+      return static_cast<PresentationProfileType>(i);
+    }
+  }
+  return std::nullopt;
+}
+
+// Gets the profile after the given one, wrapping around.
+// ~Returns: the next profile type.
+PresentationProfileType nextPresentationProfile(PresentationProfileType type) {
+  return static_cast<PresentationProfileType>((type + 1) %
+                                              PRESENTATION_PROFILE_COUNT);
+}
+
+// Looks up a present mode by its command line name.
+// ~Returns: the present mode, or nothing if the name is unknown.
+std::optional<VkPresentModeKHR> parsePresentMode(const std::string &name) {
+  if (name == "immediate") {
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  } else if (name == "mailbox") {
+    return VK_PRESENT_MODE_MAILBOX_KHR;
+  } else if (name == "fifo") {
+    return VK_PRESENT_MODE_FIFO_KHR;
+  } else if (name == "fifo-relaxed") {
+    return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+  }
+  return std::nullopt;
+}
+
+// Gets the command line name of a present mode.
+// ~Returns: name of the present mode, "unknown" for other modes.
+const char *presentModeName(VkPresentModeKHR presentMode) {
+  switch (presentMode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "immediate";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "mailbox";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "fifo";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "fifo-relaxed";
+  default:
+    return "unknown";
+  }
+}
@@ -0,0 +1,180 @@
+//===================================================================
+// File: profiler.cpp
+//
+// Desc: Low overhead scoped CPU timers recorded into per-thread ring
+//       buffers and exported as Chrome trace JSON.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/profiler.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Local Types
+//-------------------------------------------------------------------
+
+namespace {
+
+// Exported timestamps count from here, so they stay small enough to keep
+// sub-microsecond digits.
+const uint64_t sessionStartNs = Profiler::now();
+
+struct TraceEvent {
+  const char *name;
+  uint64_t start; // nanoseconds
+  uint64_t end;   // nanoseconds
+};
+
+// Ring buffer written by exactly one thread. writeIndex counts every event
+// ever written; the slot of event i is i % capacity.
+struct ThreadTraceBuffer {
+  std::vector<TraceEvent> events =
+      std::vector<TraceEvent>(PROFILER_EVENTS_PER_THREAD);
+  std::atomic<uint64_t> writeIndex{0};
+  uint32_t threadId = 0;
+  std::string threadName;
+};
+
+// Buffers of every thread that ever recorded a span. Buffers are kept alive
+// after their thread exits so its spans still show up in exports.
+struct TraceRegistry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+};
+
+TraceRegistry &registry() {
+  static TraceRegistry instance;
+  return instance;
+}
+
+// Gets the calling thread's buffer, registering it on first use. Only this
+// first call takes a lock.
+ThreadTraceBuffer &threadBuffer() {
+  thread_local std::shared_ptr<ThreadTraceBuffer> buffer;
+  if (!buffer) {
+    buffer = std::make_shared<ThreadTraceBuffer>();
+    TraceRegistry &traces = registry();
+    std::lock_guard<std::mutex> lock(traces.mutex);
+    buffer->threadId = static_cast<uint32_t>(traces.buffers.size() + 1);
+    buffer->threadName = "thread " + std::to_string(buffer->threadId);
+    traces.buffers.push_back(buffer);
+  }
+  return *buffer;
+}
+
+// Escapes a string for use inside a JSON string literal.
+std::string escapeJson(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += ' ';
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+} // namespace
+
+//-------------------------------------------------------------------
+// Profiler (Static Member Variables)
+//-------------------------------------------------------------------
+
+std::atomic<bool> Profiler::enabledFlag{true};
+
+//-------------------------------------------------------------------
+// Profiler (Public Static Methods)
+//-------------------------------------------------------------------
+
+// Appends a completed span to the calling thread's ring buffer.
+void Profiler::record(const char *name, uint64_t startNs, uint64_t endNs) {
+  ThreadTraceBuffer &buffer = threadBuffer();
+  uint64_t index = buffer.writeIndex.load(std::memory_order_relaxed);
+  buffer.events[index % PROFILER_EVENTS_PER_THREAD] = {name, startNs, endNs};
+  buffer.writeIndex.store(index + 1, std::memory_order_release);
+}
+
+// Names the calling thread in exported traces.
+void Profiler::setThreadName(const std::string &name) {
+  ThreadTraceBuffer &buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  buffer.threadName = name;
+}
+
+// Writes every thread's recorded spans to a Chrome trace JSON file that can
+// be opened in chrome://tracing or Perfetto.
+// ~Returns: true if the file was written, false otherwise.
+bool Profiler::exportChromeTrace(const std::string &path) {
+  std::vector<std::shared_ptr<ThreadTraceBuffer>> buffers;
+  {
+    TraceRegistry &traces = registry();
+    std::lock_guard<std::mutex> lock(traces.mutex);
+    buffers = traces.buffers;
+  }
+
+  std::ofstream file(path);
+  if (!file.is_open()) {
+    return false;
+  }
+
+  // microseconds since the session started, to the nanosecond
+  file << std::fixed << std::setprecision(3);
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for (const auto &buffer : buffers) {
+    std::string threadName;
+    {
+      std::lock_guard<std::mutex> lock(registry().mutex);
+      threadName = buffer->threadName;
+    }
+    file << (first ? "" : ",") << "\n{\"ph\":\"M\",\"pid\":1,\"tid\":"
+         << buffer->threadId
+         << ",\"name\":\"thread_name\",\"args\":{\"name\":\""
+         << escapeJson(threadName) << "\"}}";
+    first = false;
+
+    // copy the live window of the ring, then drop anything the owning
+    // thread may have overwritten during the copy
+    uint64_t end = buffer->writeIndex.load(std::memory_order_acquire);
+    uint64_t begin =
+        end > PROFILER_EVENTS_PER_THREAD ? end - PROFILER_EVENTS_PER_THREAD : 0;
+    std::vector<TraceEvent> events;
+    events.reserve(static_cast<size_t>(end - begin));
+    for (uint64_t i = begin; i < end; i++) {
+      events.push_back(buffer->events[i % PROFILER_EVENTS_PER_THREAD]);
+    }
+    // the slot of event `after` may be mid-write as well
+    uint64_t after = buffer->writeIndex.load(std::memory_order_acquire);
+    uint64_t firstValid = after >= PROFILER_EVENTS_PER_THREAD
+                              ? after - PROFILER_EVENTS_PER_THREAD + 1
+                              : 0;
+
+    for (uint64_t i = begin; i < end; i++) {
+      if (i < firstValid) {
+        continue;
+      }
+      const TraceEvent &event = events[static_cast<size_t>(i - begin)];
+      file << ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+           << ",\"name\":\"" << escapeJson(event.name)
+           << "\",\"ts\":"
+           << static_cast<int64_t>(event.start - sessionStartNs) / 1000.0
+           << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+    }
+  }
+  file << "\n]}\n";
+
+  return static_cast<bool>(file);
+}
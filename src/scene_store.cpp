@@ -0,0 +1,294 @@
+//===================================================================
+// File: scene_store.cpp
+//
+// Desc: Scene objects stored as separate arrays per attribute, with
+//       world matrices propagated level by level as parallel jobs.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/scene_store.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Local Functions
+//-------------------------------------------------------------------
+
+// Splits [begin, end) into SCENE_CHUNK_SIZE chunks and runs task on each,
+// as jobs when there is more than one.
+static void forEachChunk(JobSystem &jobs, size_t begin, size_t end,
+                         const JobSystem::Task &task) {
+  size_t chunks = (end - begin + SCENE_CHUNK_SIZE - 1) / SCENE_CHUNK_SIZE;
+  if (chunks == 1) {
+    task(0, 0);
+  } else {
+    jobs.parallelFor(chunks, task);
+  }
+}
+
+// Reorders values so that values[i] becomes the old values[order[i]].
+template <typename T>
+static void permute(std::vector<T> &values,
+                    const std::vector<uint32_t> &order) {
+  std::vector<T> sorted;
+  sorted.reserve(values.size());
+  for (uint32_t slot : order) {
+    sorted.push_back(values[slot]);
+  }
+  values.swap(sorted);
+}
+
+//-------------------------------------------------------------------
+// SceneStore (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Reserves room for count objects, so adding them doesn't reallocate.
+void SceneStore::reserve(size_t count) {
+  positions.reserve(count);
+  rotations.reserve(count);
+  scales.reserve(count);
+  colors.reserve(count);
+  parents.reserve(count);
+  levels.reserve(count);
+  worldMatrices.reserve(count);
+  dirty.reserve(count);
+  versions.reserve(count);
+  slotToId.reserve(count);
+  idToSlot.reserve(count);
+}
+
+// Adds an object under parent, or as a root when parent is
+// SCENE_NO_PARENT. Its world matrix is valid after the next propagate().
+// Ids are handed out in order, starting at 0.
+// ~Returns: id of the new object.
+SceneStore::ObjectId SceneStore::add(ObjectId parent, const Vec3 &position,
+                                     const Quat &rotation, const Vec3 &scale,
+                                     const Vec4 &color) {
+  uint32_t parentSlot = SCENE_NO_PARENT;
+  uint32_t level = 0;
+  if (parent != SCENE_NO_PARENT) {
+    if (parent >= idToSlot.size()) {
+      throw std::runtime_error("unknown parent object!");
+    }
+    parentSlot = idToSlot[parent];
+    level = levels[parentSlot] + 1;
+  }
+
+  // appending keeps the slots sorted unless the object is shallower than
+  // the deepest level so far
+  if (levelStarts.empty()) {
+    levelStarts.push_back(0);
+  }
+  uint32_t deepest = levelCount();
+  if (level == deepest) {
+    levelStarts.push_back(levelStarts.back() + 1);
+    levelDirtyCounts.push_back(0);
+  } else if (level + 1 == deepest && ordered) {
+    levelStarts.back()++;
+  } else {
+    ordered = false;
+  }
+
+  uint32_t slot = static_cast<uint32_t>(positions.size());
+  ObjectId id = static_cast<ObjectId>(idToSlot.size());
+  positions.push_back(position);
+  rotations.push_back(rotation);
+  scales.push_back(scale);
+  colors.push_back(color);
+  parents.push_back(parentSlot);
+  levels.push_back(level);
+  worldMatrices.push_back(mat4Identity());
+  dirty.push_back(0);
+  versions.push_back(0);
+  slotToId.push_back(id);
+  idToSlot.push_back(slot);
+  markDirty(slot);
+  return id;
+}
+
+// Moves an object relative to its parent.
+void SceneStore::setPosition(ObjectId id, const Vec3 &position) {
+  uint32_t slot = idToSlot[id];
+  positions[slot] = position;
+  markDirty(slot);
+}
+
+// Rotates an object relative to its parent.
+void SceneStore::setRotation(ObjectId id, const Quat &rotation) {
+  uint32_t slot = idToSlot[id];
+  rotations[slot] = rotation;
+  markDirty(slot);
+}
+
+// Scales an object relative to its parent.
+void SceneStore::setScale(ObjectId id, const Vec3 &scale) {
+  uint32_t slot = idToSlot[id];
+  scales[slot] = scale;
+  markDirty(slot);
+}
+
+// Changes the color written with an object's instance.
+void SceneStore::setColor(ObjectId id, const Vec4 &color) {
+  uint32_t slot = idToSlot[id];
+  colors[slot] = color;
+  markDirty(slot);
+}
+
+// Gets an object's world matrix as of the last propagate().
+// ~Returns: the world matrix.
+const Mat4 &SceneStore::worldMatrix(ObjectId id) const {
+  return worldMatrices[idToSlot[id]];
+}
+
+// Recomputes the world matrices of dirty objects and of everything below
+// them, one level at a time with each level split into jobs.
+// ~Returns: number of world matrices that changed.
+size_t SceneStore::propagate(JobSystem &jobs) {
+  if (dirtyCount == 0) {
+    return 0;
+  }
+  if (!ordered) {
+    sortByLevel();
+  }
+
+  // objects whose world changed in this pass carry the new version, which
+  // is how their children notice without a separate flag to clear
+  uint32_t current = ++version;
+  size_t changed = 0;
+  bool parentsChanged = false;
+  std::vector<size_t> chunkChanged;
+  for (uint32_t level = 0; level < levelCount(); level++) {
+    if (levelDirtyCounts[level] == 0 && !parentsChanged) {
+      continue;
+    }
+
+    size_t begin = levelStarts[level];
+    size_t end = levelStarts[level + 1];
+    chunkChanged.assign(
+        (end - begin + SCENE_CHUNK_SIZE - 1) / SCENE_CHUNK_SIZE, 0);
+    forEachChunk(jobs, begin, end, [&](size_t chunk, uint32_t) {
+      size_t first = begin + chunk * SCENE_CHUNK_SIZE;
+      size_t last = std::min(first + SCENE_CHUNK_SIZE, end);
+      size_t count = 0;
+      for (size_t i = first; i < last; i++) {
+        uint32_t parent = parents[i];
+        bool moved = parent != SCENE_NO_PARENT && versions[parent] == current;
+        if (!dirty[i] && !moved) {
+          continue;
+        }
+        Mat4 local = mat4Compose(positions[i], rotations[i], scales[i]);
+        worldMatrices[i] = parent == SCENE_NO_PARENT
+                               ? local
+                               : mat4Mul(worldMatrices[parent], local);
+        dirty[i] = 0;
+        versions[i] = current;
+        count++;
+      }
+      chunkChanged[chunk] = count;
+    });
+
+    size_t levelChanged =
+        std::accumulate(chunkChanged.begin(), chunkChanged.end(), size_t(0));
+    changed += levelChanged;
+    parentsChanged = levelChanged > 0;
+    levelDirtyCounts[level] = 0;
+  }
+  dirtyCount = 0;
+  return changed;
+}
+
+// Writes the world matrices and colors that changed since region was last
+// written into out, one instance per object. Call after propagate().
+// ~Returns: number of instances written.
+size_t SceneStore::writeInstances(InstanceData *out, size_t capacity,
+                                  uint32_t region, JobSystem &jobs) {
+  if (size() > capacity) {
+    throw std::runtime_error("scene has more objects than instances!");
+  }
+  if (region >= regionVersions.size()) {
+    regionVersions.resize(region + 1, 0);
+  }
+  uint32_t since = regionVersions[region];
+  if (since == version || size() == 0) {
+    return 0;
+  }
+
+  std::vector<size_t> chunkWritten(
+      (size() + SCENE_CHUNK_SIZE - 1) / SCENE_CHUNK_SIZE, 0);
+  forEachChunk(jobs, 0, size(), [&](size_t chunk, uint32_t) {
+    size_t first = chunk * SCENE_CHUNK_SIZE;
+    size_t last = std::min(first + SCENE_CHUNK_SIZE, size());
+    size_t count = 0;
+    for (size_t i = first; i < last; i++) {
+      if (versions[i] > since) {
+        std::memcpy(out[i].transform, &worldMatrices[i], sizeof(Mat4));
+        std::memcpy(out[i].color, &colors[i], sizeof(Vec4));
+        count++;
+      }
+    }
+    chunkWritten[chunk] = count;
+  });
+  regionVersions[region] = version;
+  return std::accumulate(chunkWritten.begin(), chunkWritten.end(), size_t(0));
+}
+
+//-------------------------------------------------------------------
+// SceneStore (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Flags an object for recomputation by the next propagate().
+void SceneStore::markDirty(uint32_t slot) {
+  if (!dirty[slot]) {
+    dirty[slot] = 1;
+    levelDirtyCounts[levels[slot]]++;
+    dirtyCount++;
+  }
+}
+
+// Reorders the slots by level, keeping the order within a level, and
+// rebuilds the level ranges. Instances move, so every region of the
+// instance buffer is rewritten in full afterwards.
+void SceneStore::sortByLevel() {
+  std::vector<uint32_t> order(size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return levels[a] < levels[b];
+  });
+
+  std::vector<uint32_t> newSlots(size());
+  for (uint32_t slot = 0; slot < order.size(); slot++) {
+    newSlots[order[slot]] = slot;
+  }
+  permute(positions, order);
+  permute(rotations, order);
+  permute(scales, order);
+  permute(colors, order);
+  permute(parents, order);
+  permute(levels, order);
+  permute(worldMatrices, order);
+  permute(dirty, order);
+  permute(versions, order);
+  permute(slotToId, order);
+  for (uint32_t slot = 0; slot < size(); slot++) {
+    if (parents[slot] != SCENE_NO_PARENT) {
+      parents[slot] = newSlots[parents[slot]];
+    }
+    idToSlot[slotToId[slot]] = slot;
+  }
+
+  levelStarts.assign(levelCount() + 1, 0);
+  for (uint32_t level : levels) {
+    levelStarts[level + 1]++;
+  }
+  std::partial_sum(levelStarts.begin(), levelStarts.end(),
+                   levelStarts.begin());
+  std::fill(regionVersions.begin(), regionVersions.end(), 0);
+  ordered = true;
+}
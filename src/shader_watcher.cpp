@@ -0,0 +1,197 @@
+//===================================================================
+// File: shader_watcher.cpp
+//
+// Desc: Watches the shader directory and recompiles changed GLSL to
+//       SPIR-V on a background thread.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/shader_watcher.h"
+#include "../includes/profiler.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Maps a GLSL source to the SPIR-V file compile.sh produces for it.
+// glslangValidator names its default output after the stage, which
+// compile.sh keeps for shader.vert and shader.frag; every other source is
+// compiled to <name>.spv.
+// ~Returns: path of the SPIR-V file next to the source.
+std::string spirvPathForShader(const std::string &sourcePath) {
+  size_t slash = sourcePath.find_last_of('/');
+  std::string directory =
+      slash == std::string::npos ? "" : sourcePath.substr(0, slash + 1);
+  std::string name = sourcePath.substr(directory.size());
+  size_t dot = name.find_last_of('.');
+  std::string stem = name.substr(0, dot);
+  std::string stage = dot == std::string::npos ? "" : name.substr(dot + 1);
+  return directory + (stem == "shader" ? stage : stem) + ".spv";
+}
+
+// Checks whether a file name has one of the shader stage extensions.
+// ~Returns: true for .vert, .frag and .comp files.
+static bool isShaderSource(const std::string &name) {
+  size_t dot = name.find_last_of('.');
+  if (dot == std::string::npos) {
+    return false;
+  }
+  std::string extension = name.substr(dot + 1);
+  return extension == "vert" || extension == "frag" || extension == "comp";
+}
+
+//-------------------------------------------------------------------
+// ShaderWatcher (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Stops watching.
+ShaderWatcher::~ShaderWatcher() { stop(); }
+
+// Starts watching directory on a background thread, calling onCompiled
+// with the path of every SPIR-V file rebuilt from a changed source.
+// ~Returns: false if the directory can't be watched.
+bool ShaderWatcher::start(const std::string &directory, Callback onCompiled) {
+  stop();
+  this->directory = directory;
+  this->onCompiled = std::move(onCompiled);
+  stopping = false;
+
+#ifdef __linux__
+  // editors either rewrite a file in place or move a new one over it
+  inotifyFd = inotify_init1(IN_CLOEXEC);
+  if (inotifyFd < 0 ||
+      inotify_add_watch(inotifyFd, directory.c_str(),
+                        IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+      pipe(wakeFds) != 0) {
+    std::cerr << "failed to watch " << directory << " for shader changes"
+              << std::endl;
+    stop();
+    return false;
+  }
+  thread = std::thread(&ShaderWatcher::watchLoop, this);
+  return true;
+#else
+  std::cerr << "shader hot reload needs inotify and is unavailable"
+            << std::endl;
+  return false;
+#endif
+}
+
+// Stops the watcher thread. A build already handed to the callback is
+// finished first.
+void ShaderWatcher::stop() {
+#ifdef __linux__
+  stopping = true;
+  if (thread.joinable()) {
+    // if the wake up fails the thread still stops after its next event
+    char wake = 0;
+    ssize_t written = write(wakeFds[1], &wake, 1);
+    (void)written;
+    thread.join();
+  }
+  auto closeFd = [](int &fd) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  };
+  closeFd(inotifyFd);
+  closeFd(wakeFds[0]);
+  closeFd(wakeFds[1]);
+#endif
+}
+
+//-------------------------------------------------------------------
+// ShaderWatcher (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Collects changed sources until the directory has been quiet for the
+// debounce period, then compiles each of them once.
+void ShaderWatcher::watchLoop() {
+#ifdef __linux__
+  Profiler::setThreadName("shader watcher");
+  std::set<std::string> changed;
+  alignas(inotify_event) char buffer[4096];
+
+  while (!stopping) {
+    pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wakeFds[0], POLLIN, 0}};
+    int timeout = changed.empty() ? -1 : SHADER_WATCH_DEBOUNCE_MS;
+    int ready = poll(fds, 2, timeout);
+    if (ready < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "shader watcher stopped: poll failed" << std::endl;
+      return;
+    }
+    if (fds[1].revents != 0) {
+      return;
+    }
+
+    // quiet period over, rebuild everything that changed
+    if (ready == 0) {
+      for (const auto &sourcePath : changed) {
+        PROFILE_SCOPE("recompileShader");
+        std::string spirvPath = spirvPathForShader(sourcePath);
+        if (!compile(sourcePath, spirvPath)) {
+          std::cerr << "failed to compile " << sourcePath
+                    << ", keeping the previous pipeline" << std::endl;
+          continue;
+        }
+        try {
+          onCompiled(spirvPath);
+        } catch (const std::exception &e) {
+          std::cerr << "shader reload failed: " << e.what() << std::endl;
+        }
+      }
+      changed.clear();
+      continue;
+    }
+
+    ssize_t length = read(inotifyFd, buffer, sizeof(buffer));
+    for (ssize_t offset = 0; offset < length;) {
+      auto event = reinterpret_cast<const inotify_event *>(buffer + offset);
+      if (event->len > 0 && isShaderSource(event->name)) {
+        changed.insert(directory + "/" + event->name);
+      }
+      offset += sizeof(inotify_event) + event->len;
+    }
+  }
+#endif
+}
+
+// Compiles sourcePath into a temporary file and renames it to spirvPath.
+// Compiler errors are printed by glslangValidator itself.
+// ~Returns: true if spirvPath now holds the new module.
+bool ShaderWatcher::compile(const std::string &sourcePath,
+                            const std::string &spirvPath) {
+  const char *sdk = std::getenv("VULKAN_SDK");
+  std::string compiler = sdk != nullptr
+                             ? std::string(sdk) + "/bin/glslangValidator"
+                             : "glslangValidator";
+  std::string tempPath = spirvPath + ".tmp";
+  std::string command = "\"" + compiler + "\" -V \"" + sourcePath +
+                        "\" -o \"" + tempPath + "\"";
+  if (std::system(command.c_str()) != 0) {
+    std::remove(tempPath.c_str());
+    return false;
+  }
+  return std::rename(tempPath.c_str(), spirvPath.c_str()) == 0;
+}
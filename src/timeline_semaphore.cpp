@@ -0,0 +1,70 @@
+//===================================================================
+// File: timeline_semaphore.cpp
+//
+// Desc: Vulkan 1.2 timeline semaphore with a monotonically increasing
+//       signal value.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/timeline_semaphore.h"
+
+#include <limits>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// TimelineSemaphore (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the semaphore with a value of 0.
+void TimelineSemaphore::init(VkDevice device) {
+  this->device = device;
+  lastValue = 0;
+
+  VkSemaphoreTypeCreateInfo typeInfo = {};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+  if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+}
+
+// Destroys the semaphore. No submission may still signal or wait on it.
+void TimelineSemaphore::destroy() {
+  if (semaphore != VK_NULL_HANDLE) {
+    vkDestroySemaphore(device, semaphore, nullptr);
+    semaphore = VK_NULL_HANDLE;
+  }
+}
+
+// Reads the value the GPU has reached. Never waits.
+// ~Returns: the semaphore's current value.
+uint64_t TimelineSemaphore::completedValue() const {
+  uint64_t value = 0;
+  if (vkGetSemaphoreCounterValue(device, semaphore, &value) != VK_SUCCESS) {
+    throw std::runtime_error("failed to read timeline semaphore!");
+  }
+  return value;
+}
+
+// Blocks until the semaphore reaches value.
+void TimelineSemaphore::wait(uint64_t value) const {
+  VkSemaphoreWaitInfo waitInfo = {};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &semaphore;
+  waitInfo.pValues = &value;
+  if (vkWaitSemaphores(device, &waitInfo,
+                       std::numeric_limits<uint64_t>::max()) != VK_SUCCESS) {
+    throw std::runtime_error("failed to wait for timeline semaphore!");
+  }
+}
@@ -0,0 +1,90 @@
+//===================================================================
+// File: uniform_ring.cpp
+//
+// Desc: Per-frame uniform data written into one persistently mapped
+//       buffer and addressed with dynamic offsets.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/uniform_ring.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// UniformRing (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the buffer with a UNIFORM_RING_FRAME_SIZE region for each frame
+// in flight.
+void UniformRing::init(VkDevice device, DeviceAllocator *allocator,
+                       uint32_t framesInFlight,
+                       VkDeviceSize minOffsetAlignment) {
+  this->device = device;
+  this->allocator = allocator;
+  alignment = std::max<VkDeviceSize>(minOffsetAlignment, 1);
+  regionStart = 0;
+  head = 0;
+
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = UNIFORM_RING_FRAME_SIZE * framesInFlight;
+  bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create uniform ring buffer!");
+  }
+
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+  memory = allocator->allocate(memRequirements,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               ALLOCATION_KIND_LINEAR);
+  vkBindBufferMemory(device, buffer, memory.memory, memory.offset);
+}
+
+// Destroys the buffer and returns its memory.
+void UniformRing::destroy() {
+  if (buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator->free(memory);
+    buffer = VK_NULL_HANDLE;
+  }
+}
+
+// Starts writing a frame's region from the beginning. The frame's previous
+// submission must have completed.
+void UniformRing::beginFrame(uint32_t frame) {
+  regionStart = frame * UNIFORM_RING_FRAME_SIZE;
+  head = 0;
+}
+
+// Copies size bytes of uniform data into the current frame's region.
+// ~Returns: dynamic offset to bind the data with.
+uint32_t UniformRing::push(const void *data, VkDeviceSize size) {
+  VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+  if (offset + size > UNIFORM_RING_FRAME_SIZE) {
+    throw std::runtime_error("uniform ring frame region is full!");
+  }
+  std::memcpy(static_cast<char *>(memory.mapped) + regionStart + offset, data,
+              static_cast<size_t>(size));
+  head = offset + size;
+  return static_cast<uint32_t>(regionStart + offset);
+}
+
+// Describes the buffer for a dynamic uniform buffer descriptor whose
+// blocks are range bytes long.
+// ~Returns: VkDescriptorBufferInfo struct starting at the buffer's start.
+VkDescriptorBufferInfo UniformRing::descriptorInfo(VkDeviceSize range) const {
+  VkDescriptorBufferInfo bufferInfo = {};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = 0;
+  bufferInfo.range = range;
+  return bufferInfo;
+}
@@ -0,0 +1,333 @@
+//===================================================================
+// File: upload_queue.cpp
+//
+// Desc: Streams buffer data to the GPU through a staging ring on a
+//       transfer queue.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/upload_queue.h"
+#include "../includes/profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Local Constants
+//-------------------------------------------------------------------
+
+static const VkDeviceSize UPLOAD_COPY_ALIGNMENT = 16;
+
+//-------------------------------------------------------------------
+// UploadQueue (Public Class Methods)
+//-------------------------------------------------------------------
+
+// Creates the staging ring, the command buffers of each batch, and either
+// a fence and semaphore per batch or one timeline semaphore.
+void UploadQueue::init(VkDevice device, DeviceAllocator *allocator,
+                       uint32_t graphicsFamily, uint32_t transferFamily,
+                       VkQueue transferQueue, bool timeline,
+                       VkDeviceSize ringSize, VkDeviceSize frameBudget) {
+  this->device = device;
+  this->allocator = allocator;
+  this->graphicsFamily = graphicsFamily;
+  this->transferFamily = transferFamily;
+  this->transferQueue = transferQueue;
+  this->timeline = timeline;
+  this->ringSize = ringSize;
+  this->frameBudget = frameBudget;
+
+  // staging ring, host visible and mapped for as long as it lives
+  VkBufferCreateInfo bufferInfo = {};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = ringSize;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &ringBuffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create staging ring buffer!");
+  }
+  VkMemoryRequirements memRequirements;
+  vkGetBufferMemoryRequirements(device, ringBuffer, &memRequirements);
+  ringMemory = allocator->allocate(memRequirements,
+                                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                   ALLOCATION_KIND_LINEAR);
+  vkBindBufferMemory(device, ringBuffer, ringMemory.memory, ringMemory.offset);
+
+  // one transient pool per batch, reset whenever the batch is reused
+  VkCommandPoolCreateInfo poolInfo = {};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.queueFamilyIndex = transferFamily;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  VkFenceCreateInfo fenceInfo = {};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+  VkSemaphoreCreateInfo semaphoreInfo = {};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  if (timeline) {
+    timelineSemaphore.init(device);
+  }
+
+  batches.resize(UPLOAD_BATCH_COUNT);
+  for (auto &batch : batches) {
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &batch.pool) !=
+            VK_SUCCESS ||
+        (!timeline && vkCreateFence(device, &fenceInfo, nullptr,
+                                    &batch.fence) != VK_SUCCESS)) {
+      throw std::runtime_error("failed to create upload batch!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = batch.pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &batch.commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate upload command buffer!");
+    }
+
+    // only needed to hand ownership over to another queue family
+    if (!timeline && usesTransferQueue() &&
+        vkCreateSemaphore(device, &semaphoreInfo, nullptr, &batch.semaphore) !=
+            VK_SUCCESS) {
+      throw std::runtime_error("failed to create upload semaphore!");
+    }
+  }
+}
+
+// Destroys the ring and the batches. The device must be idle.
+void UploadQueue::destroy() {
+  for (auto &batch : batches) {
+    vkDestroySemaphore(device, batch.semaphore, nullptr);
+    vkDestroyFence(device, batch.fence, nullptr);
+    vkDestroyCommandPool(device, batch.pool, nullptr);
+  }
+  batches.clear();
+  inFlight.clear();
+  pending.clear();
+  acquireBarriers.clear();
+  timelineSemaphore.destroy();
+
+  if (ringBuffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, ringBuffer, nullptr);
+    allocator->free(ringMemory);
+    ringBuffer = VK_NULL_HANDLE;
+  }
+}
+
+// Queues data to be copied into a buffer at the given offset. The buffer
+// must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT and may not
+// be read until the upload completes.
+// ~Returns: ticket to poll with isComplete().
+UploadTicket UploadQueue::upload(VkBuffer buffer, VkDeviceSize offset,
+                                 std::vector<char> data) {
+  UploadTicket ticket = nextTicket++;
+  if (data.empty()) {
+    completedTicket = std::max(completedTicket, ticket);
+    return ticket;
+  }
+  pending.push_back({ticket, buffer, offset, std::move(data), 0});
+  return ticket;
+}
+
+// Retires batches whose fence or timeline value has signaled, freeing their
+// part of the ring. Never waits.
+void UploadQueue::collect() {
+  if (inFlight.empty()) {
+    return;
+  }
+  uint64_t completedValue = timeline ? timelineSemaphore.completedValue() : 0;
+  while (!inFlight.empty()) {
+    Batch &batch = batches[inFlight.front()];
+    bool complete = timeline
+                        ? batch.timelineValue <= completedValue
+                        : vkGetFenceStatus(device, batch.fence) == VK_SUCCESS;
+    if (!complete) {
+      break;
+    }
+    ringTail = batch.ringEnd;
+    completedTicket = std::max(completedTicket, batch.lastTicket);
+    inFlight.pop_front();
+  }
+}
+
+// Stages up to the frame budget of queued data and submits the copies.
+// ~Returns: semaphore the next graphics submit must wait on at
+// UPLOAD_CONSUMER_STAGES, or VK_NULL_HANDLE if there is none. For a timeline
+// semaphore the value to wait for is stored in waitValue.
+VkSemaphore UploadQueue::flush(uint64_t *waitValue) {
+  PROFILE_SCOPE("UploadQueue::flush");
+  *waitValue = 0;
+  if (pending.empty() || inFlight.size() == batches.size()) {
+    return VK_NULL_HANDLE;
+  }
+
+  // stage as much as the budget and the free part of the ring allow
+  struct Copy {
+    VkBuffer buffer;
+    VkBufferCopy region;
+  };
+  std::vector<Copy> copies;
+  UploadTicket lastTicket = 0;
+  VkDeviceSize budget = frameBudget;
+  while (!pending.empty() && budget > 0) {
+    PendingUpload &upload = pending.front();
+    VkDeviceSize chunk =
+        std::min({upload.data.size() - upload.copied, budget, ringSize / 4});
+    VkDeviceSize ringOffset;
+    if (!reserveRing(chunk, &ringOffset)) {
+      break;
+    }
+    std::memcpy(static_cast<char *>(ringMemory.mapped) + ringOffset,
+                upload.data.data() + upload.copied, chunk);
+    copies.push_back(
+        {upload.buffer, {ringOffset, upload.offset + upload.copied, chunk}});
+
+    upload.copied += chunk;
+    budget -= chunk;
+    if (upload.copied == upload.data.size()) {
+      lastTicket = upload.ticket;
+      pending.pop_front();
+    }
+  }
+  if (copies.empty()) {
+    return VK_NULL_HANDLE;
+  }
+
+  size_t batchIndex = nextBatch;
+  nextBatch = (nextBatch + 1) % batches.size();
+  Batch &batch = batches[batchIndex];
+  batch.ringEnd = ringHead;
+  batch.lastTicket = lastTicket;
+
+  vkResetCommandPool(device, batch.pool, 0);
+  VkCommandBufferBeginInfo beginInfo = {};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin upload command buffer!");
+  }
+
+  std::vector<VkBufferMemoryBarrier> barriers;
+  for (const auto &copy : copies) {
+    vkCmdCopyBuffer(batch.commandBuffer, ringBuffer, copy.buffer, 1,
+                    &copy.region);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = copy.buffer;
+    barrier.offset = copy.region.dstOffset;
+    barrier.size = copy.region.size;
+
+    // release on the transfer queue, the matching acquire is recorded on the
+    // graphics queue by recordAcquireBarriers()
+    if (usesTransferQueue()) {
+      barrier.dstAccessMask = 0;
+      barrier.srcQueueFamilyIndex = transferFamily;
+      barrier.dstQueueFamilyIndex = graphicsFamily;
+
+      VkBufferMemoryBarrier acquire = barrier;
+      acquire.srcAccessMask = 0;
+      acquire.dstAccessMask = UPLOAD_CONSUMER_ACCESS;
+      acquireBarriers.push_back(acquire);
+    }
+    barriers.push_back(barrier);
+  }
+  VkPipelineStageFlags dstStages = usesTransferQueue()
+                                       ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                                       : UPLOAD_CONSUMER_STAGES;
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       dstStages, 0, 0, nullptr,
+                       static_cast<uint32_t>(barriers.size()), barriers.data(),
+                       0, nullptr);
+
+  if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record upload command buffer!");
+  }
+
+  VkSubmitInfo submitInfo = {};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+  VkSemaphore signalSemaphore = batch.semaphore;
+  VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+  if (timeline) {
+    // the timeline value also stands in for the batch's fence, so it is
+    // signaled even when nothing waits on it
+    signalSemaphore = timelineSemaphore.handle();
+    batch.timelineValue = timelineSemaphore.nextValue();
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.signalSemaphoreValueCount = 1;
+    timelineInfo.pSignalSemaphoreValues = &batch.timelineValue;
+    submitInfo.pNext = &timelineInfo;
+  }
+  if (timeline || usesTransferQueue()) {
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signalSemaphore;
+  }
+  if (!timeline) {
+    vkResetFences(device, 1, &batch.fence);
+  }
+  if (vkQueueSubmit(transferQueue, 1, &submitInfo, batch.fence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload command buffer!");
+  }
+  inFlight.push_back(batchIndex);
+
+  if (!usesTransferQueue()) {
+    return VK_NULL_HANDLE;
+  }
+  *waitValue = batch.timelineValue;
+  return signalSemaphore;
+}
+
+// Records the acquire half of the ownership transfers released by the last
+// flush. Must go into the graphics command buffer that waits on its
+// semaphore, outside of a render pass.
+void UploadQueue::recordAcquireBarriers(VkCommandBuffer commandBuffer) {
+  if (acquireBarriers.empty()) {
+    return;
+  }
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       UPLOAD_CONSUMER_STAGES, 0, 0, nullptr,
+                       static_cast<uint32_t>(acquireBarriers.size()),
+                       acquireBarriers.data(), 0, nullptr);
+  acquireBarriers.clear();
+}
+
+//-------------------------------------------------------------------
+// UploadQueue (Private Class Methods)
+//-------------------------------------------------------------------
+
+// Reserves a contiguous range of the staging ring, skipping the tail end of
+// the ring when the range would wrap.
+// ~Returns: true and the range's offset if enough of the ring is free.
+bool UploadQueue::reserveRing(VkDeviceSize size, VkDeviceSize *offset) {
+  uint64_t start = (ringHead + UPLOAD_COPY_ALIGNMENT - 1) &
+                   ~uint64_t(UPLOAD_COPY_ALIGNMENT - 1);
+  VkDeviceSize ringOffset = start % ringSize;
+  if (ringOffset + size > ringSize) {
+    start += ringSize - ringOffset;
+    ringOffset = 0;
+  }
+  if (start + size - ringTail > ringSize) {
+    return false;
+  }
+
+  ringHead = start + size;
+  *offset = ringOffset;
+  return true;
+}
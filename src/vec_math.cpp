@@ -0,0 +1,133 @@
+//===================================================================
+// File: vec_math.cpp
+//
+// Desc: 16 byte aligned vector, matrix and quaternion types with SSE
+//       and AVX2 kernels and a scalar fallback.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/vec_math.h"
+
+//-------------------------------------------------------------------
+// Local Functions
+//-------------------------------------------------------------------
+
+#if defined(VEC_MATH_AVX2)
+// Multiplies the matrix whose columns are repeated in both halves of m0 to
+// m3 by the two vectors in v, one per half.
+// ~Returns: the two products.
+static inline __m256 mulColumns(__m256 m0, __m256 m1, __m256 m2, __m256 m3,
+                                __m256 v) {
+  __m256 s = _mm256_mul_ps(m0, _mm256_permute_ps(v, 0x00));
+#if defined(__FMA__)
+  s = _mm256_fmadd_ps(m1, _mm256_permute_ps(v, 0x55), s);
+  s = _mm256_fmadd_ps(m2, _mm256_permute_ps(v, 0xaa), s);
+  s = _mm256_fmadd_ps(m3, _mm256_permute_ps(v, 0xff), s);
+#else
+  s = _mm256_add_ps(s, _mm256_mul_ps(m1, _mm256_permute_ps(v, 0x55)));
+  s = _mm256_add_ps(s, _mm256_mul_ps(m2, _mm256_permute_ps(v, 0xaa)));
+  s = _mm256_add_ps(s, _mm256_mul_ps(m3, _mm256_permute_ps(v, 0xff)));
+#endif
+  return s;
+}
+#endif
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Names the kernels compiled in.
+// ~Returns: "avx2", "sse" or "scalar".
+const char *vecMathBackend() {
+#if defined(VEC_MATH_AVX2)
+  return "avx2";
+#elif defined(VEC_MATH_SSE)
+  return "sse";
+#else
+  return "scalar";
+#endif
+}
+
+// Multiplies one matrix by an array of matrices, out[i] = a * b[i], as
+// when applying a view projection to every object. out may alias b.
+void mat4MulBatch(const Mat4 &a, const Mat4 *b, Mat4 *out, size_t count) {
+#if defined(VEC_MATH_AVX2)
+  // a's columns are loaded once for the whole batch; matrices are only
+  // 16 byte aligned, so the 256 bit accesses are unaligned ones
+  const __m128 *ac = reinterpret_cast<const __m128 *>(a.columns);
+  __m256 a0 = _mm256_broadcast_ps(ac + 0);
+  __m256 a1 = _mm256_broadcast_ps(ac + 1);
+  __m256 a2 = _mm256_broadcast_ps(ac + 2);
+  __m256 a3 = _mm256_broadcast_ps(ac + 3);
+  for (size_t i = 0; i < count; i++) {
+    const float *bf = &b[i].columns[0].x;
+    float *rf = &out[i].columns[0].x;
+    __m256 low = mulColumns(a0, a1, a2, a3, _mm256_loadu_ps(bf));
+    __m256 high = mulColumns(a0, a1, a2, a3, _mm256_loadu_ps(bf + 8));
+    _mm256_storeu_ps(rf, low);
+    _mm256_storeu_ps(rf + 8, high);
+  }
+#else
+  for (size_t i = 0; i < count; i++) {
+    out[i] = mat4Mul(a, b[i]);
+  }
+#endif
+}
+
+// Multiplies arrays of matrices element by element, out[i] = a[i] * b[i],
+// as when combining parent and local transforms. out may alias a or b.
+void mat4MulPairs(const Mat4 *a, const Mat4 *b, Mat4 *out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = mat4Mul(a[i], b[i]);
+  }
+}
+
+// Transforms an array of vectors by one matrix, out[i] = m * in[i]. out
+// may alias in.
+void mat4TransformBatch(const Mat4 &m, const Vec4 *in, Vec4 *out,
+                        size_t count) {
+  size_t i = 0;
+#if defined(VEC_MATH_AVX2)
+  // two vectors per iteration, one in each half
+  const __m128 *mc = reinterpret_cast<const __m128 *>(m.columns);
+  __m256 m0 = _mm256_broadcast_ps(mc + 0);
+  __m256 m1 = _mm256_broadcast_ps(mc + 1);
+  __m256 m2 = _mm256_broadcast_ps(mc + 2);
+  __m256 m3 = _mm256_broadcast_ps(mc + 3);
+  for (; i + 2 <= count; i += 2) {
+    __m256 v = _mm256_loadu_ps(&in[i].x);
+    _mm256_storeu_ps(&out[i].x, mulColumns(m0, m1, m2, m3, v));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = mat4MulVec4(m, in[i]);
+  }
+}
+
+// Scalar reference of mat4MulBatch(), for benchmarks and checks.
+void mat4MulBatchScalar(const Mat4 &a, const Mat4 *b, Mat4 *out,
+                        size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = mat4MulScalar(a, b[i]);
+  }
+}
+
+// Scalar reference of mat4MulPairs(), for benchmarks and checks.
+void mat4MulPairsScalar(const Mat4 *a, const Mat4 *b, Mat4 *out,
+                        size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = mat4MulScalar(a[i], b[i]);
+  }
+}
+
+// Scalar reference of mat4TransformBatch(), for benchmarks and checks.
+void mat4TransformBatchScalar(const Mat4 &m, const Vec4 *in, Vec4 *out,
+                              size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    out[i] = mat4MulVec4Scalar(m, in[i]);
+  }
+}
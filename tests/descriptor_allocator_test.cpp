@@ -0,0 +1,249 @@
+//===================================================================
+// File: descriptor_allocator_test.cpp
+//
+// Desc: Tests the descriptor layout cache and descriptor pools without a
+//       GPU, against fake Vulkan entry points.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/descriptor_allocator.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// FakeDevice (Struct Definition)
+//-------------------------------------------------------------------
+
+// What the fake entry points below have been asked to create, so tests
+// can see which layouts and pools exist and how full each pool is.
+struct FakeDevice {
+  struct FakePool {
+    uint32_t maxSets;
+    uint32_t allocated;
+  };
+
+  std::set<VkDescriptorSetLayout> layouts;
+  std::map<VkDescriptorPool, FakePool> pools;
+  size_t layoutsCreated = 0;
+  size_t poolResets = 0;
+  uint64_t nextId = 1;
+
+  // Makes up a handle no other fake object has.
+  template <typename Handle> Handle makeHandle() {
+    uint64_t id = nextId++;
+    static_assert(sizeof(Handle) == sizeof(id),
+                  "handles are 64 bits on every platform");
+    Handle handle;
+    std::memcpy(&handle, &id, sizeof(id));
+    return handle;
+  }
+};
+
+static FakeDevice fakeDevice;
+
+//-------------------------------------------------------------------
+// Fake Vulkan Entry Points
+//-------------------------------------------------------------------
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorSetLayout(VkDevice, const VkDescriptorSetLayoutCreateInfo *,
+                            const VkAllocationCallbacks *,
+                            VkDescriptorSetLayout *pSetLayout) {
+  *pSetLayout = fakeDevice.makeHandle<VkDescriptorSetLayout>();
+  fakeDevice.layouts.insert(*pSetLayout);
+  fakeDevice.layoutsCreated++;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorSetLayout(VkDevice, VkDescriptorSetLayout layout,
+                             const VkAllocationCallbacks *) {
+  if (fakeDevice.layouts.erase(layout) == 0) {
+    throw std::runtime_error("destroyed an unknown layout!");
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorPool(VkDevice, const VkDescriptorPoolCreateInfo *pCreateInfo,
+                       const VkAllocationCallbacks *,
+                       VkDescriptorPool *pDescriptorPool) {
+  *pDescriptorPool = fakeDevice.makeHandle<VkDescriptorPool>();
+  fakeDevice.pools[*pDescriptorPool] = {pCreateInfo->maxSets, 0};
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorPool(VkDevice, VkDescriptorPool descriptorPool,
+                        const VkAllocationCallbacks *) {
+  if (fakeDevice.pools.erase(descriptorPool) == 0) {
+    throw std::runtime_error("destroyed an unknown pool!");
+  }
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkResetDescriptorPool(VkDevice, VkDescriptorPool descriptorPool,
+                      VkDescriptorPoolResetFlags) {
+  fakeDevice.pools.at(descriptorPool).allocated = 0;
+  fakeDevice.poolResets++;
+  return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkAllocateDescriptorSets(VkDevice,
+                         const VkDescriptorSetAllocateInfo *pAllocateInfo,
+                         VkDescriptorSet *pDescriptorSets) {
+  FakeDevice::FakePool &pool =
+      fakeDevice.pools.at(pAllocateInfo->descriptorPool);
+  if (pool.allocated + pAllocateInfo->descriptorSetCount > pool.maxSets) {
+    return VK_ERROR_OUT_OF_POOL_MEMORY;
+  }
+  for (uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; i++) {
+    pDescriptorSets[i] = fakeDevice.makeHandle<VkDescriptorSet>();
+  }
+  pool.allocated += pAllocateInfo->descriptorSetCount;
+  return VK_SUCCESS;
+}
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + "!");
+  }
+}
+
+// Describes a single descriptor binding.
+// ~Returns: the binding.
+static VkDescriptorSetLayoutBinding binding(uint32_t index,
+                                            VkDescriptorType type,
+                                            VkShaderStageFlags stages) {
+  VkDescriptorSetLayoutBinding layoutBinding = {};
+  layoutBinding.binding = index;
+  layoutBinding.descriptorType = type;
+  layoutBinding.descriptorCount = 1;
+  layoutBinding.stageFlags = stages;
+  return layoutBinding;
+}
+
+// Identical binding lists share one layout, in any order; a list that
+// differs in any field gets its own.
+static void testLayoutDeduplication() {
+  DescriptorLayoutCache cache;
+  cache.init(VK_NULL_HANDLE);
+  auto storage = [](uint32_t index) {
+    return binding(index, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                   VK_SHADER_STAGE_COMPUTE_BIT);
+  };
+
+  VkDescriptorSetLayout first = cache.get({storage(0), storage(1)});
+  check(cache.get({storage(0), storage(1)}) == first,
+        "an identical binding list created a second layout");
+  check(cache.get({storage(1), storage(0)}) == first,
+        "reordered bindings created a second layout");
+  check(fakeDevice.layoutsCreated == 1 && cache.size() == 1,
+        "the cache created more than one layout");
+
+  VkDescriptorSetLayoutBinding vertex = storage(1);
+  vertex.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  VkDescriptorSetLayoutBinding uniform = storage(1);
+  uniform.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  VkDescriptorSetLayoutBinding array = storage(1);
+  array.descriptorCount = 2;
+  check(cache.get({storage(0), vertex}) != first &&
+            cache.get({storage(0), uniform}) != first &&
+            cache.get({storage(0), array}) != first &&
+            cache.get({storage(0)}) != first,
+        "different bindings shared a layout");
+  check(cache.size() == 5, "the cache holds " +
+                               std::to_string(cache.size()) +
+                               " layouts instead of 5");
+
+  cache.destroy();
+  check(fakeDevice.layouts.empty(), "destroy() left layouts alive");
+}
+
+// Frame sets come from the frame's own pools, which grow when full and
+// are recycled by resetFrame() without touching other frames or the
+// persistent pools.
+static void testFramePools() {
+  DescriptorLayoutCache cache;
+  cache.init(VK_NULL_HANDLE);
+  VkDescriptorSetLayout layout = cache.get(
+      {binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+               VK_SHADER_STAGE_VERTEX_BIT)});
+
+  DescriptorAllocator allocator;
+  allocator.init(VK_NULL_HANDLE, 2);
+  allocator.allocate(layout);
+  check(fakeDevice.pools.size() == 1, "a persistent set made no pool");
+
+  // one more set than a pool holds spills into a second pool
+  for (uint32_t i = 0; i <= DESCRIPTOR_POOL_SETS; i++) {
+    allocator.allocateFrame(0, layout);
+  }
+  check(fakeDevice.pools.size() == 3, "frame 0 didn't grow to two pools");
+  allocator.allocateFrame(1, layout);
+  check(fakeDevice.pools.size() == 4, "frame 1 shared frame 0's pools");
+
+  size_t resets = fakeDevice.poolResets;
+  allocator.resetFrame(0);
+  check(fakeDevice.poolResets == resets + 2,
+        "resetFrame() didn't reset both of the frame's pools");
+  // left: the persistent set and frame 1's set
+  uint32_t liveSets = 0;
+  for (const auto &pool : fakeDevice.pools) {
+    liveSets += pool.second.allocated;
+  }
+  check(liveSets == 2,
+        "resetFrame() recycled sets of another frame or persistent sets");
+
+  // a recycled frame reuses its pools instead of creating more
+  for (uint32_t round = 0; round < 4; round++) {
+    for (uint32_t i = 0; i <= DESCRIPTOR_POOL_SETS; i++) {
+      allocator.allocateFrame(0, layout);
+    }
+    allocator.resetFrame(0);
+  }
+  check(fakeDevice.pools.size() == 4, "recycled frames created pools");
+
+  // a frame with nothing allocated since its reset isn't reset again
+  resets = fakeDevice.poolResets;
+  allocator.resetFrame(0);
+  check(fakeDevice.poolResets == resets, "an unused frame was reset");
+
+  allocator.destroy();
+  cache.destroy();
+  check(fakeDevice.pools.empty(), "destroy() left pools alive");
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main() {
+  try {
+    testLayoutDeduplication();
+    testFramePools();
+  } catch (const std::exception &e) {
+    std::cerr << "descriptor allocator test failed: " << e.what()
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "descriptor allocator tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
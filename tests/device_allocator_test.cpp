@@ -0,0 +1,457 @@
+//===================================================================
+// File: device_allocator_test.cpp
+//
+// Desc: Tests the device allocator without a GPU, against a fake
+//       memory backend.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/device_allocator.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const VkDeviceSize TEST_BLOCK_SIZE = 1 << 20;     // small blocks, 1 MiB
+const VkDeviceSize TEST_GRANULARITY = 1024;       // bufferImageGranularity
+const uint32_t TEST_DEVICE_LOCAL_TYPE = 0;
+const uint32_t TEST_HOST_VISIBLE_TYPE = 1;
+
+//-------------------------------------------------------------------
+// FakeMemoryBackend (Class Definition)
+//-------------------------------------------------------------------
+
+// Hands out host memory as device memory blocks and counts the calls, so
+// tests can see which blocks the allocator creates, maps and releases.
+class FakeMemoryBackend : public MemoryBackend {
+public:
+  VkResult allocate(uint32_t memoryTypeIndex, VkDeviceSize size,
+                    VkDeviceMemory *memory) override {
+    uint64_t id = nextId++;
+    static_assert(sizeof(VkDeviceMemory) == sizeof(id),
+                  "handles are 64 bits on every platform");
+    std::memcpy(memory, &id, sizeof(id));
+    blocks[*memory] = {memoryTypeIndex, std::vector<char>(size), false};
+    allocateCount++;
+    return VK_SUCCESS;
+  }
+  void free(VkDeviceMemory memory) override {
+    if (blocks.at(memory).mapped) {
+      throw std::runtime_error("freed a block that is still mapped!");
+    }
+    blocks.erase(memory);
+  }
+  void *map(VkDeviceMemory memory) override {
+    blocks.at(memory).mapped = true;
+    return blocks.at(memory).data.data();
+  }
+  void unmap(VkDeviceMemory memory) override {
+    blocks.at(memory).mapped = false;
+  }
+
+  size_t liveBlocks() const { return blocks.size(); }
+  VkDeviceSize blockSize(VkDeviceMemory memory) const {
+    return blocks.at(memory).data.size();
+  }
+  char *blockData(VkDeviceMemory memory) {
+    return blocks.at(memory).data.data();
+  }
+  uint32_t memoryType(VkDeviceMemory memory) const {
+    return blocks.at(memory).memoryTypeIndex;
+  }
+
+  size_t allocateCount = 0;
+
+private:
+  struct FakeBlock {
+    uint32_t memoryTypeIndex;
+    std::vector<char> data;
+    bool mapped;
+  };
+  std::map<VkDeviceMemory, FakeBlock> blocks;
+  uint64_t nextId = 1;
+};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + "!");
+  }
+}
+
+// Sets up an allocator with a device local and a host visible memory type.
+static void initAllocator(DeviceAllocator &allocator,
+                          FakeMemoryBackend &backend,
+                          AllocationStrategy strategy) {
+  VkPhysicalDeviceMemoryProperties memoryProperties = {};
+  memoryProperties.memoryTypeCount = 2;
+  memoryProperties.memoryTypes[TEST_DEVICE_LOCAL_TYPE].propertyFlags =
+      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+  memoryProperties.memoryTypes[TEST_HOST_VISIBLE_TYPE].propertyFlags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+  VkPhysicalDeviceLimits limits = {};
+  limits.bufferImageGranularity = TEST_GRANULARITY;
+  limits.maxMemoryAllocationCount = 64;
+  allocator.init(&backend, memoryProperties, limits, strategy,
+                 TEST_BLOCK_SIZE);
+}
+
+// Requirements of a resource that may live in either memory type.
+// ~Returns: VkMemoryRequirements struct.
+static VkMemoryRequirements requirements(VkDeviceSize size,
+                                         VkDeviceSize alignment) {
+  VkMemoryRequirements memRequirements = {};
+  memRequirements.size = size;
+  memRequirements.alignment = alignment;
+  memRequirements.memoryTypeBits = 0x3;
+  return memRequirements;
+}
+
+// Allocates device local memory.
+// ~Returns: the allocation.
+static MemoryAllocation allocate(DeviceAllocator &allocator, VkDeviceSize size,
+                                 VkDeviceSize alignment,
+                                 AllocationKind kind = ALLOCATION_KIND_LINEAR) {
+  return allocator.allocate(requirements(size, alignment),
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, kind);
+}
+
+// Packs free list allocations back to back within one block.
+static void testFreeListAllocation() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+
+  MemoryAllocation a = allocate(allocator, 1000, 256);
+  MemoryAllocation b = allocate(allocator, 1000, 256);
+  MemoryAllocation c = allocate(allocator, 1000, 256);
+  check(a.offset == 0 && b.offset == 1024 && c.offset == 2048,
+        "free list allocations aren't packed");
+  check(a.memory == b.memory && b.memory == c.memory,
+        "small allocations didn't share a block");
+  check(backend.liveBlocks() == 1, "more than one block was created");
+  check(backend.memoryType(a.memory) == TEST_DEVICE_LOCAL_TYPE,
+        "wrong memory type chosen");
+
+  AllocationStats stats = allocator.stats();
+  check(stats.allocationCount == 3 && stats.usedBytes == 3000,
+        "stats don't count the allocations");
+  check(stats.blockBytes == TEST_BLOCK_SIZE, "stats miscount block bytes");
+  allocator.destroy();
+  check(backend.liveBlocks() == 0, "destroy() leaked blocks");
+}
+
+// Places linear allocations behind each other, reclaiming a block only
+// once it is empty, and moves on to a new block when one is full.
+static void testLinearAllocation() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_LINEAR);
+
+  MemoryAllocation a = allocate(allocator, 100, 16);
+  MemoryAllocation b = allocate(allocator, 100, 16);
+  check(a.offset == 0 && b.offset == 112, "linear allocations aren't bumped");
+
+  // freeing the first doesn't make its space reusable
+  allocator.free(a);
+  MemoryAllocation c = allocate(allocator, 100, 16);
+  check(c.offset == 224, "linear strategy reused a freed range");
+
+  // an empty block starts over
+  allocator.free(b);
+  allocator.free(c);
+  MemoryAllocation d = allocate(allocator, 100, 16);
+  check(d.offset == 0, "empty linear block wasn't reset");
+
+  // a full block makes room in a new one
+  MemoryAllocation e = allocate(allocator, TEST_BLOCK_SIZE / 2, 16);
+  MemoryAllocation f = allocate(allocator, TEST_BLOCK_SIZE / 2, 16);
+  check(e.memory == d.memory && f.memory != d.memory && f.offset == 0,
+        "full linear block wasn't followed by a new one");
+  allocator.destroy();
+}
+
+// Honors every requested alignment.
+static void testAlignment() {
+  for (AllocationStrategy strategy :
+       {ALLOCATION_STRATEGY_FREE_LIST, ALLOCATION_STRATEGY_LINEAR}) {
+    FakeMemoryBackend backend;
+    DeviceAllocator allocator;
+    initAllocator(allocator, backend, strategy);
+
+    MemoryAllocation small = allocate(allocator, 100, 1);
+    MemoryAllocation page = allocate(allocator, 100, 4096);
+    check(small.offset == 0 && page.offset == 4096,
+          "4096 byte alignment not honored");
+
+    VkDeviceSize alignments[] = {1, 4, 16, 64, 256, 512, 2048};
+    for (uint32_t i = 0; i < 50; i++) {
+      VkDeviceSize alignment = alignments[i % 7];
+      MemoryAllocation allocation =
+          allocate(allocator, 37 + i * 13, alignment);
+      check(allocation.offset % alignment == 0,
+            "offset " + std::to_string(allocation.offset) +
+                " isn't aligned to " + std::to_string(alignment));
+    }
+    allocator.destroy();
+  }
+}
+
+// Keeps linear and optimal resources off each other's
+// bufferImageGranularity pages, while resources of one kind may share a
+// page.
+static void testGranularity() {
+  for (AllocationStrategy strategy :
+       {ALLOCATION_STRATEGY_FREE_LIST, ALLOCATION_STRATEGY_LINEAR}) {
+    FakeMemoryBackend backend;
+    DeviceAllocator allocator;
+    initAllocator(allocator, backend, strategy);
+
+    MemoryAllocation buffer = allocate(allocator, 100, 16);
+    MemoryAllocation otherBuffer = allocate(allocator, 100, 16);
+    check(otherBuffer.offset == 112, "same kinds didn't share a page");
+
+    MemoryAllocation image =
+        allocate(allocator, 100, 16, ALLOCATION_KIND_OPTIMAL);
+    check(image.offset == TEST_GRANULARITY,
+          "optimal image shares a page with a buffer");
+    MemoryAllocation otherImage =
+        allocate(allocator, 100, 16, ALLOCATION_KIND_OPTIMAL);
+    check(otherImage.offset == TEST_GRANULARITY + 112,
+          "optimal images didn't share a page");
+
+    // the free list strategy fills the space in front of the images, the
+    // linear one skips the images' page
+    MemoryAllocation lastBuffer = allocate(allocator, 100, 16);
+    VkDeviceSize expected = strategy == ALLOCATION_STRATEGY_FREE_LIST
+                                ? 224
+                                : 2 * TEST_GRANULARITY;
+    check(lastBuffer.offset == expected,
+          "buffer shares a page with an optimal image");
+    (void)buffer;
+    allocator.destroy();
+  }
+
+  // a free range squeezed between pages of the other kind only fits a
+  // resource that stays off both pages
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+  allocate(allocator, 512, 16, ALLOCATION_KIND_OPTIMAL);
+  MemoryAllocation gap =
+      allocate(allocator, 1024, 16, ALLOCATION_KIND_OPTIMAL);
+  allocate(allocator, 512, 16, ALLOCATION_KIND_OPTIMAL);
+  allocator.free(gap);
+  MemoryAllocation buffer = allocate(allocator, 256, 16);
+  check(buffer.offset != 512, "buffer placed on an optimal image's page");
+  MemoryAllocation image =
+      allocate(allocator, 256, 16, ALLOCATION_KIND_OPTIMAL);
+  check(image.offset == 512, "optimal image didn't reuse the gap");
+  allocator.destroy();
+}
+
+// Merges freed ranges with their free neighbours and reuses them.
+static void testFreeAndCoalesce() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+
+  MemoryAllocation a = allocate(allocator, 256, 256);
+  MemoryAllocation b = allocate(allocator, 256, 256);
+  MemoryAllocation c = allocate(allocator, 256, 256);
+
+  allocator.free(b);
+  check(allocator.stats().freeRegionCount == 2, "freed range not listed");
+  allocator.free(a);
+  AllocationStats stats = allocator.stats();
+  check(stats.freeRegionCount == 2 && stats.largestFreeRegion ==
+                                          TEST_BLOCK_SIZE - 768,
+        "neighbouring free ranges weren't merged");
+
+  MemoryAllocation merged = allocate(allocator, 512, 256);
+  check(merged.offset == 0, "merged range wasn't reused");
+
+  allocator.free(merged);
+  allocator.free(c);
+  stats = allocator.stats();
+  check(stats.freeRegionCount == 1 && stats.freeBytes == TEST_BLOCK_SIZE,
+        "empty block isn't one free range");
+  check(stats.allocationCount == 0 && stats.usedBytes == 0,
+        "stats still count freed allocations");
+  check(backend.liveBlocks() == 1, "the empty shared block wasn't kept");
+
+  bool threw = false;
+  try {
+    allocator.free(c);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  check(threw, "double free wasn't detected");
+  allocator.destroy();
+}
+
+// Picks the free range with the least space left after the placement,
+// counting the padding alignment adds.
+static void testBestFitAfterPadding() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+
+  // free ranges [16, 8208) and [12288, 18432), kept apart by used ones
+  allocate(allocator, 16, 1);
+  MemoryAllocation unaligned = allocate(allocator, 8192, 1);
+  allocate(allocator, 4080, 1);
+  MemoryAllocation aligned = allocate(allocator, 6144, 1);
+  allocate(allocator, 16, 1);
+  check(unaligned.offset == 16 && aligned.offset == 12288,
+        "unexpected layout");
+  allocator.free(unaligned);
+  allocator.free(aligned);
+
+  // the first range is larger, but placed at 4096 only 16 bytes remain,
+  // against 2048 in the second
+  MemoryAllocation page = allocate(allocator, 4096, 4096);
+  check(page.offset == 4096, "best fit ignored alignment padding, placed at " +
+                                 std::to_string(page.offset));
+  allocator.destroy();
+}
+
+// Gives large resources a block of their own, released once freed, and
+// keeps small ones out of it.
+static void testDedicatedAllocations() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+
+  VkDeviceSize largeSize = TEST_BLOCK_SIZE / 2 + 4096;
+  MemoryAllocation large = allocate(allocator, largeSize, 256);
+  check(large.offset == 0 && backend.blockSize(large.memory) == largeSize,
+        "large resource didn't get a dedicated block");
+  MemoryAllocation small = allocate(allocator, 256, 256);
+  check(small.memory != large.memory,
+        "small resource placed in a dedicated block");
+  check(allocator.stats().blockCount == 2, "stats miscount blocks");
+
+  allocator.free(large);
+  check(backend.liveBlocks() == 1, "empty dedicated block wasn't released");
+
+  // a resource of exactly a block is dedicated too
+  MemoryAllocation whole = allocate(allocator, TEST_BLOCK_SIZE, 256);
+  check(whole.memory != small.memory, "block sized resource shared a block");
+  allocator.free(whole);
+  allocator.free(small);
+  check(backend.liveBlocks() == 1,
+        "block sized dedicated block kept as the spare");
+  MemoryAllocation reused = allocate(allocator, 256, 256);
+  check(reused.memory == small.memory, "spare shared block wasn't reused");
+  allocator.destroy();
+}
+
+// Reports free space and how scattered it is.
+static void testFragmentationStats() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+  check(allocator.stats().fragmentation() == 0.0,
+        "empty allocator reports fragmentation");
+
+  const VkDeviceSize size = 64 << 10;
+  std::vector<MemoryAllocation> allocations;
+  for (uint32_t i = 0; i < 8; i++) {
+    allocations.push_back(allocate(allocator, size, 256));
+  }
+  AllocationStats stats = allocator.stats();
+  check(stats.freeRegionCount == 1 && stats.fragmentation() == 0.0,
+        "contiguous free space reported as fragmented");
+
+  for (uint32_t i = 0; i < 8; i += 2) {
+    allocator.free(allocations[i]);
+  }
+  stats = allocator.stats();
+  check(stats.freeRegionCount == 5, "free ranges miscounted");
+  check(stats.freeBytes == TEST_BLOCK_SIZE - 4 * size,
+        "free bytes miscounted");
+  check(stats.largestFreeRegion == TEST_BLOCK_SIZE - 8 * size,
+        "largest free range wrong");
+  double expected = 1.0 - double(TEST_BLOCK_SIZE - 8 * size) /
+                               double(TEST_BLOCK_SIZE - 4 * size);
+  check(stats.fragmentation() == expected, "fragmentation wrong");
+  allocator.destroy();
+}
+
+// Maps host visible blocks once and points allocations into them.
+static void testHostVisibleMemory() {
+  FakeMemoryBackend backend;
+  DeviceAllocator allocator;
+  initAllocator(allocator, backend, ALLOCATION_STRATEGY_FREE_LIST);
+
+  MemoryAllocation device = allocate(allocator, 256, 256);
+  check(device.mapped == nullptr, "device local memory is mapped");
+  MemoryAllocation host = allocator.allocate(
+      requirements(256, 256), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      ALLOCATION_KIND_LINEAR);
+  MemoryAllocation next = allocator.allocate(
+      requirements(256, 256), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+      ALLOCATION_KIND_LINEAR);
+  check(backend.memoryType(host.memory) == TEST_HOST_VISIBLE_TYPE,
+        "host visible request got another memory type");
+  check(host.mapped == backend.blockData(host.memory) &&
+            next.mapped == backend.blockData(next.memory) + next.offset,
+        "mapped pointer doesn't match the offset");
+
+  VkMemoryRequirements unsupported = requirements(256, 256);
+  unsupported.memoryTypeBits = 0x1;
+  bool threw = false;
+  try {
+    allocator.allocate(unsupported, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                       ALLOCATION_KIND_LINEAR);
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  check(threw, "request without a matching memory type didn't throw");
+
+  // destroy() unmaps before freeing, the backend throws otherwise
+  allocator.destroy();
+  check(backend.liveBlocks() == 0, "destroy() leaked blocks");
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main() {
+  try {
+    testFreeListAllocation();
+    testLinearAllocation();
+    testAlignment();
+    testGranularity();
+    testFreeAndCoalesce();
+    testBestFitAfterPadding();
+    testDedicatedAllocations();
+    testFragmentationStats();
+    testHostVisibleMemory();
+  } catch (const std::exception &e) {
+    std::cerr << "device allocator test failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "device allocator tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+//===================================================================
+// File: device_selection_test.cpp
+//
+// Desc: Tests device scoring and selection against hand built device
+//       candidates.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/device_selection.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + "!");
+  }
+}
+
+// Builds a candidate with one graphics family and heapMiB of device local
+// memory, as the application would from Vulkan.
+// ~Returns: the candidate.
+static DeviceCandidate makeCandidate(uint32_t index, const char *name,
+                                     VkPhysicalDeviceType type,
+                                     uint64_t heapMiB, bool suitable = true) {
+  DeviceCandidate candidate;
+  candidate.index = index;
+  std::strncpy(candidate.properties.deviceName, name,
+               VK_MAX_PHYSICAL_DEVICE_NAME_SIZE - 1);
+  candidate.properties.deviceType = type;
+  candidate.properties.apiVersion = VK_API_VERSION_1_1;
+  candidate.memoryProperties.memoryHeapCount = 1;
+  candidate.memoryProperties.memoryHeaps[0].size = heapMiB << 20;
+  candidate.memoryProperties.memoryHeaps[0].flags =
+      VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+  VkQueueFamilyProperties family = {};
+  family.queueFlags =
+      VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT;
+  family.queueCount = 1;
+  candidate.queueFamilies.push_back(family);
+  candidate.suitable = suitable;
+  return candidate;
+}
+
+// Runs selectDevice and reports whether it threw the expected message.
+// ~Returns: true if it threw message.
+static bool selectThrows(const std::vector<DeviceCandidate> &candidates,
+                         const std::string &override,
+                         const std::string &message) {
+  try {
+    selectDevice(candidates, override);
+  } catch (const std::runtime_error &e) {
+    return e.what() == message;
+  }
+  return false;
+}
+
+// A discrete GPU outranks an integrated one with far more memory, and an
+// unsuitable device ranks last whatever it is.
+static void testRanking() {
+  std::vector<DeviceCandidate> candidates = {
+      makeCandidate(0, "Big Discrete", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+                    65536, false),
+      makeCandidate(1, "Integrated", VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU,
+                    32768),
+      makeCandidate(2, "Discrete", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU,
+                    2048)};
+  std::vector<DeviceRanking> rankings = rankDevices(candidates);
+  check(rankings.size() == 3, "rankDevices() dropped candidates");
+  check(rankings[0].index == 2 && rankings[1].index == 1,
+        "an integrated GPU with a larger heap beat a discrete GPU");
+  check(rankings[2].index == 0 &&
+            rankings[2].score == DEVICE_SCORE_UNSUITABLE,
+        "an unsuitable device wasn't ranked last");
+  check(selectDevice(candidates, "") == 2,
+        "selectDevice() didn't pick the best suitable device");
+}
+
+// Devices that score the same keep the order they were enumerated in.
+static void testTiesKeepOrder() {
+  std::vector<DeviceCandidate> candidates;
+  for (uint32_t i = 0; i < 4; i++) {
+    candidates.push_back(makeCandidate(
+        i, "Twin", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192));
+  }
+  std::vector<DeviceRanking> rankings = rankDevices(candidates);
+  for (uint32_t i = 0; i < 4; i++) {
+    check(rankings[i].index == i, "equal scores changed order");
+  }
+  check(selectDevice(candidates, "") == 0,
+        "a tie didn't pick the first device");
+}
+
+// An override picks a device by enumeration index or by a case
+// insensitive part of its name, over a better scoring device, and throws
+// when it matches nothing or an unsuitable device.
+static void testOverrides() {
+  std::vector<DeviceCandidate> candidates = {
+      makeCandidate(0, "AMD Radeon RX 580",
+                    VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192),
+      makeCandidate(1, "Intel(R) UHD Graphics 630",
+                    VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU, 4096),
+      makeCandidate(2, "llvmpipe", VK_PHYSICAL_DEVICE_TYPE_CPU, 1024, false)};
+
+  check(selectDevice(candidates, "1") == 1,
+        "an index override wasn't honoured");
+  check(selectDevice(candidates, "uhd GRAPHICS") == 1,
+        "a mixed case name override wasn't honoured");
+  check(selectDevice(candidates, "radeon") == 0,
+        "a name override picked the wrong device");
+
+  check(selectThrows(candidates, "7", "no GPU matches 7!"),
+        "an unknown index override didn't throw");
+  check(selectThrows(candidates, "GeForce", "no GPU matches GeForce!"),
+        "an unknown name override didn't throw");
+  check(selectThrows(candidates, "LLVMpipe",
+                     "GPU llvmpipe can't run the renderer!"),
+        "an override naming an unsuitable device didn't throw");
+  check(selectThrows(candidates, "2", "GPU llvmpipe can't run the renderer!"),
+        "an index override of an unsuitable device didn't throw");
+}
+
+// With no suitable device, or none at all, selection fails.
+static void testNoSuitableDevice() {
+  std::vector<DeviceCandidate> candidates = {
+      makeCandidate(0, "Broken", VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU, 8192,
+                    false),
+      makeCandidate(1, "llvmpipe", VK_PHYSICAL_DEVICE_TYPE_CPU, 1024, false)};
+  check(selectThrows(candidates, "", "failed to find a suitable GPU!"),
+        "selection with only unsuitable devices didn't throw");
+  check(selectThrows({}, "", "failed to find a suitable GPU!"),
+        "selection without devices didn't throw");
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main() {
+  try {
+    testRanking();
+    testTiesKeepOrder();
+    testOverrides();
+    testNoSuitableDevice();
+  } catch (const std::exception &e) {
+    std::cerr << "device selection test failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "device selection tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,353 @@
+//===================================================================
+// File: job_system_test.cpp
+//
+// Desc: Stresses the job system for correctness under contention, with
+//       more workers than cores so threads get preempted mid-operation.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/job_system.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const uint32_t JOB_TEST_ROUNDS = 10;          // rounds of each test
+const uint32_t JOB_TEST_RACE_ROUNDS = 20000;  // tiny batches per race test
+const uint32_t JOB_TEST_WORKER_COUNTS[] = {0, 1, 3, 8};
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + "!");
+  }
+}
+
+// Submits a binary tree of jobs from inside jobs, all against one counter.
+static void spawnTree(JobSystem &jobs, JobCounter &counter,
+                      std::atomic<uint64_t> &nodes, uint32_t depth) {
+  nodes.fetch_add(1, std::memory_order_relaxed);
+  if (depth == 0) {
+    return;
+  }
+  for (int child = 0; child < 2; child++) {
+    jobs.submit(counter, [&jobs, &counter, &nodes, depth](uint32_t) {
+      spawnTree(jobs, counter, nodes, depth - 1);
+    });
+  }
+}
+
+// Every index of a parallel loop runs exactly once, on a valid thread.
+static void testParallelFor(JobSystem &jobs) {
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    size_t count = 10000 + round * 997;
+    std::vector<std::atomic<uint32_t>> hits(count);
+    jobs.parallelFor(count, [&](size_t i, uint32_t thread) {
+      check(thread < jobs.size(), "thread index out of range");
+      hits[i].fetch_add(1, std::memory_order_relaxed);
+    });
+    for (size_t i = 0; i < count; i++) {
+      check(hits[i].load() == 1, "parallelFor ran an index " +
+                                     std::to_string(hits[i].load()) +
+                                     " times");
+    }
+  }
+}
+
+// A worker submits a few jobs and pops them back while the other workers
+// try to steal them, so the owner's pop and the thieves' steals race for
+// the last items of a deque over and over. Every job must run once.
+static void testStealPopRace(JobSystem &jobs) {
+  std::atomic<uint64_t> ran{0};
+  uint64_t expected = 0;
+  for (uint32_t i = 0; i < JOB_TEST_RACE_ROUNDS; i++) {
+    expected += i % 4 + 1;
+  }
+
+  JobCounter root;
+  jobs.submit(root, [&](uint32_t) {
+    for (uint32_t i = 0; i < JOB_TEST_RACE_ROUNDS; i++) {
+      JobCounter batch;
+      for (uint32_t j = 0; j <= i % 4; j++) {
+        jobs.submit(batch, [&](uint32_t) {
+          ran.fetch_add(1, std::memory_order_relaxed);
+        });
+      }
+      jobs.wait(batch);
+    }
+  });
+  jobs.wait(root);
+  check(ran.load() == expected, "steal and pop races lost or repeated " +
+                                    std::to_string(expected - ran.load()) +
+                                    " jobs");
+
+  // more jobs than a deque holds run inline once it is full
+  JobCounter overflow;
+  std::atomic<uint64_t> overflowed{0};
+  const size_t overflowCount = JOB_QUEUE_CAPACITY * 3;
+  jobs.submit(overflow, [&](uint32_t) {
+    JobCounter inner;
+    for (size_t i = 0; i < overflowCount; i++) {
+      jobs.submit(inner, [&](uint32_t) {
+        overflowed.fetch_add(1, std::memory_order_relaxed);
+      });
+    }
+    jobs.wait(inner);
+  });
+  jobs.wait(overflow);
+  check(overflowed.load() == overflowCount, "a full deque lost jobs");
+}
+
+// Jobs wait on the counters of jobs they depend on, counters are reused
+// once waited on, and an exception reaches the waiter and leaves the
+// counter usable. A waiting thread may pick up any queued job, so jobs
+// only wait on jobs that don't wait themselves, or on jobs they spawned.
+static void testCounterDependencies(JobSystem &jobs) {
+  const uint32_t width = 64;
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    // the dependent jobs start while the jobs they wait for are still
+    // queued or running, and run those while waiting
+    JobCounter first, second, dependents;
+    std::atomic<uint32_t> firstDone{0}, secondDone{0};
+    for (uint32_t i = 0; i < width; i++) {
+      jobs.submit(first, [&](uint32_t) { firstDone.fetch_add(1); });
+      jobs.submit(second, [&](uint32_t) { secondDone.fetch_add(1); });
+    }
+    for (uint32_t i = 0; i < width; i++) {
+      jobs.submit(dependents, [&](uint32_t) {
+        jobs.wait(first);
+        jobs.wait(second);
+        check(firstDone.load() == width && secondDone.load() == width,
+              "a job ran before the jobs it waits for finished");
+      });
+    }
+    jobs.wait(dependents);
+  }
+
+  // pipelines whose stages each fan out and wait before the next starts,
+  // several at once so waiters run other pipelines' stages
+  const uint32_t pipelines = 4;
+  const uint32_t stages = 8;
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    JobCounter all;
+    std::atomic<uint32_t> finished{0};
+    for (uint32_t p = 0; p < pipelines; p++) {
+      jobs.submit(all, [&](uint32_t) {
+        for (uint32_t stage = 0; stage < stages; stage++) {
+          JobCounter stageCounter;
+          std::atomic<uint32_t> done{0};
+          for (uint32_t i = 0; i < width; i++) {
+            jobs.submit(stageCounter, [&](uint32_t) { done.fetch_add(1); });
+          }
+          jobs.wait(stageCounter);
+          check(done.load() == width, "a stage finished with jobs pending");
+        }
+        finished.fetch_add(1);
+      });
+    }
+    jobs.wait(all);
+    check(finished.load() == pipelines, "a pipeline didn't finish");
+  }
+
+  // jobs submitting jobs against the counter being waited on
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    JobCounter tree;
+    std::atomic<uint64_t> nodes{0};
+    uint32_t depth = 10 + round % 4;
+    jobs.submit(tree, [&](uint32_t) { spawnTree(jobs, tree, nodes, depth); });
+    jobs.wait(tree);
+    check(nodes.load() == (uint64_t(2) << depth) - 1,
+          "job tree lost or repeated nodes");
+  }
+
+  // one counter reused across waits, one of which fails
+  JobCounter reused;
+  std::atomic<uint32_t> ran{0};
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    bool fail = round % 3 == 1;
+    for (uint32_t i = 0; i < 100; i++) {
+      jobs.submit(reused, [&, fail, i](uint32_t) {
+        ran.fetch_add(1);
+        if (fail && i == 57) {
+          throw std::runtime_error("job failure");
+        }
+      });
+    }
+    bool caught = false;
+    try {
+      jobs.wait(reused);
+    } catch (const std::runtime_error &) {
+      caught = true;
+    }
+    check(caught == fail, fail ? "an exception thrown by a job was lost"
+                               : "a stale exception was rethrown");
+    check(reused.isDone(), "a counter wasn't done after its wait");
+  }
+  check(ran.load() == JOB_TEST_ROUNDS * 100, "a reused counter lost jobs");
+}
+
+// Parallel loops inside parallel loops, three levels deep, with every
+// level waiting on its own loop.
+static void testNestedParallelFor(JobSystem &jobs) {
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    std::atomic<uint64_t> sum{0};
+    jobs.parallelFor(16, [&](size_t i, uint32_t) {
+      jobs.parallelFor(16, [&](size_t j, uint32_t) {
+        jobs.parallelFor(16, [&](size_t k, uint32_t thread) {
+          check(thread < jobs.size(), "thread index out of range");
+          sum.fetch_add(i * 256 + j * 16 + k, std::memory_order_relaxed);
+        });
+      });
+    });
+    check(sum.load() == 4096ull * 4095 / 2, "nested parallelFor lost work");
+
+    // a failure deep inside reaches the outermost caller
+    bool caught = false;
+    try {
+      jobs.parallelFor(8, [&](size_t i, uint32_t) {
+        jobs.parallelFor(8, [&](size_t j, uint32_t) {
+          if (i == 5 && j == 3) {
+            throw std::runtime_error("nested failure");
+          }
+        });
+      });
+    } catch (const std::runtime_error &) {
+      caught = true;
+    }
+    check(caught, "a nested exception was lost");
+  }
+}
+
+// A thread that isn't a worker runs queued jobs while it waits: with the
+// workers all blocked it must run the job it waits for itself, under the
+// index shared by non-worker threads.
+static void testWaitHelps(JobSystem &jobs) {
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    std::atomic<bool> release{false};
+    std::atomic<uint32_t> blocked{0};
+    JobCounter blockers;
+    for (uint32_t i = 0; i < jobs.workerCount(); i++) {
+      jobs.submit(blockers, [&](uint32_t) {
+        blocked.fetch_add(1);
+        while (!release.load()) {
+          std::this_thread::yield();
+        }
+      });
+    }
+    while (blocked.load() < jobs.workerCount()) {
+      std::this_thread::yield();
+    }
+
+    JobCounter counter;
+    std::atomic<uint32_t> helper{UINT32_MAX};
+    jobs.submit(counter, [&](uint32_t thread) {
+      helper = thread;
+      release = true;
+    });
+    jobs.wait(counter);
+    check(helper.load() == jobs.workerCount(),
+          "the waiting thread didn't run the job itself");
+    jobs.wait(blockers);
+  }
+
+  // outside threads submitting and waiting at once
+  const uint32_t submitters = 4;
+  std::atomic<uint64_t> total{0};
+  std::vector<std::thread> threads;
+  for (uint32_t t = 0; t < submitters; t++) {
+    threads.emplace_back([&]() {
+      for (int repeat = 0; repeat < 8; repeat++) {
+        jobs.parallelFor(1000, [&](size_t, uint32_t) {
+          total.fetch_add(1, std::memory_order_relaxed);
+        });
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  check(total.load() == submitters * 8 * 1000,
+        "concurrent submitters lost work");
+}
+
+// Background jobs and the jobs they spawn only run on workers, and the
+// waits of a non-worker thread keep finishing while they run, even when
+// its steals turn up background jobs.
+static void testBackgroundJobs(JobSystem &jobs) {
+  const size_t count = 4096;
+  for (uint32_t round = 0; round < JOB_TEST_ROUNDS; round++) {
+    JobCounter background;
+    std::atomic<uint32_t> frames{0};
+    std::atomic<uint64_t> ran{0};
+    std::atomic<bool> strayed{false};
+    bool workers = jobs.workerCount() > 0;
+    jobs.submitBackground(background, [&](uint32_t thread) {
+      if (workers && thread >= jobs.workerCount()) {
+        strayed = true;
+      }
+      // hold a worker until frames have finished without it
+      while (workers && frames.load() < 8) {
+        std::this_thread::yield();
+      }
+      jobs.parallelFor(count, [&](size_t, uint32_t thread) {
+        if (workers && thread >= jobs.workerCount()) {
+          strayed = true;
+        }
+        ran.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+      });
+    });
+
+    // frame jobs yield too, so the frame waits go stealing while
+    // background jobs are queued
+    while (!background.isDone()) {
+      jobs.parallelFor(64, [&](size_t, uint32_t) {
+        std::this_thread::yield();
+      });
+      frames.fetch_add(1);
+    }
+    jobs.wait(background);
+    check(!strayed.load(), "a background job ran on a non-worker thread");
+    check(ran.load() == count, "background jobs lost work");
+  }
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main() {
+  try {
+    for (uint32_t workers : JOB_TEST_WORKER_COUNTS) {
+      JobSystem jobs(workers);
+      testParallelFor(jobs);
+      testStealPopRace(jobs);
+      testCounterDependencies(jobs);
+      testNestedParallelFor(jobs);
+      testWaitHelps(jobs);
+      testBackgroundJobs(jobs);
+      std::cout << "job system tests passed with " << workers
+                << " worker(s)" << std::endl;
+    }
+  } catch (const std::exception &e) {
+    std::cerr << "job system test failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
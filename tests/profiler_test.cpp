@@ -0,0 +1,92 @@
+//===================================================================
+// File: profiler_test.cpp
+//
+// Desc: Tests that exported Chrome traces keep spans apart to the
+//       microsecond.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/profiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const char *PROFILER_TEST_TRACE = "profiler_test_trace.json";
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + "!");
+  }
+}
+
+// Finds the span called name in an exported trace and reads its fields.
+// ~Returns: the text of field key, such as "ts", for that span.
+static std::string spanField(const std::string &trace, const std::string &name,
+                             const std::string &key) {
+  size_t span = trace.find("\"name\":\"" + name + "\"");
+  check(span != std::string::npos, "span " + name + " wasn't exported");
+  size_t field = trace.find("\"" + key + "\":", span);
+  check(field != std::string::npos, "span " + name + " has no " + key);
+  size_t begin = field + key.size() + 3;
+  size_t end = trace.find_first_of(",}", begin);
+  return trace.substr(begin, end - begin);
+}
+
+// Spans a microsecond apart, recorded well after the clock's epoch, still
+// export to different timestamps and their exact durations.
+static void testTimestampPrecision() {
+  uint64_t start = Profiler::now();
+  Profiler::record("first", start, start + 1000);
+  Profiler::record("second", start + 1000, start + 2500);
+  check(Profiler::exportChromeTrace(PROFILER_TEST_TRACE),
+        "failed to write the trace");
+
+  std::ifstream file(PROFILER_TEST_TRACE);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  std::string trace = contents.str();
+  std::remove(PROFILER_TEST_TRACE);
+
+  check(trace.find("e+") == std::string::npos,
+        "the trace has numbers in scientific notation");
+  double first = std::stod(spanField(trace, "first", "ts"));
+  double second = std::stod(spanField(trace, "second", "ts"));
+  check(second - first > 0.999 && second - first < 1.001,
+        "spans 1 us apart exported " + std::to_string(second - first) +
+            " us apart");
+  check(spanField(trace, "second", "dur") == "1.500",
+        "a 1.5 us span exported as " + spanField(trace, "second", "dur"));
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main() {
+  try {
+    testTimestampPrecision();
+  } catch (const std::exception &e) {
+    std::cerr << "profiler test failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "profiler tests passed" << std::endl;
+  return EXIT_SUCCESS;
+}
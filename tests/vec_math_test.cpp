@@ -0,0 +1,257 @@
+//===================================================================
+// File: vec_math_test.cpp
+//
+// Desc: Tests the SIMD math kernels against the scalar path and a few
+//       known identities.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/vec_math.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------------
+// Global Constants
+//-------------------------------------------------------------------
+
+const float MATH_TEST_TOLERANCE = 1e-5f; // relative, per element
+const size_t MATH_TEST_MAX_BATCH = 19;   // past two AVX2 widths plus a tail
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Throws with message unless condition holds.
+static void check(bool condition, const std::string &message) {
+  if (!condition) {
+    throw std::runtime_error(message + " (" + vecMathBackend() + ")!");
+  }
+}
+
+// Compares two float arrays element by element, relative to the larger
+// magnitude so big translations don't hide small errors. scale is the
+// smallest magnitude compared against; products pass the size of their
+// terms, since FMA and summation order change rounding when large terms
+// cancel.
+// ~Returns: true if every element is within MATH_TEST_TOLERANCE.
+static bool nearlyEqual(const float *a, const float *b, size_t count,
+                        float scale) {
+  for (size_t i = 0; i < count; i++) {
+    float magnitude = std::max({std::fabs(a[i]), std::fabs(b[i]), scale});
+    if (std::fabs(a[i] - b[i]) > MATH_TEST_TOLERANCE * magnitude) {
+      return false;
+    }
+  }
+  return true;
+}
+static bool nearlyEqual(const Mat4 &a, const Mat4 &b, float scale = 1.0f) {
+  return nearlyEqual(&a.columns[0].x, &b.columns[0].x, 16, scale);
+}
+static bool nearlyEqual(const Vec4 &a, const Vec4 &b, float scale = 1.0f) {
+  return nearlyEqual(&a.x, &b.x, 4, scale);
+}
+
+// Bounds the size of the terms summed into any element of a product.
+// ~Returns: four times the largest elements of both operands multiplied.
+static float termScale(const float *a, size_t aCount, const float *b,
+                       size_t bCount) {
+  float aMax = 0.0f, bMax = 0.0f;
+  for (size_t i = 0; i < aCount; i++) {
+    aMax = std::max(aMax, std::fabs(a[i]));
+  }
+  for (size_t i = 0; i < bCount; i++) {
+    bMax = std::max(bMax, std::fabs(b[i]));
+  }
+  return std::max(4.0f * aMax * bMax, 1.0f);
+}
+static float termScale(const Mat4 &a, const Mat4 &b) {
+  return termScale(&a.columns[0].x, 16, &b.columns[0].x, 16);
+}
+static float termScale(const Mat4 &m, const Vec4 &v) {
+  return termScale(&m.columns[0].x, 16, &v.x, 4);
+}
+
+// Builds the transform of a randomly placed, rotated and scaled object.
+// ~Returns: the transform.
+static Mat4 randomTransform(std::mt19937 &random) {
+  std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+  std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+  std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+  Vec3 axis = vec3(position(random), position(random), position(random));
+  return mat4Compose(
+      vec3(position(random), position(random), position(random)),
+      quatFromAxisAngle(axis, angle(random)),
+      vec3(scale(random), scale(random), scale(random)));
+}
+
+// Fills every element of a matrix, so projections and other matrices
+// without a 0 0 0 1 last row are covered too.
+// ~Returns: the matrix.
+static Mat4 randomMatrix(std::mt19937 &random) {
+  std::uniform_real_distribution<float> value(-10.0f, 10.0f);
+  Mat4 m;
+  for (Vec4 &column : m.columns) {
+    column = vec4(value(random), value(random), value(random), value(random));
+  }
+  return m;
+}
+
+// mat4Mul matches the scalar product and leaves the identity alone.
+static void testMat4Mul(std::mt19937 &random) {
+  for (uint32_t i = 0; i < 1000; i++) {
+    Mat4 a = i % 2 ? randomTransform(random) : randomMatrix(random);
+    Mat4 b = i % 3 ? randomTransform(random) : randomMatrix(random);
+    check(nearlyEqual(mat4Mul(a, b), mat4MulScalar(a, b), termScale(a, b)),
+          "mat4Mul disagrees with the scalar path");
+  }
+
+  Mat4 m = randomTransform(random);
+  Mat4 identity = mat4Identity();
+  check(nearlyEqual(identity * m, m) && nearlyEqual(m * identity, m),
+        "multiplying by the identity changed a matrix");
+}
+
+// mat4MulVec4 matches the scalar product and moves points as composed.
+static void testMat4MulVec4(std::mt19937 &random) {
+  std::uniform_real_distribution<float> value(-50.0f, 50.0f);
+  for (uint32_t i = 0; i < 1000; i++) {
+    Mat4 m = i % 2 ? randomTransform(random) : randomMatrix(random);
+    Vec4 v = vec4(value(random), value(random), value(random), value(random));
+    check(nearlyEqual(mat4MulVec4(m, v), mat4MulVec4Scalar(m, v),
+                      termScale(m, v)),
+          "mat4MulVec4 disagrees with the scalar path");
+  }
+
+  // a quarter turn around z maps x onto y
+  Mat4 turn = mat4Compose(vec3(1.0f, 2.0f, 3.0f),
+                          quatFromAxisAngle(vec3(0.0f, 0.0f, 1.0f),
+                                            1.5707963f),
+                          vec3(2.0f, 2.0f, 2.0f));
+  check(nearlyEqual(turn * vec4(1.0f, 0.0f, 0.0f, 1.0f),
+                    vec4(1.0f, 4.0f, 3.0f, 1.0f)),
+        "composed transform moved a point wrongly");
+}
+
+// Composing rotations as quaternions or as matrices agrees, with the
+// right operand applied first.
+static void testQuatCompose(std::mt19937 &random) {
+  std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> angle(-3.14159f, 3.14159f);
+  Vec3 one = vec3(1.0f, 1.0f, 1.0f), zero = vec3(0.0f, 0.0f, 0.0f);
+  for (uint32_t i = 0; i < 1000; i++) {
+    Quat a = quatFromAxisAngle(
+        vec3(value(random), value(random), value(random) + 2.0f),
+        angle(random));
+    Quat b = quatFromAxisAngle(
+        vec3(value(random) + 2.0f, value(random), value(random)),
+        angle(random));
+    Mat4 viaQuat = mat4Compose(zero, normalize(a * b), one);
+    Mat4 viaMat4 = mat4Compose(zero, a, one) * mat4Compose(zero, b, one);
+    check(nearlyEqual(viaQuat, viaMat4),
+          "quaternion and matrix rotations disagree");
+  }
+
+  // a quarter turn around x then around z takes y to z and then stays
+  Quat aroundX = quatFromAxisAngle(vec3(1.0f, 0.0f, 0.0f), 1.5707963f);
+  Quat aroundZ = quatFromAxisAngle(vec3(0.0f, 0.0f, 1.0f), 1.5707963f);
+  Mat4 rotation = mat4Compose(zero, aroundZ * aroundX, one);
+  check(nearlyEqual(rotation * vec4(0.0f, 1.0f, 0.0f, 0.0f),
+                    vec4(0.0f, 0.0f, 1.0f, 0.0f)),
+        "quaternion product applied in the wrong order");
+  check(nearlyEqual(mat4Compose(zero, quatIdentity() * aroundX, one),
+                    mat4Compose(zero, aroundX, one)),
+        "identity quaternion changed a rotation");
+}
+
+// The batch kernels match their scalar versions for every count up to a
+// few SIMD widths, so partial tails are covered, never write past count
+// and accept out aliasing the input.
+static void testBatchKernels(std::mt19937 &random) {
+  Mat4 single = randomMatrix(random);
+  std::vector<Mat4> a(MATH_TEST_MAX_BATCH + 1), b(MATH_TEST_MAX_BATCH + 1);
+  std::vector<Vec4> points(MATH_TEST_MAX_BATCH + 1);
+  for (size_t i = 0; i <= MATH_TEST_MAX_BATCH; i++) {
+    a[i] = randomTransform(random);
+    b[i] = randomMatrix(random);
+    points[i] = mat4MulVec4Scalar(a[i], vec4(1.0f, 2.0f, 3.0f, 1.0f));
+  }
+
+  Mat4 sentinel = mat4Identity();
+  sentinel.columns[3].x = 12345.0f;
+  Vec4 pointSentinel = vec4(12345.0f, 0.0f, 0.0f, 1.0f);
+  for (size_t count = 0; count <= MATH_TEST_MAX_BATCH; count++) {
+    std::string suffix = " for " + std::to_string(count) + " items";
+    std::vector<Mat4> out(count + 1, sentinel), expected(count + 1);
+
+    mat4MulBatch(single, b.data(), out.data(), count);
+    mat4MulBatchScalar(single, b.data(), expected.data(), count);
+    for (size_t i = 0; i < count; i++) {
+      check(nearlyEqual(out[i], expected[i], termScale(single, b[i])),
+            "mat4MulBatch disagrees with the scalar path" + suffix);
+    }
+    check(nearlyEqual(out[count], sentinel),
+          "mat4MulBatch wrote past the end" + suffix);
+
+    std::fill(out.begin(), out.end(), sentinel);
+    mat4MulPairs(a.data(), b.data(), out.data(), count);
+    mat4MulPairsScalar(a.data(), b.data(), expected.data(), count);
+    for (size_t i = 0; i < count; i++) {
+      check(nearlyEqual(out[i], expected[i], termScale(a[i], b[i])),
+            "mat4MulPairs disagrees with the scalar path" + suffix);
+    }
+    check(nearlyEqual(out[count], sentinel),
+          "mat4MulPairs wrote past the end" + suffix);
+
+    std::vector<Vec4> moved(count + 1, pointSentinel), movedExpected(count);
+    mat4TransformBatch(single, points.data(), moved.data(), count);
+    mat4TransformBatchScalar(single, points.data(), movedExpected.data(),
+                             count);
+    for (size_t i = 0; i < count; i++) {
+      check(nearlyEqual(moved[i], movedExpected[i],
+                        termScale(single, points[i])),
+            "mat4TransformBatch disagrees with the scalar path" + suffix);
+    }
+    check(nearlyEqual(moved[count], pointSentinel),
+          "mat4TransformBatch wrote past the end" + suffix);
+
+    // in place, as the header allows
+    std::vector<Mat4> inPlace(b.begin(), b.begin() + count);
+    mat4MulBatch(single, inPlace.data(), inPlace.data(), count);
+    mat4MulBatchScalar(single, b.data(), expected.data(), count);
+    for (size_t i = 0; i < count; i++) {
+      check(nearlyEqual(inPlace[i], expected[i], termScale(single, b[i])),
+            "mat4MulBatch in place disagrees" + suffix);
+    }
+  }
+}
+
+//-------------------------------------------------------------------
+// Main Entry Point
+//-------------------------------------------------------------------
+
+int main() {
+  try {
+    // fixed seed, so failures reproduce
+    std::mt19937 random(1234);
+    testMat4Mul(random);
+    testMat4MulVec4(random);
+    testQuatCompose(random);
+    testBatchKernels(random);
+  } catch (const std::exception &e) {
+    std::cerr << "math test failed: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+  std::cout << "math tests passed (" << vecMathBackend() << ")" << std::endl;
+  return EXIT_SUCCESS;
+}
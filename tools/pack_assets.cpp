@@ -0,0 +1,67 @@
+//===================================================================
+// File: pack_assets.cpp
+//
+// Desc: Packs SPIR-V modules and other assets into one archive that
+//       the renderer memory maps at startup.
+//
+// Copyright © 2019 Edwin Cloud. All rights reserved.
+//===================================================================
+
+//-------------------------------------------------------------------
+// Includes
+//-------------------------------------------------------------------
+#include "../includes/asset_archive.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+//-------------------------------------------------------------------
+// Global Functions
+//-------------------------------------------------------------------
+
+// Reads a whole file into an asset named after the file, without its
+// directory.
+// ~Returns: asset ready for writeAssetArchive().
+static AssetSource readAsset(const std::string &path) {
+  std::ifstream file(path, std::ios::ate | std::ios::binary);
+  if (!file.is_open()) {
+    throw std::runtime_error("failed to open " + path + "!");
+  }
+
+  AssetSource asset;
+  size_t slash = path.find_last_of("/\\");
+  asset.name = slash == std::string::npos ? path : path.substr(slash + 1);
+  asset.data.resize(static_cast<size_t>(file.tellg()));
+  file.seekg(0);
+  file.read(asset.data.data(), asset.data.size());
+  return asset;
+}
+
+// Packs the files named on the command line into the archive given first.
+int main(int argc, char **argv) {
+  if (argc < 2 || std::string(argv[1]) == "--help") {
+    std::cout << "usage: " << argv[0] << " <archive> <file>...\n"
+              << "Packs files into an archive, each named after its file\n"
+              << "name without the directory.\n";
+    return argc < 2 ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  try {
+    std::vector<AssetSource> assets;
+    uint64_t totalSize = 0;
+    for (int i = 2; i < argc; i++) {
+      assets.push_back(readAsset(argv[i]));
+      totalSize += assets.back().data.size();
+    }
+    writeAssetArchive(argv[1], std::move(assets));
+    std::cout << "packed " << argc - 2 << " assets (" << totalSize
+              << " bytes) into " << argv[1] << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}